@@ -0,0 +1,55 @@
+/* bench.h - Small timing helpers shared by the benchmark programs. */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Seconds since an arbitrary fixed point. */
+static inline double benchNow(void)
+{
+  return std::chrono::duration<double>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Keep the compiler from discarding a result the benchmark never reads. */
+template <typename T>
+static inline void benchKeep(const T &value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  __asm__ __volatile__("" : : "r"(&value) : "memory");
+#else
+  static const void *volatile sink;
+  sink = &value;
+#endif
+}
+
+/* Run fn() repeatedly until at least minSeconds have passed and return the
+   best (lowest) time of a single run, in seconds. */
+template <typename Fn>
+static double benchBest(Fn fn, double minSeconds = 0.25)
+{
+  double best = 1e30, start = benchNow();
+  int runs = 0;
+
+  do {
+    double t0 = benchNow();
+    fn();
+    double t = benchNow() - t0;
+    if (t < best)
+      best = t;
+    runs++;
+  } while (benchNow() - start < minSeconds || runs < 3);
+  return best;
+}
+
+/* Deterministic pseudo-random float in [lo, hi). */
+static inline float benchRandom(unsigned int *state, float lo, float hi)
+{
+  *state = *state * 1664525u + 1013904223u;
+  return lo + (hi - lo) * ((*state >> 8) * (1.0f / 16777216.0f));
+}
+
+#endif /* BENCH_H */
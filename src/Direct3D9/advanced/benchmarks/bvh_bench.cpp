@@ -0,0 +1,399 @@
+/* bvh_bench.cpp - BVH build time and ray throughput (bvh.h) on the Labs' models and a large tiled scene.
+
+   Usage: bvh_bench [file.obj ...]
+
+   For each mesh (without arguments, Lab5's model_for_cga.obj, Lab6's
+   retopoly.obj, and a field of 8x8 tessellated tori of 32768 triangles
+   each): buildBvh time on one thread and on all of them (checking that
+   the trees match), nodes, memory, and SAH cost.  Then rays per second
+   for three streams of 512x512 rays, each on one thread one ray at a
+   time, at the best SIMD level, and on all threads:
+
+     camera   closest hits of a pinhole camera's rays, ordered in 4x2
+              pixel tiles so each 8-ray packet is coherent;
+     shadow   occlusion of rays from the camera hits toward a point light;
+     random   closest hits of rays with random origins in the bounding
+              box and random directions, the packets' worst case.
+
+   Every level's hits are checked against the single-ray ones, and a
+   sample of camera rays against testing every triangle; a few rays that
+   graze an edge can come out differently from different arithmetic. */
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#include "bench.h"
+#include "objmodel.h"
+#include "../cgfx_buffer_lighting/bvh.h"
+#include "../cgfx_buffer_lighting/matrix.h"
+#include "../cgfx_buffer_lighting/parallel.h"
+#include "../cgfx_buffer_lighting/tessellate.h"
+
+static const int myImageSize = 512;
+
+/* Most triangle tests for the brute force check. */
+static const double myBruteForceTests = 2e8;
+
+typedef struct {
+  std::vector<float> positions;     /* 3 per vertex */
+  std::vector<unsigned int> indices;
+  float lo[3], hi[3];
+} Scene;
+
+static void boundScene(Scene &s)
+{
+  for (int k = 0; k < 3; k++) {
+    s.lo[k] = 1e30f;
+    s.hi[k] = -1e30f;
+  }
+  for (size_t i = 0; i < s.positions.size(); i++) {
+    int k = (int) (i % 3);
+
+    if (s.positions[i] < s.lo[k])
+      s.lo[k] = s.positions[i];
+    if (s.positions[i] > s.hi[k])
+      s.hi[k] = s.positions[i];
+  }
+}
+
+static void normalize3(float *v)
+{
+  float n = sqrtf(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+
+  v[0] /= n;
+  v[1] /= n;
+  v[2] /= n;
+}
+
+static void cross3(float *c, const float *a, const float *b)
+{
+  c[0] = a[1]*b[2] - a[2]*b[1];
+  c[1] = a[2]*b[0] - a[0]*b[2];
+  c[2] = a[0]*b[1] - a[1]*b[0];
+}
+
+/* Camera rays from above and to one side of the scene, in 4x2 pixel tiles. */
+static void makeCameraRays(std::vector<BvhRay> &rays, const Scene &s)
+{
+  const float away[3] = { 0.4f, 0.7f, 1.0f }, up[3] = { 0, 1, 0 };
+  const float halfWidth = 0.6f;
+  float center[3], radius = 0, eye[3], forward[3], right[3], down[3];
+  int i = 0;
+
+  for (int k = 0; k < 3; k++) {
+    center[k] = 0.5f * (s.lo[k] + s.hi[k]);
+    radius += 0.25f * (s.hi[k] - s.lo[k]) * (s.hi[k] - s.lo[k]);
+  }
+  radius = sqrtf(radius);
+  memcpy(forward, away, sizeof(forward));
+  normalize3(forward);
+  for (int k = 0; k < 3; k++) {
+    eye[k] = center[k] + forward[k] * radius * 1.5f;
+    forward[k] = -forward[k];
+  }
+  cross3(right, forward, up);
+  normalize3(right);
+  cross3(down, forward, right);
+
+  rays.resize(myImageSize * myImageSize);
+  for (int ty = 0; ty < myImageSize; ty += 2)
+    for (int tx = 0; tx < myImageSize; tx += 4)
+      for (int y = ty; y < ty + 2; y++)
+        for (int x = tx; x < tx + 4; x++, i++) {
+          float sx = ((x + 0.5f) / myImageSize * 2 - 1) * halfWidth,
+                sy = ((y + 0.5f) / myImageSize * 2 - 1) * halfWidth;
+
+          for (int k = 0; k < 3; k++) {
+            rays[i].origin[k] = eye[k];
+            rays[i].direction[k] = forward[k] + sx * right[k] + sy * down[k];
+          }
+          rays[i].tMin = 0;
+          rays[i].tMax = 1e30f;
+        }
+}
+
+/* Rays from the hits toward a light above the scene; t runs to 1 at the light. */
+static void makeShadowRays(std::vector<BvhRay> &shadow, const std::vector<BvhRay> &rays,
+                           const std::vector<BvhHit> &hits, const Scene &s)
+{
+  float light[3], size = 0;
+
+  for (int k = 0; k < 3; k++)
+    size = fmaxf(size, s.hi[k] - s.lo[k]);
+  light[0] = s.lo[0] - 0.5f * size;
+  light[1] = s.hi[1] + 2.0f * size;
+  light[2] = 0.5f * (s.lo[2] + s.hi[2]);
+  shadow.clear();
+  for (size_t i = 0; i < rays.size(); i++) {
+    BvhRay r;
+
+    if (hits[i].triangle < 0)
+      continue;
+    for (int k = 0; k < 3; k++) {
+      r.origin[k] = rays[i].origin[k] + hits[i].t * rays[i].direction[k];
+      r.direction[k] = light[k] - r.origin[k];
+    }
+    r.tMin = 1e-4f;
+    r.tMax = 1;
+    shadow.push_back(r);
+  }
+}
+
+static void makeRandomRays(std::vector<BvhRay> &rays, const Scene &s)
+{
+  unsigned int seed = 12345;
+
+  rays.resize(myImageSize * myImageSize);
+  for (size_t i = 0; i < rays.size(); i++) {
+    float d[3];
+
+    do {
+      for (int k = 0; k < 3; k++)
+        d[k] = benchRandom(&seed, -1, 1);
+    } while (d[0]*d[0] + d[1]*d[1] + d[2]*d[2] > 1 || d[0]*d[0] + d[1]*d[1] + d[2]*d[2] < 1e-4f);
+    normalize3(d);
+    for (int k = 0; k < 3; k++) {
+      rays[i].origin[k] = benchRandom(&seed, s.lo[k], s.hi[k]);
+      rays[i].direction[k] = d[k];
+    }
+    rays[i].tMin = 0;
+    rays[i].tMax = 1e30f;
+  }
+}
+
+/* Closest hit by testing every triangle, in double precision. */
+static int bruteForceHit(const Scene &s, const BvhRay &ray, double *tBest)
+{
+  int best = -1;
+
+  *tBest = ray.tMax;
+  for (size_t t = 0; t + 2 < s.indices.size(); t += 3) {
+    const float *p0 = &s.positions[3 * s.indices[t]], *p1 = &s.positions[3 * s.indices[t+1]],
+                *p2 = &s.positions[3 * s.indices[t+2]];
+    double e1[3], e2[3], o[3], p[3], q[3], det, u, v, d;
+
+    for (int k = 0; k < 3; k++) {
+      e1[k] = p1[k] - p0[k];
+      e2[k] = p2[k] - p0[k];
+      o[k] = ray.origin[k] - p0[k];
+    }
+    p[0] = ray.direction[1]*e2[2] - ray.direction[2]*e2[1];
+    p[1] = ray.direction[2]*e2[0] - ray.direction[0]*e2[2];
+    p[2] = ray.direction[0]*e2[1] - ray.direction[1]*e2[0];
+    det = e1[0]*p[0] + e1[1]*p[1] + e1[2]*p[2];
+    if (det == 0)
+      continue;
+    u = (o[0]*p[0] + o[1]*p[1] + o[2]*p[2]) / det;
+    q[0] = o[1]*e1[2] - o[2]*e1[1];
+    q[1] = o[2]*e1[0] - o[0]*e1[2];
+    q[2] = o[0]*e1[1] - o[1]*e1[0];
+    v = (ray.direction[0]*q[0] + ray.direction[1]*q[1] + ray.direction[2]*q[2]) / det;
+    d = (e2[0]*q[0] + e2[1]*q[1] + e2[2]*q[2]) / det;
+    if (u >= 0 && v >= 0 && u + v <= 1 && d > ray.tMin && d < *tBest) {
+      *tBest = d;
+      best = (int) (t / 3);
+    }
+  }
+  return best;
+}
+
+/* Hits that disagree: a different triangle at a different distance. */
+static int countMismatches(const std::vector<BvhHit> &a, const std::vector<BvhHit> &b)
+{
+  int bad = 0;
+
+  for (size_t i = 0; i < a.size(); i++)
+    if (a[i].triangle != b[i].triangle &&
+        (a[i].triangle < 0 || b[i].triangle < 0 ||
+         fabsf(a[i].t - b[i].t) > 1e-4f * fmaxf(1.0f, fabsf(a[i].t))))
+      bad++;
+  return bad;
+}
+
+static void reportStream(const char *name, const Bvh *bvh, const std::vector<BvhRay> &rays,
+                         bool shadow)
+{
+  MatrixSimdLevel support = getMatrixSimdSupport();
+  int count = (int) rays.size(), threads = getParallelThreadCount(), found = 0;
+  std::vector<BvhHit> reference(count), hits(count);
+  std::vector<int> referenceOccluded(count), occluded(count);
+
+  if (count == 0)
+    return;
+  printf("  %-7s %7d rays", name, count);
+
+  /* One thread, each ray alone, at each SIMD level; then all threads. */
+  for (int pass = 0; pass <= 2; pass++) {
+    const char *label = pass == 0 ? "single" : pass == 1 ? getMatrixSimdLevelName(support) : "threads";
+    double t;
+    int bad;
+
+    setParallelThreadCount(pass < 2 ? 1 : 0);
+    setMatrixSimdLevel(pass == 0 ? MATRIX_SIMD_SCALAR : support);
+    if (pass == 1 && support < MATRIX_SIMD_AVX2)
+      continue;
+    if (pass == 2 && threads == 1)
+      continue;
+    t = benchBest([&] {
+      if (shadow)
+        occludedBvhArray(bvh, &rays[0], pass == 0 ? &referenceOccluded[0] : &occluded[0], count);
+      else
+        intersectBvhArray(bvh, &rays[0], pass == 0 ? &reference[0] : &hits[0], count);
+    }, 0.2);
+    if (pass == 0) {
+      for (int i = 0; i < count; i++)
+        found += shadow ? referenceOccluded[i] : reference[i].triangle >= 0;
+      printf(", %5.1f%% %s\n", 100.0 * found / count, shadow ? "occluded" : "hit");
+      bad = 0;
+    } else if (shadow) {
+      bad = 0;
+      for (int i = 0; i < count; i++)
+        bad += occluded[i] != referenceOccluded[i];
+    } else {
+      bad = countMismatches(reference, hits);
+    }
+    printf("    %-8s %8.2f Mrays/s  %d differ\n", label, count / t * 1e-6, bad);
+  }
+  setParallelThreadCount(0);
+  setMatrixSimdLevel(support);
+}
+
+static void reportScene(const char *name, Scene &s)
+{
+  int triangles = (int) s.indices.size() / 3, threads = getParallelThreadCount(), leaves = 0;
+  std::vector<BvhRay> camera, shadowRays, random;
+  std::vector<BvhHit> hits;
+  std::vector<BvhNode> serialNodes;
+  Bvh bvh;
+
+  boundScene(s);
+  printf("%s: %d triangles\n", name, triangles);
+  for (int n = 1; n <= threads; n = n < threads ? threads : n + 1) {
+    double t;
+
+    setParallelThreadCount(n);
+    t = benchBest([&] {
+      buildBvh(&bvh, &s.positions[0], 3, &s.indices[0], (int) s.indices.size());
+      if (n == 1)
+        serialNodes.assign(bvh.nodes, bvh.nodes + bvh.nodeCount);
+      else
+        benchKeep(bvh.nodes[0]);
+      freeBvh(&bvh);
+    }, 0.5);
+    printf("  build %2d threads: %8.1f ms, %.2f M triangles/s\n", n, t * 1e3,
+      triangles / t * 1e-6);
+  }
+  setParallelThreadCount(0);
+  buildBvh(&bvh, &s.positions[0], 3, &s.indices[0], (int) s.indices.size());
+  for (int i = 0; i < bvh.nodeCount; i++)
+    leaves += bvh.nodes[i].count > 0;
+  printf("  %d nodes (%d leaves, %.2f triangles each), %.1f KB, SAH cost %.1f, %s one thread's\n",
+    bvh.nodeCount, leaves, (double) triangles / leaves,
+    (bvh.nodeCount * sizeof(BvhNode) + triangles * (sizeof(BvhTriangle) + 4)) / 1024.0,
+    getBvhCost(&bvh),
+    (int) serialNodes.size() == bvh.nodeCount &&
+      memcmp(&serialNodes[0], bvh.nodes, serialNodes.size() * sizeof(BvhNode)) == 0 ?
+      "same tree as" : "DIFFERENT tree from");
+
+  makeCameraRays(camera, s);
+  hits.resize(camera.size());
+  intersectBvhArray(&bvh, &camera[0], &hits[0], (int) camera.size());
+  makeShadowRays(shadowRays, camera, hits, s);
+  makeRandomRays(random, s);
+  reportStream("camera", &bvh, camera, false);
+  reportStream("shadow", &bvh, shadowRays, true);
+  reportStream("random", &bvh, random, false);
+
+  /* Every k-th camera ray against every triangle. */
+  {
+    int step = (int) ceil(camera.size() * (double) triangles / myBruteForceTests), checked = 0, bad = 0;
+    double t0 = benchNow(), t;
+
+    if (step < 1)
+      step = 1;
+    for (size_t i = 0; i < camera.size(); i += step, checked++) {
+      BvhHit hit;
+      int best = bruteForceHit(s, camera[i], &t);
+
+      intersectBvh(&bvh, &camera[i], &hit);
+      if (best != hit.triangle && (best < 0 || hit.triangle < 0 ||
+                                   fabs(t - hit.t) > 1e-4 * fmax(1.0, fabs(t))))
+        bad++;
+    }
+    t = benchNow() - t0;
+    printf("  brute force: %d rays, %.3f Mrays/s, %d differ\n", checked, checked / t * 1e-6, bad);
+  }
+  freeBvh(&bvh);
+  printf("\n");
+}
+
+static void reportObj(const char *path)
+{
+  const char *name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+  ObjModel m;
+  Scene s;
+
+  if (!readObj(path, m)) {
+    fprintf(stderr, "bvh_bench: cannot open %s\n", path);
+    return;
+  }
+  s.positions.resize(3 * m.vertices.size());
+  for (size_t i = 0; i < m.vertices.size(); i++)
+    memcpy(&s.positions[3 * i], m.vertices[i].position, 3 * sizeof(float));
+  s.indices.swap(m.indices);
+  reportScene(name, s);
+}
+
+/* Tori tumbled to random angles on a grid. */
+static void reportTiledScene(int tiles)
+{
+  TorusSurface torus = { 0.75f, 0.25f };
+  ParametricSurface surface = { evaluateTorusSurface, &torus, sizeof(torus) };
+  SurfaceMesh mesh;
+  Scene s;
+  unsigned int seed = 7;
+  char name[64];
+
+  tessellateSurface(&mesh, &surface, 256, 64, SURFACE_TRIANGLE_LIST);
+  for (int tz = 0; tz < tiles; tz++)
+    for (int tx = 0; tx < tiles; tx++) {
+      unsigned int base = (unsigned int) (s.positions.size() / 3);
+      float a = benchRandom(&seed, 0, 3.14159f), b = benchRandom(&seed, 0, 3.14159f),
+            ca = cosf(a), sa = sinf(a), cb = cosf(b), sb = sinf(b);
+
+      for (int i = 0; i < mesh.vertexCount; i++) {
+        const float *p = mesh.vertices[i].position;
+        float y = ca*p[1] - sa*p[2], z = sa*p[1] + ca*p[2], x = cb*p[0] + sb*z;
+
+        s.positions.push_back(x + 2.0f * tx);
+        s.positions.push_back(y);
+        s.positions.push_back(-sb*p[0] + cb*z + 2.0f * tz);
+      }
+      for (int i = 0; i < mesh.indexCount; i++)
+        s.indices.push_back(base + mesh.indices[i]);
+    }
+  freeSurfaceMesh(&mesh);
+  sprintf(name, "%dx%d tiled tori", tiles, tiles);
+  reportScene(name, s);
+}
+
+int main(int argc, char **argv)
+{
+  static const char *defaults[] = {
+    "../../../Labs/Lab5/model_for_cga.obj",
+    "../../../Labs/Lab6/retopoly.obj"
+  };
+
+  printf("SIMD support: %s, %d threads\n\n", getMatrixSimdLevelName(getMatrixSimdSupport()),
+    getParallelThreadCount());
+  if (argc > 1) {
+    for (int i = 1; i < argc; i++)
+      reportObj(argv[i]);
+  } else {
+    for (int i = 0; i < (int) (sizeof(defaults) / sizeof(defaults[0])); i++)
+      reportObj(defaults[i]);
+    reportTiledScene(8);
+  }
+  return 0;
+}
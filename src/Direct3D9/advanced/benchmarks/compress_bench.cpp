@@ -0,0 +1,206 @@
+/* compress_bench.cpp - Packed vertex formats (compress.h): size, error, and encode/decode speed.
+
+   Usage: compress_bench [file.obj ...]
+
+   For tessellated meshes (a 256x128 sphere and a 512x256 torus) and
+   loaded ones (without arguments, Lab5's model_for_cga.obj and Lab6's
+   retopoly.obj, flat shaded as they are drawn), with each texture
+   coordinate format: bytes per vertex against MeshVertex, the largest
+   position error (in bounding radii), normal error (degrees), and
+   texture coordinate error after a round trip, and packVertices and
+   unpackVertices throughput at each SIMD level, checking that every
+   level gives the scalar version's bits.  The tessellated meshes'
+   tangents go through encodeOctahedralArray as well. */
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#include "bench.h"
+#include "objmodel.h"
+#include "../cgfx_buffer_lighting/compress.h"
+#include "../cgfx_buffer_lighting/matrix.h"
+#include "../cgfx_buffer_lighting/simplify.h"
+#include "../cgfx_buffer_lighting/tessellate.h"
+
+static const double myDegrees = 57.29577951308232;
+static const char *myTexCoordFormatName[2] = { "half", "unorm16" };
+
+/* Angle between a and b in degrees; 0 if either is zero. */
+static double angleBetween(const float *a, const float *b)
+{
+  double ab = 0, aa = 0, bb = 0, c;
+
+  for (int k = 0; k < 3; k++) {
+    ab += (double) a[k] * b[k];
+    aa += (double) a[k] * a[k];
+    bb += (double) b[k] * b[k];
+  }
+  if (aa == 0 || bb == 0)
+    return 0;
+  c = ab / sqrt(aa * bb);
+  return acos(c > 1 ? 1 : c < -1 ? -1 : c) * myDegrees;
+}
+
+static void reportMesh(const char *name, const std::vector<MeshVertex> &vertices,
+                       const std::vector<float> &tangents)
+{
+  const int count = (int) vertices.size();
+  MatrixSimdLevel support = getMatrixSimdSupport();
+  std::vector<PackedVertex> packed(count), reference(count);
+  std::vector<MeshVertex> unpacked(count), referenceUnpacked(count);
+  double radius = 0;
+
+  printf("%s: %d vertices, %d bytes each as MeshVertex, %d packed\n", name, count,
+    (int) sizeof(MeshVertex), (int) sizeof(PackedVertex));
+  printf("%-8s %-7s %10s %10s %10s %12s %12s %8s\n", "format", "simd", "position",
+    "normal deg", "texcoord", "pack Mv/s", "unpack Mv/s", "bits");
+
+  for (int format = PACK_TEXCOORD_HALF; format <= PACK_TEXCOORD_UNORM16; format++) {
+    PackedMeshInfo info;
+    double positionError = 0, normalError = 0, texCoordError = 0;
+
+    getPackedMeshInfo(&info, &vertices[0], count, (PackTexCoordFormat) format);
+    radius = sqrt((double) info.positionScale[0] * info.positionScale[0] +
+                  (double) info.positionScale[1] * info.positionScale[1] +
+                  (double) info.positionScale[2] * info.positionScale[2]);
+
+    setMatrixSimdLevel(MATRIX_SIMD_SCALAR);
+    packVertices(&reference[0], &vertices[0], count, &info);
+    unpackVertices(&referenceUnpacked[0], &reference[0], count, &info);
+    for (int i = 0; i < count; i++) {
+      const MeshVertex &a = vertices[i], &b = referenceUnpacked[i];
+      double n = angleBetween(a.normal, b.normal);
+
+      for (int k = 0; k < 3; k++)
+        if (fabs(a.position[k] - b.position[k]) / radius > positionError)
+          positionError = fabs(a.position[k] - b.position[k]) / radius;
+      for (int k = 0; k < 2; k++)
+        if (fabs(a.texCoord[k] - b.texCoord[k]) > texCoordError)
+          texCoordError = fabs(a.texCoord[k] - b.texCoord[k]);
+      if (n > normalError)
+        normalError = n;
+    }
+
+    for (int level = MATRIX_SIMD_SCALAR; level <= support; level++) {
+      double pack, unpack;
+      bool same;
+
+      setMatrixSimdLevel((MatrixSimdLevel) level);
+      pack = benchBest([&] {
+        packVertices(&packed[0], &vertices[0], count, &info);
+        benchKeep(packed[0]);
+      }, 0.1);
+      unpack = benchBest([&] {
+        unpackVertices(&unpacked[0], &packed[0], count, &info);
+        benchKeep(unpacked[0]);
+      }, 0.1);
+      same = memcmp(&packed[0], &reference[0], count * sizeof(PackedVertex)) == 0 &&
+             memcmp(&unpacked[0], &referenceUnpacked[0], count * sizeof(MeshVertex)) == 0;
+      printf("%-8s %-7s %10.3g %10.4f %10.3g %12.1f %12.1f %8s\n", myTexCoordFormatName[format],
+        getMatrixSimdLevelName((MatrixSimdLevel) level), positionError, normalError,
+        texCoordError, count / pack * 1e-6, count / unpack * 1e-6, same ? "same" : "DIFFER");
+    }
+  }
+
+  if (!tangents.empty()) {
+    std::vector<short> codes(2 * count), referenceCodes(2 * count);
+    std::vector<float> decoded(3 * count), referenceDecoded(3 * count);
+    double tangentError = 0;
+
+    setMatrixSimdLevel(MATRIX_SIMD_SCALAR);
+    encodeOctahedralArray(&referenceCodes[0], &tangents[0], 3, count);
+    decodeOctahedralArray(&referenceDecoded[0], 3, &referenceCodes[0], count);
+    for (int i = 0; i < count; i++) {
+      double a = angleBetween(&tangents[3*i], &referenceDecoded[3*i]);
+
+      if (a > tangentError)
+        tangentError = a;
+    }
+    printf("tangents: 12 bytes as floats, 4 packed, error %.4f degrees\n", tangentError);
+    for (int level = MATRIX_SIMD_SCALAR; level <= support; level++) {
+      double encode, decode;
+      bool same;
+
+      setMatrixSimdLevel((MatrixSimdLevel) level);
+      encode = benchBest([&] {
+        encodeOctahedralArray(&codes[0], &tangents[0], 3, count);
+        benchKeep(codes[0]);
+      }, 0.1);
+      decode = benchBest([&] {
+        decodeOctahedralArray(&decoded[0], 3, &codes[0], count);
+        benchKeep(decoded[0]);
+      }, 0.1);
+      same = codes == referenceCodes &&
+             memcmp(&decoded[0], &referenceDecoded[0], decoded.size() * sizeof(float)) == 0;
+      printf("  %-7s encode %8.1f Mv/s, decode %8.1f Mv/s, %s\n",
+        getMatrixSimdLevelName((MatrixSimdLevel) level), count / encode * 1e-6,
+        count / decode * 1e-6, same ? "same" : "DIFFER");
+    }
+  }
+  setMatrixSimdLevel(support);
+  printf("\n");
+}
+
+static void reportSurface(const char *name, const ParametricSurface *surface, int u, int v)
+{
+  SurfaceMesh mesh;
+  std::vector<MeshVertex> vertices;
+  std::vector<float> tangents;
+
+  tessellateSurface(&mesh, surface, u, v, SURFACE_TRIANGLE_LIST);
+  vertices.resize(mesh.vertexCount);
+  tangents.resize(3 * mesh.vertexCount);
+  for (int i = 0; i < mesh.vertexCount; i++) {
+    memcpy(vertices[i].position, mesh.vertices[i].position, sizeof(vertices[i].position));
+    memcpy(vertices[i].normal, mesh.vertices[i].normal, sizeof(vertices[i].normal));
+    memcpy(vertices[i].texCoord, mesh.vertices[i].texCoord, sizeof(vertices[i].texCoord));
+    memcpy(&tangents[3*i], mesh.vertices[i].tangent, sizeof(mesh.vertices[i].tangent));
+  }
+  freeSurfaceMesh(&mesh);
+  reportMesh(name, vertices, tangents);
+}
+
+static void reportObj(const char *path)
+{
+  const char *name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+  ObjModel m;
+
+  if (!readObj(path, m)) {
+    fprintf(stderr, "compress_bench: cannot open %s\n", path);
+    return;
+  }
+  if (m.flat) {
+    std::vector<MeshVertex> shaded(m.indices.size());
+    std::vector<unsigned int> indices(m.indices.size());
+
+    shaded.resize(flatShadeMesh(&shaded[0], &indices[0], &m.indices[0],
+                                (int) m.indices.size(), &m.vertices[0]));
+    m.vertices.swap(shaded);
+  }
+  reportMesh(name, m.vertices, std::vector<float>());
+}
+
+int main(int argc, char **argv)
+{
+  static const char *defaults[] = {
+    "../../../Labs/Lab5/model_for_cga.obj",
+    "../../../Labs/Lab6/retopoly.obj"
+  };
+  SphereSurface sphere = { 1.0f };
+  TorusSurface torus = { 0.75f, 0.25f };
+  ParametricSurface sphereSurface = { evaluateSphereSurface, &sphere, sizeof(sphere) },
+                    torusSurface = { evaluateTorusSurface, &torus, sizeof(torus) };
+
+  printf("SIMD support: %s\n\n", getMatrixSimdLevelName(getMatrixSimdSupport()));
+  reportSurface("sphere 256x128", &sphereSurface, 256, 128);
+  reportSurface("torus 512x256", &torusSurface, 512, 256);
+  if (argc > 1) {
+    for (int i = 1; i < argc; i++)
+      reportObj(argv[i]);
+  } else {
+    for (int i = 0; i < (int) (sizeof(defaults) / sizeof(defaults[0])); i++)
+      reportObj(defaults[i]);
+  }
+  return 0;
+}
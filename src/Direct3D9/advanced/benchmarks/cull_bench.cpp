@@ -0,0 +1,170 @@
+/* cull_bench.cpp - Frustum culling of a million bounding volumes per frame.
+
+   Spheres and boxes are scattered through a 200-unit cube around an
+   orbiting camera like cgfx_buffer_lighting's, with the same 70 degree
+   projection pushed out to a far plane of 100.  Every frame rebuilds the
+   frustum planes from makePerspectiveMatrix times makeLookAtMatrix and
+   culls all volumes.  The first row is the obvious loop: test planes
+   until one rejects, then push_back the index.  Every SIMD level must
+   find as many visible volumes as that loop; a level that does not is
+   reported on stderr and the bench exits with 1. */
+
+#include <math.h>
+#include <vector>
+
+#include "bench.h"
+#include "../cgfx_buffer_lighting/matrix.h"
+#include "../cgfx_buffer_lighting/frustum.h"
+
+static const int myCount = 1000000;
+static const int myFrames = 16;
+
+static void frameMatrix(int frame, float viewProjection[16])
+{
+  float projection[16], view[16];
+  double angle = 0.4 * frame;
+
+  makePerspectiveMatrix(70.0, 4.0/3.0, 1.0, 100.0, projection);
+  makeLookAtMatrix(8*cos(angle), 2, -8*sin(angle),  0, 0, 0,  0, 1, 0, view);
+  multMatrix(viewProjection, projection, view);
+}
+
+static void printRow(const char *volumes, const char *name, double t, long visible)
+{
+  printf("%-8s %-18s %10.3f %12.2f %12.4g %10ld\n", volumes, name, t*1e3/myFrames,
+    t*1e9/((double) myFrames*myCount), (double) myFrames*myCount/t, visible/myFrames);
+}
+
+int main(void)
+{
+  MatrixSimdLevel support = getMatrixSimdSupport();
+  std::vector<float> x(myCount), y(myCount), z(myCount), r(myCount),
+                     minX(myCount), minY(myCount), minZ(myCount),
+                     maxX(myCount), maxY(myCount), maxZ(myCount);
+  std::vector<int> visible(myCount);
+  std::vector<float> planes(myFrames*24);
+  unsigned int seed = 3;
+  long reference, total;
+  int failed = 0;
+  double t;
+
+  for (int i = 0; i < myCount; i++) {
+    x[i] = benchRandom(&seed, -100, 100);
+    y[i] = benchRandom(&seed, -100, 100);
+    z[i] = benchRandom(&seed, -100, 100);
+    r[i] = benchRandom(&seed, 0.1f, 2);
+    minX[i] = x[i] - r[i];  maxX[i] = x[i] + benchRandom(&seed, 0.1f, 2);
+    minY[i] = y[i] - r[i];  maxY[i] = y[i] + benchRandom(&seed, 0.1f, 2);
+    minZ[i] = z[i] - r[i];  maxZ[i] = z[i] + benchRandom(&seed, 0.1f, 2);
+  }
+
+  printf("%d volumes, %d frames, SIMD support: %s\n\n", myCount, myFrames,
+    getMatrixSimdLevelName(support));
+  printf("%-8s %-18s %10s %12s %12s %10s\n",
+    "volumes", "routine", "ms/frame", "ns/volume", "volumes/s", "visible");
+
+  /* Plane extraction is part of every frame. */
+  t = benchBest([&] {
+    for (int f = 0; f < myFrames; f++) {
+      float m[16];
+      frameMatrix(f, m);
+      makeFrustumPlanes(m, &planes[f*24]);
+    }
+    benchKeep(planes[0]);
+  });
+  printf("%-8s %-18s %10.4f\n\n", "-", "makeFrustumPlanes", t*1e3/myFrames);
+
+  /* Spheres */
+
+  total = 0;
+  t = benchBest([&] {
+    std::vector<int> list;
+    total = 0;
+    for (int f = 0; f < myFrames; f++) {
+      const float *p = &planes[f*24];
+      list.clear();
+      for (int i = 0; i < myCount; i++) {
+        int j;
+        for (j = 0; j < 6; j++)
+          if (p[j*4]*x[i] + p[j*4+1]*y[i] + p[j*4+2]*z[i] + p[j*4+3] < -r[i])
+            break;
+        if (j == 6)
+          list.push_back(i);
+      }
+      total += (long) list.size();
+    }
+    benchKeep(total);
+  });
+  reference = total;
+  printRow("spheres", "early-out loop", t, total);
+
+  for (int level = MATRIX_SIMD_SCALAR; level <= support; level++) {
+    char name[64];
+
+    setMatrixSimdLevel((MatrixSimdLevel) level);
+    t = benchBest([&] {
+      total = 0;
+      for (int f = 0; f < myFrames; f++)
+        total += cullSpheres(&visible[0], &planes[f*24], &x[0], &y[0], &z[0], &r[0], myCount);
+      benchKeep(total);
+    });
+    sprintf(name, "cullSpheres/%s", getMatrixSimdLevelName((MatrixSimdLevel) level));
+    printRow("spheres", name, t, total);
+    if (total != reference) {
+      fprintf(stderr, "cull_bench: %s differs from the early-out loop by %ld\n",
+        name, total - reference);
+      failed = 1;
+    }
+  }
+  setMatrixSimdLevel(support);
+
+  /* Boxes */
+
+  t = benchBest([&] {
+    std::vector<int> list;
+    total = 0;
+    for (int f = 0; f < myFrames; f++) {
+      const float *p = &planes[f*24];
+      list.clear();
+      for (int i = 0; i < myCount; i++) {
+        int j;
+        for (j = 0; j < 6; j++) {
+          const float *q = p + j*4;
+          float d = q[0]*(q[0] >= 0 ? maxX[i] : minX[i]) +
+                    q[1]*(q[1] >= 0 ? maxY[i] : minY[i]) +
+                    q[2]*(q[2] >= 0 ? maxZ[i] : minZ[i]) + q[3];
+          if (d < 0)
+            break;
+        }
+        if (j == 6)
+          list.push_back(i);
+      }
+      total += (long) list.size();
+    }
+    benchKeep(total);
+  });
+  reference = total;
+  printRow("boxes", "early-out loop", t, total);
+
+  for (int level = MATRIX_SIMD_SCALAR; level <= support; level++) {
+    char name[64];
+
+    setMatrixSimdLevel((MatrixSimdLevel) level);
+    t = benchBest([&] {
+      total = 0;
+      for (int f = 0; f < myFrames; f++)
+        total += cullBoxes(&visible[0], &planes[f*24], &minX[0], &minY[0], &minZ[0],
+                           &maxX[0], &maxY[0], &maxZ[0], myCount);
+      benchKeep(total);
+    });
+    sprintf(name, "cullBoxes/%s", getMatrixSimdLevelName((MatrixSimdLevel) level));
+    printRow("boxes", name, t, total);
+    if (total != reference) {
+      fprintf(stderr, "cull_bench: %s differs from the early-out loop by %ld\n",
+        name, total - reference);
+      failed = 1;
+    }
+  }
+  setMatrixSimdLevel(support);
+  return failed;
+}
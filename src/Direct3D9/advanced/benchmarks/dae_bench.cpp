@@ -0,0 +1,483 @@
+/* dae_bench.cpp - Streaming COLLADA reading (daefile.h) against building a DOM tree.
+
+   Usage: dae_bench [-mb N] [file.dae ...]
+
+   Writes a synthetic FX Composer style scene of about N megabytes (100
+   by default): geometry as <float_array>s, materials with <setparam>
+   values, and nested nodes with a <matrix>, an <instance_geometry> and
+   an <instance_material> each.  It is then read three ways:
+
+     dom          the whole file read into memory and parsed into a tree
+                  of elements, attributes and text, then walked, its
+                  numbers converted with strtof
+     stream       readDaeEvent and readDaeFloats at MATRIX_SIMD_SCALAR
+     stream SSE   the same at MATRIX_SIMD_SSE, numbers 16 bytes at a time
+
+   Each gets the same values: node matrices, param values, and float
+   arrays read into buffers allocated from their count attributes.  The
+   report gives the time, MB/s, and the memory the parser itself holds
+   (the DOM's file copy and tree, or the reader's buffer and stack),
+   and checks that the values agree.
+
+   First, a short scene is read with every byte of it in turn the last
+   one of the reader's first buffer full, and must read the same.
+
+   Last, the FX Composer projects' scenes (without arguments, Lab4's
+   Project3 and Lab5's Project4) are streamed and their events listed. */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bench.h"
+#include "../cgfx_buffer_lighting/daefile.h"
+#include "../cgfx_buffer_lighting/matrix.h"
+
+static const char *mySyntheticPath = "dae_bench_synthetic.dae";
+
+/* What a reader gets out of a scene. */
+struct SceneValues {
+  std::vector<float> matrices, params;
+  std::vector<std::vector<float> > arrays;
+  int nodes, instances;
+
+  SceneValues() : nodes(0), instances(0) {}
+};
+
+static bool writeSyntheticDae(const char *path, int megabytes)
+{
+  const long target = megabytes * 1048576L;
+  const int arrayFloats = 30000, materials = 64;
+  FILE *file = fopen(path, "wb");
+  unsigned int seed = 1;
+  int geometries = 0, nodes;
+
+  if (!file)
+    return false;
+  fprintf(file, "<?xml version=\"1.0\"?>\n"
+    "<COLLADA xmlns=\"http://www.collada.org/2005/11/COLLADASchema\" version=\"1.4.1\">\n"
+    "\t<!-- dae_bench synthetic scene -->\n\t<library_geometries>\n");
+  /* Four fifths of the file is geometry, the rest scene. */
+  while (ftell(file) < target * 4 / 5) {
+    fprintf(file, "\t\t<geometry id=\"Geometry%d\">\n\t\t\t<mesh>\n"
+      "\t\t\t\t<source id=\"Geometry%d-positions\">\n"
+      "\t\t\t\t\t<float_array id=\"Geometry%d-positions-array\" count=\"%d\">",
+      geometries, geometries, geometries, arrayFloats);
+    for (int i = 0; i < arrayFloats; i++)
+      fprintf(file, i % 3 == 2 ? "%.6g\n" : "%.6g ", benchRandom(&seed, -10, 10));
+    fprintf(file, "</float_array>\n\t\t\t\t</source>\n\t\t\t</mesh>\n\t\t</geometry>\n");
+    geometries++;
+  }
+  fprintf(file, "\t</library_geometries>\n\t<library_materials>\n");
+  for (int m = 0; m < materials; m++) {
+    fprintf(file, "\t\t<material id=\"Material%d\" name=\"Phong_Material%d\">\n"
+      "\t\t\t<instance_effect url=\"#Effect\">\n"
+      "\t\t\t\t<setparam ref=\"WorldXf\">\n\t\t\t\t\t<float4x4>", m, m);
+    for (int i = 0; i < 16; i++)
+      fprintf(file, i < 15 ? "%.6g " : "%.6g", benchRandom(&seed, -1, 1));
+    fprintf(file, "</float4x4>\n\t\t\t\t</setparam>\n"
+      "\t\t\t\t<setparam ref=\"Lamp0Pos\">\n\t\t\t\t\t<float3>%.6g %.6g %.6g</float3>\n"
+      "\t\t\t\t</setparam>\n"
+      "\t\t\t\t<setparam ref=\"SpecExpon\">\n\t\t\t\t\t<float>%.6g</float>\n"
+      "\t\t\t\t</setparam>\n\t\t\t</instance_effect>\n\t\t</material>\n",
+      benchRandom(&seed, -5, 5), benchRandom(&seed, -5, 5), benchRandom(&seed, -5, 5),
+      benchRandom(&seed, 1, 128));
+  }
+  fprintf(file, "\t</library_materials>\n\t<library_visual_scenes>\n"
+    "\t\t<visual_scene id=\"DefaultScene\">\n");
+  /* Groups of a parent node with ten children. */
+  for (nodes = 0; ftell(file) < target; nodes++) {
+    bool child = nodes % 11 != 0;
+
+    fprintf(file, "%s<node id=\"Node%d\" name=\"Node%d\">\n%s<matrix>",
+      child ? "\t\t\t\t" : "\t\t\t", nodes, nodes, child ? "\t\t\t\t\t" : "\t\t\t\t");
+    for (int i = 0; i < 16; i++)
+      fprintf(file, i < 15 ? "%.6g " : "%.6g", i >= 12 ? (float) (i == 15) :
+              benchRandom(&seed, -100, 100));
+    fprintf(file, "</matrix>\n"
+      "\t\t\t\t\t<instance_geometry url=\"#Geometry%d\">\n"
+      "\t\t\t\t\t\t<bind_material><technique_common>\n"
+      "\t\t\t\t\t\t\t<instance_material symbol=\"material\" target=\"#Material%d\"/>\n"
+      "\t\t\t\t\t\t</technique_common></bind_material>\n"
+      "\t\t\t\t\t</instance_geometry>\n",
+      nodes % geometries, nodes % materials);
+    if (child)
+      fprintf(file, "\t\t\t\t</node>\n");
+    if (nodes % 11 == 10)
+      fprintf(file, "\t\t\t</node>\n");
+  }
+  if (nodes % 11 != 0)
+    fprintf(file, "\t\t\t</node>\n");
+  fprintf(file, "\t\t</visual_scene>\n\t</library_visual_scenes>\n"
+    "\t<scene>\n\t\t<instance_visual_scene url=\"#DefaultScene\"/>\n\t</scene>\n"
+    "</COLLADA>\n");
+  return fclose(file) == 0;
+}
+
+static void readStream(const char *path, SceneValues &scene)
+{
+  DaeReader reader;
+  DaeEvent event;
+
+  if (!openDaeFile(&reader, path))
+    return;
+  while (readDaeEvent(&reader, &event)) {
+    if (event.type == DAE_NODE) {
+      scene.nodes++;
+    } else if (event.type == DAE_INSTANCE) {
+      scene.instances++;
+    } else if (event.type == DAE_MATRIX) {
+      scene.matrices.insert(scene.matrices.end(), event.values, event.values + 16);
+    } else if (event.type == DAE_PARAM) {
+      scene.params.insert(scene.params.end(), event.values, event.values + event.count);
+    } else if (event.type == DAE_FLOAT_ARRAY) {
+      scene.arrays.push_back(std::vector<float>(event.count));
+      if (event.count > 0)
+        readDaeFloats(&reader, &scene.arrays.back()[0], event.count);
+    }
+  }
+  if (reader.failed)
+    fprintf(stderr, "dae_bench: %s is malformed\n", path);
+  closeDaeFile(&reader);
+}
+
+/* An element of the DOM, as a tree-building XML parser makes it. */
+struct DomNode {
+  std::string name, text;
+  std::vector<std::pair<std::string, std::string> > attributes;
+  std::vector<DomNode *> children;
+
+  ~DomNode()
+  {
+    for (size_t i = 0; i < children.size(); i++)
+      delete children[i];
+  }
+
+  const char *getAttribute(const char *attribute) const
+  {
+    for (size_t i = 0; i < attributes.size(); i++)
+      if (attributes[i].first == attribute)
+        return attributes[i].second.c_str();
+    return NULL;
+  }
+};
+
+static bool isSpace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/* The document element of xml, or NULL. */
+static DomNode *parseDom(const std::string &xml)
+{
+  std::vector<DomNode *> open;
+  DomNode root;
+  size_t p = 0;
+
+  open.push_back(&root);
+  while ((p = xml.find('<', p)) != std::string::npos) {
+    size_t end;
+
+    if (xml.compare(p, 4, "<!--") == 0) {
+      p = xml.find("-->", p);
+      p = p == std::string::npos ? p : p + 3;
+      continue;
+    }
+    if ((end = xml.find('>', p)) == std::string::npos)
+      break;
+    if (xml[p+1] == '?' || xml[p+1] == '!') {
+      p = end + 1;
+    } else if (xml[p+1] == '/') {
+      if (open.size() > 1)
+        open.pop_back();
+      p = end + 1;
+    } else {
+      DomNode *node = new DomNode;
+      size_t q = p + 1, next;
+
+      while (q < end && !isSpace(xml[q]) && xml[q] != '/')
+        q++;
+      node->name.assign(xml, p + 1, q - p - 1);
+      for (;;) {
+        size_t eq = xml.find('=', q), quote, close;
+
+        if (eq == std::string::npos || eq > end)
+          break;
+        while (isSpace(xml[q]))
+          q++;
+        quote = xml.find_first_of("\"'", eq);
+        close = xml.find(xml[quote], quote + 1);
+        node->attributes.push_back(std::make_pair(xml.substr(q, eq - q),
+                                                  xml.substr(quote + 1, close - quote - 1)));
+        q = close + 1;
+      }
+      open.back()->children.push_back(node);
+      p = end + 1;
+      if (xml[end-1] != '/') {
+        open.push_back(node);
+        next = xml.find('<', p);
+        node->text.assign(xml, p, next == std::string::npos ? std::string::npos : next - p);
+      }
+    }
+  }
+  if (root.children.empty())
+    return NULL;
+  DomNode *document = root.children[0];
+  root.children.clear();
+  return document;
+}
+
+static void getDomFloats(std::vector<float> &values, const std::string &text, int count)
+{
+  const char *p = text.c_str();
+
+  for (int i = 0; i < count; i++) {
+    char *end;
+    float v = strtof(p, &end);
+
+    if (end == p)
+      break;
+    values.push_back(v);
+    p = end;
+  }
+}
+
+static void walkDom(const DomNode *node, const DomNode *parent, SceneValues &scene)
+{
+  const std::string &name = node->name;
+
+  if (name == "node") {
+    scene.nodes++;
+  } else if (name.compare(0, 9, "instance_") == 0 || name == "import") {
+    scene.instances++;
+  } else if (name == "matrix") {
+    getDomFloats(scene.matrices, node->text, 16);
+  } else if (name == "float_array") {
+    const char *count = node->getAttribute("count");
+
+    scene.arrays.push_back(std::vector<float>());
+    scene.arrays.back().reserve(count ? atoi(count) : 0);
+    getDomFloats(scene.arrays.back(), node->text, count ? atoi(count) : 0);
+  } else if (parent && (parent->name == "setparam" || parent->name == "newparam") &&
+             name.compare(0, 5, "float") == 0) {
+    getDomFloats(scene.params, node->text, 16);
+  }
+  for (size_t i = 0; i < node->children.size(); i++)
+    walkDom(node->children[i], node, scene);
+}
+
+/* Bytes the tree holds, by its strings' and vectors' capacities. */
+static size_t getDomSize(const DomNode *node)
+{
+  size_t size = sizeof(DomNode) + node->name.capacity() + node->text.capacity() +
+    node->attributes.capacity() * sizeof(node->attributes[0]) +
+    node->children.capacity() * sizeof(DomNode *);
+
+  for (size_t i = 0; i < node->attributes.size(); i++)
+    size += node->attributes[i].first.capacity() + node->attributes[i].second.capacity();
+  for (size_t i = 0; i < node->children.size(); i++)
+    size += getDomSize(node->children[i]);
+  return size;
+}
+
+static size_t readDom(const char *path, SceneValues &scene)
+{
+  FILE *file = fopen(path, "rb");
+  std::string xml;
+  DomNode *document;
+  size_t size;
+
+  if (!file)
+    return 0;
+  fseek(file, 0, SEEK_END);
+  xml.resize(ftell(file));
+  fseek(file, 0, SEEK_SET);
+  if (!xml.empty() && fread(&xml[0], 1, xml.size(), file) != xml.size())
+    xml.clear();
+  fclose(file);
+  document = parseDom(xml);
+  if (!document)
+    return 0;
+  walkDom(document, NULL, scene);
+  size = xml.capacity() + getDomSize(document);
+  delete document;
+  return size;
+}
+
+/* Whether b holds a's values, to within strtof's and parseObjFloat's
+   rounding of the same text. */
+static bool sameValues(const std::vector<float> &a, const std::vector<float> &b)
+{
+  if (a.size() != b.size())
+    return false;
+  for (size_t i = 0; i < a.size(); i++)
+    if (fabsf(a[i] - b[i]) > 1e-7f * fabsf(a[i]))
+      return false;
+  return true;
+}
+
+static bool sameScene(const SceneValues &a, const SceneValues &b)
+{
+  if (a.nodes != b.nodes || a.instances != b.instances || a.arrays.size() != b.arrays.size() ||
+      !sameValues(a.matrices, b.matrices) || !sameValues(a.params, b.params))
+    return false;
+  for (size_t i = 0; i < a.arrays.size(); i++)
+    if (!sameValues(a.arrays[i], b.arrays[i]))
+      return false;
+  return true;
+}
+
+/* Read a node's matrix and a param with a comment in front sized so
+   that each byte of them in turn is the last one of the first buffer
+   full, and the rest arrives with the refill.  Report how many of the
+   files read wrongly. */
+static void checkRefills(void)
+{
+  static const char *path = "dae_bench_refill.dae";
+  /* Space after the last numbers, longer than the reader looks ahead
+     for a number, lets an end tag's '<' be the buffer's last byte. */
+  static const char scene[] =
+    "<node id=\"Node\">\n<matrix>1 0 0 2 0 1 0 3 0 0 1 4 0 0 0 1"
+    "                                                                                \n"
+    "</matrix>\n</node>\n<material id=\"Material\"><setparam ref=\"Lamp0Pos\">"
+    "<float3> 1.5 -2 0.25"
+    "                                                                                \n"
+    "</float3></setparam></material>\n";
+  const int length = (int) sizeof(scene) - 1;
+  int wrong = 0;
+
+  for (int at = 0; at < length; at++) {
+    FILE *file = fopen(path, "wb");
+    SceneValues values;
+
+    if (!file) {
+      fprintf(stderr, "dae_bench: cannot write %s\n", path);
+      return;
+    }
+    fprintf(file, "<COLLADA>\n<!--");
+    for (long i = ftell(file); i < DAE_BUFFER_SIZE - 4 - at; i++)
+      fputc('x', file);
+    fprintf(file, " -->%s</COLLADA>\n", scene);
+    fclose(file);
+
+    readStream(path, values);
+    if (values.nodes != 1 || values.matrices.size() != 16 || values.matrices[3] != 2 ||
+        values.matrices[15] != 1 || values.params.size() != 3 || values.params[2] != 0.25f)
+      wrong++;
+  }
+  remove(path);
+  printf("refills: %d of %d boundaries read %s\n\n", length - wrong, length,
+    wrong ? "right, the rest WRONG" : "right");
+}
+
+static void reportSynthetic(int megabytes)
+{
+  SceneValues dom, scalar, sse;
+  double megabytesRead, domTime, scalarTime, sseTime;
+  size_t domSize = 0, streamSize = sizeof(DaeReader) + DAE_BUFFER_SIZE + sizeof(DaeEvent);
+  size_t floats = 0;
+  MatrixSimdLevel level = getMatrixSimdLevel();
+  FILE *file;
+
+  if (!writeSyntheticDae(mySyntheticPath, megabytes) || !(file = fopen(mySyntheticPath, "rb"))) {
+    fprintf(stderr, "dae_bench: cannot write %s\n", mySyntheticPath);
+    return;
+  }
+  fseek(file, 0, SEEK_END);
+  megabytesRead = ftell(file) / 1048576.0;
+  fclose(file);
+
+  domTime = benchBest([&] {
+    dom = SceneValues();
+    domSize = readDom(mySyntheticPath, dom);
+  }, 0);
+  setMatrixSimdLevel(MATRIX_SIMD_SCALAR);
+  scalarTime = benchBest([&] {
+    scalar = SceneValues();
+    readStream(mySyntheticPath, scalar);
+  }, 0);
+  setMatrixSimdLevel(level);
+  sseTime = benchBest([&] {
+    sse = SceneValues();
+    readStream(mySyntheticPath, sse);
+  }, 0);
+  for (size_t i = 0; i < sse.arrays.size(); i++)
+    floats += sse.arrays[i].size();
+
+  printf("%s: %.1f MB, %d nodes, %d instances, %lu params, %lu float arrays of %lu numbers\n",
+    mySyntheticPath, megabytesRead, sse.nodes, sse.instances, (unsigned long) sse.params.size(),
+    (unsigned long) sse.arrays.size(), (unsigned long) floats);
+  printf("  %-11s %9.1f ms %9.1f MB/s %10.1f MB held\n", "dom", domTime * 1e3,
+    megabytesRead / domTime, domSize / 1048576.0);
+  printf("  %-11s %9.1f ms %9.1f MB/s %10.1f KB held %6.1fx\n", "stream", scalarTime * 1e3,
+    megabytesRead / scalarTime, streamSize / 1024.0, domTime / scalarTime);
+  printf("  %-11s %9.1f ms %9.1f MB/s %10.1f KB held %6.1fx\n", "stream SSE", sseTime * 1e3,
+    megabytesRead / sseTime, streamSize / 1024.0, domTime / sseTime);
+  printf("  values %s\n\n", sameScene(dom, scalar) && sameScene(dom, sse) &&
+    scalar.arrays == sse.arrays ? "match" : "DIFFER");
+  remove(mySyntheticPath);
+}
+
+static void reportFile(const char *path)
+{
+  static const char *types[] = { "", "node", "matrix", "instance", "param", "float_array" };
+  DaeReader reader;
+  DaeEvent event;
+
+  if (!openDaeFile(&reader, path)) {
+    fprintf(stderr, "dae_bench: cannot open %s\n", path);
+    return;
+  }
+  printf("%s:\n", path);
+  while (readDaeEvent(&reader, &event)) {
+    printf("  %-11s %-22s", types[event.type], event.element);
+    if (event.id[0])
+      printf(" %s", event.id);
+    if (event.url[0])
+      printf(" -> %s", event.url);
+    if (event.owner[0])
+      printf(" in %s", event.owner);
+    if (event.type == DAE_FLOAT_ARRAY)
+      printf(", %d numbers", event.count);
+    else if (event.count == 1)
+      printf(" = %g", event.values[0]);
+    else if (event.count == 16)
+      printf(", translation %g %g %g", event.values[3], event.values[7], event.values[11]);
+    else
+      for (int i = 0; i < event.count; i++)
+        printf("%s%g", i == 0 ? " = " : " ", event.values[i]);
+    printf("\n");
+  }
+  printf("  %s\n\n", reader.failed ? "MALFORMED" : "end");
+  closeDaeFile(&reader);
+}
+
+int main(int argc, char **argv)
+{
+  static const char *defaults[] = {
+    "../../../Labs/Lab4/Project3/Document1.dae",
+    "../../../Labs/Lab5/Project4/Document1.dae",
+    "../../../Labs/Lab5/Project4/cache-model_for_cga-0a07f46b-3b63-4040-9cca-780f1e69c0c2.dae"
+  };
+  int megabytes = 100, files = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-mb") == 0 && i + 1 < argc)
+      megabytes = atoi(argv[++i]);
+    else
+      argv[++files] = argv[i];
+  }
+  checkRefills();
+  if (megabytes > 0)
+    reportSynthetic(megabytes);
+  if (files == 0)
+    for (int i = 0; i < (int) (sizeof(defaults) / sizeof(defaults[0])); i++)
+      reportFile(defaults[i]);
+  for (int i = 1; i <= files; i++)
+    reportFile(argv[i]);
+  return 0;
+}
@@ -0,0 +1,135 @@
+/* inverse_bench.cpp - Throughput and accuracy of the matrix inverse routines.
+
+   Each routine is run over three kinds of input: rigid-body matrices (what
+   cgfx_buffer_lighting inverts every draw), affine matrices with
+   non-uniform scale, and general matrices including a projection.  Accuracy
+   is reported both as the largest difference from invertMatrix (the
+   double-precision Gauss-Jordan routine) and as the largest element of
+   M * inverse(M) - I. */
+
+#include <math.h>
+#include <vector>
+
+#include "bench.h"
+#include "../cgfx_buffer_lighting/matrix.h"
+
+enum { RIGID, AFFINE, GENERAL, KIND_COUNT };
+static const char *myKindName[KIND_COUNT] = { "rigid", "affine", "general" };
+static const int myCount = 10000;
+
+static void makeInputs(int kind, std::vector<float> &m)
+{
+  float projection[16];
+  unsigned int seed = 7 + kind;
+
+  makePerspectiveMatrix(60.0, 1.5, 0.5, 50.0, projection);
+  m.resize(myCount*16);
+  for (int i = 0; i < myCount; i++) {
+    float *dst = &m[i*16], rotate[16], other[16];
+
+    makeRotateMatrix(benchRandom(&seed, 0, 360),
+                     benchRandom(&seed, -1, 1), benchRandom(&seed, -1, 1), 1,
+                     rotate);
+    makeTranslateMatrix(benchRandom(&seed, -10, 10), benchRandom(&seed, -10, 10),
+                        benchRandom(&seed, -10, 10), other);
+    multMatrix(dst, other, rotate);
+    if (kind != RIGID) {
+      makeTranslateMatrix(0, 0, 0, other);
+      other[0] = benchRandom(&seed, 0.2f, 5);
+      other[5] = benchRandom(&seed, 0.2f, 5);
+      other[10] = benchRandom(&seed, 0.2f, 5);
+      multMatrix(dst, dst, other);
+    }
+    if (kind == GENERAL)
+      multMatrix(dst, projection, dst);
+  }
+}
+
+/* Largest difference from the reference inverse, relative to the size of
+   the reference element, and largest element of M * inv - I. */
+static void measureError(const std::vector<float> &m, const std::vector<float> &inv,
+                         const std::vector<float> &ref,
+                         double *refError, double *residual)
+{
+  *refError = 0;
+  *residual = 0;
+  for (int i = 0; i < myCount; i++) {
+    float product[16];
+
+    multMatrix(product, &m[i*16], &inv[i*16]);
+    for (int j = 0; j < 16; j++) {
+      double r = ref[i*16+j];
+      double e = fabs(inv[i*16+j] - r) / (fabs(r) > 1 ? fabs(r) : 1);
+      double p = fabs(product[j] - ((j % 5) == 0 ? 1.0 : 0.0));
+      if (e > *refError)
+        *refError = e;
+      if (p > *residual)
+        *residual = p;
+    }
+  }
+}
+
+int main(void)
+{
+  MatrixSimdLevel support = getMatrixSimdSupport();
+
+  printf("%-8s %-27s %9s %12s %10s %10s\n",
+    "input", "routine", "ns/matrix", "matrices/s", "vs ref", "residual");
+
+  for (int kind = 0; kind < KIND_COUNT; kind++) {
+    std::vector<float> m, ref(myCount*16), inv(myCount*16);
+    double refTime, t, refError, residual;
+
+    makeInputs(kind, m);
+
+    refTime = benchBest([&] {
+      for (int i = 0; i < myCount; i++)
+        invertMatrix(&ref[i*16], &m[i*16]);
+      benchKeep(ref[0]);
+    });
+    measureError(m, ref, ref, &refError, &residual);
+    printf("%-8s %-27s %9.2f %12.4g %10s %10.3g\n", myKindName[kind], "invertMatrix",
+      refTime*1e9/myCount, myCount/refTime, "-", residual);
+
+    for (int level = MATRIX_SIMD_SCALAR; level <= support && level <= MATRIX_SIMD_SSE; level++) {
+      char name[64];
+
+      setMatrixSimdLevel((MatrixSimdLevel) level);
+      t = benchBest([&] {
+        for (int i = 0; i < myCount; i++)
+          invertMatrixCofactor(&inv[i*16], &m[i*16]);
+        benchKeep(inv[0]);
+      });
+      measureError(m, inv, ref, &refError, &residual);
+      sprintf(name, "invertMatrixCofactor/%s", getMatrixSimdLevelName((MatrixSimdLevel) level));
+      printf("%-8s %-27s %9.2f %12.4g %10.3g %10.3g\n", myKindName[kind], name,
+        t*1e9/myCount, myCount/t, refError, residual);
+    }
+    setMatrixSimdLevel(support);
+
+    if (kind == GENERAL)
+      continue;
+
+    t = benchBest([&] {
+      for (int i = 0; i < myCount; i++)
+        invertAffineMatrix(&inv[i*16], &m[i*16]);
+      benchKeep(inv[0]);
+    });
+    measureError(m, inv, ref, &refError, &residual);
+    printf("%-8s %-27s %9.2f %12.4g %10.3g %10.3g\n", myKindName[kind], "invertAffineMatrix",
+      t*1e9/myCount, myCount/t, refError, residual);
+
+    if (kind != RIGID)
+      continue;
+
+    t = benchBest([&] {
+      for (int i = 0; i < myCount; i++)
+        invertRigidMatrix(&inv[i*16], &m[i*16]);
+      benchKeep(inv[0]);
+    });
+    measureError(m, inv, ref, &refError, &residual);
+    printf("%-8s %-27s %9.2f %12.4g %10.3g %10.3g\n", myKindName[kind], "invertRigidMatrix",
+      t*1e9/myCount, myCount/t, refError, residual);
+  }
+  return 0;
+}
@@ -0,0 +1,158 @@
+/* lod_bench.cpp - Level-of-detail chains against one fixed mesh for a field of distant spheres.
+
+   10000 unit spheres scattered 5 to 500 units in front of a 60-degree,
+   1080-pixel-high view, as in a scene of many distant objects.  For the
+   fixed 20x20 sphere the samples draw and for an 80x80 sphere chain
+   picked at 0.5, 1, and 2 pixels of error: triangles and vertices per
+   frame, mean screen pixels per front-facing triangle, how many spheres
+   draw triangles under one pixel, and the largest error on screen.  Then the
+   time selectLodArray takes per frame, and how often spheres change level
+   (pop) while the eye only jitters and while it also dollies in and out,
+   with and without hysteresis.  The same for the tessellated torus chain. */
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include "bench.h"
+#include "../cgfx_buffer_lighting/lod.h"
+#include "../cgfx_buffer_lighting/matrix.h"
+
+static const int myCount = 10000, myHeight = 1080;
+static const float myPixelError = 0.5f;
+static const double myPi = 3.14159265358979323846;
+
+typedef struct {
+  std::vector<float> x, y, z, r;
+} Objects;
+
+static void makeObjects(Objects &o)
+{
+  unsigned int seed = 1;
+
+  for (int i = 0; i < myCount; i++) {
+    float d = benchRandom(&seed, 5, 500);
+
+    o.x.push_back(benchRandom(&seed, -0.5f, 0.5f) * d);
+    o.y.push_back(benchRandom(&seed, -0.3f, 0.3f) * d);
+    o.z.push_back(-d);
+    o.r.push_back(1);
+  }
+}
+
+/* Triangles, vertices, pixels per front-facing triangle, spheres with
+   sub-pixel triangles, and worst error in pixels, for levels[i] of chain
+   (or all at level 0). */
+static void printFrame(const char *name, const LodChain *chain, const int *levels,
+                       const float *projection, const Objects &o)
+{
+  const float eye[3] = { 0, 0, 0 };
+  double triangles = 0, vertices = 0, pixels = 0, worst = 0;
+  int subPixel = 0;
+
+  for (int i = 0; i < myCount; i++) {
+    const LodLevel *level = &chain->levels[levels ? levels[i] : 0];
+    float dx = o.x[i] - eye[0], dy = o.y[i] - eye[1], dz = o.z[i] - eye[2],
+          radius = getProjectedRadius(projection, myHeight, sqrtf(dx*dx + dy*dy + dz*dz), o.r[i]);
+    double area = myPi * radius * radius, t = level->indexCount / 3;
+
+    triangles += t;
+    vertices += level->vertexCount;
+    pixels += area;
+    if (area / (t / 2) < 1)
+      subPixel++;
+    if (level->error * radius > worst)
+      worst = level->error * radius;
+  }
+  printf("%-24s %10.0f %10.0f %12.2f %10d %10.2f\n",
+    name, triangles, vertices, pixels / (triangles / 2), subPixel, worst);
+}
+
+/* Level changes over 600 frames of the eye dollying dolly units along Z
+   and back, plus up to 0.05 units of jitter. */
+static long countChanges(const LodChain *chain, const float *projection, const Objects &o,
+                         float dolly, float hysteresis)
+{
+  std::vector<int> levels(myCount, -1), last(myCount);
+  unsigned int seed = 7;
+  long changes = 0;
+
+  for (int frame = 0; frame < 600; frame++) {
+    float eye[3] = { 0, 0, 0 };
+
+    eye[2] = (float) (dolly * sin(frame * 0.01)) + benchRandom(&seed, -0.05f, 0.05f);
+    last = levels;
+    selectLodArray(&levels[0], chain, projection, myHeight, eye,
+                   &o.x[0], &o.y[0], &o.z[0], &o.r[0], myCount, myPixelError, hysteresis);
+    if (frame > 0)
+      for (int i = 0; i < myCount; i++)
+        changes += levels[i] != last[i];
+  }
+  return changes;
+}
+
+static void report(const char *name, const LodChain *chain, const float *projection,
+                   const Objects &o)
+{
+  const float eye[3] = { 0, 0, 0 };
+  std::vector<int> levels(myCount, -1);
+  double t;
+
+  printf("%s chain:", name);
+  for (int i = 0; i < chain->levelCount; i++)
+    printf(" %dx%d (%d tris, error %.4f)", chain->levels[i].uSteps, chain->levels[i].vSteps,
+           chain->levels[i].indexCount / 3, chain->levels[i].error);
+  printf("\n\n%-24s %10s %10s %12s %10s %10s\n",
+    "frame", "triangles", "vertices", "px/triangle", "sub-pixel", "error px");
+
+  for (float pixelError = 0.5f; pixelError <= 2; pixelError *= 2) {
+    char row[64];
+
+    std::fill(levels.begin(), levels.end(), -1);
+    selectLodArray(&levels[0], chain, projection, myHeight, eye,
+                   &o.x[0], &o.y[0], &o.z[0], &o.r[0], myCount, pixelError, 0);
+    sprintf(row, "LOD, %g px", pixelError);
+    printFrame(row, chain, &levels[0], projection, o);
+  }
+
+  t = benchBest([&] {
+    selectLodArray(&levels[0], chain, projection, myHeight, eye,
+                   &o.x[0], &o.y[0], &o.z[0], &o.r[0], myCount, myPixelError, 0.25f);
+    benchKeep(levels[0]);
+  });
+  printf("\nselectLodArray: %.1f us per frame for %d objects (%.1f ns each)\n",
+    t * 1e6, myCount, t * 1e9 / myCount);
+  printf("level changes over 600 frames, jitter only: %ld without hysteresis, %ld with 0.25\n",
+    countChanges(chain, projection, o, 0, 0), countChanges(chain, projection, o, 0, 0.25f));
+  printf("level changes over 600 frames, dolly +-20: %ld without hysteresis, %ld with 0.25\n\n",
+    countChanges(chain, projection, o, 20, 0), countChanges(chain, projection, o, 20, 0.25f));
+}
+
+int main(void)
+{
+  float projection[16];
+  Objects o;
+  LodChain fixed, chain;
+
+  makePerspectiveMatrix(60, 16.0 / 9.0, 0.1, 1000, projection);
+  makeObjects(o);
+
+  getSphereLodChain(&fixed, 20, 20, 1);
+  getSphereLodChain(&chain, 80, 80, LOD_MAX_LEVELS);
+  printf("%d unit spheres 5 to 500 units away, %d pixels high, 60 degree field of view\n\n",
+    myCount, myHeight);
+  printf("%-24s %10s %10s %12s %10s %10s\n",
+    "frame", "triangles", "vertices", "px/triangle", "sub-pixel", "error px");
+  printFrame("fixed 20x20 sphere", &fixed, NULL, projection, o);
+  printf("\n");
+  report("sphere", &chain, projection, o);
+
+  {
+    TorusSurface torus = { 0.75f, 0.25f };
+    ParametricSurface surface = { evaluateTorusSurface, &torus, sizeof(torus) };
+
+    getSurfaceLodChain(&chain, &surface, torus.M + torus.N, 160, 80, LOD_MAX_LEVELS);
+    report("torus", &chain, projection, o);
+  }
+  return 0;
+}
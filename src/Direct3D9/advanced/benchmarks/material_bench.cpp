@@ -0,0 +1,219 @@
+/* material_bench.cpp - MTL materials (mtlfile.h) merged and drawn in material order (objmesh.h).
+
+   Usage: material_bench [-objects N] [file.mtl ...]
+
+   Makes a scene as an exporter writes one: an MTL library naming each
+   of materials.h's materials twice ("jade" and "jade_copy", as when two
+   objects got their own copy of a material), and an OBJ of N cubes (1000
+   by default), each its own object with a random one of those names.
+   Both are parsed from memory, then reports the MTL parse time, how
+   long mergeMaterials and sortObjMeshByMaterial take, and how many
+   times a frame BindMaterialBuffer sets a material buffer drawing the
+   submeshes:
+
+     every draw        binding before each draw, as the sample did
+     by name           skipping a bind when the name repeats
+     merged            skipping it when the merged material repeats
+     merged, sorted    the same, with submeshes sorted by merged material
+
+   The sorted submeshes must be the unsorted ones reordered.  Last, each
+   file given (without arguments, the Labs' MTL files) is read with
+   readMtlFile and its materials counted. */
+
+#include <algorithm>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "../cgfx_buffer_lighting/materials.h"
+#include "../cgfx_buffer_lighting/mtlfile.h"
+#include "../cgfx_buffer_lighting/objfile.h"
+#include "../cgfx_buffer_lighting/objmesh.h"
+
+static void appendf(std::string &s, const char *format, ...)
+{
+  char line[256];
+  va_list args;
+
+  va_start(args, format);
+  vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  s += line;
+}
+
+/* Every material twice; %.9g keeps each float bit for bit, so a name
+   and its copy merge. */
+static std::string makeMtl(void)
+{
+  std::string s = "# material_bench\n";
+
+  for (int copy = 0; copy < 2; copy++)
+    for (int i = 0; i < materialInfoCount; i++) {
+      const MaterialData *m = &materialInfo[i].data;
+
+      appendf(s, "\nnewmtl %s%s\n", materialInfo[i].name, copy ? "_copy" : "");
+      appendf(s, "Ka %.9g %.9g %.9g\n", m->ambient[0], m->ambient[1], m->ambient[2]);
+      appendf(s, "Kd %.9g %.9g %.9g\n", m->diffuse[0], m->diffuse[1], m->diffuse[2]);
+      appendf(s, "Ks %.9g %.9g %.9g\n", m->specular[0], m->specular[1], m->specular[2]);
+      appendf(s, "Ns %.9g\nillum 2\n", m->shine[0]);
+    }
+  return s;
+}
+
+/* objects unit cubes in a row, each with its own o and usemtl. */
+static std::string makeObj(int objects)
+{
+  std::string s = "mtllib material_bench.mtl\n";
+  unsigned int seed = 1;
+
+  for (int i = 0; i < objects; i++) {
+    int m = (int) benchRandom(&seed, 0, 2.0f * materialInfoCount);
+
+    appendf(s, "o cube%d\n", i);
+    for (int k = 0; k < 8; k++)
+      appendf(s, "v %d %d %d\n", 2 * i + (k & 1), (k >> 1) & 1, (k >> 2) & 1);
+    appendf(s, "usemtl %s%s\n", materialInfo[m % materialInfoCount].name,
+      m >= materialInfoCount ? "_copy" : "");
+    appendf(s, "f -8 -6 -5 -7\nf -4 -3 -1 -2\nf -8 -7 -3 -4\n"
+               "f -6 -2 -1 -5\nf -8 -4 -2 -6\nf -7 -5 -1 -3\n");
+  }
+  return s;
+}
+
+/* Material buffer binds drawing mesh's submeshes in order, with
+   key[material] telling materials apart (NULL: a bind every draw). */
+static int countBinds(const ObjMesh *mesh, const int *key)
+{
+  int binds = 0, bound = -2;
+
+  for (int i = 0; i < mesh->submeshCount; i++) {
+    int m = mesh->submeshes[i].material;
+    int k = m >= 0 && key ? key[m] : -1;
+
+    if (!key || k != bound)
+      binds++;
+    bound = k;
+  }
+  return binds;
+}
+
+static bool lessByIndexStart(const ObjSubmesh &a, const ObjSubmesh &b)
+{
+  return a.indexStart < b.indexStart;
+}
+
+/* Whether a and b hold the same submeshes, in any order. */
+static bool sameSubmeshes(std::vector<ObjSubmesh> a, std::vector<ObjSubmesh> b)
+{
+  std::sort(a.begin(), a.end(), lessByIndexStart);
+  std::sort(b.begin(), b.end(), lessByIndexStart);
+  return a.size() == b.size() &&
+         (a.empty() || memcmp(&a[0], &b[0], a.size() * sizeof(ObjSubmesh)) == 0);
+}
+
+static void reportScene(int objects)
+{
+  std::string mtlText = makeMtl(), objText = makeObj(objects);
+  MtlFile mtl;
+  ObjFile obj;
+  ObjMesh mesh;
+
+  if (!parseMtlText(mtlText.data(), mtlText.size(), &mtl) ||
+      !parseObjText(objText.data(), objText.size(), &obj) || !buildObjMesh(&mesh, &obj)) {
+    fprintf(stderr, "material_bench: cannot parse the scene\n");
+    exit(1);
+  }
+
+  std::vector<MaterialData> materials(obj.materialCount + 1), unique(obj.materialCount + 1);
+  std::vector<int> materialOf(obj.materialCount + 1), byName(obj.materialCount + 1);
+  std::vector<ObjSubmesh> fileOrder(mesh.submeshes, mesh.submeshes + mesh.submeshCount);
+  double parseTime, mergeTime, sortTime;
+  int distinct, everyDraw, named, merged, sorted;
+
+  parseTime = benchBest([&] {
+    MtlFile m;
+
+    parseMtlText(mtlText.data(), mtlText.size(), &m);
+    benchKeep(m.count);
+    freeMtlFile(&m);
+  });
+  getObjMaterials(&materials[0], &obj, &mtl);
+  mergeTime = benchBest([&] {
+    benchKeep(mergeMaterials(&materialOf[0], &unique[0], &materials[0], obj.materialCount));
+  });
+  distinct = mergeMaterials(&materialOf[0], &unique[0], &materials[0], obj.materialCount);
+  for (int i = 0; i < obj.materialCount; i++)
+    byName[i] = i;
+
+  everyDraw = countBinds(&mesh, NULL);
+  named = countBinds(&mesh, &byName[0]);
+  merged = countBinds(&mesh, &materialOf[0]);
+  sortTime = benchBest([&] {
+    std::copy(fileOrder.begin(), fileOrder.end(), mesh.submeshes);
+    sortObjMeshByMaterial(&mesh, &materialOf[0]);
+  });
+  sorted = countBinds(&mesh, &materialOf[0]);
+
+  printf("scene: %d objects, %d submeshes, %d MTL materials (%d used), %d distinct\n",
+    objects, mesh.submeshCount, mtl.count, obj.materialCount, distinct);
+  printf("  parseMtlText          %10.3f us for %lu bytes\n", parseTime * 1e6,
+    (unsigned long) mtlText.size());
+  printf("  mergeMaterials        %10.3f us\n", mergeTime * 1e6);
+  printf("  sortObjMeshByMaterial %10.3f us\n", sortTime * 1e6);
+  printf("  binds per frame:\n");
+  printf("    %-16s %6d\n", "every draw", everyDraw);
+  printf("    %-16s %6d\n", "by name", named);
+  printf("    %-16s %6d\n", "merged", merged);
+  printf("    %-16s %6d  %.1fx fewer than every draw\n", "merged, sorted", sorted,
+    (double) everyDraw / sorted);
+  printf("  sorted submeshes %s\n\n",
+    sameSubmeshes(fileOrder, std::vector<ObjSubmesh>(mesh.submeshes,
+                  mesh.submeshes + mesh.submeshCount)) ? "match" : "DIFFER");
+
+  freeObjMesh(&mesh);
+  freeObjFile(&obj);
+  freeMtlFile(&mtl);
+}
+
+static void reportFile(const char *path)
+{
+  MtlFile mtl;
+
+  if (!readMtlFile(path, &mtl)) {
+    fprintf(stderr, "material_bench: cannot read %s\n", path);
+    return;
+  }
+  printf("%s: %d materials\n", path, mtl.count);
+  for (int i = 0; i < mtl.count; i++)
+    printf("  %s: diffuse %g %g %g, shine %g\n", mtl.names[i], mtl.materials[i].diffuse[0],
+      mtl.materials[i].diffuse[1], mtl.materials[i].diffuse[2], mtl.materials[i].shine[0]);
+  freeMtlFile(&mtl);
+}
+
+int main(int argc, char **argv)
+{
+  static const char *defaults[] = {
+    "../../../Labs/Lab4/model_for_cga.mtl",
+    "../../../Labs/Lab5/model_for_cga.mtl",
+    "../../../Labs/Lab6/model_cga.mtl"
+  };
+  int objects = 1000, files = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-objects") == 0 && i + 1 < argc)
+      objects = atoi(argv[++i]);
+    else
+      argv[++files] = argv[i];
+  }
+  reportScene(objects);
+  if (files == 0)
+    for (int i = 0; i < (int) (sizeof(defaults) / sizeof(defaults[0])); i++)
+      reportFile(defaults[i]);
+  for (int i = 1; i <= files; i++)
+    reportFile(argv[i]);
+  return 0;
+}
@@ -0,0 +1,75 @@
+/* matrix_bench.cpp - Compare the batched multMatrixArray kernels against
+   calling multMatrix once per matrix, for the per-object modelview and
+   modelview-projection products that cgfx_buffer_lighting computes. */
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#include "bench.h"
+#include "../cgfx_buffer_lighting/matrix.h"
+
+static const int myObjectCounts[] = { 16, 1000, 20000, 100000 };
+
+int main(void)
+{
+  float projection[16], view[16];
+  MatrixSimdLevel support = getMatrixSimdSupport();
+
+  makePerspectiveMatrix(70.0, 4.0/3.0, 1.0, 20.0, projection);
+  makeLookAtMatrix(8, 0, 0,  0, 0, 0,  0, 1, 0, view);
+
+  printf("matrix_bench: best kernel on this CPU is %s\n",
+    getMatrixSimdLevelName(support));
+  printf("%8s  %-10s %10s %12s %8s %10s\n",
+    "objects", "path", "ns/object", "objects/s", "speedup", "max error");
+
+  for (size_t c = 0; c < sizeof(myObjectCounts)/sizeof(myObjectCounts[0]); c++) {
+    const int count = myObjectCounts[c];
+    std::vector<float> model(count*16), modelview(count*16), mvp(count*16);
+    std::vector<float> refModelview(count*16), refMvp(count*16);
+    unsigned int seed = 1;
+
+    for (int i = 0; i < count; i++) {
+      float rotate[16], translate[16];
+      makeRotateMatrix(benchRandom(&seed, 0, 360),
+                       benchRandom(&seed, -1, 1), benchRandom(&seed, -1, 1), 1,
+                       rotate);
+      makeTranslateMatrix(benchRandom(&seed, -10, 10), benchRandom(&seed, -10, 10),
+                          benchRandom(&seed, -10, 10), translate);
+      multMatrix(&model[i*16], translate, rotate);
+    }
+
+    /* Current path: two multMatrix calls per object. */
+    double scalar = benchBest([&] {
+      for (int i = 0; i < count; i++) {
+        multMatrix(&refModelview[i*16], view, &model[i*16]);
+        multMatrix(&refMvp[i*16], projection, &refModelview[i*16]);
+      }
+      benchKeep(refMvp[0]);
+    });
+    printf("%8d  %-10s %10.2f %12.4g %8s %10s\n",
+      count, "multMatrix", scalar*1e9/count, count/scalar, "1.00x", "-");
+
+    for (int level = MATRIX_SIMD_SCALAR; level <= support; level++) {
+      setMatrixSimdLevel((MatrixSimdLevel) level);
+      double t = benchBest([&] {
+        multMatrixArrayStrided(&modelview[0], 16, view, 0, &model[0], 16, count);
+        multMatrixArrayStrided(&mvp[0], 16, projection, 0, &modelview[0], 16, count);
+        benchKeep(mvp[0]);
+      });
+
+      float maxError = 0;
+      for (int i = 0; i < count*16; i++) {
+        float e = fabsf(mvp[i] - refMvp[i]);
+        if (e > maxError)
+          maxError = e;
+      }
+      printf("%8d  %-10s %10.2f %12.4g %7.2fx %10.3g\n",
+        count, getMatrixSimdLevelName((MatrixSimdLevel) level),
+        t*1e9/count, count/t, scalar/t, maxError);
+    }
+    setMatrixSimdLevel(support);
+  }
+  return 0;
+}
@@ -0,0 +1,571 @@
+/* matrix_report.cpp - Time every math routine in matrix.h and measure its
+   error against a long double reference, and print the results as JSON
+   so that runs can be compared.
+
+   Every routine is run over the same set of inputs, on one thread, once
+   per SIMD level it has a kernel for.  For each one the report gives
+
+     ns_per_op    best time per call (per matrix or vertex for the
+                  array routines)
+     ops_per_s    1e9 / ns_per_op
+     max_ulp      largest error of any output element, in units in the
+                  last place of the float nearest the reference value
+     mean_ulp     the same, averaged over all output elements
+
+   An output element whose reference is much smaller than the largest
+   element of the same result (say, an off-diagonal zero of a rotation)
+   would otherwise report an enormous ulp count for a negligible error,
+   so errors are measured against ulps of at least 1/1024 of that largest
+   element.
+
+   The single-matrix routines compute in the precision matrix.cpp was
+   built with (see MATRIX_PRECISION in matrix.h), which the report names;
+   "make precision" builds and runs it once per setting.
+
+   Usage: matrix_report [--min-time seconds] */
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#include "bench.h"
+#include "../cgfx_buffer_lighting/matrix.h"
+#include "../cgfx_buffer_lighting/parallel.h"
+
+typedef long double Real;
+
+static const int myCount = 4096;
+static double myMinTime = 0.25;
+
+/* Error statistics for one routine. */
+struct UlpStats
+{
+  double maxUlp, sumUlp;
+  long elements;
+
+  UlpStats() : maxUlp(0), sumUlp(0), elements(0) {}
+
+  /* One result of n elements. */
+  void add(const float *got, const Real *ref, int n)
+  {
+    Real largest = 0;
+    int i;
+
+    for (i = 0; i < n; i++)
+      if (fabsl(ref[i]) > largest)
+        largest = fabsl(ref[i]);
+    for (i = 0; i < n; i++) {
+      float scale = (float) (fabsl(ref[i]) > largest/1024 ? fabsl(ref[i]) : largest/1024);
+      double ulp = (double) (nextafterf(scale, FLT_MAX) - scale);
+      double e = (double) (fabsl(got[i] - ref[i]) / (ulp > 0 ? ulp : FLT_MIN));
+
+      if (e > maxUlp)
+        maxUlp = e;
+      sumUlp += e;
+      elements++;
+    }
+  }
+};
+
+static bool myFirstResult = true;
+
+static void report(const char *function, const char *variant,
+                   double seconds, int ops, const UlpStats &stats)
+{
+  double ns = seconds * 1e9 / ops;
+
+  printf("%s    {\"function\": \"%s\", \"variant\": \"%s\", "
+         "\"ns_per_op\": %.4f, \"ops_per_s\": %.6g, "
+         "\"max_ulp\": %.3f, \"mean_ulp\": %.4f}",
+    myFirstResult ? "" : ",\n", function, variant, ns, 1e9 / ns,
+    stats.maxUlp, stats.elements ? stats.sumUlp / stats.elements : 0.0);
+  myFirstResult = false;
+}
+
+/* Long double references. */
+
+static const Real myPi = 3.14159265358979323846264338327950288L;
+
+static void refMult(Real dst[16], const float a[16], const float b[16])
+{
+  for (int i = 0; i < 4; i++)
+    for (int j = 0; j < 4; j++)
+      dst[i*4+j] = (Real) a[i*4+0]*b[0*4+j] + (Real) a[i*4+1]*b[1*4+j] +
+                   (Real) a[i*4+2]*b[2*4+j] + (Real) a[i*4+3]*b[3*4+j];
+}
+
+static void refTransform(Real dst[4], const float m[16], const float v[4], int rows, int cols)
+{
+  for (int i = 0; i < rows; i++) {
+    dst[i] = 0;
+    for (int k = 0; k < cols; k++)
+      dst[i] += (Real) m[i*4+k] * v[k];
+  }
+}
+
+/* Gauss-Jordan elimination with partial pivoting. */
+static void refInvert(Real out[16], const float m[16])
+{
+  Real a[4][8];
+  int r, c, k;
+
+  for (r = 0; r < 4; r++)
+    for (c = 0; c < 8; c++)
+      a[r][c] = c < 4 ? (Real) m[r*4+c] : (Real) (c - 4 == r);
+  for (c = 0; c < 4; c++) {
+    int pivot = c;
+    for (r = c+1; r < 4; r++)
+      if (fabsl(a[r][c]) > fabsl(a[pivot][c]))
+        pivot = r;
+    for (k = 0; k < 8; k++) {
+      Real t = a[c][k]; a[c][k] = a[pivot][k]; a[pivot][k] = t;
+    }
+    for (k = 7; k >= c; k--)
+      a[c][k] /= a[c][c];
+    for (r = 0; r < 4; r++) {
+      if (r == c)
+        continue;
+      for (k = 7; k >= c; k--)
+        a[r][k] -= a[r][c] * a[c][k];
+    }
+  }
+  for (r = 0; r < 4; r++)
+    for (c = 0; c < 4; c++)
+      out[r*4+c] = a[r][c+4];
+}
+
+static void refLookAt(Real m[16], const float p[9])
+{
+  Real x[3], y[3], z[3], mag;
+  int i;
+
+  for (i = 0; i < 3; i++) {
+    z[i] = (Real) p[i] - p[3+i];
+    y[i] = p[6+i];
+  }
+  mag = sqrtl(z[0]*z[0] + z[1]*z[1] + z[2]*z[2]);
+  for (i = 0; i < 3; i++)
+    z[i] /= mag;
+  x[0] = y[1]*z[2] - y[2]*z[1];
+  x[1] = y[2]*z[0] - y[0]*z[2];
+  x[2] = y[0]*z[1] - y[1]*z[0];
+  mag = sqrtl(x[0]*x[0] + x[1]*x[1] + x[2]*x[2]);
+  for (i = 0; i < 3; i++)
+    x[i] /= mag;
+  y[0] = z[1]*x[2] - z[2]*x[1];
+  y[1] = z[2]*x[0] - z[0]*x[2];
+  y[2] = z[0]*x[1] - z[1]*x[0];
+  for (i = 0; i < 3; i++) {
+    m[0*4+i] = x[i];
+    m[1*4+i] = y[i];
+    m[2*4+i] = z[i];
+    m[3*4+i] = 0;
+  }
+  m[3]  = -(x[0]*p[0] + x[1]*p[1] + x[2]*p[2]);
+  m[7]  = -(y[0]*p[0] + y[1]*p[1] + y[2]*p[2]);
+  m[11] = -(z[0]*p[0] + z[1]*p[1] + z[2]*p[2]);
+  m[15] = 1;
+}
+
+/* Same layout as makeRotateMatrix. */
+static void refRotate(Real m[16], const float p[4])
+{
+  Real len = sqrtl((Real) p[1]*p[1] + (Real) p[2]*p[2] + (Real) p[3]*p[3]);
+  Real x = p[1]/len, y = p[2]/len, z = p[3]/len;
+  Real s = sinl(p[0] * myPi / 180), c = cosl(p[0] * myPi / 180);
+
+  m[0] = x*x + c*(1 - x*x);  m[1] = x*y*(1 - c) + z*s;  m[2]  = z*x*(1 - c) - y*s;  m[3]  = 0;
+  m[4] = x*y*(1 - c) - z*s;  m[5] = y*y + c*(1 - y*y);  m[6]  = y*z*(1 - c) + x*s;  m[7]  = 0;
+  m[8] = z*x*(1 - c) + y*s;  m[9] = y*z*(1 - c) - x*s;  m[10] = z*z + c*(1 - z*z);  m[11] = 0;
+  m[12] = 0;  m[13] = 0;  m[14] = 0;  m[15] = 1;
+}
+
+static void refPerspective(Real m[16], const float p[4])
+{
+  Real cotangent = 1 / tanl(p[0] / 2 * myPi / 180);
+
+  for (int i = 0; i < 16; i++)
+    m[i] = 0;
+  m[0]  = cotangent / p[1];
+  m[5]  = cotangent;
+  m[10] = -((Real) p[3] + p[2]) / ((Real) p[3] - p[2]);
+  m[11] = -2 * (Real) p[2] * p[3] / ((Real) p[3] - p[2]);
+  m[14] = -1;
+}
+
+/* Inputs */
+
+struct Inputs
+{
+  std::vector<float> rigid, affine, general, other;   /* myCount matrices each */
+  std::vector<float> vec;                             /* myCount 4-vectors */
+  std::vector<float> points;                          /* in front of camera */
+  std::vector<float> lookAt, rotate, perspective;     /* builder parameters */
+  float mvp[16];
+};
+
+static void makeInputs(Inputs &in)
+{
+  float projection[16], view[16];
+  unsigned int seed = 11;
+
+  makePerspectiveMatrix(60.0, 1.5, 1.0, 50.0, projection);
+  makeLookAtMatrix(8, 2, 3,  0, 0, 0,  0, 1, 0, view);
+  multMatrix(in.mvp, projection, view);
+
+  in.rigid.resize(myCount*16);
+  in.affine.resize(myCount*16);
+  in.general.resize(myCount*16);
+  in.other.resize(myCount*16);
+  in.vec.resize(myCount*4);
+  in.points.resize(myCount*4);
+  in.lookAt.resize(myCount*9);
+  in.rotate.resize(myCount*4);
+  in.perspective.resize(myCount*4);
+
+  for (int i = 0; i < myCount; i++) {
+    float rotate[16], translate[16], scale[16];
+
+    makeRotateMatrix(benchRandom(&seed, 0, 360),
+                     benchRandom(&seed, -1, 1), benchRandom(&seed, -1, 1), 1, rotate);
+    makeTranslateMatrix(benchRandom(&seed, -10, 10), benchRandom(&seed, -10, 10),
+                        benchRandom(&seed, -10, 10), translate);
+    makeTranslateMatrix(0, 0, 0, scale);
+    scale[0] = benchRandom(&seed, 0.2f, 5);
+    scale[5] = benchRandom(&seed, 0.2f, 5);
+    scale[10] = benchRandom(&seed, 0.2f, 5);
+    multMatrix(&in.rigid[i*16], translate, rotate);
+    multMatrix(&in.affine[i*16], &in.rigid[i*16], scale);
+    multMatrix(&in.general[i*16], projection, &in.affine[i*16]);
+    for (int j = 0; j < 16; j++)
+      in.other[i*16+j] = benchRandom(&seed, -2, 2);
+
+    for (int j = 0; j < 4; j++)
+      in.vec[i*4+j] = benchRandom(&seed, -5, 5);
+    for (int j = 0; j < 3; j++)
+      in.points[i*4+j] = benchRandom(&seed, -3, 3);
+    in.points[i*4+3] = 1;
+
+    for (int j = 0; j < 6; j++)
+      in.lookAt[i*9+j] = benchRandom(&seed, -10, 10);
+    in.lookAt[i*9+6] = benchRandom(&seed, -0.2f, 0.2f);
+    in.lookAt[i*9+7] = 1;
+    in.lookAt[i*9+8] = benchRandom(&seed, -0.2f, 0.2f);
+
+    in.rotate[i*4+0] = benchRandom(&seed, -360, 360);
+    for (int j = 1; j < 4; j++)
+      in.rotate[i*4+j] = benchRandom(&seed, -1, 1);
+
+    in.perspective[i*4+0] = benchRandom(&seed, 20, 120);
+    in.perspective[i*4+1] = benchRandom(&seed, 0.5f, 2.5f);
+    in.perspective[i*4+2] = benchRandom(&seed, 0.05f, 2);
+    in.perspective[i*4+3] = benchRandom(&seed, 10, 1000);
+  }
+}
+
+/* Pack structure-of-arrays outputs into 4-float records for measure(). */
+static void gatherSoA(std::vector<float> &dst, const std::vector<float> &x,
+                      const std::vector<float> &y, const std::vector<float> &z,
+                      const std::vector<float> &w)
+{
+  for (int i = 0; i < myCount; i++) {
+    dst[i*4+0] = x[i];  dst[i*4+1] = y[i];  dst[i*4+2] = z[i];  dst[i*4+3] = w[i];
+  }
+}
+
+/* One result per input: n elements of got[i*stride...] against ref. */
+template <typename RefFn>
+static UlpStats measure(const std::vector<float> &got, int n, int stride, RefFn refFn)
+{
+  UlpStats stats;
+  Real ref[16];
+
+  for (int i = 0; i < myCount; i++) {
+    refFn(i, ref);
+    stats.add(&got[i*stride], ref, n);
+  }
+  return stats;
+}
+
+int main(int argc, char **argv)
+{
+  MatrixSimdLevel support = getMatrixSimdSupport();
+  Inputs in;
+  std::vector<float> out(myCount*16);
+  const float *mvp = in.mvp;
+  double t;
+  int i, level;
+
+  for (i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--min-time") && i+1 < argc) {
+      myMinTime = atof(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--min-time seconds]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  makeInputs(in);
+  setParallelThreadCount(1);
+
+  printf("{\n  \"benchmark\": \"matrix_report\",\n  \"inputs\": %d,\n"
+         "  \"precision\": \"%s\",\n  \"simd_support\": \"%s\",\n  \"results\": [\n",
+    myCount, getMatrixPrecisionName(), getMatrixSimdLevelName(support));
+
+  /* Builders */
+
+  t = benchBest([&] {
+    for (int i = 0; i < myCount; i++) {
+      const float *p = &in.perspective[i*4];
+      makePerspectiveMatrix(p[0], p[1], p[2], p[3], &out[i*16]);
+    }
+    benchKeep(out[0]);
+  }, myMinTime);
+  report("makePerspectiveMatrix", "scalar", t, myCount,
+    measure(out, 16, 16, [&](int i, Real *ref) { refPerspective(ref, &in.perspective[i*4]); }));
+
+  t = benchBest([&] {
+    for (int i = 0; i < myCount; i++) {
+      const float *p = &in.lookAt[i*9];
+      makeLookAtMatrix(p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7], p[8], &out[i*16]);
+    }
+    benchKeep(out[0]);
+  }, myMinTime);
+  report("makeLookAtMatrix", "scalar", t, myCount,
+    measure(out, 16, 16, [&](int i, Real *ref) { refLookAt(ref, &in.lookAt[i*9]); }));
+
+  t = benchBest([&] {
+    for (int i = 0; i < myCount; i++) {
+      const float *p = &in.rotate[i*4];
+      makeRotateMatrix(p[0], p[1], p[2], p[3], &out[i*16]);
+    }
+    benchKeep(out[0]);
+  }, myMinTime);
+  report("makeRotateMatrix", "scalar", t, myCount,
+    measure(out, 16, 16, [&](int i, Real *ref) { refRotate(ref, &in.rotate[i*4]); }));
+
+  {
+    std::vector<float> angle(myCount);
+
+    for (int i = 0; i < myCount; i++)
+      angle[i] = in.rotate[i*4];
+    for (level = MATRIX_SIMD_SCALAR; level <= support; level++) {
+      setMatrixSimdLevel((MatrixSimdLevel) level);
+      t = benchBest([&] {
+        makeRotateMatrixArray(&out[0], 16, &angle[0], &in.rotate[1], 4, myCount);
+        benchKeep(out[0]);
+      }, myMinTime);
+      report("makeRotateMatrixArray", getMatrixSimdLevelName((MatrixSimdLevel) level), t, myCount,
+        measure(out, 16, 16, [&](int i, Real *ref) { refRotate(ref, &in.rotate[i*4]); }));
+    }
+    setMatrixSimdLevel(support);
+  }
+
+  t = benchBest([&] {
+    for (int i = 0; i < myCount; i++) {
+      const float *p = &in.vec[i*4];
+      makeTranslateMatrix(p[0], p[1], p[2], &out[i*16]);
+    }
+    benchKeep(out[0]);
+  }, myMinTime);
+  report("makeTranslateMatrix", "scalar", t, myCount,
+    measure(out, 16, 16, [&](int i, Real *ref) {
+      const float *p = &in.vec[i*4];
+      for (int j = 0; j < 16; j++)
+        ref[j] = (j % 5) == 0;
+      ref[3] = p[0];  ref[7] = p[1];  ref[11] = p[2];
+    }));
+
+  /* Products */
+
+  t = benchBest([&] {
+    for (int i = 0; i < myCount; i++)
+      multMatrix(&out[i*16], &in.general[i*16], &in.other[i*16]);
+    benchKeep(out[0]);
+  }, myMinTime);
+  report("multMatrix", "scalar", t, myCount,
+    measure(out, 16, 16, [&](int i, Real *ref) { refMult(ref, &in.general[i*16], &in.other[i*16]); }));
+
+  for (level = MATRIX_SIMD_SCALAR; level <= support; level++) {
+    setMatrixSimdLevel((MatrixSimdLevel) level);
+    t = benchBest([&] {
+      multMatrixArray(&out[0], &in.general[0], &in.other[0], myCount);
+      benchKeep(out[0]);
+    }, myMinTime);
+    report("multMatrixArray", getMatrixSimdLevelName((MatrixSimdLevel) level), t, myCount,
+      measure(out, 16, 16, [&](int i, Real *ref) { refMult(ref, &in.general[i*16], &in.other[i*16]); }));
+
+    t = benchBest([&] {
+      multMatrixArrayStrided(&out[0], 16, mvp, 0, &in.affine[0], 16, myCount);
+      benchKeep(out[0]);
+    }, myMinTime);
+    report("multMatrixArrayStrided", getMatrixSimdLevelName((MatrixSimdLevel) level), t, myCount,
+      measure(out, 16, 16, [&](int i, Real *ref) { refMult(ref, mvp, &in.affine[i*16]); }));
+  }
+  setMatrixSimdLevel(support);
+
+  t = benchBest([&] {
+    for (int i = 0; i < myCount; i++)
+      transposeMatrix(&out[i*16], &in.other[i*16]);
+    benchKeep(out[0]);
+  }, myMinTime);
+  report("transposeMatrix", "scalar", t, myCount,
+    measure(out, 16, 16, [&](int i, Real *ref) {
+      for (int j = 0; j < 16; j++)
+        ref[j] = in.other[i*16 + (j%4)*4 + j/4];
+    }));
+
+  /* Inverses */
+
+  t = benchBest([&] {
+    for (int i = 0; i < myCount; i++)
+      invertMatrix(&out[i*16], &in.general[i*16]);
+    benchKeep(out[0]);
+  }, myMinTime);
+  report("invertMatrix", "scalar", t, myCount,
+    measure(out, 16, 16, [&](int i, Real *ref) { refInvert(ref, &in.general[i*16]); }));
+
+  for (level = MATRIX_SIMD_SCALAR; level <= support && level <= MATRIX_SIMD_SSE; level++) {
+    setMatrixSimdLevel((MatrixSimdLevel) level);
+    t = benchBest([&] {
+      for (int i = 0; i < myCount; i++)
+        invertMatrixCofactor(&out[i*16], &in.general[i*16]);
+      benchKeep(out[0]);
+    }, myMinTime);
+    report("invertMatrixCofactor", getMatrixSimdLevelName((MatrixSimdLevel) level), t, myCount,
+      measure(out, 16, 16, [&](int i, Real *ref) { refInvert(ref, &in.general[i*16]); }));
+  }
+  setMatrixSimdLevel(support);
+
+  t = benchBest([&] {
+    for (int i = 0; i < myCount; i++)
+      invertAffineMatrix(&out[i*16], &in.affine[i*16]);
+    benchKeep(out[0]);
+  }, myMinTime);
+  report("invertAffineMatrix", "scalar", t, myCount,
+    measure(out, 16, 16, [&](int i, Real *ref) { refInvert(ref, &in.affine[i*16]); }));
+
+  t = benchBest([&] {
+    for (int i = 0; i < myCount; i++)
+      invertRigidMatrix(&out[i*16], &in.rigid[i*16]);
+    benchKeep(out[0]);
+  }, myMinTime);
+  report("invertRigidMatrix", "scalar", t, myCount,
+    measure(out, 16, 16, [&](int i, Real *ref) { refInvert(ref, &in.rigid[i*16]); }));
+
+  /* Single-vector transforms */
+
+  t = benchBest([&] {
+    for (int i = 0; i < myCount; i++)
+      transformPosition(&out[i*4], mvp, &in.points[i*4]);
+    benchKeep(out[0]);
+  }, myMinTime);
+  report("transformPosition", "scalar", t, myCount,
+    measure(out, 3, 4, [&](int i, Real *ref) {
+      refTransform(ref, mvp, &in.points[i*4], 4, 4);
+      ref[0] /= ref[3];  ref[1] /= ref[3];  ref[2] /= ref[3];
+    }));
+
+  t = benchBest([&] {
+    for (int i = 0; i < myCount; i++)
+      transformVector(&out[i*4], &in.affine[i*16], &in.vec[i*4]);
+    benchKeep(out[0]);
+  }, myMinTime);
+  report("transformVector", "scalar", t, myCount,
+    measure(out, 4, 4, [&](int i, Real *ref) { refTransform(ref, &in.affine[i*16], &in.vec[i*4], 4, 4); }));
+
+  t = benchBest([&] {
+    for (int i = 0; i < myCount; i++)
+      transformDirection(&out[i*4], &in.affine[i*16], &in.vec[i*4]);
+    benchKeep(out[0]);
+  }, myMinTime);
+  report("transformDirection", "scalar", t, myCount,
+    measure(out, 3, 4, [&](int i, Real *ref) { refTransform(ref, &in.affine[i*16], &in.vec[i*4], 3, 3); }));
+
+  t = benchBest([&] {
+    for (int i = 0; i < myCount; i++) {
+      memcpy(&out[i*4], &in.vec[i*4], 3*sizeof(float));
+      normalizeDirection(&out[i*4]);
+    }
+    benchKeep(out[0]);
+  }, myMinTime);
+  report("normalizeDirection", "scalar", t, myCount,
+    measure(out, 3, 4, [&](int i, Real *ref) {
+      const float *v = &in.vec[i*4];
+      Real len = sqrtl((Real) v[0]*v[0] + (Real) v[1]*v[1] + (Real) v[2]*v[2]);
+      ref[0] = v[0]/len;  ref[1] = v[1]/len;  ref[2] = v[2]/len;
+    }));
+
+  /* Array transforms, all through the mvp */
+
+  {
+    std::vector<float> x(myCount), y(myCount), z(myCount), w(myCount);
+    std::vector<float> ox(myCount), oy(myCount), oz(myCount), ow(myCount);
+    std::vector<float> packed(myCount*3), gathered(myCount*4);
+
+    for (i = 0; i < myCount; i++) {
+      x[i] = packed[i*3+0] = in.points[i*4+0];
+      y[i] = packed[i*3+1] = in.points[i*4+1];
+      z[i] = packed[i*3+2] = in.points[i*4+2];
+      w[i] = in.points[i*4+3];
+    }
+
+    for (level = MATRIX_SIMD_SCALAR; level <= support; level++) {
+      const char *name = getMatrixSimdLevelName((MatrixSimdLevel) level);
+
+      setMatrixSimdLevel((MatrixSimdLevel) level);
+
+      t = benchBest([&] {
+        transformVectorArraySoA(&ox[0], &oy[0], &oz[0], &ow[0], mvp,
+                                &x[0], &y[0], &z[0], &w[0], myCount);
+        benchKeep(ox[0]);
+      }, myMinTime);
+      gatherSoA(gathered, ox, oy, oz, ow);
+      report("transformVectorArraySoA", name, t, myCount,
+        measure(gathered, 4, 4, [&](int i, Real *ref) { refTransform(ref, mvp, &in.points[i*4], 4, 4); }));
+
+      t = benchBest([&] {
+        transformPositionArraySoA(&ox[0], &oy[0], &oz[0], mvp,
+                                  &x[0], &y[0], &z[0], NULL, myCount);
+        benchKeep(ox[0]);
+      }, myMinTime);
+      gatherSoA(gathered, ox, oy, oz, ow);
+      report("transformPositionArraySoA", name, t, myCount,
+        measure(gathered, 3, 4, [&](int i, Real *ref) {
+          refTransform(ref, mvp, &in.points[i*4], 4, 4);
+          ref[0] /= ref[3];  ref[1] /= ref[3];  ref[2] /= ref[3];
+        }));
+
+      t = benchBest([&] {
+        transformDirectionArraySoA(&ox[0], &oy[0], &oz[0], mvp,
+                                   &x[0], &y[0], &z[0], myCount);
+        benchKeep(ox[0]);
+      }, myMinTime);
+      gatherSoA(gathered, ox, oy, oz, ow);
+      report("transformDirectionArraySoA", name, t, myCount,
+        measure(gathered, 3, 4, [&](int i, Real *ref) { refTransform(ref, mvp, &in.points[i*4], 3, 3); }));
+
+      t = benchBest([&] {
+        transformPositionArray(&out[0], 3, mvp, &packed[0], 3, myCount);
+        benchKeep(out[0]);
+      }, myMinTime);
+      report("transformPositionArray", name, t, myCount,
+        measure(out, 3, 3, [&](int i, Real *ref) {
+          refTransform(ref, mvp, &in.points[i*4], 4, 4);
+          ref[0] /= ref[3];  ref[1] /= ref[3];  ref[2] /= ref[3];
+        }));
+
+      t = benchBest([&] {
+        transformDirectionArray(&out[0], 3, mvp, &packed[0], 3, myCount);
+        benchKeep(out[0]);
+      }, myMinTime);
+      report("transformDirectionArray", name, t, myCount,
+        measure(out, 3, 3, [&](int i, Real *ref) { refTransform(ref, mvp, &in.points[i*4], 3, 3); }));
+    }
+    setMatrixSimdLevel(support);
+  }
+
+  printf("\n  ]\n}\n");
+  return 0;
+}
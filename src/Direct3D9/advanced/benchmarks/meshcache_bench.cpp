@@ -0,0 +1,180 @@
+/* meshcache_bench.cpp - Loading a mesh cache file (meshcache.h) against parsing the OBJ it came from.
+
+   Usage: meshcache_bench [-mb N] [-lod N] [file.obj ...]
+
+   For each OBJ file (without arguments, Lab5's model_for_cga.obj and
+   Lab6's retopoly.obj) and a synthetic OBJ of about N megabytes (100
+   by default; see writeSyntheticObj in objmodel.h), writes a mesh cache
+   <file>.mesh next to the program, with a MeshVertex stream, a
+   PackedVertex stream, and up to -lod N levels (4 by default), then
+   times getting the mesh ready to draw:
+
+     readObj      objmodel.h's sscanf and std::map reader
+     objfile      readObjFile and buildObjMesh (objfile.h, objmesh.h)
+     open         openMeshCache: map, check, and point into the file
+     open+copy    openMeshCache, then the MeshVertex stream and the
+                  indices copied out as into a locked vertex and index
+                  buffer
+
+   The files are read from the system's file cache, as on a second run;
+   the first run after a reboot also waits for the disk, text or not.
+   The cache file's vertices and level 0 indices must match what
+   buildObjMesh built. */
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "objmodel.h"
+#include "../cgfx_buffer_lighting/meshcache.h"
+#include "../cgfx_buffer_lighting/objfile.h"
+#include "../cgfx_buffer_lighting/objmesh.h"
+
+static const char *mySyntheticPath = "meshcache_bench_synthetic.obj";
+
+/* Whether the cache holds mesh: the same vertices, and level 0's
+   submeshes drawing the same indices. */
+static bool sameMesh(const MeshCacheContents *c, const ObjMesh *mesh)
+{
+  const MeshCacheIndexBuffer *b = &c->indexBuffers[0];
+
+  if (c->streams[0].vertexCount != (unsigned int) mesh->vertexCount ||
+      memcmp(c->streamData[0], mesh->vertices, mesh->vertexCount * sizeof(MeshVertex)) != 0 ||
+      c->lods[0].submeshCount != (unsigned int) mesh->submeshCount)
+    return false;
+  for (int s = 0; s < mesh->submeshCount; s++) {
+    const MeshCacheSubmesh *cs = &c->submeshes[c->lods[0].submeshStart + s];
+    const ObjSubmesh *os = &mesh->submeshes[s];
+
+    if (cs->vertexStart != (unsigned int) os->vertexStart ||
+        cs->indexCount != (unsigned int) os->indexCount)
+      return false;
+    for (int i = 0; i < os->indexCount; i++) {
+      unsigned int index = b->indexSize == 2 ?
+        ((const unsigned short *) c->indexData[0])[cs->indexStart + i] :
+        ((const unsigned int *) c->indexData[0])[cs->indexStart + i];
+
+      if (index != mesh->indices[os->indexStart + i])
+        return false;
+    }
+  }
+  return true;
+}
+
+static void reportFile(const char *path, int lodLevels)
+{
+  const char *name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+  std::string cachePath = std::string(name) + ".mesh";
+  std::vector<char> vertexBuffer, indexBuffer;
+  ObjModel model;
+  ObjFile obj;
+  ObjMesh mesh;
+  MeshCache cache;
+  double t0, readObjTime, objfileTime, openTime, copyTime, writeTime, megabytes;
+
+  t0 = benchNow();
+  if (!readObj(path, model)) {
+    fprintf(stderr, "meshcache_bench: cannot open %s\n", path);
+    return;
+  }
+  readObjTime = benchNow() - t0;
+  megabytes = model.fileSize / 1048576.0;
+  objfileTime = benchBest([&] {
+    ObjFile o;
+    ObjMesh m;
+
+    readObjFile(path, &o);
+    buildObjMesh(&m, &o);
+    benchKeep(m.indexCount);
+    freeObjMesh(&m);
+    freeObjFile(&o);
+  }, 0.5);
+
+  if (!readObjFile(path, &obj) || !buildObjMesh(&mesh, &obj)) {
+    fprintf(stderr, "meshcache_bench: cannot parse %s\n", path);
+    return;
+  }
+  t0 = benchNow();
+  if (!writeObjMeshCache(cachePath.c_str(), &obj, &mesh, NULL, OBJMESH_CACHE_PACKED,
+                         lodLevels) ||
+      !openMeshCache(&cache, cachePath.c_str())) {
+    fprintf(stderr, "meshcache_bench: cannot write %s\n", cachePath.c_str());
+    freeObjMesh(&mesh);
+    freeObjFile(&obj);
+    return;
+  }
+  writeTime = benchNow() - t0;
+  printf("%s: %.1f MB of OBJ, %d vertices, %d triangles, %d submeshes\n", name, megabytes,
+    mesh.vertexCount, mesh.indexCount / 3, mesh.submeshCount);
+  printf("  %s: %.1f MB, %d streams, %u-byte indices, %d levels, written in %.0f ms\n",
+    cachePath.c_str(), cache.file.size / 1048576.0, cache.contents.streamCount,
+    cache.contents.indexBuffers[0].indexSize, cache.contents.lodCount, writeTime * 1e3);
+  printf("  contents %s\n", sameMesh(&cache.contents, &mesh) ? "match" : "DIFFER");
+  vertexBuffer.resize(cache.contents.streams[0].vertexCount * sizeof(MeshVertex) + 1);
+  indexBuffer.resize(cache.contents.indexBuffers[0].indexCount *
+                     cache.contents.indexBuffers[0].indexSize + 1);
+  closeMeshCache(&cache);
+  freeObjMesh(&mesh);
+  freeObjFile(&obj);
+
+  openTime = benchBest([&] {
+    MeshCache c;
+
+    openMeshCache(&c, cachePath.c_str());
+    benchKeep(c.contents.submeshes);
+    closeMeshCache(&c);
+  }, 0.25);
+  copyTime = benchBest([&] {
+    MeshCache c;
+    const MeshCacheContents *m = &c.contents;
+
+    openMeshCache(&c, cachePath.c_str());
+    memcpy(&vertexBuffer[0], m->streamData[0], m->streams[0].vertexCount * sizeof(MeshVertex));
+    memcpy(&indexBuffer[0], m->indexData[0],
+           m->indexBuffers[0].indexCount * m->indexBuffers[0].indexSize);
+    benchKeep(indexBuffer[0]);
+    closeMeshCache(&c);
+  }, 0.25);
+
+  printf("  %-10s %10.3f ms %9.1f MB/s of OBJ\n", "readObj", readObjTime * 1e3,
+    megabytes / readObjTime);
+  printf("  %-10s %10.3f ms %9.1f MB/s of OBJ %9.1fx\n", "objfile", objfileTime * 1e3,
+    megabytes / objfileTime, readObjTime / objfileTime);
+  printf("  %-10s %10.3f ms %21s %9.1fx\n", "open", openTime * 1e3, "",
+    readObjTime / openTime);
+  printf("  %-10s %10.3f ms %21s %9.1fx\n\n", "open+copy", copyTime * 1e3, "",
+    readObjTime / copyTime);
+}
+
+int main(int argc, char **argv)
+{
+  static const char *defaults[] = {
+    "../../../Labs/Lab5/model_for_cga.obj",
+    "../../../Labs/Lab6/retopoly.obj"
+  };
+  int megabytes = 100, lodLevels = 4, files = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-mb") == 0 && i + 1 < argc)
+      megabytes = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-lod") == 0 && i + 1 < argc)
+      lodLevels = atoi(argv[++i]);
+    else
+      reportFile(argv[i], lodLevels), files++;
+  }
+  if (files == 0)
+    for (int i = 0; i < (int) (sizeof(defaults) / sizeof(defaults[0])); i++)
+      reportFile(defaults[i], lodLevels);
+  if (megabytes > 0) {
+    if (!writeSyntheticObj(mySyntheticPath, megabytes)) {
+      fprintf(stderr, "meshcache_bench: cannot write %s\n", mySyntheticPath);
+      return 1;
+    }
+    reportFile(mySyntheticPath, lodLevels);
+    remove(mySyntheticPath);
+    remove((std::string(mySyntheticPath) + ".mesh").c_str());
+  }
+  return 0;
+}
@@ -0,0 +1,115 @@
+/* obj2mesh.cpp - Convert a Wavefront OBJ file to a mesh cache file (meshcache.h).
+
+   Usage: obj2mesh [-packed] [-lod N] in.obj out.mesh
+
+   Parses in.obj with readObjFile (objfile.h) and its mtllib with
+   readMtlFile (mtlfile.h), builds one submesh per object and material
+   with buildObjMesh (objmesh.h), sorts the submeshes by distinct
+   material, and writes them with writeObjMeshCache: -packed adds a
+   16-byte PackedVertex stream (compress.h) beside the MeshVertex one,
+   and -lod N asks for up to N LOD levels (1, no simplification, by
+   default).  The file is then opened again and its tables printed. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "objmodel.h"
+#include "../cgfx_buffer_lighting/meshcache.h"
+#include "../cgfx_buffer_lighting/mtlfile.h"
+#include "../cgfx_buffer_lighting/objfile.h"
+#include "../cgfx_buffer_lighting/objmesh.h"
+
+static void printMeshCache(const MeshCache *cache)
+{
+  const MeshCacheContents *c = &cache->contents;
+  int i;
+
+  printf("%lu bytes, bounds (%g %g %g) to (%g %g %g), radius %g\n",
+    (unsigned long) cache->file.size, c->boundsMin[0], c->boundsMin[1], c->boundsMin[2],
+    c->boundsMax[0], c->boundsMax[1], c->boundsMax[2], c->radius);
+  for (i = 0; i < c->streamCount; i++)
+    printf("  stream %d: %s, %u vertices of %u bytes\n", i,
+      c->streams[i].format == MESHCACHE_PACKED_VERTEX ? "PackedVertex" : "MeshVertex",
+      c->streams[i].vertexCount, c->streams[i].stride);
+  for (i = 0; i < c->indexBufferCount; i++)
+    printf("  index buffer %d: %u indices of %u bytes\n", i, c->indexBuffers[i].indexCount,
+      c->indexBuffers[i].indexSize);
+  for (i = 0; i < c->materialCount; i++) {
+    const MaterialData *m = &c->materials[i].data;
+
+    printf("  material %d: %s, diffuse %g %g %g, specular %g %g %g, shine %g\n", i,
+      c->materials[i].name, m->diffuse[0], m->diffuse[1], m->diffuse[2], m->specular[0],
+      m->specular[1], m->specular[2], m->shine[0]);
+  }
+  for (i = 0; i < c->lodCount; i++) {
+    const MeshCacheLod *lod = &c->lods[i];
+    unsigned int triangles = 0, s;
+
+    for (s = lod->submeshStart; s < lod->submeshStart + lod->submeshCount; s++)
+      triangles += c->submeshes[s].indexCount / 3;
+    printf("  level %d: %u submeshes, %u triangles, error %.5f\n", i, lod->submeshCount,
+      triangles, lod->error);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  const char *in = NULL, *out = NULL;
+  int flags = 0, lodLevels = 1, i;
+  ObjFile obj;
+  ObjMesh mesh;
+  MtlFile mtl;
+  MeshCache cache;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-packed") == 0)
+      flags |= OBJMESH_CACHE_PACKED;
+    else if (strcmp(argv[i], "-lod") == 0 && i + 1 < argc)
+      lodLevels = atoi(argv[++i]);
+    else if (!in)
+      in = argv[i];
+    else
+      out = argv[i];
+  }
+  if (!in || !out) {
+    fprintf(stderr, "usage: obj2mesh [-packed] [-lod N] in.obj out.mesh\n");
+    return 2;
+  }
+  if (!readObjFile(in, &obj)) {
+    fprintf(stderr, "obj2mesh: cannot parse %s\n", in);
+    return 1;
+  }
+  memset(&mtl, 0, sizeof(mtl));
+  if (obj.materialLibrary &&
+      !readMtlFile(getObjLibraryPath(in, obj.materialLibrary).c_str(), &mtl))
+    fprintf(stderr, "obj2mesh: cannot read %s; using default materials\n", obj.materialLibrary);
+  if (!buildObjMesh(&mesh, &obj)) {
+    fprintf(stderr, "obj2mesh: %s is too large\n", in);
+    return 1;
+  }
+  if (obj.materialCount > 0) {
+    std::vector<MaterialData> materials(obj.materialCount), unique(obj.materialCount);
+    std::vector<int> materialOf(obj.materialCount);
+
+    getObjMaterials(&materials[0], &obj, &mtl);
+    mergeMaterials(&materialOf[0], &unique[0], &materials[0], obj.materialCount);
+    sortObjMeshByMaterial(&mesh, &materialOf[0]);
+  }
+  if (!writeObjMeshCache(out, &obj, &mesh, &mtl, flags, lodLevels)) {
+    fprintf(stderr, "obj2mesh: cannot write %s\n", out);
+    return 1;
+  }
+  freeObjMesh(&mesh);
+  freeMtlFile(&mtl);
+  freeObjFile(&obj);
+  if (!openMeshCache(&cache, out)) {
+    fprintf(stderr, "obj2mesh: %s does not open again\n", out);
+    return 1;
+  }
+  printf("%s: ", out);
+  printMeshCache(&cache);
+  closeMeshCache(&cache);
+  return 0;
+}
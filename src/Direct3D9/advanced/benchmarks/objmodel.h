@@ -0,0 +1,181 @@
+/* objmodel.h - A small OBJ reader and a synthetic OBJ writer shared by the benchmark programs. */
+
+#ifndef OBJMODEL_H
+#define OBJMODEL_H
+
+#include <map>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "../cgfx_buffer_lighting/mesh.h"
+#include "../cgfx_buffer_lighting/tessellate.h"
+
+typedef struct {
+  std::vector<MeshVertex> vertices;
+  std::vector<unsigned int> indices;
+  bool flat;
+  long fileSize;
+} ObjModel;
+
+/* OBJ index i of count values so far: 1-based, or negative from the end. */
+static inline int objIndex(long i, size_t count)
+{
+  return (int) (i < 0 ? (long) count + i : i - 1);
+}
+
+/* Positions, texture coordinates, and normals of "v", "vt", "vn", and "f"
+   lines; faces are split into fans and equal v/vt/vn corners welded.
+   When every face has one normal the mesh is flat and corners are welded
+   without their normals. */
+static inline bool readObj(const char *path, ObjModel &model)
+{
+  FILE *file = fopen(path, "r");
+  std::vector<float> v, vt, vn;
+  std::vector<int> corners, faceSizes;   /* 3 per corner: v, vt, vn (-1 if none) */
+  std::map<std::vector<int>, unsigned int> welded;
+  char line[4096];
+  size_t corner = 0;
+
+  if (!file)
+    return false;
+  model.flat = true;
+  while (fgets(line, sizeof(line), file)) {
+    float x, y, z;
+
+    if (sscanf(line, "v %f %f %f", &x, &y, &z) == 3) {
+      v.push_back(x);
+      v.push_back(y);
+      v.push_back(z);
+    } else if (sscanf(line, "vn %f %f %f", &x, &y, &z) == 3) {
+      vn.push_back(x);
+      vn.push_back(y);
+      vn.push_back(z);
+    } else if (sscanf(line, "vt %f %f", &x, &y) == 2) {
+      vt.push_back(x);
+      vt.push_back(y);
+    } else if (line[0] == 'f' && line[1] == ' ') {
+      char *token = strtok(line + 2, " \t\r\n");
+      int size = 0;
+
+      for (; token; token = strtok(NULL, " \t\r\n"), size++) {
+        char *p = token, *end;
+        long a = strtol(p, &end, 10), b = 0, c = 0;
+
+        if (*end == '/') {
+          p = end + 1;
+          b = strtol(p, &end, 10);
+          if (*end == '/')
+            c = strtol(end + 1, &end, 10);
+        }
+        corners.push_back(objIndex(a, v.size() / 3));
+        corners.push_back(b ? objIndex(b, vt.size() / 2) : -1);
+        corners.push_back(c ? objIndex(c, vn.size() / 3) : -1);
+        if (size > 0 && corners[corners.size() - 1] != corners[corners.size() - 4])
+          model.flat = false;
+      }
+      faceSizes.push_back(size);
+    }
+  }
+  model.fileSize = ftell(file);
+  fclose(file);
+  if (vn.empty())
+    model.flat = false;
+
+  for (size_t f = 0; f < faceSizes.size(); f++) {
+    std::vector<unsigned int> face;
+
+    for (int i = 0; i < faceSizes[f]; i++, corner++) {
+      std::vector<int> key(&corners[3 * corner], &corners[3 * corner] + 3);
+      std::map<std::vector<int>, unsigned int>::iterator w;
+
+      if (model.flat)
+        key[2] = -1;
+      w = welded.find(key);
+      if (w == welded.end()) {
+        MeshVertex m;
+
+        memset(&m, 0, sizeof(m));
+        memcpy(m.position, &v[3 * key[0]], sizeof(m.position));
+        if (key[1] >= 0)
+          memcpy(m.texCoord, &vt[2 * key[1]], sizeof(m.texCoord));
+        if (corners[3 * corner + 2] >= 0)
+          memcpy(m.normal, &vn[3 * corners[3 * corner + 2]], sizeof(m.normal));
+        w = welded.insert(std::make_pair(key, (unsigned int) model.vertices.size())).first;
+        model.vertices.push_back(m);
+      }
+      face.push_back(w->second);
+    }
+    for (size_t i = 2; i < face.size(); i++) {
+      model.indices.push_back(face[0]);
+      model.indices.push_back(face[i-1]);
+      model.indices.push_back(face[i]);
+    }
+  }
+  return true;
+}
+
+/* The path of an OBJ file's mtllib, which is relative to the OBJ file. */
+static inline std::string getObjLibraryPath(const char *objPath, const char *library)
+{
+  const char *slash = strrchr(objPath, '/'), *backslash = strrchr(objPath, '\\');
+
+  if (backslash > slash)
+    slash = backslash;
+  return slash ? std::string(objPath, slash + 1) + library : std::string(library);
+}
+
+/* About megabytes of OBJ text: a finely tessellated torus cut into 16
+   objects along v with alternating materials ("even" and "odd"),
+   v/vt/vn quads, and every other object indexed with negative
+   indices. */
+static inline bool writeSyntheticObj(const char *path, int megabytes)
+{
+  const int objects = 16;
+  /* A grid vertex writes about 100 bytes of v, vt, and vn and a quad about 65. */
+  int u = (int) sqrt(megabytes * 1048576.0 / 165 * 2), v = u / 2 / objects * objects;
+  TorusSurface torus = { 0.75f, 0.25f };
+  ParametricSurface surface = { evaluateTorusSurface, &torus, sizeof(torus) };
+  SurfaceMesh mesh;
+  FILE *file = fopen(path, "w");
+  int written = 0, rows = v / objects;
+
+  if (!file)
+    return false;
+  tessellateSurface(&mesh, &surface, u, v, SURFACE_TRIANGLE_LIST);
+  fprintf(file, "# synthetic torus %dx%d\nmtllib synthetic.mtl\n", u, v);
+  for (int o = 0; o < objects; o++) {
+    int firstRow = o * rows, base = written, perObject = (rows + 1) * (u + 1);
+
+    fprintf(file, "o band%d\nusemtl %s\n", o, o % 2 ? "odd" : "even");
+    for (int j = firstRow; j <= firstRow + rows; j++)
+      for (int i = 0; i <= u; i++) {
+        const SurfaceVertex *s = &mesh.vertices[i + j * (u + 1)];
+
+        fprintf(file, "v %f %f %f\nvt %f %f\nvn %f %f %f\n", s->position[0], s->position[1],
+          s->position[2], s->texCoord[0], s->texCoord[1], s->normal[0], s->normal[1],
+          s->normal[2]);
+      }
+    written += perObject;
+    for (int j = 0; j < rows; j++)
+      for (int i = 0; i < u; i++) {
+        int q[4] = { i + j * (u + 1), i + 1 + j * (u + 1),
+                     i + 1 + (j + 1) * (u + 1), i + (j + 1) * (u + 1) };
+
+        fputc('f', file);
+        for (int c = 0; c < 4; c++) {
+          int n = o % 2 ? q[c] - perObject : base + q[c] + 1;
+
+          fprintf(file, " %d/%d/%d", n, n, n);
+        }
+        fputc('\n', file);
+      }
+  }
+  freeSurfaceMesh(&mesh);
+  return fclose(file) == 0;
+}
+
+#endif /* OBJMODEL_H */
@@ -0,0 +1,210 @@
+/* objparse_bench.cpp - readObjFile (objfile.h) against a plain ifstream OBJ parser.
+
+   Usage: objparse_bench [-mb N] [file.obj ...]
+
+   Writes a synthetic OBJ of about N megabytes (100 by default): a
+   finely tessellated torus in 16 objects with alternating materials,
+   v/vt/vn quads, and every other object indexed with negative indices,
+   and parses it and the given files (without arguments, Lab5's
+   model_for_cga.obj and Lab6's retopoly.obj) with
+
+     ifstream    std::getline and std::istringstream, one line at a time;
+     objfile     readObjFile on one thread and on all of them,
+
+   reporting time and megabytes per second.  The results must match:
+   the same counts and indices, and floats that differ by at most a
+   unit in the last place, which the report counts. */
+
+#include <fstream>
+#include <math.h>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "objmodel.h"
+#include "../cgfx_buffer_lighting/objfile.h"
+#include "../cgfx_buffer_lighting/parallel.h"
+
+static const char *mySyntheticPath = "objparse_bench_synthetic.obj";
+
+/* What the ifstream parser produces, laid out like ObjFile. */
+typedef struct {
+  std::vector<float> attributes[3];
+  std::vector<int> indices[3];
+  std::vector<int> faceStarts;
+} NaiveObj;
+
+static int naiveIndex(long i, size_t count)
+{
+  return (int) (i < 0 ? (long) count + i : i - 1);
+}
+
+static bool naiveParseObj(const char *path, NaiveObj &obj)
+{
+  static const int elementSize[3] = { 3, 2, 3 };
+  std::ifstream in(path);
+  std::string line;
+
+  if (!in)
+    return false;
+  while (std::getline(in, line)) {
+    std::istringstream words(line);
+    std::string keyword;
+
+    words >> keyword;
+    if (keyword == "v" || keyword == "vt" || keyword == "vn") {
+      int kind = keyword == "v" ? 0 : keyword == "vt" ? 1 : 2;
+      float f;
+
+      for (int k = 0; k < elementSize[kind]; k++) {
+        if (!(words >> f))
+          f = 0;
+        obj.attributes[kind].push_back(f);
+      }
+    } else if (keyword == "f") {
+      std::string corner;
+
+      obj.faceStarts.push_back((int) obj.indices[0].size());
+      while (words >> corner) {
+        const char *p = corner.c_str();
+        char *end;
+
+        for (int kind = 0; kind < 3; kind++) {
+          long i = strtol(p, &end, 10);
+
+          obj.indices[kind].push_back(end == p ? -1 :
+            naiveIndex(i, obj.attributes[kind].size() / elementSize[kind]));
+          p = *end == '/' ? end + 1 : end;
+        }
+      }
+    }
+  }
+  obj.faceStarts.push_back((int) obj.indices[0].size());
+  return true;
+}
+
+/* Units in the last place between a and b. */
+static int ulpDistance(float a, float b)
+{
+  int ia, ib;
+
+  memcpy(&ia, &a, 4);
+  memcpy(&ib, &b, 4);
+  if (ia < 0)
+    ia = (int) 0x80000000 - ia;
+  if (ib < 0)
+    ib = (int) 0x80000000 - ib;
+  return ia > ib ? ia - ib : ib - ia;
+}
+
+static void compareResults(const ObjFile &obj, const NaiveObj &naive)
+{
+  const float *attributes[3] = { obj.positions, obj.texCoords, obj.normals };
+  const int *indices[3] = { obj.positionIndices, obj.texCoordIndices, obj.normalIndices };
+  const int counts[3] = { 3 * obj.positionCount, 2 * obj.texCoordCount, 3 * obj.normalCount };
+  int offByOne = 0, worse = 0, badIndices = 0;
+  bool sameCounts = obj.faceCount + 1 == (int) naive.faceStarts.size() &&
+                    obj.cornerCount == (int) naive.indices[0].size();
+
+  for (int k = 0; k < 3; k++) {
+    sameCounts = sameCounts && counts[k] == (int) naive.attributes[k].size();
+    if (!sameCounts)
+      break;
+    for (int i = 0; i < counts[k]; i++) {
+      int d = ulpDistance(attributes[k][i], naive.attributes[k][i]);
+
+      offByOne += d == 1;
+      worse += d > 1;
+    }
+    for (int i = 0; i < obj.cornerCount; i++)
+      badIndices += indices[k][i] != naive.indices[k][i];
+  }
+  if (sameCounts)
+    for (int f = 0; f <= obj.faceCount; f++)
+      badIndices += obj.faceStarts[f] != naive.faceStarts[f];
+  if (!sameCounts)
+    printf("  results DIFFER: counts\n");
+  else
+    printf("  results %s: %d floats 1 ulp apart, %d further, %d indices differ\n",
+      worse == 0 && badIndices == 0 ? "match" : "DIFFER", offByOne, worse, badIndices);
+}
+
+static void reportFile(const char *path)
+{
+  const char *name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+  int threads = getParallelThreadCount();
+  NaiveObj naive;
+  ObjFile obj;
+  double t0, naiveTime, megabytes;
+  FILE *file = fopen(path, "rb");
+
+  if (!file) {
+    fprintf(stderr, "objparse_bench: cannot open %s\n", path);
+    return;
+  }
+  fseek(file, 0, SEEK_END);
+  megabytes = ftell(file) / 1048576.0;
+  fclose(file);
+
+  t0 = benchNow();
+  naiveParseObj(path, naive);
+  naiveTime = benchNow() - t0;
+  if (!readObjFile(path, &obj)) {
+    fprintf(stderr, "objparse_bench: cannot parse %s\n", path);
+    return;
+  }
+  printf("%s: %.1f MB, %d positions, %d texture coordinates, %d normals, %d faces, "
+    "%d corners, %d ranges\n", name, megabytes, obj.positionCount, obj.texCoordCount,
+    obj.normalCount, obj.faceCount, obj.cornerCount, obj.rangeCount);
+  printf("  ifstream     %9.1f ms %9.1f MB/s\n", naiveTime * 1e3, megabytes / naiveTime);
+  for (int n = 1; n <= threads; n = n < threads ? threads : n + 1) {
+    double t;
+
+    setParallelThreadCount(n);
+    t = benchBest([&] {
+      ObjFile o;
+
+      readObjFile(path, &o);
+      benchKeep(o.cornerCount);
+      freeObjFile(&o);
+    }, 0.5);
+    printf("  objfile %2d   %9.1f ms %9.1f MB/s  %5.1fx\n", n, t * 1e3, megabytes / t,
+      naiveTime / t);
+  }
+  setParallelThreadCount(0);
+  compareResults(obj, naive);
+  freeObjFile(&obj);
+  printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+  static const char *defaults[] = {
+    "../../../Labs/Lab5/model_for_cga.obj",
+    "../../../Labs/Lab6/retopoly.obj"
+  };
+  int megabytes = 100, files = 0;
+
+  printf("%d threads\n\n", getParallelThreadCount());
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-mb") == 0 && i + 1 < argc)
+      megabytes = atoi(argv[++i]);
+    else
+      reportFile(argv[i]), files++;
+  }
+  if (files == 0)
+    for (int i = 0; i < (int) (sizeof(defaults) / sizeof(defaults[0])); i++)
+      reportFile(defaults[i]);
+  if (megabytes > 0) {
+    if (!writeSyntheticObj(mySyntheticPath, megabytes)) {
+      fprintf(stderr, "objparse_bench: cannot write %s\n", mySyntheticPath);
+      return 1;
+    }
+    reportFile(mySyntheticPath);
+    remove(mySyntheticPath);
+  }
+  return 0;
+}
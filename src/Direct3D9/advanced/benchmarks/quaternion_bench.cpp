@@ -0,0 +1,161 @@
+/* quaternion_bench.cpp - Rotation updates with quaternions against 4x4 matrices.
+
+   Models many independently spinning objects: every frame each object's
+   rotation is composed with its own small step rotation, then turned into
+   a matrix for the shaders.  The matrix path is one multMatrixArray; the
+   quaternion path is multQuaternionArray followed by
+   makeQuaternionMatrixArray.  Interpolation and the dual-quaternion
+   conversion are timed on their own, and the last table shows how far
+   each representation drifts from a rotation after many composed steps. */
+
+#include <math.h>
+#include <vector>
+
+#include "bench.h"
+#include "../cgfx_buffer_lighting/matrix.h"
+#include "../cgfx_buffer_lighting/quaternion.h"
+
+static const int myCount = 10000;
+
+static void printRow(const char *name, double t)
+{
+  printf("%-36s %9.2f %12.4g\n", name, t*1e9/myCount, myCount/t);
+}
+
+/* Largest element of R * transpose(R) - I for the upper-left 3x3. */
+static double orthonormalError(const float m[16])
+{
+  double worst = 0;
+
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      double dot = 0;
+      for (int k = 0; k < 3; k++)
+        dot += (double) m[i*4+k] * m[j*4+k];
+      dot = fabs(dot - (i == j ? 1 : 0));
+      if (dot > worst)
+        worst = dot;
+    }
+  }
+  return worst;
+}
+
+int main(void)
+{
+  MatrixSimdLevel support = getMatrixSimdSupport();
+  std::vector<float> q(myCount*4), qStep(myCount*4), qOther(myCount*4), qOut(myCount*4),
+                     m(myCount*16), mStep(myCount*16), mOut(myCount*16),
+                     dq(myCount*8);
+  unsigned int seed = 11;
+  double t;
+
+  for (int i = 0; i < myCount; i++) {
+    float angle = benchRandom(&seed, 0, 360),
+          ax = benchRandom(&seed, -1, 1), ay = benchRandom(&seed, -1, 1), az = benchRandom(&seed, -1, 1),
+          step = benchRandom(&seed, 0.1f, 2),
+          translate[3] = { benchRandom(&seed, -10, 10), benchRandom(&seed, -10, 10),
+                           benchRandom(&seed, -10, 10) };
+
+    makeRotateQuaternion(angle, ax, ay, az, &q[i*4]);
+    makeRotateMatrix(angle, ax, ay, az, &m[i*16]);
+    makeRotateQuaternion(step, ay, az, ax, &qStep[i*4]);
+    makeRotateMatrix(step, ay, az, ax, &mStep[i*16]);
+    makeRotateQuaternion(angle + 90, az, ax, ay, &qOther[i*4]);
+    makeDualQuaternion(&q[i*4], translate, &dq[i*8]);
+  }
+
+  printf("%d objects, SIMD support: %s\n\n", myCount, getMatrixSimdLevelName(support));
+  printf("%-36s %9s %12s\n", "routine", "ns/object", "objects/s");
+
+  /* Composition alone. */
+  t = benchBest([&] {
+    multMatrixArray(&mOut[0], &m[0], &mStep[0], myCount);
+    benchKeep(mOut[0]);
+  });
+  printRow("multMatrixArray", t);
+  t = benchBest([&] {
+    multQuaternionArray(&qOut[0], &q[0], 4, &qStep[0], 4, myCount);
+    benchKeep(qOut[0]);
+  });
+  printRow("multQuaternionArray", t);
+
+  /* Interpolation. */
+  t = benchBest([&] {
+    for (int i = 0; i < myCount; i++)
+      slerpQuaternion(&qOut[i*4], &q[i*4], &qOther[i*4], 0.3f);
+    benchKeep(qOut[0]);
+  });
+  printRow("slerpQuaternion", t);
+  t = benchBest([&] {
+    nlerpQuaternionArray(&qOut[0], &q[0], &qOther[0], 0.3f, myCount);
+    benchKeep(qOut[0]);
+  });
+  printRow("nlerpQuaternionArray", t);
+
+  /* Conversion to matrices, and the whole per-frame update. */
+  t = benchBest([&] {
+    for (int i = 0; i < myCount; i++)
+      makeQuaternionMatrix(&q[i*4], &mOut[i*16]);
+    benchKeep(mOut[0]);
+  });
+  printRow("makeQuaternionMatrix", t);
+
+  for (int level = MATRIX_SIMD_SCALAR; level <= support; level++) {
+    const char *levelName = getMatrixSimdLevelName((MatrixSimdLevel) level);
+    char name[64];
+
+    setMatrixSimdLevel((MatrixSimdLevel) level);
+
+    t = benchBest([&] {
+      makeQuaternionMatrixArray(&mOut[0], 16, &q[0], 4, myCount);
+      benchKeep(mOut[0]);
+    });
+    sprintf(name, "makeQuaternionMatrixArray/%s", levelName);
+    printRow(name, t);
+
+    t = benchBest([&] {
+      makeDualQuaternionMatrixArray(&mOut[0], 16, &dq[0], 8, myCount);
+      benchKeep(mOut[0]);
+    });
+    sprintf(name, "makeDualQuaternionMatrixArray/%s", levelName);
+    printRow(name, t);
+
+    t = benchBest([&] {
+      multMatrixArray(&mOut[0], &m[0], &mStep[0], myCount);
+      benchKeep(mOut[0]);
+    });
+    sprintf(name, "update: matrices/%s", levelName);
+    printRow(name, t);
+
+    t = benchBest([&] {
+      multQuaternionArray(&qOut[0], &q[0], 4, &qStep[0], 4, myCount);
+      makeQuaternionMatrixArray(&mOut[0], 16, &qOut[0], 4, myCount);
+      benchKeep(mOut[0]);
+    });
+    sprintf(name, "update: quaternions/%s", levelName);
+    printRow(name, t);
+  }
+  setMatrixSimdLevel(support);
+
+  /* Drift: compose each object's step many times without renormalizing. */
+  printf("\n%-10s %22s %22s\n", "steps", "matrix orthonormality", "quaternion matrix");
+  for (int steps = 1000; steps <= 100000; steps *= 10) {
+    float mAcc[16], qAcc[4], qMatrix[16];
+    double mError, qError;
+
+    for (int i = 0; i < 16; i++)
+      mAcc[i] = m[i];
+    for (int i = 0; i < 4; i++)
+      qAcc[i] = q[i];
+    for (int s = 0; s < steps; s++) {
+      multMatrix(mAcc, mAcc, &mStep[0]);
+      multQuaternion(qAcc, qAcc, &qStep[0]);
+    }
+    mError = orthonormalError(mAcc);
+    /* makeQuaternionMatrix removes any scale, so this is pure rotation. */
+    makeQuaternionMatrix(qAcc, qMatrix);
+    qError = orthonormalError(qMatrix);
+    printf("%-10d %22.3g %22.3g\n", steps, mError, qError);
+  }
+  return 0;
+}
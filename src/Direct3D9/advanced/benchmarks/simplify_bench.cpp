@@ -0,0 +1,180 @@
+/* simplify_bench.cpp - simplifyMesh on the Labs' OBJ models: error against triangle count, time, and LOD files.
+
+   Usage: simplify_bench [file.obj ...]
+
+   Without arguments, Lab5's model_for_cga.obj and Lab6's retopoly.obj.
+   For each model: the error (in bounding radii) and time of simplifying
+   the full mesh to 90%, 80%, ... 2% of its triangles, then an LOD set
+   halving the triangles per level, written to <model>.lod next to the
+   program (see lodmesh.h), read back, and compared with the OBJ file's
+   size.  Models whose faces each carry one normal are drawn flat: they
+   are simplified without their normals and get new face normals per
+   level (see flatShadeMesh).  Last, a 512x256 tessellated torus, whose
+   u = 0 and u = 1 columns form a texture seam, simplified to 10% on one
+   thread and on all of them. */
+
+#include <string.h>
+#include <vector>
+
+#include "bench.h"
+#include "objmodel.h"
+#include "../cgfx_buffer_lighting/lodmesh.h"
+#include "../cgfx_buffer_lighting/parallel.h"
+#include "../cgfx_buffer_lighting/simplify.h"
+#include "../cgfx_buffer_lighting/tessellate.h"
+
+static void printCurve(const ObjModel &m)
+{
+  static const int percents[] = { 90, 80, 70, 60, 50, 40, 30, 20, 10, 5, 2 };
+  std::vector<unsigned int> out(m.indices.size());
+  int triangles = (int) m.indices.size() / 3;
+
+  printf("%8s %10s %10s %10s\n", "target", "triangles", "error", "ms");
+  for (int i = 0; i < (int) (sizeof(percents) / sizeof(percents[0])); i++) {
+    float error = 0;
+    int n = 0;
+    double t = benchBest([&] {
+      n = simplifyMesh(&out[0], &m.indices[0], (int) m.indices.size(),
+                       &m.vertices[0], (int) m.vertices.size(),
+                       3 * (triangles * percents[i] / 100), 0, &error);
+      benchKeep(out[0]);
+    }, 0.1);
+
+    printf("%7d%% %10d %10.5f %10.3f\n", percents[i], n / 3, error, t * 1e3);
+  }
+}
+
+/* Levels halving the triangles, each simplified from the full mesh,
+   down to about 64 triangles. */
+static void buildLodMesh(const ObjModel &m, LodMesh *lod)
+{
+  std::vector<MeshVertex> vertices;
+  std::vector<unsigned int> indices;
+  std::vector<unsigned int> out(m.indices.size());
+  int target = (int) m.indices.size();
+  float lastError = 0;
+
+  initLodChain(&lod->chain);
+  for (int level = 0; level < LOD_MAX_LEVELS && target >= 3 * 64; level++, target /= 2) {
+    float error = 0;
+    int n = simplifyMesh(&out[0], &m.indices[0], (int) m.indices.size(),
+                         &m.vertices[0], (int) m.vertices.size(), target - target % 3, 0, &error);
+    size_t vertexStart = vertices.size(), indexStart = indices.size();
+    int count;
+
+    vertices.resize(vertexStart + n);
+    indices.resize(indexStart + n);
+    if (m.flat) {
+      std::vector<MeshVertex> shaded(n);
+
+      count = flatShadeMesh(&shaded[0], &indices[indexStart], &out[0], n, &m.vertices[0]);
+      count = compactMesh(&vertices[vertexStart], &indices[indexStart], n, &shaded[0]);
+    } else {
+      std::copy(out.begin(), out.begin() + n, indices.begin() + indexStart);
+      count = compactMesh(&vertices[vertexStart], &indices[indexStart], n, &m.vertices[0]);
+    }
+    vertices.resize(vertexStart + count);
+    lastError = error > lastError ? error : lastError;
+    addLodLevel(&lod->chain, count, n, lastError);
+  }
+  lod->vertices = new MeshVertex[vertices.size()];
+  lod->indices = new unsigned int[indices.size()];
+  std::copy(vertices.begin(), vertices.end(), lod->vertices);
+  std::copy(indices.begin(), indices.end(), lod->indices);
+}
+
+static void reportModel(const char *path)
+{
+  const char *name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+  char lodPath[1024];
+  ObjModel m;
+  LodMesh lod, check;
+  double t;
+
+  if (!readObj(path, m)) {
+    fprintf(stderr, "simplify_bench: cannot open %s\n", path);
+    return;
+  }
+  printf("%s: %d vertices, %d triangles, %s\n\n", name, (int) m.vertices.size(),
+    (int) m.indices.size() / 3, m.flat ? "flat shaded" : "smooth");
+  printCurve(m);
+
+  t = benchBest([&] {
+    buildLodMesh(m, &lod);
+    freeLodMesh(&lod);
+  }, 0.1);
+  buildLodMesh(m, &lod);
+  lod.radius = 1;
+  sprintf(lodPath, "%.*s.lod", (int) (strrchr(name, '.') ? strrchr(name, '.') - name : strlen(name)),
+          name);
+  printf("\nLOD set (%.1f ms):\n%6s %10s %10s %10s\n", t * 1e3, "level", "triangles",
+    "vertices", "error");
+  for (int i = 0; i < lod.chain.levelCount; i++)
+    printf("%6d %10d %10d %10.5f\n", i, lod.chain.levels[i].indexCount / 3,
+      lod.chain.levels[i].vertexCount, lod.chain.levels[i].error);
+  if (!writeLodMesh(lodPath, &lod) || !readLodMesh(lodPath, &check) ||
+      check.chain.vertexCount != lod.chain.vertexCount ||
+      memcmp(check.vertices, lod.vertices, lod.chain.vertexCount * sizeof(MeshVertex)) != 0 ||
+      memcmp(check.indices, lod.indices, lod.chain.indexCount * sizeof(unsigned int)) != 0) {
+    fprintf(stderr, "simplify_bench: %s did not read back\n", lodPath);
+  } else {
+    printf("%s: %ld bytes for every level, against %ld bytes of OBJ text\n\n",
+      lodPath, getLodMeshFileSize(&lod.chain), m.fileSize);
+  }
+  freeLodMesh(&check);
+  freeLodMesh(&lod);
+}
+
+static void reportThreads(void)
+{
+  TorusSurface torus = { 0.75f, 0.25f };
+  ParametricSurface surface = { evaluateTorusSurface, &torus, sizeof(torus) };
+  SurfaceMesh mesh;
+  std::vector<MeshVertex> vertices;
+  int threads = getParallelThreadCount();
+
+  tessellateSurface(&mesh, &surface, 512, 256, SURFACE_TRIANGLE_LIST);
+  vertices.resize(mesh.vertexCount);
+  for (int i = 0; i < mesh.vertexCount; i++) {
+    memcpy(vertices[i].position, mesh.vertices[i].position, sizeof(vertices[i].position));
+    memcpy(vertices[i].normal, mesh.vertices[i].normal, sizeof(vertices[i].normal));
+    memcpy(vertices[i].texCoord, mesh.vertices[i].texCoord, sizeof(vertices[i].texCoord));
+  }
+  std::vector<unsigned int> out(mesh.indexCount);
+
+  printf("torus 512x256: %d vertices, %d triangles, to 10%%\n", mesh.vertexCount,
+    mesh.indexCount / 3);
+  for (int n = 1; n <= threads; n = n < threads ? threads : n + 1) {
+    float error = 0;
+    int count = 0;
+    double t;
+
+    setParallelThreadCount(n);
+    t = benchBest([&] {
+      count = simplifyMesh(&out[0], mesh.indices, mesh.indexCount, &vertices[0],
+                           mesh.vertexCount, mesh.indexCount / 10, 0, &error);
+      benchKeep(out[0]);
+    }, 0.5);
+    printf("%2d threads: %8.1f ms, %d triangles, error %.5f\n", n, t * 1e3, count / 3, error);
+  }
+  setParallelThreadCount(0);
+  freeSurfaceMesh(&mesh);
+}
+
+int main(int argc, char **argv)
+{
+  static const char *defaults[] = {
+    "../../../Labs/Lab5/model_for_cga.obj",
+    "../../../Labs/Lab6/retopoly.obj"
+  };
+
+  if (argc > 1) {
+    for (int i = 1; i < argc; i++)
+      reportModel(argv[i]);
+  } else {
+    for (int i = 0; i < (int) (sizeof(defaults) / sizeof(defaults[0])); i++)
+      reportModel(defaults[i]);
+  }
+  reportThreads();
+  return 0;
+}
@@ -0,0 +1,253 @@
+/* sincos_bench.cpp - sinCosArray against libm in the loops that need sines and cosines.
+
+   Four workloads, each timed with one sinf and one cosf per angle (as the
+   samples do today) and with sinCosArray at both precisions and every SIMD
+   level:
+
+     angles       raw throughput over angles in [-4 pi, 4 pi], with the
+                  largest error against double precision;
+     torus        tessellating C8E6v_torus's parametric surface on the CPU:
+                  position and normal for every vertex of a 256x256 grid;
+     twist        C3E4v_twist on the CPU for a million 2D vertices: rotate
+                  each by twisting times its distance from the origin;
+     rotations    makeRotateMatrix and makeRotateQuaternion per object
+                  against the ...Array versions. */
+
+#include <math.h>
+#include <vector>
+
+#include "bench.h"
+#include "../cgfx_buffer_lighting/matrix.h"
+#include "../cgfx_buffer_lighting/quaternion.h"
+#include "../cgfx_buffer_lighting/sincos.h"
+
+static const double myPi = 3.14159265358979323846;
+static const char *myPrecisionName[2] = { "full", "graphics" };
+
+static void printRow(const char *workload, const char *name, double t, int count, double error)
+{
+  if (error >= 0)
+    printf("%-10s %-28s %9.2f %12.4g %10.3g\n", workload, name, t*1e9/count, count/t, error);
+  else
+    printf("%-10s %-28s %9.2f %12.4g %10s\n", workload, name, t*1e9/count, count/t, "-");
+}
+
+static double maxError(const std::vector<float> &s, const std::vector<float> &c,
+                       const std::vector<float> &x)
+{
+  double worst = 0;
+
+  for (size_t i = 0; i < x.size(); i++) {
+    double es = fabs(s[i] - sin((double) x[i])), ec = fabs(c[i] - cos((double) x[i]));
+    if (es > worst)
+      worst = es;
+    if (ec > worst)
+      worst = ec;
+  }
+  return worst;
+}
+
+/* C8E6v_torus's position and normal from per-vertex sines and cosines. */
+static void torusVertex(float *out, float M, float N, float sinS, float cosS, float sinT, float cosT)
+{
+  float ring = M + N * cosT;
+
+  out[0] = ring * cosS;
+  out[1] = ring * sinS;
+  out[2] = N * sinT;
+  out[3] = cosS * cosT;
+  out[4] = sinS * cosT;
+  out[5] = sinT;
+}
+
+int main(void)
+{
+  MatrixSimdLevel support = getMatrixSimdSupport();
+  unsigned int seed = 5;
+  double t;
+
+  printf("SIMD support: %s\n\n", getMatrixSimdLevelName(support));
+  printf("%-10s %-28s %9s %12s %10s\n", "workload", "routine", "ns/item", "items/s", "max error");
+
+  /* Raw throughput. */
+  {
+    const int count = 1 << 16;
+    std::vector<float> x(count), s(count), c(count);
+
+    for (int i = 0; i < count; i++)
+      x[i] = benchRandom(&seed, (float) (-4*myPi), (float) (4*myPi));
+
+    t = benchBest([&] {
+      for (int i = 0; i < count; i++) {
+        s[i] = sinf(x[i]);
+        c[i] = cosf(x[i]);
+      }
+      benchKeep(s[0]);
+    });
+    printRow("angles", "sinf+cosf", t, count, maxError(s, c, x));
+
+    for (int precision = SINCOS_FULL; precision <= SINCOS_GRAPHICS; precision++) {
+      for (int level = MATRIX_SIMD_SCALAR; level <= support; level++) {
+        char name[64];
+
+        setMatrixSimdLevel((MatrixSimdLevel) level);
+        t = benchBest([&] {
+          sinCosArray(&s[0], &c[0], &x[0], count, (SincosPrecision) precision);
+          benchKeep(s[0]);
+        });
+        sprintf(name, "sinCosArray/%s/%s", myPrecisionName[precision],
+                getMatrixSimdLevelName((MatrixSimdLevel) level));
+        printRow("angles", name, t, count, maxError(s, c, x));
+      }
+    }
+    setMatrixSimdLevel(support);
+  }
+
+  /* Torus tessellation: the angles come per vertex, as they would from a
+     vertex stream, rather than from per-row and per-column tables. */
+  {
+    const int side = 256, count = side * side;
+    const float M = 2.0f, N = 0.6f;
+    std::vector<float> angleS(count), angleT(count), sinS(count), cosS(count),
+                       sinT(count), cosT(count), out(count*6), ref(count*6);
+
+    for (int j = 0; j < side; j++) {
+      for (int i = 0; i < side; i++) {
+        angleS[j*side+i] = (float) (2*myPi * i / (side-1));
+        angleT[j*side+i] = (float) (2*myPi * j / (side-1));
+      }
+    }
+
+    t = benchBest([&] {
+      for (int i = 0; i < count; i++)
+        torusVertex(&ref[i*6], M, N, sinf(angleS[i]), cosf(angleS[i]),
+                    sinf(angleT[i]), cosf(angleT[i]));
+      benchKeep(ref[0]);
+    });
+    printRow("torus", "sinf+cosf", t, count, -1);
+
+    for (int precision = SINCOS_FULL; precision <= SINCOS_GRAPHICS; precision++) {
+      for (int level = MATRIX_SIMD_SCALAR; level <= support; level++) {
+        char name[64];
+        double error = 0;
+
+        setMatrixSimdLevel((MatrixSimdLevel) level);
+        t = benchBest([&] {
+          sinCosArray(&sinS[0], &cosS[0], &angleS[0], count, (SincosPrecision) precision);
+          sinCosArray(&sinT[0], &cosT[0], &angleT[0], count, (SincosPrecision) precision);
+          for (int i = 0; i < count; i++)
+            torusVertex(&out[i*6], M, N, sinS[i], cosS[i], sinT[i], cosT[i]);
+          benchKeep(out[0]);
+        });
+        for (int i = 0; i < count*6; i++)
+          if (fabs(out[i] - ref[i]) > error)
+            error = fabs(out[i] - ref[i]);
+        sprintf(name, "sinCosArray/%s/%s", myPrecisionName[precision],
+                getMatrixSimdLevelName((MatrixSimdLevel) level));
+        printRow("torus", name, t, count, error);
+      }
+    }
+    setMatrixSimdLevel(support);
+  }
+
+  /* Vertex twisting. */
+  {
+    const int count = 1 << 20;
+    const float twisting = 2.9f;
+    std::vector<float> x(count), y(count), angle(count), s(count), c(count),
+                       outX(count), outY(count), refX(count), refY(count);
+
+    for (int i = 0; i < count; i++) {
+      x[i] = benchRandom(&seed, -0.8f, 0.8f);
+      y[i] = benchRandom(&seed, -0.8f, 0.8f);
+    }
+
+    t = benchBest([&] {
+      for (int i = 0; i < count; i++) {
+        float a = twisting * sqrtf(x[i]*x[i] + y[i]*y[i]);
+        float sine = sinf(a), cosine = cosf(a);
+        refX[i] = cosine * x[i] - sine * y[i];
+        refY[i] = sine * x[i] + cosine * y[i];
+      }
+      benchKeep(refX[0]);
+    });
+    printRow("twist", "sinf+cosf", t, count, -1);
+
+    for (int precision = SINCOS_FULL; precision <= SINCOS_GRAPHICS; precision++) {
+      for (int level = MATRIX_SIMD_SCALAR; level <= support; level++) {
+        char name[64];
+        double error = 0;
+
+        setMatrixSimdLevel((MatrixSimdLevel) level);
+        t = benchBest([&] {
+          for (int i = 0; i < count; i++)
+            angle[i] = twisting * sqrtf(x[i]*x[i] + y[i]*y[i]);
+          sinCosArray(&s[0], &c[0], &angle[0], count, (SincosPrecision) precision);
+          for (int i = 0; i < count; i++) {
+            outX[i] = c[i] * x[i] - s[i] * y[i];
+            outY[i] = s[i] * x[i] + c[i] * y[i];
+          }
+          benchKeep(outX[0]);
+        });
+        for (int i = 0; i < count; i++) {
+          if (fabs(outX[i] - refX[i]) > error)
+            error = fabs(outX[i] - refX[i]);
+          if (fabs(outY[i] - refY[i]) > error)
+            error = fabs(outY[i] - refY[i]);
+        }
+        sprintf(name, "sinCosArray/%s/%s", myPrecisionName[precision],
+                getMatrixSimdLevelName((MatrixSimdLevel) level));
+        printRow("twist", name, t, count, error);
+      }
+    }
+    setMatrixSimdLevel(support);
+  }
+
+  /* Rotation builders. */
+  {
+    const int count = 10000;
+    std::vector<float> angle(count), axis(count*3), m(count*16), ref(count*16),
+                       q(count*4), qRef(count*4);
+    double error;
+
+    for (int i = 0; i < count; i++) {
+      angle[i] = benchRandom(&seed, -360, 360);
+      axis[i*3+0] = benchRandom(&seed, -1, 1);
+      axis[i*3+1] = benchRandom(&seed, -1, 1);
+      axis[i*3+2] = benchRandom(&seed, 0.1f, 1);
+    }
+
+    t = benchBest([&] {
+      for (int i = 0; i < count; i++)
+        makeRotateMatrix(angle[i], axis[i*3+0], axis[i*3+1], axis[i*3+2], &ref[i*16]);
+      benchKeep(ref[0]);
+    });
+    printRow("rotations", "makeRotateMatrix", t, count, -1);
+    t = benchBest([&] {
+      makeRotateMatrixArray(&m[0], 16, &angle[0], &axis[0], 3, count);
+      benchKeep(m[0]);
+    });
+    error = 0;
+    for (int i = 0; i < count*16; i++)
+      if (fabs(m[i] - ref[i]) > error)
+        error = fabs(m[i] - ref[i]);
+    printRow("rotations", "makeRotateMatrixArray", t, count, error);
+
+    t = benchBest([&] {
+      for (int i = 0; i < count; i++)
+        makeRotateQuaternion(angle[i], axis[i*3+0], axis[i*3+1], axis[i*3+2], &qRef[i*4]);
+      benchKeep(qRef[0]);
+    });
+    printRow("rotations", "makeRotateQuaternion", t, count, -1);
+    t = benchBest([&] {
+      makeRotateQuaternionArray(&q[0], &angle[0], &axis[0], 3, count);
+      benchKeep(q[0]);
+    });
+    error = 0;
+    for (int i = 0; i < count*4; i++)
+      if (fabs(q[i] - qRef[i]) > error)
+        error = fabs(q[i] - qRef[i]);
+    printRow("rotations", "makeRotateQuaternionArray", t, count, error);
+  }
+  return 0;
+}
@@ -0,0 +1,214 @@
+/* sphere_bench.cpp - makeSphere against cgfx_buffer_lighting's old unindexed sphere.
+
+   For each size, four ways to build the sphere's buffers:
+
+     unindexed    the old initSphereVertexBuffer: six sinf/cosf-computed
+                  vertices per quad pushed onto a std::vector (which it
+                  never cleared, so each device reset added another copy);
+     ring order   an indexed sphere drawn ring by ring, for comparison;
+     makeSphere16, makeSphere
+                  sphere.h, with 16- and 32-bit indices.
+
+   Memory is the vertex buffer plus the index buffer.  ACMR (average cache
+   miss ratio) is vertex shader runs per triangle with a 16-entry FIFO
+   post-transform cache; unindexed triangles always cost 3. */
+
+#include <math.h>
+#include <vector>
+
+#include "bench.h"
+#include "../cgfx_buffer_lighting/sphere.h"
+
+struct Vertex
+{
+  float x, y, z;
+};
+
+/* initSphereVertexBuffer's loop, apart from creating the buffer. */
+static void unindexedSphere(std::vector<Vertex> &vertexList, float radius, int slices, int stacks)
+{
+  const float PI = 3.1415926f;
+  float phiStep = PI / stacks;
+  int rings = stacks - 1;
+
+  for (int i = 1; i <= rings; ++i) {
+    float phi = i * phiStep;
+    float phi2 = (i - 1) * phiStep;
+    float thetaStep = 2.0f * PI / slices;
+
+    for (int j = 0; j <= slices; ++j) {
+      Vertex vert;
+      float theta = j * thetaStep;
+      float theta2 = (j-1) * thetaStep;
+
+      vert.x = radius * sinf(phi) * cosf(theta);
+      vert.y = radius * cosf(phi);
+      vert.z = radius * sinf(phi) * sinf(theta);
+      vertexList.push_back(vert);
+      vert.x = radius * sinf(phi2) * cosf(theta);
+      vert.y = radius * cosf(phi2);
+      vert.z = radius * sinf(phi2) * sinf(theta);
+      vertexList.push_back(vert);
+      vert.x = radius * sinf(phi2) * cosf(theta2);
+      vert.y = radius * cosf(phi2);
+      vert.z = radius * sinf(phi2) * sinf(theta2);
+      vertexList.push_back(vert);
+      vert.x = radius * sinf(phi) * cosf(theta);
+      vert.y = radius * cosf(phi);
+      vert.z = radius * sinf(phi) * sinf(theta);
+      vertexList.push_back(vert);
+      vert.x = radius * sinf(phi) * cosf(theta2);
+      vert.y = radius * cosf(phi);
+      vert.z = radius * sinf(phi) * sinf(theta2);
+      vertexList.push_back(vert);
+      vert.x = radius * sinf(phi2) * cosf(theta2);
+      vert.y = radius * cosf(phi2);
+      vert.z = radius * sinf(phi2) * sinf(theta2);
+      vertexList.push_back(vert);
+    }
+  }
+}
+
+/* Indexed, with the quads of each band in turn; positions from sinf/cosf
+   per vertex. */
+static void ringOrderSphere(std::vector<Vertex> &v, std::vector<unsigned short> &index,
+                            float radius, int slices, int stacks)
+{
+  const double pi = 3.14159265358979323846;
+  int south = 1 + (stacks - 1) * slices;
+
+  v.resize(south + 1);
+  v[0].x = 0;  v[0].y = radius;  v[0].z = 0;
+  for (int k = 1; k < stacks; k++) {
+    for (int x = 0; x < slices; x++) {
+      float phi = (float) (pi * k / stacks), theta = (float) (2 * pi * x / slices);
+      Vertex &p = v[1 + (k-1)*slices + x];
+
+      p.x = radius * sinf(phi) * cosf(theta);
+      p.y = radius * cosf(phi);
+      p.z = radius * sinf(phi) * sinf(theta);
+    }
+  }
+  v[south].x = 0;  v[south].y = -radius;  v[south].z = 0;
+
+  index.clear();
+  for (int k = 0; k < stacks; k++) {
+    for (int x = 0; x < slices; x++) {
+      int x1 = (x + 1) % slices;
+      int a = k == 0 ? 0 : 1 + (k-1)*slices + x,
+          d = k == 0 ? 0 : 1 + (k-1)*slices + x1,
+          b = k == stacks-1 ? south : 1 + k*slices + x,
+          c = k == stacks-1 ? south : 1 + k*slices + x1;
+
+      if (k != stacks - 1) {
+        index.push_back(a);  index.push_back(b);  index.push_back(c);
+      }
+      if (k != 0) {
+        index.push_back(a);  index.push_back(c);  index.push_back(d);
+      }
+    }
+  }
+}
+
+/* Vertex shader runs per triangle with a FIFO cache of the given size. */
+template <typename Index>
+static double acmr(const Index *index, int count, int cacheSize)
+{
+  std::vector<int> cache(cacheSize, -1);
+  int head = 0, misses = 0;
+
+  for (int i = 0; i < count; i++) {
+    int j;
+
+    for (j = 0; j < cacheSize; j++)
+      if (cache[j] == (int) index[i])
+        break;
+    if (j == cacheSize) {
+      cache[head] = (int) index[i];
+      head = (head + 1) % cacheSize;
+      misses++;
+    }
+  }
+  return (double) misses / (count / 3);
+}
+
+static void printRow(const char *size, const char *name, long vertices, long triangles,
+                     long bytes, double t, double cacheMisses)
+{
+  printf("%-8s %-14s %9ld %10ld %11ld %12.2f %7.3f\n",
+    size, name, vertices, triangles, bytes, t*1e6, cacheMisses);
+}
+
+int main(void)
+{
+  static const int sizes[] = { 20, 64, 180 };
+  const float radius = 2.0f;
+
+  printf("%-8s %-14s %9s %10s %11s %12s %7s\n",
+    "size", "routine", "vertices", "triangles", "bytes", "us/mesh", "ACMR");
+
+  for (int s = 0; s < (int) (sizeof(sizes) / sizeof(sizes[0])); s++) {
+    int n = sizes[s];
+    int vertexCount = getSphereVertexCount(n, n), indexCount = getSphereIndexCount(n, n);
+    char size[32];
+    double t;
+
+    sprintf(size, "%dx%d", n, n);
+
+    {
+      std::vector<Vertex> vertexList;
+
+      t = benchBest([&] {
+        vertexList.clear();
+        unindexedSphere(vertexList, radius, n, n);
+        benchKeep(vertexList[0].x);
+      });
+      printRow(size, "unindexed", (long) vertexList.size(), (long) vertexList.size() / 3,
+               (long) (vertexList.size() * sizeof(Vertex)), t, 3.0);
+    }
+
+    {
+      std::vector<Vertex> v;
+      std::vector<unsigned short> index;
+
+      t = benchBest([&] {
+        ringOrderSphere(v, index, radius, n, n);
+        benchKeep(v[0].x);
+      });
+      printRow(size, "ring order", (long) v.size(), (long) index.size() / 3,
+               (long) (v.size() * sizeof(Vertex) + index.size() * sizeof(index[0])), t,
+               acmr(&index[0], (int) index.size(), 16));
+    }
+
+    {
+      std::vector<float> xyz(vertexCount * 3);
+      std::vector<unsigned short> index(indexCount);
+
+      t = benchBest([&] {
+        makeSphere16(&xyz[0], &index[0], radius, n, n);
+        benchKeep(xyz[0]);
+      });
+      printRow(size, "makeSphere16", vertexCount, indexCount / 3,
+               (long) (xyz.size() * sizeof(float) + index.size() * sizeof(index[0])), t,
+               acmr(&index[0], indexCount, 16));
+    }
+
+    {
+      std::vector<float> xyz(vertexCount * 3);
+      std::vector<unsigned int> index(indexCount);
+
+      t = benchBest([&] {
+        makeSphere(&xyz[0], &index[0], radius, n, n);
+        benchKeep(xyz[0]);
+      });
+      printRow(size, "makeSphere", vertexCount, indexCount / 3,
+               (long) (xyz.size() * sizeof(float) + index.size() * sizeof(index[0])), t,
+               acmr(&index[0], indexCount, 16));
+    }
+    printf("\n");
+  }
+
+  printf("The unindexed sphere is missing its south polar band and draws the\n"
+         "quads next to its seam twice, hence its different triangle count.\n");
+  return 0;
+}
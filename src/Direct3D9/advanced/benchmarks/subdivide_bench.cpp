@@ -0,0 +1,157 @@
+/* subdivide_bench.cpp - subdivideTriangle against 06_vertex_twisting's recursive triangleDivide.
+
+   For subdivision depths up to 12 (16.7 million triangles): the old
+   recursion, which writes three vertices per triangle, and
+   subdivideTriangle on one thread and on all of them.  Memory is the
+   vertex buffer plus the index buffer; ACMR is vertex shader runs per
+   triangle with a 16-entry FIFO post-transform cache (3 when unindexed).
+   The recursion is only run while its output stays under 1 GB. */
+
+#include <vector>
+
+#include "bench.h"
+#include "../cgfx_buffer_lighting/parallel.h"
+#include "../../basic/06_vertex_twisting/subdivide.h"
+
+struct Vertex
+{
+  float x, y, z;
+  unsigned int color;
+};
+
+static unsigned int packColor(const float c[3])
+{
+  return 0xff000000u | (unsigned int) (c[0] * 255 + 0.5f) << 16 |
+         (unsigned int) (c[1] * 255 + 0.5f) << 8 | (unsigned int) (c[2] * 255 + 0.5f);
+}
+
+static inline void writeVertex(Vertex &v, const float p[2], const float c[3])
+{
+  v.x = p[0];
+  v.y = p[1];
+  v.z = 0;
+  v.color = packColor(c);
+}
+
+/* 06_vertex_twisting's triangleDivide, apart from the D3DXCOLOR. */
+static void triangleDivide(Vertex v[], int &n, int depth,
+                           const float a[2], const float b[2], const float c[2],
+                           const float ca[3], const float cb[3], const float cc[3])
+{
+  if (depth == 0) {
+    writeVertex(v[n++], a, ca);
+    writeVertex(v[n++], b, cb);
+    writeVertex(v[n++], c, cc);
+  } else {
+    const float d[2] = { (a[0]+b[0])/2, (a[1]+b[1])/2 },
+                e[2] = { (b[0]+c[0])/2, (b[1]+c[1])/2 },
+                f[2] = { (c[0]+a[0])/2, (c[1]+a[1])/2 };
+    const float cd[3] = { (ca[0]+cb[0])/2, (ca[1]+cb[1])/2, (ca[2]+cb[2])/2 },
+                ce[3] = { (cb[0]+cc[0])/2, (cb[1]+cc[1])/2, (cb[2]+cc[2])/2 },
+                cf[3] = { (cc[0]+ca[0])/2, (cc[1]+ca[1])/2, (cc[2]+ca[2])/2 };
+
+    depth -= 1;
+    triangleDivide(v, n, depth, a, d, f, ca, cd, cf);
+    triangleDivide(v, n, depth, d, b, e, cd, cb, ce);
+    triangleDivide(v, n, depth, f, e, c, cf, ce, cc);
+    triangleDivide(v, n, depth, d, e, f, cd, ce, cf);
+  }
+}
+
+/* Vertex shader runs per triangle with a FIFO cache of the given size. */
+template <typename Index>
+static double acmr(const Index *index, long count, int cacheSize)
+{
+  std::vector<long> cache(cacheSize, -1);
+  long misses = 0;
+  int head = 0;
+
+  for (long i = 0; i < count; i++) {
+    int j;
+
+    for (j = 0; j < cacheSize; j++)
+      if (cache[j] == (long) index[i])
+        break;
+    if (j == cacheSize) {
+      cache[head] = (long) index[i];
+      head = (head + 1) % cacheSize;
+      misses++;
+    }
+  }
+  return (double) misses / (count / 3);
+}
+
+static void printRow(int depth, const char *name, long vertices, long triangles,
+                     double bytes, double t, double cacheMisses)
+{
+  printf("%5d %-22s %10ld %10ld %9.1f %10.3f %9.1f %6.3f\n",
+    depth, name, vertices, triangles, bytes / 1048576, t*1e3, triangles / t / 1e6,
+    cacheMisses);
+}
+
+int main(void)
+{
+  static const int depths[] = { 5, 8, 10, 11, 12 };
+  const float a[2] = { -0.8f, 0.8f }, b[2] = { 0.8f, 0.8f }, c[2] = { 0.0f, -0.8f },
+              ca[3] = { 0, 0, 1 }, cb[3] = { 0, 0, 1 }, cc[3] = { 0.7f, 0.7f, 1 };
+  int threads = getParallelThreadCount();
+
+  printf("%d threads\n\n", threads);
+  printf("%5s %-22s %10s %10s %9s %10s %9s %6s\n",
+    "depth", "routine", "vertices", "triangles", "MB", "ms/mesh", "Mtris/s", "ACMR");
+
+  for (int d = 0; d < (int) (sizeof(depths) / sizeof(depths[0])); d++) {
+    int depth = depths[d];
+    long vertexCount = getSubdividedVertexCount(depth),
+         triangleCount = getSubdividedTriangleCount(depth);
+    double minTime = depth >= 11 ? 1.0 : 0.25, t;
+
+    if (triangleCount * 3 * sizeof(Vertex) < (1u << 30)) {
+      std::vector<Vertex> v(triangleCount * 3);
+
+      t = benchBest([&] {
+        int n = 0;
+
+        triangleDivide(&v[0], n, depth, a, b, c, ca, cb, cc);
+        benchKeep(v[0].x);
+      }, minTime);
+      printRow(depth, "triangleDivide", triangleCount * 3, triangleCount,
+               (double) v.size() * sizeof(Vertex), t, 3.0);
+    }
+
+    {
+      std::vector<SubdividedVertex> v(vertexCount);
+      std::vector<unsigned int> index(triangleCount * 3);
+
+      for (int n = 1; n <= threads; n = n < threads ? threads : n + 1) {
+        char name[64];
+
+        setParallelThreadCount(n);
+        t = benchBest([&] {
+          subdivideTriangle(&v[0], &index[0], depth, a, b, c, ca, cb, cc);
+          benchKeep(v[0].x);
+        }, minTime);
+        sprintf(name, "subdivideTriangle/%dt", n);
+        printRow(depth, name, vertexCount, triangleCount,
+                 (double) v.size() * sizeof(v[0]) + (double) index.size() * sizeof(index[0]),
+                 t, acmr(&index[0], (long) index.size(), 16));
+      }
+      setParallelThreadCount(0);
+    }
+
+    if (vertexCount <= 65536) {
+      std::vector<SubdividedVertex> v(vertexCount);
+      std::vector<unsigned short> index(triangleCount * 3);
+
+      t = benchBest([&] {
+        subdivideTriangle16(&v[0], &index[0], depth, a, b, c, ca, cb, cc);
+        benchKeep(v[0].x);
+      });
+      printRow(depth, "subdivideTriangle16", vertexCount, triangleCount,
+               (double) v.size() * sizeof(v[0]) + (double) index.size() * sizeof(index[0]),
+               t, acmr(&index[0], (long) index.size(), 16));
+    }
+    printf("\n");
+  }
+  return 0;
+}
@@ -0,0 +1,169 @@
+/* tessellate_bench.cpp - tessellateSurface against a hand-written torus loop.
+
+   For C8E6v_torus's torus at a few grid sizes: the obvious loop (sinf and
+   cosf per vertex, quads indexed row by row), tessellateSurface as a list
+   and as a strip on one thread and on all of them, and getSurfaceMesh once
+   the mesh is cached.  ACMR is vertex shader runs per triangle with a
+   16-entry FIFO post-transform cache. */
+
+#include <math.h>
+#include <vector>
+
+#include "bench.h"
+#include "../cgfx_buffer_lighting/parallel.h"
+#include "../cgfx_buffer_lighting/tessellate.h"
+
+/* Hand-written torus: the same vertices as evaluateTorusSurface. */
+static void loopTorus(std::vector<SurfaceVertex> &vertices, std::vector<unsigned int> &indices,
+                      float M, float N, int uSteps, int vSteps)
+{
+  const float pi2 = 6.28318530f;
+  const int rowLength = uSteps + 1;
+
+  vertices.resize(rowLength * (vSteps + 1));
+  for (int j = 0; j <= vSteps; j++) {
+    for (int i = 0; i <= uSteps; i++) {
+      SurfaceVertex &p = vertices[j*rowLength + i];
+      float u = (float) i / uSteps, v = (float) j / vSteps;
+      float sinS = sinf(pi2 * u), cosS = cosf(pi2 * u),
+            sinT = sinf(pi2 * v), cosT = cosf(pi2 * v);
+
+      p.position[0] = (M + N * cosT) * cosS;
+      p.position[1] = (M + N * cosT) * sinS;
+      p.position[2] = N * sinT;
+      p.normal[0] = cosS * cosT;
+      p.normal[1] = sinS * cosT;
+      p.normal[2] = sinT;
+      p.tangent[0] = -sinS;
+      p.tangent[1] = cosS;
+      p.tangent[2] = 0;
+      p.texCoord[0] = u;
+      p.texCoord[1] = v;
+    }
+  }
+
+  indices.clear();
+  for (int j = 0; j < vSteps; j++) {
+    for (int i = 0; i < uSteps; i++) {
+      unsigned int a = j*rowLength + i, b = a + rowLength, c = b + 1, d = a + 1;
+
+      indices.push_back(a);  indices.push_back(b);  indices.push_back(d);
+      indices.push_back(d);  indices.push_back(b);  indices.push_back(c);
+    }
+  }
+}
+
+/* Vertex shader runs per triangle; strips are expanded first. */
+static double acmr(const unsigned int *index, int count, bool strip)
+{
+  const int cacheSize = 16;
+  std::vector<unsigned int> list;
+  unsigned int cache[cacheSize];
+  int head = 0, misses = 0;
+
+  if (strip) {
+    for (int i = 0; i + 2 < count; i++) {
+      if (index[i] == index[i+1] || index[i+1] == index[i+2] || index[i] == index[i+2])
+        continue;
+      list.push_back(index[i]);  list.push_back(index[i+1]);  list.push_back(index[i+2]);
+    }
+    index = &list[0];
+    count = (int) list.size();
+  }
+  for (int i = 0; i < cacheSize; i++)
+    cache[i] = ~0u;
+  for (int i = 0; i < count; i++) {
+    int j;
+
+    for (j = 0; j < cacheSize; j++)
+      if (cache[j] == index[i])
+        break;
+    if (j == cacheSize) {
+      cache[head] = index[i];
+      head = (head + 1) % cacheSize;
+      misses++;
+    }
+  }
+  return (double) misses / (count / 3);
+}
+
+static void printRow(const char *size, const char *name, double t, int vertices,
+                     int indices, double cacheMisses)
+{
+  if (cacheMisses >= 0)
+    printf("%-10s %-26s %10.4f %12.4g %10d %7.3f\n",
+      size, name, t*1e3, vertices/t, indices, cacheMisses);
+  else
+    printf("%-10s %-26s %10.4f %12.4g %10d %7s\n",
+      size, name, t*1e3, vertices/t, indices, "-");
+}
+
+int main(void)
+{
+  static const int sizes[][2] = { { 40, 20 }, { 256, 256 }, { 1024, 1024 } };
+  TorusSurface torus = { 2.0f, 0.6f };
+  ParametricSurface surface = { evaluateTorusSurface, &torus, sizeof(torus) };
+  int threads = getParallelThreadCount();
+
+  printf("%d threads\n\n", threads);
+  printf("%-10s %-26s %10s %12s %10s %7s\n",
+    "grid", "routine", "ms/mesh", "vertices/s", "indices", "ACMR");
+
+  for (int s = 0; s < (int) (sizeof(sizes) / sizeof(sizes[0])); s++) {
+    int uSteps = sizes[s][0], vSteps = sizes[s][1];
+    char size[32];
+    double t;
+
+    sprintf(size, "%dx%d", uSteps, vSteps);
+
+    {
+      std::vector<SurfaceVertex> vertices;
+      std::vector<unsigned int> indices;
+
+      /* Fresh vectors every time, as tessellateSurface allocates a new mesh. */
+      t = benchBest([&] {
+        std::vector<SurfaceVertex> v;
+        std::vector<unsigned int> i;
+
+        loopTorus(v, i, torus.M, torus.N, uSteps, vSteps);
+        benchKeep(v[0].position[0]);
+      });
+      loopTorus(vertices, indices, torus.M, torus.N, uSteps, vSteps);
+      printRow(size, "sinf/cosf loop", t, (int) vertices.size(), (int) indices.size(),
+               acmr(&indices[0], (int) indices.size(), false));
+    }
+
+    for (int topology = SURFACE_TRIANGLE_LIST; topology <= SURFACE_TRIANGLE_STRIP; topology++) {
+      for (int n = 1; n <= threads; n = n < threads ? threads : n + 1) {
+        SurfaceMesh mesh;
+        char name[64];
+
+        setParallelThreadCount(n);
+        t = benchBest([&] {
+          tessellateSurface(&mesh, &surface, uSteps, vSteps, (SurfaceTopology) topology);
+          benchKeep(mesh.vertices[0].position[0]);
+          freeSurfaceMesh(&mesh);
+        });
+        tessellateSurface(&mesh, &surface, uSteps, vSteps, (SurfaceTopology) topology);
+        sprintf(name, "tessellateSurface/%s/%dt",
+                topology == SURFACE_TRIANGLE_LIST ? "list" : "strip", n);
+        printRow(size, name, t, mesh.vertexCount, mesh.indexCount,
+                 acmr(mesh.indices, mesh.indexCount, topology == SURFACE_TRIANGLE_STRIP));
+        freeSurfaceMesh(&mesh);
+      }
+    }
+    setParallelThreadCount(0);
+
+    {
+      const SurfaceMesh *mesh = getSurfaceMesh(&surface, uSteps, vSteps, SURFACE_TRIANGLE_LIST);
+
+      t = benchBest([&] {
+        benchKeep(getSurfaceMesh(&surface, uSteps, vSteps, SURFACE_TRIANGLE_LIST));
+      });
+      printRow(size, "getSurfaceMesh (cached)", t, mesh->vertexCount, mesh->indexCount, -1);
+    }
+    printf("\n");
+  }
+  clearSurfaceMeshCache();
+  return 0;
+}
@@ -0,0 +1,256 @@
+/* topology_report.cpp - What each primitive topology costs for the samples' meshes and OBJ files.
+
+   Usage: topology_report [file.obj ...]
+
+   For every mesh, the ways it is drawn today (where the samples build it
+   by hand) and then the forms stripify.h can produce from its triangle
+   list: the list itself, one strip in cache-sized pieces, one strip in
+   pieces as long as possible, the same with strip restarts, and the form
+   optimizePrimitives picks with the default cost model (Direct3D 9, so
+   no restarts).  Shader runs assume a 16-entry FIFO post-transform
+   cache; an unindexed draw runs the shader for every vertex.
+
+   Built-in meshes: Lab 1's star (the hand-made fan, strip, and list, and
+   the list welded into an indexed mesh), cgfx_bumpdemo's flat patch (one
+   unindexed strip per ring), makeSphere's sphere, and tessellateSurface's
+   torus.  OBJ faces are split into fans; only positions are indexed. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "../cgfx_buffer_lighting/sphere.h"
+#include "../cgfx_buffer_lighting/stripify.h"
+#include "../cgfx_buffer_lighting/tessellate.h"
+
+typedef std::vector<unsigned int> Indices;
+
+static PrimitiveCostModel myModel;
+
+static void printHeader(void)
+{
+  printf("%-24s %-20s %8s %8s %7s %8s %8s %6s %11s\n",
+    "mesh", "form", "indices", "tris", "degen", "verts", "runs", "draws", "cost");
+}
+
+static void printStats(const char *mesh, const char *form, const PrimitiveStats *s)
+{
+  printf("%-24s %-20s %8d %8d %7d %8d %8d %6d %11.1f\n",
+    mesh, form, s->indexCount, s->triangleCount, s->degenerateCount, s->vertexCount,
+    s->shaderRuns, s->drawCalls, s->cost);
+}
+
+/* Sum of several draws. */
+static void addStats(PrimitiveStats *sum, const PrimitiveStats *s)
+{
+  sum->indexCount += s->indexCount;
+  sum->triangleCount += s->triangleCount;
+  sum->degenerateCount += s->degenerateCount;
+  sum->vertexCount += s->vertexCount;
+  sum->shaderRuns += s->shaderRuns;
+  sum->drawCalls += s->drawCalls;
+  sum->cost += s->cost;
+}
+
+/* An unindexed draw of count vertices. */
+static void measureUnindexed(PrimitiveStats *s, PrimitiveTopology topology, int count)
+{
+  Indices sequence(count);
+
+  for (int i = 0; i < count; i++)
+    sequence[i] = i;
+  measurePrimitives(s, topology, &sequence[0], count, 1, &myModel);
+}
+
+static void reportList(const char *mesh, const Indices &list)
+{
+  static const struct {
+    const char *name;
+    PrimitiveTopology topology;
+    int cacheSize;
+  } strips[] = {
+    { "strip/cache", PRIMITIVE_TRIANGLE_STRIP, -1 },
+    { "strip/long", PRIMITIVE_TRIANGLE_STRIP, 0 },
+    { "restart/cache", PRIMITIVE_TRIANGLE_STRIP_RESTART, -1 },
+    { "restart/long", PRIMITIVE_TRIANGLE_STRIP_RESTART, 0 }
+  };
+  Indices out(getMaxStripIndexCount((int) list.size() / 3) + 3);
+  PrimitiveStats s;
+  char form[64];
+
+  if (list.empty())
+    return;
+  measurePrimitives(&s, PRIMITIVE_TRIANGLE_LIST, &list[0], (int) list.size(), 1, &myModel);
+  printStats(mesh, "list", &s);
+  for (int i = 0; i < (int) (sizeof(strips) / sizeof(strips[0])); i++) {
+    int n = stripifyTriangles(&out[0], &list[0], (int) list.size(), strips[i].topology,
+                              strips[i].cacheSize < 0 ? myModel.cacheSize : strips[i].cacheSize);
+
+    measurePrimitives(&s, strips[i].topology, &out[0], n, 1, &myModel);
+    printStats(mesh, strips[i].name, &s);
+  }
+  optimizePrimitives(&out[0], &s, &list[0], (int) list.size(), &myModel);
+  sprintf(form, "chosen: %s", s.topology == PRIMITIVE_TRIANGLE_LIST ? "list" : "strip");
+  printStats(mesh, form, &s);
+  printf("\n");
+}
+
+/* Lab 1 (01_vertex_program.cpp) */
+
+static void reportStar(void)
+{
+  /* starVerticesList */
+  static const float list[27][2] = {
+    { 0.0f, 0.8f }, { 0.2f, 0.4f }, { -0.2f, 0.4f },
+    { -0.7f, 0.4f }, { -0.2f, 0.4f }, { -0.25f, -0.15f },
+    { -0.2f, 0.4f }, { 0.2f, 0.4f }, { -0.25f, -0.15f },
+    { -0.25f, -0.15f }, { 0.2f, 0.4f }, { 0.25f, -0.15f },
+    { 0.2f, 0.4f }, { 0.7f, 0.4f }, { 0.25f, -0.15f },
+    { -0.25f, -0.15f }, { 0.0f, -0.15f }, { 0.0f, -0.4f },
+    { 0.0f, -0.15f }, { 0.25f, -0.15f }, { 0.0f, -0.4f },
+    { 0.0f, -0.4f }, { 0.25f, -0.15f }, { 0.4f, -0.7f },
+    { 0.0f, -0.4f }, { -0.4f, -0.7f }, { -0.25f, -0.15f }
+  };
+  std::vector<int> welded;
+  Indices indices;
+  PrimitiveStats s;
+
+  measureUnindexed(&s, PRIMITIVE_TRIANGLE_FAN, 12);
+  printStats("lab1 star", "hand fan", &s);
+  measureUnindexed(&s, PRIMITIVE_TRIANGLE_STRIP, 22);
+  printStats("lab1 star", "hand strip", &s);
+  measureUnindexed(&s, PRIMITIVE_TRIANGLE_LIST, 27);
+  printStats("lab1 star", "hand list", &s);
+
+  /* Weld equal positions. */
+  for (int i = 0; i < 27; i++) {
+    int j;
+
+    for (j = 0; j < (int) welded.size(); j++)
+      if (list[welded[j]][0] == list[i][0] && list[welded[j]][1] == list[i][1])
+        break;
+    if (j == (int) welded.size())
+      welded.push_back(i);
+    indices.push_back(j);
+  }
+  reportList("lab1 star (welded)", indices);
+}
+
+/* cgfx_bumpdemo's drawFlatPatch */
+
+static void reportFlatPatch(int sides, int rings)
+{
+  Indices list, ring;
+  PrimitiveStats sum, s;
+  char mesh[64];
+
+  sprintf(mesh, "flat patch %dx%d", sides, rings);
+  memset(&sum, 0, sizeof(sum));
+  sum.topology = PRIMITIVE_TRIANGLE_STRIP;
+  for (int i = 0; i < rings; i++) {
+    measureUnindexed(&s, PRIMITIVE_TRIANGLE_STRIP, 2 * sides + 2);
+    addStats(&sum, &s);
+  }
+  printStats(mesh, "hand strip per ring", &sum);
+
+  /* The same strips over shared grid vertices (i, j). */
+  for (int i = 0; i < rings; i++) {
+    size_t n = list.size();
+
+    ring.clear();
+    for (int j = 0; j <= sides; j++) {
+      ring.push_back(i * (sides + 1) + j);
+      ring.push_back((i + 1) * (sides + 1) + j);
+    }
+    list.resize(n + 3 * ring.size());
+    list.resize(n + listTriangles(&list[n], PRIMITIVE_TRIANGLE_STRIP,
+                                  &ring[0], (int) ring.size()));
+  }
+  reportList(mesh, list);
+}
+
+static void reportSphere(int slices, int stacks)
+{
+  Indices list(getSphereIndexCount(slices, stacks));
+  std::vector<float> xyz(3 * getSphereVertexCount(slices, stacks));
+  char mesh[64];
+
+  makeSphere(&xyz[0], &list[0], 1, slices, stacks);
+  sprintf(mesh, "makeSphere %dx%d", slices, stacks);
+  reportList(mesh, list);
+}
+
+static void reportTorus(int uSteps, int vSteps)
+{
+  TorusSurface torus = { 6, 2 };
+  ParametricSurface surface = { evaluateTorusSurface, &torus, sizeof(torus) };
+  SurfaceMesh m;
+  char mesh[64];
+
+  tessellateSurface(&m, &surface, uSteps, vSteps, SURFACE_TRIANGLE_LIST);
+  sprintf(mesh, "torus %dx%d", uSteps, vSteps);
+  reportList(mesh, Indices(m.indices, m.indices + m.indexCount));
+  freeSurfaceMesh(&m);
+}
+
+/* Positions of "f" lines, each face split into a fan. */
+static bool readObj(const char *path, Indices &list)
+{
+  FILE *file = fopen(path, "r");
+  char line[4096];
+  long positions = 0;
+
+  if (!file)
+    return false;
+  while (fgets(line, sizeof(line), file)) {
+    if (line[0] == 'v' && line[1] == ' ') {
+      positions++;
+    } else if (line[0] == 'f' && line[1] == ' ') {
+      std::vector<long> face;
+      char *token = strtok(line + 2, " \t\r\n");
+
+      for (; token; token = strtok(NULL, " \t\r\n")) {
+        long v = strtol(token, NULL, 10);
+
+        face.push_back(v < 0 ? positions + v : v - 1);
+      }
+      for (size_t i = 2; i < face.size(); i++) {
+        list.push_back((unsigned int) face[0]);
+        list.push_back((unsigned int) face[i-1]);
+        list.push_back((unsigned int) face[i]);
+      }
+    }
+  }
+  fclose(file);
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  getDefaultPrimitiveCostModel(&myModel);
+  printf("Cost model: shader run %g, index %g, draw call %g, %d-entry cache\n\n",
+    myModel.shaderRun, myModel.index, myModel.drawCall, myModel.cacheSize);
+  printHeader();
+
+  if (argc > 1) {
+    for (int i = 1; i < argc; i++) {
+      Indices list;
+      const char *name = strrchr(argv[i], '/') ? strrchr(argv[i], '/') + 1 : argv[i];
+
+      if (!readObj(argv[i], list)) {
+        fprintf(stderr, "topology_report: cannot open %s\n", argv[i]);
+        return 1;
+      }
+      reportList(name, list);
+    }
+    return 0;
+  }
+
+  reportStar();
+  reportFlatPatch(20, 40);
+  reportSphere(20, 20);
+  reportTorus(40, 20);
+  reportTorus(256, 256);
+  return 0;
+}
@@ -0,0 +1,166 @@
+/* torus_bench.cpp - Per-frame vertex work of cgfx_bumpdemo's parametric and baked torus.
+
+   Both vertex programs are run on the CPU (torus.h) over what each mode
+   draws every frame:
+
+     parametric  the flat patch: one strip of 2*(sides+1) (s, t) vertices
+                 per ring, drawn unindexed, so every strip vertex runs
+                 C8E6v_torus;
+     baked       tessellateSurface's indexed triangle list, so C8E6v_bakedTorus
+                 runs once per miss of a 16-entry FIFO post-transform cache.
+
+   ns/run is the CPU cost of one vertex program run, a stand-in for its
+   instruction count; ms/frame is ns/run times runs/frame.  Bytes/frame is
+   the vertex (and index) data fetched.  "bake" is the one-time cost of
+   the baked mode, and max diff is the largest difference between the two
+   programs' outputs over the baked vertices. */
+
+#include <math.h>
+#include <vector>
+
+#include "bench.h"
+#include "../cgfx_buffer_lighting/matrix.h"
+#include "../cgfx_bumpdemo/torus.h"
+
+/* initTorusVertexBuffer's (s, t) strips. */
+static void flatPatch(std::vector<float> &parametric, int sides, int rings)
+{
+  parametric.clear();
+  for (int i = 0; i < rings; i++) {
+    for (int j = 0; j <= sides; j++) {
+      parametric.push_back((float) i / rings);
+      parametric.push_back((float) j / sides);
+      parametric.push_back((float) (i+1) / rings);
+      parametric.push_back((float) j / sides);
+    }
+  }
+}
+
+/* Vertex program runs with a FIFO cache of cacheSize entries. */
+static int cacheMisses(const unsigned int *index, int count, int cacheSize)
+{
+  std::vector<unsigned int> cache(cacheSize, ~0u);
+  int head = 0, misses = 0;
+
+  for (int i = 0; i < count; i++) {
+    int j;
+
+    for (j = 0; j < cacheSize; j++)
+      if (cache[j] == index[i])
+        break;
+    if (j == cacheSize) {
+      cache[head] = index[i];
+      head = (head + 1) % cacheSize;
+      misses++;
+    }
+  }
+  return misses;
+}
+
+static float maxDifference(const TorusShaderOutput &a, const TorusShaderOutput &b)
+{
+  float d = 0;
+
+  for (int i = 0; i < 4; i++)
+    d = fmaxf(d, fabsf(a.position[i] - b.position[i]));
+  for (int i = 0; i < 2; i++)
+    d = fmaxf(d, fabsf(a.texCoord[i] - b.texCoord[i]));
+  for (int i = 0; i < 3; i++) {
+    d = fmaxf(d, fabsf(a.lightDirection[i] - b.lightDirection[i]));
+    d = fmaxf(d, fabsf(a.halfAngle[i] - b.halfAngle[i]));
+  }
+  return d;
+}
+
+static void printRow(const char *size, const char *name, long runs, double t,
+                     long bytes)
+{
+  printf("%-11s %-11s %10ld %8.2f %10.3f %12ld\n",
+    size, name, runs, t*1e9 / runs, t*1e3, bytes);
+}
+
+int main(void)
+{
+  static const int sizes[][2] = { { 20, 40 }, { 256, 512 }, { 1024, 2048 } };
+  TorusUniforms uniforms = { { -8, 0, 15 }, { 0, 8, 18 }, { 0 }, 6, 2 };
+  TorusSurface torus;
+  ParametricSurface surface = { evaluateTorusSurface, &torus, sizeof(torus) };
+  float projection[16], view[16];
+
+  /* cgfx_bumpdemo's camera, at one point of its orbit. */
+  makePerspectiveMatrix(60, 4.0 / 3.0, 0.1, 100, projection);
+  makeLookAtMatrix(0, 8, 18,  0, 0, 0,  0, 1, 0, view);
+  multMatrix(uniforms.modelViewProj, projection, view);
+  torus.M = uniforms.M;
+  torus.N = uniforms.N;
+
+  printf("%-11s %-11s %10s %8s %10s %12s\n",
+    "sides/rings", "mode", "runs/frame", "ns/run", "ms/frame", "bytes/frame");
+
+  for (int s = 0; s < (int) (sizeof(sizes) / sizeof(sizes[0])); s++) {
+    int sides = sizes[s][0], rings = sizes[s][1];
+    std::vector<float> parametric;
+    SurfaceMesh mesh;
+    char size[32];
+    double t;
+
+    sprintf(size, "%dx%d", sides, rings);
+    flatPatch(parametric, sides, rings);
+    tessellateSurface(&mesh, &surface, rings, sides, SURFACE_TRIANGLE_LIST);
+
+    {
+      int runs = (int) parametric.size() / 2;
+      std::vector<TorusShaderOutput> out(runs);
+
+      t = benchBest([&] {
+        shadeParametricTorus(&out[0], &parametric[0], runs, &uniforms);
+        benchKeep(out[0].position[0]);
+      });
+      printRow(size, "parametric", runs, t, (long) (runs * 3 * sizeof(float)));
+    }
+
+    {
+      int runs = cacheMisses(mesh.indices, mesh.indexCount, 16);
+      std::vector<TorusShaderOutput> out(mesh.vertexCount);
+      double perRun;
+
+      /* Time the distinct vertices, then charge each cache miss one run. */
+      perRun = benchBest([&] {
+        shadeBakedTorus(&out[0], mesh.vertices, mesh.vertexCount, &uniforms);
+        benchKeep(out[0].position[0]);
+      }) / mesh.vertexCount;
+      printRow(size, "baked", runs, perRun * runs,
+               (long) (runs * sizeof(SurfaceVertex) +
+                       mesh.indexCount * (mesh.vertexCount <= 65536 ? 2 : 4)));
+    }
+
+    {
+      SurfaceMesh baked;
+
+      t = benchBest([&] {
+        tessellateSurface(&baked, &surface, rings, sides, SURFACE_TRIANGLE_LIST);
+        benchKeep(baked.vertices[0].position[0]);
+        freeSurfaceMesh(&baked);
+      });
+      printf("%-11s %-11s %10s %8s %10.3f %12s   (once)\n", size, "bake", "-", "-", t*1e3, "-");
+    }
+
+    {
+      std::vector<TorusShaderOutput> a(mesh.vertexCount), b(mesh.vertexCount);
+      std::vector<float> st(2 * mesh.vertexCount);
+      float d = 0;
+
+      for (int i = 0; i < mesh.vertexCount; i++) {
+        st[2*i] = mesh.vertices[i].texCoord[0];
+        st[2*i+1] = mesh.vertices[i].texCoord[1];
+      }
+      shadeParametricTorus(&a[0], &st[0], mesh.vertexCount, &uniforms);
+      shadeBakedTorus(&b[0], mesh.vertices, mesh.vertexCount, &uniforms);
+      for (int i = 0; i < mesh.vertexCount; i++)
+        d = fmaxf(d, maxDifference(a[i], b[i]));
+      printf("%-11s max diff %g\n\n", size, d);
+    }
+    freeSurfaceMesh(&mesh);
+  }
+  return 0;
+}
@@ -0,0 +1,103 @@
+/* transform_bench.cpp - Per-vertex transformPosition calls against the
+   structure-of-arrays and interleaved array transforms, per SIMD level and
+   with one or all hardware threads. */
+
+#include <math.h>
+#include <vector>
+
+#include "bench.h"
+#include "../cgfx_buffer_lighting/matrix.h"
+#include "../cgfx_buffer_lighting/parallel.h"
+
+struct MY_V3F
+{
+  float x, y, z;
+};
+
+static const int myVertexCounts[] = { 10000, 1000000, 4000000 };
+
+int main(void)
+{
+  float projection[16], view[16], mvp[16];
+  MatrixSimdLevel support = getMatrixSimdSupport();
+  int hardwareThreads = getParallelThreadCount();
+
+  makePerspectiveMatrix(70.0, 4.0/3.0, 1.0, 20.0, projection);
+  makeLookAtMatrix(8, 1, 3,  0, 0, 0,  0, 1, 0, view);
+  multMatrix(mvp, projection, view);
+
+  printf("transform_bench: %d hardware threads\n", hardwareThreads);
+  printf("%9s  %-26s %8s %11s %12s %8s %10s\n",
+    "vertices", "path", "threads", "ns/vertex", "vertices/s", "speedup", "max error");
+
+  for (size_t c = 0; c < sizeof(myVertexCounts)/sizeof(myVertexCounts[0]); c++) {
+    const int count = myVertexCounts[c];
+    std::vector<float> x(count), y(count), z(count), ox(count), oy(count), oz(count);
+    std::vector<MY_V3F> interleaved(count), out(count);
+    std::vector<float> ref(count*3);
+    unsigned int seed = 5;
+
+    for (int i = 0; i < count; i++) {
+      x[i] = interleaved[i].x = benchRandom(&seed, -3, 3);
+      y[i] = interleaved[i].y = benchRandom(&seed, -3, 3);
+      z[i] = interleaved[i].z = benchRandom(&seed, -3, 3);
+    }
+
+    /* Current path: one transformPosition per vertex. */
+    double single = benchBest([&] {
+      for (int i = 0; i < count; i++) {
+        float v[4] = { interleaved[i].x, interleaved[i].y, interleaved[i].z, 1 }, r[4];
+        transformPosition(r, mvp, v);
+        ref[i*3+0] = r[0];
+        ref[i*3+1] = r[1];
+        ref[i*3+2] = r[2];
+      }
+      benchKeep(ref[0]);
+    });
+    printf("%9d  %-26s %8d %11.3f %12.4g %8s %10s\n", count, "transformPosition", 1,
+      single*1e9/count, count/single, "1.00x", "-");
+
+    for (int level = MATRIX_SIMD_SCALAR; level <= support; level++) {
+      for (int pass = 0; pass < (hardwareThreads > 1 ? 2 : 1); pass++) {
+        int threads = pass ? hardwareThreads : 1;
+        char name[64];
+        double t;
+        float maxError;
+
+        setMatrixSimdLevel((MatrixSimdLevel) level);
+        setParallelThreadCount(threads);
+
+        t = benchBest([&] {
+          transformPositionArraySoA(&ox[0], &oy[0], &oz[0], mvp, &x[0], &y[0], &z[0], NULL, count);
+          benchKeep(ox[0]);
+        });
+        maxError = 0;
+        for (int i = 0; i < count; i++) {
+          float e = fabsf(ox[i]-ref[i*3]) + fabsf(oy[i]-ref[i*3+1]) + fabsf(oz[i]-ref[i*3+2]);
+          if (e > maxError)
+            maxError = e;
+        }
+        sprintf(name, "PositionArraySoA/%s", getMatrixSimdLevelName((MatrixSimdLevel) level));
+        printf("%9d  %-26s %8d %11.3f %12.4g %7.2fx %10.3g\n", count, name, threads,
+          t*1e9/count, count/t, single/t, maxError);
+
+        t = benchBest([&] {
+          transformPositionArray(&out[0].x, 3, mvp, &interleaved[0].x, 3, count);
+          benchKeep(out[0]);
+        });
+        maxError = 0;
+        for (int i = 0; i < count; i++) {
+          float e = fabsf(out[i].x-ref[i*3]) + fabsf(out[i].y-ref[i*3+1]) + fabsf(out[i].z-ref[i*3+2]);
+          if (e > maxError)
+            maxError = e;
+        }
+        sprintf(name, "PositionArray/%s", getMatrixSimdLevelName((MatrixSimdLevel) level));
+        printf("%9d  %-26s %8d %11.3f %12.4g %7.2fx %10.3g\n", count, name, threads,
+          t*1e9/count, count/t, single/t, maxError);
+      }
+    }
+    setMatrixSimdLevel(support);
+    setParallelThreadCount(0);
+  }
+  return 0;
+}
@@ -0,0 +1,286 @@
+/* vcache_report.cpp - How well the samples' meshes and OBJ files use the post-transform and fetch caches.
+
+   Usage: vcache_report [-cache N] [file.obj ...]
+
+   For every mesh, as built and after optimizeVertexCache and
+   getFirstUseRemap (see vertexcache.h): ACMR and ATVR with an N-entry
+   FIFO and LRU post-transform cache (N is 16 unless given), vertex fetch
+   overfetch and mean index jump for the mesh's own vertex size, and
+   overdraw from the six axis views.
+
+   Built-in meshes: Lab 1's stars (each hand-made fan, strip, and list
+   welded into an indexed list), cgfx_bumpdemo's flat patch as a shared
+   grid, makeSphere's sphere, tessellateSurface's torus at two sizes and
+   once with its triangles shuffled, and 06_vertex_twisting's subdivided
+   triangle.  Without OBJ arguments, Lab5's model_for_cga.obj and Lab6's
+   retopoly.obj as objmodel.h loads them. */
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "bench.h"
+#include "objmodel.h"
+#include "../cgfx_buffer_lighting/sphere.h"
+#include "../cgfx_buffer_lighting/stripify.h"
+#include "../cgfx_buffer_lighting/tessellate.h"
+#include "../cgfx_buffer_lighting/vertexcache.h"
+#include "../../basic/06_vertex_twisting/subdivide.h"
+
+typedef std::vector<unsigned int> Indices;
+
+static int myCacheSize = 16;
+
+static void printHeader(void)
+{
+  printf("%-24s %-10s %8s %8s %6s %6s %6s %6s %9s %8s %8s\n", "mesh", "order", "tris",
+    "verts", "fifo", "atvr", "lru", "atvr", "overfetch", "jump", "overdraw");
+}
+
+static void printRow(const char *mesh, const char *order, const Indices &list,
+                     const float *positions, int stride, int vertexCount, int vertexSize)
+{
+  VertexCacheStats fifo, lru;
+  VertexFetchStats fetch;
+  OverdrawStats overdraw;
+
+  simulateVertexCache(&fifo, &list[0], (int) list.size(), vertexCount, myCacheSize,
+                      VERTEX_CACHE_FIFO);
+  simulateVertexCache(&lru, &list[0], (int) list.size(), vertexCount, myCacheSize,
+                      VERTEX_CACHE_LRU);
+  simulateVertexFetch(&fetch, &list[0], (int) list.size(), vertexCount, vertexSize, myCacheSize);
+  estimateOverdraw(&overdraw, &list[0], (int) list.size(), positions, stride, vertexCount);
+  printf("%-24s %-10s %8d %8d %6.3f %6.3f %6.3f %6.3f %9.3f %8.1f %8.3f\n", mesh, order,
+    fifo.triangleCount, fifo.vertexCount, fifo.acmr, fifo.atvr, lru.acmr, lru.atvr,
+    fetch.overfetch, fetch.meanIndexJump, overdraw.overdraw);
+}
+
+/* The mesh as built, then reordered: triangles for the cache, vertices
+   by first use. */
+static void reportMesh(const char *mesh, const Indices &list, const float *positions,
+                       int stride, int vertexCount, int vertexSize)
+{
+  Indices optimized(list.size()), remap(vertexCount);
+  std::vector<float> moved((size_t) vertexCount * stride);
+  double t;
+  int used;
+
+  if (list.empty())
+    return;
+  printRow(mesh, "built", list, positions, stride, vertexCount, vertexSize);
+
+  t = benchBest([&] {
+    optimizeVertexCache(&optimized[0], &list[0], (int) list.size(), vertexCount, myCacheSize);
+    benchKeep(optimized[0]);
+  }, 0.05);
+  used = getFirstUseRemap(&remap[0], &optimized[0], (int) optimized.size(), vertexCount);
+  for (int v = 0; v < vertexCount; v++)
+    if (remap[v] != ~0u)
+      memcpy(&moved[(size_t) remap[v] * stride], positions + (size_t) v * stride,
+             stride * sizeof(float));
+  for (size_t i = 0; i < optimized.size(); i++)
+    optimized[i] = remap[optimized[i]];
+  printRow(mesh, "optimized", optimized, &moved[0], stride, used, vertexSize);
+  printf("%-24s %-10s %.2f ms to optimize\n\n", "", "", t * 1e3);
+}
+
+/* Lab 1 (01_vertex_program.cpp): each star drawn by hand, welded. */
+
+static void reportStar(const char *mesh, const float (*xy)[2], int count,
+                       PrimitiveTopology topology)
+{
+  std::vector<float> welded;
+  Indices sequence, indices, list(3 * count);
+
+  /* Weld equal positions; z is zero. */
+  for (int i = 0; i < count; i++) {
+    int j;
+
+    for (j = 0; j < (int) welded.size() / 3; j++)
+      if (welded[3*j] == xy[i][0] && welded[3*j+1] == xy[i][1])
+        break;
+    if (j == (int) welded.size() / 3) {
+      welded.push_back(xy[i][0]);
+      welded.push_back(xy[i][1]);
+      welded.push_back(0);
+    }
+    indices.push_back(j);
+  }
+  list.resize(listTriangles(&list[0], topology, &indices[0], count));
+  reportMesh(mesh, list, &welded[0], 3, (int) welded.size() / 3, 12);
+}
+
+static void reportStars(void)
+{
+  static const float fan[12][2] = {
+    { 0.0f, 0.0f }, { 0.0f, 0.8f }, { 0.2f, 0.4f }, { 0.7f, 0.4f },
+    { 0.25f, -0.15f }, { 0.4f, -0.7f }, { 0.0f, -0.4f }, { -0.4f, -0.7f },
+    { -0.25f, -0.15f }, { -0.7f, 0.4f }, { -0.2f, 0.4f }, { 0.0f, 0.8f }
+  };
+  static const float fan4[10][2] = {
+    { 0.0f, 0.0f }, { 0.0f, 0.8f }, { 0.2f, 0.2f }, { 0.8f, 0.0f }, { 0.2f, -0.2f },
+    { 0.0f, -0.8f }, { -0.2f, -0.2f }, { -0.8f, 0.0f }, { -0.2f, 0.2f }, { 0.0f, 0.8f }
+  };
+  static const float fan6[9][2] = {
+    { 0.0f, 0.0f }, { 0.0f, 0.8f }, { 0.4f, 0.4f }, { 0.4f, -0.4f }, { 0.4f, -0.4f },
+    { 0.0f, -0.8f }, { -0.4f, -0.4f }, { -0.4f, 0.4f }, { 0.0f, 0.8f }
+  };
+  static const float strip[22][2] = {
+    { 0.0f, 0.0f }, { -0.7f, 0.4f }, { 0.0f, 0.0f }, { -0.2f, 0.4f },
+    { 0.0f, 0.0f }, { 0.0f, 0.8f }, { 0.0f, 0.0f }, { 0.2f, 0.4f },
+    { 0.0f, 0.0f }, { 0.7f, 0.4f }, { 0.0f, 0.0f }, { 0.25f, -0.15f },
+    { 0.0f, 0.0f }, { 0.4f, -0.7f }, { 0.0f, 0.0f }, { 0.0f, -0.4f },
+    { 0.0f, 0.0f }, { -0.4f, -0.7f }, { 0.0f, 0.0f }, { -0.25f, -0.15f },
+    { 0.0f, 0.0f }, { -0.7f, 0.4f }
+  };
+  static const float list[27][2] = {
+    { 0.0f, 0.8f }, { 0.2f, 0.4f }, { -0.2f, 0.4f },
+    { -0.7f, 0.4f }, { -0.2f, 0.4f }, { -0.25f, -0.15f },
+    { -0.2f, 0.4f }, { 0.2f, 0.4f }, { -0.25f, -0.15f },
+    { -0.25f, -0.15f }, { 0.2f, 0.4f }, { 0.25f, -0.15f },
+    { 0.2f, 0.4f }, { 0.7f, 0.4f }, { 0.25f, -0.15f },
+    { -0.25f, -0.15f }, { 0.0f, -0.15f }, { 0.0f, -0.4f },
+    { 0.0f, -0.15f }, { 0.25f, -0.15f }, { 0.0f, -0.4f },
+    { 0.0f, -0.4f }, { 0.25f, -0.15f }, { 0.4f, -0.7f },
+    { 0.0f, -0.4f }, { -0.4f, -0.7f }, { -0.25f, -0.15f }
+  };
+
+  reportStar("lab1 star fan", fan, 12, PRIMITIVE_TRIANGLE_FAN);
+  reportStar("lab1 star fan 4-ray", fan4, 10, PRIMITIVE_TRIANGLE_FAN);
+  reportStar("lab1 star fan 6-ray", fan6, 9, PRIMITIVE_TRIANGLE_FAN);
+  reportStar("lab1 star strip", strip, 22, PRIMITIVE_TRIANGLE_STRIP);
+  reportStar("lab1 star list", list, 27, PRIMITIVE_TRIANGLE_LIST);
+}
+
+/* cgfx_bumpdemo's flat patch: a strip per ring over a shared grid. */
+static void reportFlatPatch(int sides, int rings)
+{
+  std::vector<float> grid;
+  Indices list, ring;
+  char mesh[64];
+
+  for (int i = 0; i <= rings; i++)
+    for (int j = 0; j <= sides; j++) {
+      grid.push_back((float) i / rings);
+      grid.push_back((float) j / sides);
+      grid.push_back(0);
+    }
+  for (int i = 0; i < rings; i++) {
+    size_t n = list.size();
+
+    ring.clear();
+    for (int j = 0; j <= sides; j++) {
+      ring.push_back(i * (sides + 1) + j);
+      ring.push_back((i + 1) * (sides + 1) + j);
+    }
+    list.resize(n + 3 * ring.size());
+    list.resize(n + listTriangles(&list[n], PRIMITIVE_TRIANGLE_STRIP,
+                                  &ring[0], (int) ring.size()));
+  }
+  sprintf(mesh, "flat patch %dx%d", sides, rings);
+  reportMesh(mesh, list, &grid[0], 3, (int) grid.size() / 3, 12);
+}
+
+static void reportSphere(int slices, int stacks)
+{
+  Indices list(getSphereIndexCount(slices, stacks));
+  std::vector<float> xyz(3 * getSphereVertexCount(slices, stacks));
+  char mesh[64];
+
+  makeSphere(&xyz[0], &list[0], 1, slices, stacks);
+  sprintf(mesh, "makeSphere %dx%d", slices, stacks);
+  reportMesh(mesh, list, &xyz[0], 3, (int) xyz.size() / 3, 12);
+}
+
+static void reportTorus(int uSteps, int vSteps, bool shuffle)
+{
+  TorusSurface torus = { 6, 2 };
+  ParametricSurface surface = { evaluateTorusSurface, &torus, sizeof(torus) };
+  SurfaceMesh m;
+  char mesh[64];
+  const int stride = sizeof(SurfaceVertex) / sizeof(float);
+
+  tessellateSurface(&m, &surface, uSteps, vSteps, SURFACE_TRIANGLE_LIST);
+  Indices list(m.indices, m.indices + m.indexCount);
+  if (shuffle) {
+    unsigned int seed = 7;
+
+    for (int t = (int) list.size() / 3 - 1; t > 0; t--) {
+      int r = (int) benchRandom(&seed, 0, (float) (t + 1));
+
+      for (int k = 0; k < 3; k++)
+        std::swap(list[3*t + k], list[3*r + k]);
+    }
+  }
+  sprintf(mesh, "torus %dx%d%s", uSteps, vSteps, shuffle ? " shuffled" : "");
+  reportMesh(mesh, list, m.vertices[0].position, stride, m.vertexCount,
+             (int) sizeof(SurfaceVertex));
+  freeSurfaceMesh(&m);
+}
+
+static void reportSubdivided(int depth)
+{
+  static const float a[2] = { -0.8f, 0.8f }, b[2] = { 0.8f, 0.8f }, c[2] = { 0.0f, -0.8f },
+                     color[3] = { 1, 1, 1 };
+  std::vector<SubdividedVertex> vertices(getSubdividedVertexCount(depth));
+  Indices list(3 * getSubdividedTriangleCount(depth));
+  char mesh[64];
+
+  subdivideTriangle(&vertices[0], &list[0], depth, a, b, c, color, color, color);
+  sprintf(mesh, "subdivided depth %d", depth);
+  reportMesh(mesh, list, &vertices[0].x, (int) (sizeof(SubdividedVertex) / sizeof(float)),
+             (int) vertices.size(), (int) sizeof(SubdividedVertex));
+}
+
+static void reportObj(const char *path)
+{
+  const char *name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+  ObjModel m;
+
+  if (!readObj(path, m)) {
+    fprintf(stderr, "vcache_report: cannot open %s\n", path);
+    return;
+  }
+  reportMesh(name, m.indices, m.vertices[0].position,
+             (int) (sizeof(MeshVertex) / sizeof(float)), (int) m.vertices.size(),
+             (int) sizeof(MeshVertex));
+}
+
+int main(int argc, char **argv)
+{
+  static const char *defaults[] = {
+    "../../../Labs/Lab5/model_for_cga.obj",
+    "../../../Labs/Lab6/retopoly.obj"
+  };
+  int first = 1;
+
+  if (argc > 2 && strcmp(argv[1], "-cache") == 0) {
+    myCacheSize = atoi(argv[2]);
+    first = 3;
+  }
+  if (myCacheSize < 1) {
+    fprintf(stderr, "usage: vcache_report [-cache N] [file.obj ...]\n");
+    return 1;
+  }
+  printf("%d-entry post-transform cache; fetches through 16 KB of 64-byte lines; "
+         "overdraw from 6 views\n\n", myCacheSize);
+  printHeader();
+
+  reportStars();
+  reportFlatPatch(20, 40);
+  reportSphere(80, 80);
+  reportTorus(40, 20, false);
+  reportTorus(256, 256, false);
+  reportTorus(256, 256, true);
+  reportSubdivided(6);
+  if (argc > first) {
+    for (int i = first; i < argc; i++)
+      reportObj(argv[i]);
+  } else {
+    for (int i = 0; i < (int) (sizeof(defaults) / sizeof(defaults[0])); i++)
+      reportObj(defaults[i]);
+  }
+  return 0;
+}
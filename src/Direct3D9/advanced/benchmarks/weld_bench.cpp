@@ -0,0 +1,305 @@
+/* weld_bench.cpp - buildObjMesh's hash welding and ear clipping (objmesh.h) against std::map and sorting.
+
+   Usage: weld_bench [-mb N] [file.obj ...]
+
+   For each OBJ file (without arguments, Lab5's model_for_cga.obj and
+   Lab6's retopoly.obj) and a synthetic OBJ of about N megabytes (20 by
+   default; see writeSyntheticObj in objmodel.h), parses it once with
+   readObjFile and turns its polygons into welded vertices and a
+   triangle list three ways:
+
+     map     a std::map from v/vt/vn to vertex, and fans
+     sort    corners sorted by v/vt/vn, and fans
+     hash    buildObjMesh: an open-addressing hash table, and
+             triangulatePolygon
+
+   reporting faces by size, the dedup ratio (corners per vertex), and
+   millions of corners welded per second.  All three must find the same
+   vertices in the same order.
+
+   Last, star-shaped polygons of 5 to 40 corners, half their corners
+   pushed inward, are cut by triangulatePolygon and by a fan from
+   corner 0: the ear clipper's triangles must all face the polygon's
+   way and cover exactly its area, where the fan's fold over and spill
+   out. */
+
+#include <algorithm>
+#include <map>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "bench.h"
+#include "objmodel.h"
+#include "../cgfx_buffer_lighting/objfile.h"
+#include "../cgfx_buffer_lighting/objmesh.h"
+
+static const char *mySyntheticPath = "weld_bench_synthetic.obj";
+
+/* The welded vertices and triangles of one way. */
+typedef struct {
+  std::vector<MeshVertex> vertices;
+  std::vector<unsigned int> indices;
+} Welded;
+
+typedef struct {
+  int v, vt, vn;
+} CornerKey;
+
+static bool operator<(const CornerKey &a, const CornerKey &b)
+{
+  return a.v != b.v ? a.v < b.v : a.vt != b.vt ? a.vt < b.vt : a.vn < b.vn;
+}
+
+static CornerKey getKey(const ObjFile &obj, int c)
+{
+  CornerKey key = { obj.positionIndices[c], obj.texCoordIndices[c], obj.normalIndices[c] };
+
+  return key;
+}
+
+static MeshVertex getVertex(const ObjFile &obj, int c)
+{
+  MeshVertex m;
+
+  memset(&m, 0, sizeof(m));
+  memcpy(m.position, &obj.positions[3 * (size_t) obj.positionIndices[c]], sizeof(m.position));
+  if (obj.texCoordIndices[c] >= 0)
+    memcpy(m.texCoord, &obj.texCoords[2 * (size_t) obj.texCoordIndices[c]], sizeof(m.texCoord));
+  if (obj.normalIndices[c] >= 0)
+    memcpy(m.normal, &obj.normals[3 * (size_t) obj.normalIndices[c]], sizeof(m.normal));
+  return m;
+}
+
+/* Fans over vertexOf (range-relative vertices per corner) for range r. */
+static void addFans(Welded &w, const ObjFile &obj, const ObjRange &r, const int *vertexOf)
+{
+  for (int f = r.firstFace; f < r.firstFace + r.faceCount; f++)
+    for (int c = obj.faceStarts[f] + 2; c < obj.faceStarts[f+1]; c++) {
+      w.indices.push_back(vertexOf[obj.faceStarts[f]]);
+      w.indices.push_back(vertexOf[c-1]);
+      w.indices.push_back(vertexOf[c]);
+    }
+}
+
+static void weldWithMap(Welded &w, const ObjFile &obj)
+{
+  std::vector<int> vertexOf(obj.cornerCount);
+
+  for (int r = 0; r < obj.rangeCount; r++) {
+    const ObjRange &range = obj.ranges[r];
+    int first = obj.faceStarts[range.firstFace];
+    int last = obj.faceStarts[range.firstFace + range.faceCount];
+    int start = (int) w.vertices.size();
+    std::map<CornerKey, int> welded;
+
+    for (int c = first; c < last; c++) {
+      std::pair<std::map<CornerKey, int>::iterator, bool> in =
+        welded.insert(std::make_pair(getKey(obj, c), (int) w.vertices.size() - start));
+
+      if (in.second)
+        w.vertices.push_back(getVertex(obj, c));
+      vertexOf[c] = in.first->second;
+    }
+    addFans(w, obj, range, &vertexOf[0]);
+  }
+}
+
+struct SortOrder {
+  const ObjFile *obj;
+
+  bool operator()(int a, int b) const
+  {
+    CornerKey ka = getKey(*obj, a), kb = getKey(*obj, b);
+
+    return ka < kb || (!(kb < ka) && a < b);
+  }
+};
+
+static void weldWithSort(Welded &w, const ObjFile &obj)
+{
+  std::vector<int> vertexOf(obj.cornerCount), order;
+  SortOrder less = { &obj };
+
+  for (int r = 0; r < obj.rangeCount; r++) {
+    const ObjRange &range = obj.ranges[r];
+    int first = obj.faceStarts[range.firstFace];
+    int last = obj.faceStarts[range.firstFace + range.faceCount];
+    int start = (int) w.vertices.size();
+
+    order.resize(last - first);
+    for (int c = first; c < last; c++)
+      order[c - first] = c;
+    std::sort(order.begin(), order.end(), less);
+    /* The first corner of each run of equals, c, stands for the run:
+       its corners hold -1 - c until c gets a vertex. */
+    for (size_t k = 0; k < order.size(); k++)
+      vertexOf[order[k]] = k > 0 && !(getKey(obj, order[k-1]) < getKey(obj, order[k])) ?
+                           vertexOf[order[k-1]] : -1 - order[k];
+    for (int c = first; c < last; c++) {
+      if (vertexOf[c] == -1 - c) {
+        vertexOf[c] = (int) w.vertices.size() - start;
+        w.vertices.push_back(getVertex(obj, c));
+      } else {
+        vertexOf[c] = vertexOf[-1 - vertexOf[c]];
+      }
+    }
+    addFans(w, obj, range, &vertexOf[0]);
+  }
+}
+
+static void reportFile(const char *path)
+{
+  const char *name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+  int sizes[4] = { 0, 0, 0, 0 };   /* 3, 4, 5 to 8, more */
+  Welded byMap, bySort;
+  ObjMesh mesh;
+  ObjFile obj;
+  double corners, times[3];
+  int otherCuts = 0;
+  bool same;
+
+  if (!readObjFile(path, &obj)) {
+    fprintf(stderr, "weld_bench: cannot parse %s\n", path);
+    return;
+  }
+  for (int f = 0; f < obj.faceCount; f++) {
+    int n = obj.faceStarts[f+1] - obj.faceStarts[f];
+
+    if (n >= 3)
+      sizes[n == 3 ? 0 : n == 4 ? 1 : n <= 8 ? 2 : 3]++;
+  }
+  weldWithMap(byMap, obj);
+  weldWithSort(bySort, obj);
+  buildObjMesh(&mesh, &obj);
+  corners = obj.cornerCount;
+
+  times[0] = benchBest([&] {
+    Welded w;
+
+    weldWithMap(w, obj);
+    benchKeep(w.indices.size());
+  }, 0.25);
+  times[1] = benchBest([&] {
+    Welded w;
+
+    weldWithSort(w, obj);
+    benchKeep(w.indices.size());
+  }, 0.25);
+  times[2] = benchBest([&] {
+    ObjMesh m;
+
+    buildObjMesh(&m, &obj);
+    benchKeep(m.indexCount);
+    freeObjMesh(&m);
+  }, 0.25);
+
+  same = byMap.vertices.size() == (size_t) mesh.vertexCount &&
+         bySort.vertices.size() == (size_t) mesh.vertexCount &&
+         bySort.indices == byMap.indices &&
+         memcmp(&byMap.vertices[0], mesh.vertices, mesh.vertexCount * sizeof(MeshVertex)) == 0 &&
+         memcmp(&bySort.vertices[0], mesh.vertices, mesh.vertexCount * sizeof(MeshVertex)) == 0;
+  for (int i = 0; i < mesh.indexCount && i < (int) byMap.indices.size(); i++)
+    otherCuts += mesh.indices[i] != byMap.indices[i];
+  printf("%s: %d faces (%d triangles, %d quads, %d of 5-8 corners, %d larger), %d corners\n",
+    name, obj.faceCount, sizes[0], sizes[1], sizes[2], sizes[3], obj.cornerCount);
+  printf("  %d vertices: %.2f corners per vertex, %.1f%% of corners kept; %d triangles\n",
+    mesh.vertexCount, corners / mesh.vertexCount, 100.0 * mesh.vertexCount / corners,
+    mesh.indexCount / 3);
+  printf("  %-6s %10.3f ms %9.1f M corners/s\n", "map", times[0] * 1e3, corners / times[0] * 1e-6);
+  printf("  %-6s %10.3f ms %9.1f M corners/s %6.1fx\n", "sort", times[1] * 1e3,
+    corners / times[1] * 1e-6, times[0] / times[1]);
+  printf("  %-6s %10.3f ms %9.1f M corners/s %6.1fx\n", "hash", times[2] * 1e3,
+    corners / times[2] * 1e-6, times[0] / times[2]);
+  printf("  vertices %s; %d indices differ from fans\n\n", same ? "match" : "DIFFER",
+    otherCuts);
+  freeObjMesh(&mesh);
+  freeObjFile(&obj);
+}
+
+/* Signed area of 2D triangle a, b, c (x, y of 3-float points). */
+static double area2(const float *a, const float *b, const float *c)
+{
+  return 0.5 * (((double) b[0] - a[0]) * ((double) c[1] - a[1]) -
+                ((double) b[1] - a[1]) * ((double) c[0] - a[0]));
+}
+
+static void reportStars(void)
+{
+  unsigned int seed = 7;
+  int polygons = 0, clipFlipped = 0, fanFlipped = 0, clipWrongArea = 0, fanWrongArea = 0;
+  double clipTime = 0;
+
+  for (int n = 5; n <= 40; n++)
+    for (int trial = 0; trial < 50; trial++, polygons++) {
+      std::vector<float> points(3 * n);
+      std::vector<int> triangles(3 * (n - 2));
+      double area = 0, clipArea = 0, fanArea = 0, t0;
+      int count;
+
+      /* Counterclockwise in x, y, every other corner pulled in, and
+         the whole star tilted out of the plane. */
+      for (int i = 0; i < n; i++) {
+        float angle = 6.2831853f * i / n, r = i % 2 ? benchRandom(&seed, 0.2f, 0.6f) : 1;
+
+        points[3*i] = r * cosf(angle);
+        points[3*i + 1] = r * sinf(angle);
+        points[3*i + 2] = 0.3f * points[3*i];
+      }
+      for (int i = 1; i + 1 < n; i++)
+        area += area2(&points[0], &points[3*i], &points[3*i + 3]);
+      t0 = benchNow();
+      count = triangulatePolygon(&triangles[0], &points[0], n);
+      clipTime += benchNow() - t0;
+      for (int k = 0; k < count; k++) {
+        double a = area2(&points[3 * triangles[3*k]], &points[3 * triangles[3*k + 1]],
+                         &points[3 * triangles[3*k + 2]]);
+
+        clipFlipped += a < 0;
+        clipArea += fabs(a);
+      }
+      for (int i = 1; i + 1 < n; i++) {
+        double a = area2(&points[0], &points[3*i], &points[3*i + 3]);
+
+        fanFlipped += a < 0;
+        fanArea += fabs(a);
+      }
+      clipWrongArea += count != n - 2 || fabs(clipArea - area) > 1e-5 * area;
+      fanWrongArea += fabs(fanArea - area) > 1e-5 * area;
+    }
+  printf("star polygons of 5-40 corners: %d\n", polygons);
+  printf("  ear clipping: %d flipped triangles, %d polygons with the wrong area, %.2f us each\n",
+    clipFlipped, clipWrongArea, clipTime / polygons * 1e6);
+  printf("  fan:          %d flipped triangles, %d polygons with the wrong area\n",
+    fanFlipped, fanWrongArea);
+}
+
+int main(int argc, char **argv)
+{
+  static const char *defaults[] = {
+    "../../../Labs/Lab5/model_for_cga.obj",
+    "../../../Labs/Lab6/retopoly.obj"
+  };
+  int megabytes = 20, files = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-mb") == 0 && i + 1 < argc)
+      megabytes = atoi(argv[++i]);
+    else
+      reportFile(argv[i]), files++;
+  }
+  if (files == 0)
+    for (int i = 0; i < (int) (sizeof(defaults) / sizeof(defaults[0])); i++)
+      reportFile(defaults[i]);
+  if (megabytes > 0) {
+    if (!writeSyntheticObj(mySyntheticPath, megabytes)) {
+      fprintf(stderr, "weld_bench: cannot write %s\n", mySyntheticPath);
+      return 1;
+    }
+    reportFile(mySyntheticPath);
+    remove(mySyntheticPath);
+  }
+  reportStars();
+  return 0;
+}
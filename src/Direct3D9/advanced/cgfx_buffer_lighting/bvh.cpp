@@ -0,0 +1,834 @@
+/* bvh.c - SAH-binned bounding volume hierarchy with single-ray and 8-ray packet traversal. */
+
+/* The builder works on a permutation of the triangle numbers, sorting
+   each node's range in place into its two children's.  Ranges above a
+   size that depends only on the triangle count are split on the calling
+   thread; the rest become tasks, each building its subtree into its own
+   node array, which are dealt out to the threads largest first and then
+   appended in task order.
+
+   Traversal tests both children of an inner node, goes on with the
+   nearer one, and stacks the other with its entry distance, so a stacked
+   subtree is dropped once a closer hit has been found.  Stacks hold
+   BVH_MAX_DEPTH nodes: the builder makes a leaf of anything at that
+   depth. */
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "bvh.h"
+#include "matrix.h"
+#include "matrix_simd.h"
+#include "parallel.h"
+
+/* SAH costs of a node visit and a triangle test. */
+static const float myTraversalCost = 1.0f;
+static const float myTriangleCost = 1.0f;
+
+/* Leaves hold at most this many triangles even when the SAH would keep more. */
+static const int myMaxLeafTriangles = 16;
+
+/* Ranges of at most this many triangles (or a 128th of the mesh, if more)
+   are built as separate tasks. */
+static const int myMinTaskTriangles = 4096;
+
+static const int myTrianglesMinPerThread = 16384;
+static const int myRaysMinPerThread = 256;
+
+typedef struct {
+  float lo[3], hi[3];
+} BvhBox;
+
+static void emptyBox(BvhBox *b)
+{
+  for (int k = 0; k < 3; k++) {
+    b->lo[k] = FLT_MAX;
+    b->hi[k] = -FLT_MAX;
+  }
+}
+
+static void growBox(BvhBox *b, const BvhBox *c)
+{
+  for (int k = 0; k < 3; k++) {
+    b->lo[k] = std::min(b->lo[k], c->lo[k]);
+    b->hi[k] = std::max(b->hi[k], c->hi[k]);
+  }
+}
+
+static void growBoxPoint(BvhBox *b, const float *p)
+{
+  for (int k = 0; k < 3; k++) {
+    b->lo[k] = std::min(b->lo[k], p[k]);
+    b->hi[k] = std::max(b->hi[k], p[k]);
+  }
+}
+
+/* Half the surface area; 0 for an empty box. */
+static float boxArea(const BvhBox *b)
+{
+  float dx = b->hi[0] - b->lo[0], dy = b->hi[1] - b->lo[1], dz = b->hi[2] - b->lo[2];
+
+  if (dx < 0 || dy < 0 || dz < 0)
+    return 0;
+  return dx*dy + dy*dz + dz*dx;
+}
+
+typedef struct {
+  const BvhBox *bounds;        /* Per mesh triangle */
+  const float *centroids;      /* 3 per mesh triangle */
+  unsigned int *order;         /* Triangle numbers, sorted into leaf order */
+} Builder;
+
+typedef struct {
+  int node, first, count, depth;
+} BuildRange;
+
+static void setNodeBounds(BvhNode *node, const BvhBox *b)
+{
+  memcpy(node->boundsMin, b->lo, sizeof(b->lo));
+  memcpy(node->boundsMax, b->hi, sizeof(b->hi));
+}
+
+static int centroidBin(float c, float lo, float scale)
+{
+  int bin = (int) ((c - lo) * scale);
+
+  return bin < 0 ? 0 : bin >= BVH_BINS ? BVH_BINS - 1 : bin;
+}
+
+/* Bound the triangles order[first..first+count) into node, and sort them
+   into the two halves of the best split.  Returns the left half's size,
+   or 0 to keep the node as a leaf. */
+static int splitRange(const Builder *b, BvhNode *node, int first, int count, int depth)
+{
+  unsigned int *order = b->order + first;
+  BvhBox bounds, centroidBounds, binBounds[3][BVH_BINS], left;
+  int binCount[3][BVH_BINS], i, k, axis = -1, split = 0, leftCount;
+  float area, scale[3], rightArea[BVH_BINS], bestCost;
+
+  emptyBox(&bounds);
+  emptyBox(&centroidBounds);
+  for (i = 0; i < count; i++) {
+    growBox(&bounds, &b->bounds[order[i]]);
+    growBoxPoint(&centroidBounds, &b->centroids[3 * order[i]]);
+  }
+  setNodeBounds(node, &bounds);
+  if (count <= 1 || depth >= BVH_MAX_DEPTH - 1)
+    return 0;
+
+  for (k = 0; k < 3; k++) {
+    float extent = centroidBounds.hi[k] - centroidBounds.lo[k];
+
+    scale[k] = extent > 0 ? BVH_BINS / extent : 0;
+    for (i = 0; i < BVH_BINS; i++) {
+      binCount[k][i] = 0;
+      emptyBox(&binBounds[k][i]);
+    }
+  }
+  for (i = 0; i < count; i++) {
+    const float *c = &b->centroids[3 * order[i]];
+
+    for (k = 0; k < 3; k++) {
+      int bin = centroidBin(c[k], centroidBounds.lo[k], scale[k]);
+
+      binCount[k][bin]++;
+      growBox(&binBounds[k][bin], &b->bounds[order[i]]);
+    }
+  }
+
+  /* Cost of splitting after bin i: the children's areas times their
+     triangles, relative to this node's area. */
+  area = boxArea(&bounds);
+  bestCost = FLT_MAX;
+  for (k = 0; k < 3; k++) {
+    BvhBox right;
+    int rightCount = 0;
+
+    if (scale[k] == 0)
+      continue;
+    emptyBox(&right);
+    for (i = BVH_BINS - 1; i > 0; i--) {
+      growBox(&right, &binBounds[k][i]);
+      rightCount += binCount[k][i];
+      rightArea[i] = boxArea(&right) * rightCount;
+    }
+    emptyBox(&left);
+    leftCount = 0;
+    for (i = 0; i < BVH_BINS - 1; i++) {
+      float cost;
+
+      growBox(&left, &binBounds[k][i]);
+      leftCount += binCount[k][i];
+      cost = boxArea(&left) * leftCount + rightArea[i + 1];
+      if (leftCount > 0 && leftCount < count && cost < bestCost) {
+        bestCost = cost;
+        axis = k;
+        split = i + 1;
+      }
+    }
+  }
+
+  if (axis < 0) {
+    /* All centroids coincide: halve the range if it is too big for a leaf. */
+    return count > myMaxLeafTriangles ? count / 2 : 0;
+  }
+  bestCost = myTraversalCost + myTriangleCost * bestCost / (area > 0 ? area : 1);
+  if (bestCost >= myTriangleCost * count && count <= myMaxLeafTriangles)
+    return 0;
+
+  leftCount = 0;
+  for (i = 0; i < count; i++)
+    if (centroidBin(b->centroids[3 * order[i] + axis], centroidBounds.lo[axis], scale[axis]) < split)
+      std::swap(order[i], order[leftCount++]);
+  return leftCount;
+}
+
+/* Build the subtree over order[first..first+count) into nodes, whose
+   element root is already allocated. */
+static void buildSubtree(const Builder *b, std::vector<BvhNode> &nodes,
+                         int root, int first, int count, int depth)
+{
+  BuildRange stack[BVH_MAX_DEPTH];
+  int sp = 0;
+
+  stack[sp].node = root;
+  stack[sp].first = first;
+  stack[sp].count = count;
+  stack[sp++].depth = depth;
+  while (sp > 0) {
+    BuildRange r = stack[--sp];
+    BvhNode node;
+    int leftCount = splitRange(b, &node, r.first, r.count, r.depth);
+
+    if (leftCount == 0) {
+      node.leftFirst = (unsigned int) r.first;
+      node.count = (unsigned int) r.count;
+      nodes[r.node] = node;
+      continue;
+    }
+    node.leftFirst = (unsigned int) nodes.size();
+    node.count = 0;
+    nodes[r.node] = node;
+    nodes.resize(nodes.size() + 2);
+
+    /* Left on top, so the nodes come out depth first. */
+    stack[sp].node = (int) node.leftFirst + 1;
+    stack[sp].first = r.first + leftCount;
+    stack[sp].count = r.count - leftCount;
+    stack[sp++].depth = r.depth + 1;
+    stack[sp].node = (int) node.leftFirst;
+    stack[sp].first = r.first;
+    stack[sp].count = leftCount;
+    stack[sp++].depth = r.depth + 1;
+  }
+}
+
+struct TriangleBoundsTask
+{
+  const float *positions;
+  int stride;
+  const unsigned int *indices;
+  BvhBox *bounds;
+  float *centroids;
+
+  void operator()(int begin, int end) const
+  {
+    for (int t = begin; t < end; t++) {
+      BvhBox *box = &bounds[t];
+
+      emptyBox(box);
+      for (int j = 0; j < 3; j++)
+        growBoxPoint(box, positions + (size_t) indices[3*t + j] * stride);
+      for (int k = 0; k < 3; k++)
+        centroids[3*t + k] = 0.5f * (box->lo[k] + box->hi[k]);
+    }
+  }
+};
+
+struct SubtreeTask
+{
+  const Builder *b;
+  const std::vector<BuildRange> *ranges;     /* Largest first */
+  std::vector<BvhNode> *subtrees;
+  int slots;
+
+  void operator()(int begin, int end) const
+  {
+    for (int slot = begin; slot < end; slot++)
+      for (int i = slot; i < (int) ranges->size(); i += slots) {
+        const BuildRange &r = (*ranges)[i];
+
+        subtrees[i].resize(1);
+        buildSubtree(b, subtrees[i], 0, r.first, r.count, r.depth);
+      }
+  }
+};
+
+static bool largerRange(const BuildRange &a, const BuildRange &b)
+{
+  return a.count != b.count ? a.count > b.count : a.first < b.first;
+}
+
+struct LeafTrianglesTask
+{
+  const float *positions;
+  int stride;
+  const unsigned int *indices;
+  const unsigned int *order;
+  BvhTriangle *triangles;
+
+  void operator()(int begin, int end) const
+  {
+    for (int i = begin; i < end; i++) {
+      const unsigned int *t = indices + 3 * (size_t) order[i];
+      const float *p0 = positions + (size_t) t[0] * stride,
+                  *p1 = positions + (size_t) t[1] * stride,
+                  *p2 = positions + (size_t) t[2] * stride;
+
+      for (int k = 0; k < 3; k++) {
+        triangles[i].corner[k] = p0[k];
+        triangles[i].edge1[k] = p1[k] - p0[k];
+        triangles[i].edge2[k] = p2[k] - p0[k];
+      }
+    }
+  }
+};
+
+int buildBvh(Bvh *bvh, const float *positions, int stride,
+             const unsigned int *indices, int indexCount)
+{
+  const int triangleCount = indexCount / 3;
+  std::vector<BvhBox> bounds(triangleCount);
+  std::vector<float> centroids(3 * triangleCount);
+  std::vector<unsigned int> order(triangleCount);
+  std::vector<BvhNode> nodes;
+  std::vector<BuildRange> serial, tasks;
+  std::vector<std::vector<BvhNode> > subtrees;
+  TriangleBoundsTask boundsTask;
+  SubtreeTask subtreeTask;
+  LeafTrianglesTask leafTask;
+  Builder b;
+  int taskSize, i;
+
+  memset(bvh, 0, sizeof(*bvh));
+  if (triangleCount <= 0)
+    return 0;
+
+  boundsTask.positions = positions;
+  boundsTask.stride = stride;
+  boundsTask.indices = indices;
+  boundsTask.bounds = &bounds[0];
+  boundsTask.centroids = &centroids[0];
+  parallelFor(triangleCount, myTrianglesMinPerThread, 1, boundsTask);
+  for (i = 0; i < triangleCount; i++)
+    order[i] = (unsigned int) i;
+  b.bounds = &bounds[0];
+  b.centroids = &centroids[0];
+  b.order = &order[0];
+
+  /* Split the top of the tree here until the ranges are task sized. */
+  taskSize = std::max(myMinTaskTriangles, triangleCount / 128);
+  nodes.reserve(2 * (size_t) triangleCount);
+  nodes.resize(1);
+  serial.resize(1);
+  serial[0].node = 0;
+  serial[0].first = 0;
+  serial[0].count = triangleCount;
+  serial[0].depth = 0;
+  while (!serial.empty()) {
+    BuildRange r = serial.back(), child;
+    BvhNode node;
+    int leftCount;
+
+    serial.pop_back();
+    if (r.count <= taskSize) {
+      tasks.push_back(r);
+      continue;
+    }
+    leftCount = splitRange(&b, &node, r.first, r.count, r.depth);
+    if (leftCount == 0) {
+      node.leftFirst = (unsigned int) r.first;
+      node.count = (unsigned int) r.count;
+      nodes[r.node] = node;
+      continue;
+    }
+    node.leftFirst = (unsigned int) nodes.size();
+    node.count = 0;
+    nodes[r.node] = node;
+    nodes.resize(nodes.size() + 2);
+    child.depth = r.depth + 1;
+    child.node = (int) node.leftFirst + 1;
+    child.first = r.first + leftCount;
+    child.count = r.count - leftCount;
+    serial.push_back(child);
+    child.node = (int) node.leftFirst;
+    child.first = r.first;
+    child.count = leftCount;
+    serial.push_back(child);
+  }
+
+  std::sort(tasks.begin(), tasks.end(), largerRange);
+  subtrees.resize(tasks.size());
+  subtreeTask.b = &b;
+  subtreeTask.ranges = &tasks;
+  subtreeTask.subtrees = tasks.empty() ? NULL : &subtrees[0];
+  subtreeTask.slots = std::min(getParallelThreadCount(), (int) tasks.size());
+  if (!tasks.empty())
+    parallelFor(subtreeTask.slots, 1, 1, subtreeTask);
+
+  /* Each subtree's root replaces its placeholder and the rest go on the
+     end, with their child links moved along. */
+  for (i = 0; i < (int) tasks.size(); i++) {
+    std::vector<BvhNode> &sub = subtrees[i];
+    unsigned int base = (unsigned int) nodes.size() - 1;
+
+    for (size_t j = 0; j < sub.size(); j++)
+      if (sub[j].count == 0)
+        sub[j].leftFirst += base;
+    nodes[tasks[i].node] = sub[0];
+    nodes.insert(nodes.end(), sub.begin() + 1, sub.end());
+    std::vector<BvhNode>().swap(sub);
+  }
+
+  bvh->nodeCount = (int) nodes.size();
+  bvh->nodes = new BvhNode[nodes.size()];
+  memcpy(bvh->nodes, &nodes[0], nodes.size() * sizeof(BvhNode));
+  bvh->triangleCount = triangleCount;
+  bvh->triangles = new BvhTriangle[triangleCount];
+  bvh->original = new unsigned int[triangleCount];
+  memcpy(bvh->original, &order[0], triangleCount * sizeof(unsigned int));
+  leafTask.positions = positions;
+  leafTask.stride = stride;
+  leafTask.indices = indices;
+  leafTask.order = &order[0];
+  leafTask.triangles = bvh->triangles;
+  parallelFor(triangleCount, myTrianglesMinPerThread, 1, leafTask);
+  return 1;
+}
+
+void freeBvh(Bvh *bvh)
+{
+  delete [] bvh->nodes;
+  delete [] bvh->triangles;
+  delete [] bvh->original;
+  memset(bvh, 0, sizeof(*bvh));
+}
+
+static float nodeArea(const BvhNode *n)
+{
+  BvhBox b;
+
+  memcpy(b.lo, n->boundsMin, sizeof(b.lo));
+  memcpy(b.hi, n->boundsMax, sizeof(b.hi));
+  return boxArea(&b);
+}
+
+double getBvhCost(const Bvh *bvh)
+{
+  double cost = 0, rootArea;
+
+  if (bvh->nodeCount == 0)
+    return 0;
+  rootArea = nodeArea(&bvh->nodes[0]);
+  if (rootArea <= 0)
+    rootArea = 1;
+  for (int i = 0; i < bvh->nodeCount; i++) {
+    const BvhNode *n = &bvh->nodes[i];
+
+    cost += nodeArea(n) / rootArea *
+            (n->count == 0 ? myTraversalCost : myTriangleCost * n->count);
+  }
+  return cost;
+}
+
+/* Single rays */
+
+typedef struct {
+  float origin[3], inverse[3];
+} RayBoxSetup;
+
+static void setupRay(RayBoxSetup *s, const BvhRay *ray)
+{
+  for (int k = 0; k < 3; k++) {
+    s->origin[k] = ray->origin[k];
+    s->inverse[k] = 1.0f / ray->direction[k];
+  }
+}
+
+/* Entry distance into n's box within (tMin, tMax), or FLT_MAX for a miss. */
+static float enterBox(const BvhNode *n, const RayBoxSetup *s, float tMin, float tMax)
+{
+  float tNear = tMin, tFar = tMax;
+
+  for (int k = 0; k < 3; k++) {
+    float t0 = (n->boundsMin[k] - s->origin[k]) * s->inverse[k],
+          t1 = (n->boundsMax[k] - s->origin[k]) * s->inverse[k];
+
+    tNear = std::max(tNear, std::min(t0, t1));
+    tFar = std::min(tFar, std::max(t0, t1));
+  }
+  return tNear <= tFar ? tNear : FLT_MAX;
+}
+
+/* Moller-Trumbore: whether ray hits t within (tMin, *t), updating *t, *u, *v. */
+static int hitTriangle(const BvhTriangle *tri, const BvhRay *ray, float tMin,
+                       float *t, float *u, float *v)
+{
+  const float *d = ray->direction, *e1 = tri->edge1, *e2 = tri->edge2;
+  float p[3], s[3], q[3], det, inv, a, b, c;
+
+  p[0] = d[1]*e2[2] - d[2]*e2[1];
+  p[1] = d[2]*e2[0] - d[0]*e2[2];
+  p[2] = d[0]*e2[1] - d[1]*e2[0];
+  det = e1[0]*p[0] + e1[1]*p[1] + e1[2]*p[2];
+  if (det == 0)
+    return 0;
+  inv = 1.0f / det;
+  s[0] = ray->origin[0] - tri->corner[0];
+  s[1] = ray->origin[1] - tri->corner[1];
+  s[2] = ray->origin[2] - tri->corner[2];
+  a = (s[0]*p[0] + s[1]*p[1] + s[2]*p[2]) * inv;
+  if (a < 0 || a > 1)
+    return 0;
+  q[0] = s[1]*e1[2] - s[2]*e1[1];
+  q[1] = s[2]*e1[0] - s[0]*e1[2];
+  q[2] = s[0]*e1[1] - s[1]*e1[0];
+  b = (d[0]*q[0] + d[1]*q[1] + d[2]*q[2]) * inv;
+  if (b < 0 || a + b > 1)
+    return 0;
+  c = (e2[0]*q[0] + e2[1]*q[1] + e2[2]*q[2]) * inv;
+  if (!(c > tMin && c < *t))
+    return 0;
+  *t = c;
+  *u = a;
+  *v = b;
+  return 1;
+}
+
+/* Trace one ray; with anyHit, stop at the first hit found.  Returns the
+   hit triangle in leaf order, or -1. */
+static int traceRay(const Bvh *bvh, const BvhRay *ray, int anyHit, float *t, float *u, float *v)
+{
+  const BvhNode *nodes = bvh->nodes;
+  const BvhNode *stack[BVH_MAX_DEPTH];
+  float stackNear[BVH_MAX_DEPTH];
+  const BvhNode *n = nodes;
+  RayBoxSetup s;
+  int sp = 0, found = -1;
+
+  *t = ray->tMax;
+  setupRay(&s, ray);
+  if (enterBox(n, &s, ray->tMin, *t) == FLT_MAX)
+    return -1;
+  for (;;) {
+    if (n->count > 0) {
+      for (unsigned int i = n->leftFirst; i < n->leftFirst + n->count; i++)
+        if (hitTriangle(&bvh->triangles[i], ray, ray->tMin, t, u, v)) {
+          found = (int) i;
+          if (anyHit)
+            return found;
+        }
+    } else {
+      const BvhNode *nearNode = &nodes[n->leftFirst], *farNode = nearNode + 1;
+      float tNear = enterBox(nearNode, &s, ray->tMin, *t), tFar = enterBox(farNode, &s, ray->tMin, *t);
+
+      if (tFar < tNear) {
+        std::swap(nearNode, farNode);
+        std::swap(tNear, tFar);
+      }
+      if (tNear != FLT_MAX) {
+        if (tFar != FLT_MAX) {
+          stack[sp] = farNode;
+          stackNear[sp++] = tFar;
+        }
+        n = nearNode;
+        continue;
+      }
+    }
+    do {
+      if (sp == 0)
+        return found;
+      n = stack[--sp];
+    } while (stackNear[sp] >= *t);
+  }
+}
+
+int intersectBvh(const Bvh *bvh, const BvhRay *ray, BvhHit *hit)
+{
+  int found = -1;
+
+  hit->u = hit->v = 0;
+  if (bvh->nodeCount > 0)
+    found = traceRay(bvh, ray, 0, &hit->t, &hit->u, &hit->v);
+  hit->triangle = found >= 0 ? (int) bvh->original[found] : -1;
+  if (found < 0)
+    hit->t = ray->tMax;
+  return found >= 0;
+}
+
+int occludedBvh(const Bvh *bvh, const BvhRay *ray)
+{
+  float t, u, v;
+
+  return bvh->nodeCount > 0 && traceRay(bvh, ray, 1, &t, &u, &v) >= 0;
+}
+
+/* 8-ray packets */
+
+#ifdef MATRIX_HAVE_AVX2
+
+typedef struct {
+  __m256 origin[3], direction[3], inverse[3];
+  __m256 tMin;
+} Packet8;
+
+static int countBits(int mask)
+{
+  int n = 0;
+
+  for (; mask; mask &= mask - 1)
+    n++;
+  return n;
+}
+
+/* Load rays[0..n), n <= 8; the missing lanes get an empty interval. */
+MATRIX_TARGET_AVX2
+static __m256 loadPacket8(Packet8 *p, const BvhRay *rays, int n)
+{
+  float o[3][8], d[3][8], tMin[8], tMax[8];
+  int i, k;
+
+  for (i = 0; i < 8; i++) {
+    const BvhRay *r = &rays[i < n ? i : 0];
+
+    for (k = 0; k < 3; k++) {
+      o[k][i] = r->origin[k];
+      d[k][i] = r->direction[k];
+    }
+    tMin[i] = i < n ? r->tMin : 1.0f;
+    tMax[i] = i < n ? r->tMax : 0.0f;
+  }
+  for (k = 0; k < 3; k++) {
+    p->origin[k] = _mm256_loadu_ps(o[k]);
+    p->direction[k] = _mm256_loadu_ps(d[k]);
+    p->inverse[k] = _mm256_div_ps(_mm256_set1_ps(1.0f), p->direction[k]);
+  }
+  p->tMin = _mm256_loadu_ps(tMin);
+  return _mm256_loadu_ps(tMax);
+}
+
+/* Lanes whose ray enters n's box within (tMin, tBest); their entry
+   distances go in *tNear. */
+MATRIX_TARGET_AVX2
+static int enterBox8(const BvhNode *n, const Packet8 *p, __m256 tBest, __m256 *tNear)
+{
+  __m256 lo = p->tMin, hi = tBest;
+
+  for (int k = 0; k < 3; k++) {
+    /* Not min*inverse - origin*inverse: with a zero direction that is
+       infinity minus infinity where the origin is on the slab's axis. */
+    __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_broadcast_ss(&n->boundsMin[k]), p->origin[k]),
+                              p->inverse[k]),
+           t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_broadcast_ss(&n->boundsMax[k]), p->origin[k]),
+                              p->inverse[k]);
+
+    lo = _mm256_max_ps(lo, _mm256_min_ps(t0, t1));
+    hi = _mm256_min_ps(hi, _mm256_max_ps(t0, t1));
+  }
+  *tNear = lo;
+  return _mm256_movemask_ps(_mm256_cmp_ps(lo, hi, _CMP_LE_OQ));
+}
+
+/* Test live lanes against tri, updating the hit lanes' tBest, u, v, and
+   triangle.  Returns the hit lanes. */
+MATRIX_TARGET_AVX2
+static __m256 hitTriangle8(const BvhTriangle *tri, int index, const Packet8 *p, __m256 live,
+                           __m256 *tBest, __m256 *u, __m256 *v, __m256 *triangle)
+{
+  const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+  __m256 e1[3], e2[3], s[3], pv[3], q[3], det, inv, a, b, c, hit;
+  int k;
+
+  for (k = 0; k < 3; k++) {
+    e1[k] = _mm256_broadcast_ss(&tri->edge1[k]);
+    e2[k] = _mm256_broadcast_ss(&tri->edge2[k]);
+    s[k] = _mm256_sub_ps(p->origin[k], _mm256_broadcast_ss(&tri->corner[k]));
+  }
+  pv[0] = _mm256_fmsub_ps(p->direction[1], e2[2], _mm256_mul_ps(p->direction[2], e2[1]));
+  pv[1] = _mm256_fmsub_ps(p->direction[2], e2[0], _mm256_mul_ps(p->direction[0], e2[2]));
+  pv[2] = _mm256_fmsub_ps(p->direction[0], e2[1], _mm256_mul_ps(p->direction[1], e2[0]));
+  det = _mm256_fmadd_ps(e1[2], pv[2], _mm256_fmadd_ps(e1[1], pv[1], _mm256_mul_ps(e1[0], pv[0])));
+  inv = _mm256_div_ps(one, det);
+  a = _mm256_mul_ps(_mm256_fmadd_ps(s[2], pv[2],
+        _mm256_fmadd_ps(s[1], pv[1], _mm256_mul_ps(s[0], pv[0]))), inv);
+  q[0] = _mm256_fmsub_ps(s[1], e1[2], _mm256_mul_ps(s[2], e1[1]));
+  q[1] = _mm256_fmsub_ps(s[2], e1[0], _mm256_mul_ps(s[0], e1[2]));
+  q[2] = _mm256_fmsub_ps(s[0], e1[1], _mm256_mul_ps(s[1], e1[0]));
+  b = _mm256_mul_ps(_mm256_fmadd_ps(p->direction[2], q[2],
+        _mm256_fmadd_ps(p->direction[1], q[1], _mm256_mul_ps(p->direction[0], q[0]))), inv);
+  c = _mm256_mul_ps(_mm256_fmadd_ps(e2[2], q[2],
+        _mm256_fmadd_ps(e2[1], q[1], _mm256_mul_ps(e2[0], q[0]))), inv);
+
+  hit = _mm256_and_ps(live, _mm256_cmp_ps(det, zero, _CMP_NEQ_OQ));
+  hit = _mm256_and_ps(hit, _mm256_cmp_ps(a, zero, _CMP_GE_OQ));
+  hit = _mm256_and_ps(hit, _mm256_cmp_ps(b, zero, _CMP_GE_OQ));
+  hit = _mm256_and_ps(hit, _mm256_cmp_ps(_mm256_add_ps(a, b), one, _CMP_LE_OQ));
+  hit = _mm256_and_ps(hit, _mm256_cmp_ps(c, p->tMin, _CMP_GT_OQ));
+  hit = _mm256_and_ps(hit, _mm256_cmp_ps(c, *tBest, _CMP_LT_OQ));
+  if (_mm256_testz_ps(hit, hit))
+    return hit;
+  *tBest = _mm256_blendv_ps(*tBest, c, hit);
+  *u = _mm256_blendv_ps(*u, a, hit);
+  *v = _mm256_blendv_ps(*v, b, hit);
+  *triangle = _mm256_blendv_ps(*triangle, _mm256_castsi256_ps(_mm256_set1_epi32(index)), hit);
+  return hit;
+}
+
+/* Trace rays[0..n), n <= 8, together.  For closest hits, fill hits; for
+   any hits, set occluded. */
+MATRIX_TARGET_AVX2
+static void tracePacket8(const Bvh *bvh, const BvhRay *rays, int n,
+                         BvhHit *hits, int *occluded)
+{
+  const BvhNode *nodes = bvh->nodes;
+  const BvhNode *stack[BVH_MAX_DEPTH];
+  const BvhNode *node = nodes;
+  Packet8 p;
+  __m256 tBest, u = _mm256_setzero_ps(), v = _mm256_setzero_ps(),
+         triangle = _mm256_castsi256_ps(_mm256_set1_epi32(-1)),
+         live = _mm256_castsi256_ps(_mm256_set1_epi32(-1)), tNear;
+  int sp = 0, i;
+
+  tBest = loadPacket8(&p, rays, n);
+  if (enterBox8(node, &p, tBest, &tNear) == 0)
+    goto done;
+  for (;;) {
+    if (node->count > 0) {
+      for (unsigned int t = node->leftFirst; t < node->leftFirst + node->count; t++) {
+        __m256 hit = hitTriangle8(&bvh->triangles[t], (int) t, &p, live, &tBest, &u, &v, &triangle);
+
+        if (occluded) {
+          live = _mm256_andnot_ps(hit, live);
+          if (_mm256_testz_ps(live, live))
+            goto done;
+        }
+      }
+    } else {
+      const BvhNode *nearNode = &nodes[node->leftFirst], *farNode = nearNode + 1;
+      __m256 bestLive = _mm256_blendv_ps(_mm256_set1_ps(-FLT_MAX), tBest, live), nearT, farT;
+      int nearMask = enterBox8(nearNode, &p, bestLive, &nearT),
+          farMask = enterBox8(farNode, &p, bestLive, &farT);
+
+      if (nearMask != 0 || farMask != 0) {
+        /* Go first where more of the rays that enter both boxes enter first. */
+        int both = nearMask & farMask,
+            closer = _mm256_movemask_ps(_mm256_cmp_ps(farT, nearT, _CMP_LT_OQ)) & both;
+
+        if (nearMask == 0 || 2 * countBits(closer) > countBits(both)) {
+          std::swap(nearNode, farNode);
+          std::swap(nearMask, farMask);
+        }
+        if (farMask != 0)
+          stack[sp++] = farNode;
+        node = nearNode;
+        continue;
+      }
+    }
+    /* A stacked node is tested again, against the hits found since. */
+    do {
+      if (sp == 0)
+        goto done;
+      node = stack[--sp];
+    } while (enterBox8(node, &p, _mm256_blendv_ps(_mm256_set1_ps(-FLT_MAX), tBest, live),
+                       &tNear) == 0);
+  }
+
+done:
+  if (occluded) {
+    int hitMask = _mm256_movemask_ps(live) ^ 0xff;
+
+    for (i = 0; i < n; i++)
+      occluded[i] = (hitMask >> i) & 1;
+  } else {
+    float t8[8], u8[8], v8[8];
+    int tri8[8];
+
+    _mm256_storeu_ps(t8, tBest);
+    _mm256_storeu_ps(u8, u);
+    _mm256_storeu_ps(v8, v);
+    _mm256_storeu_si256((__m256i *) tri8, _mm256_castps_si256(triangle));
+    for (i = 0; i < n; i++) {
+      hits[i].t = t8[i];
+      hits[i].u = tri8[i] >= 0 ? u8[i] : 0;
+      hits[i].v = tri8[i] >= 0 ? v8[i] : 0;
+      hits[i].triangle = tri8[i] >= 0 ? (int) bvh->original[tri8[i]] : -1;
+    }
+  }
+}
+
+#endif /* MATRIX_HAVE_AVX2 */
+
+/* parallelFor work item for the ray stream routines. */
+struct TraceTask
+{
+  const Bvh *bvh;
+  const BvhRay *rays;
+  BvhHit *hits;           /* Closest hits, or */
+  int *occluded;          /* any hits */
+
+  void operator()(int begin, int end) const
+  {
+    int i = begin;
+
+#ifdef MATRIX_HAVE_AVX2
+    if (getMatrixSimdLevel() >= MATRIX_SIMD_AVX2) {
+      for (; i < end; i += 8)
+        tracePacket8(bvh, rays + i, std::min(8, end - i),
+                     hits ? hits + i : NULL, occluded ? occluded + i : NULL);
+      return;
+    }
+#endif
+    for (; i < end; i++)
+      if (hits)
+        intersectBvh(bvh, &rays[i], &hits[i]);
+      else
+        occluded[i] = occludedBvh(bvh, &rays[i]);
+  }
+};
+
+void intersectBvhArray(const Bvh *bvh, const BvhRay *rays, BvhHit *hits, int count)
+{
+  TraceTask task;
+
+  if (bvh->nodeCount == 0) {
+    for (int i = 0; i < count; i++) {
+      hits[i].t = rays[i].tMax;
+      hits[i].u = hits[i].v = 0;
+      hits[i].triangle = -1;
+    }
+    return;
+  }
+  task.bvh = bvh;
+  task.rays = rays;
+  task.hits = hits;
+  task.occluded = NULL;
+  parallelFor(count, myRaysMinPerThread, 8, task);
+}
+
+void occludedBvhArray(const Bvh *bvh, const BvhRay *rays, int *occluded, int count)
+{
+  TraceTask task;
+
+  if (bvh->nodeCount == 0) {
+    memset(occluded, 0, count * sizeof(int));
+    return;
+  }
+  task.bvh = bvh;
+  task.rays = rays;
+  task.hits = NULL;
+  task.occluded = occluded;
+  parallelFor(count, myRaysMinPerThread, 8, task);
+}
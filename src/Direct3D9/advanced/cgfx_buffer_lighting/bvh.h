@@ -0,0 +1,86 @@
+/* bvh.h - Bounding volume hierarchy over a triangle mesh for ray casting, picking, and occlusion. */
+
+/* buildBvh splits the triangles top-down: at each node the centroids are
+   sorted into BVH_BINS bins along each axis, and the split between bins
+   with the lowest surface area heuristic cost (the triangles on each side
+   times that side's box area) wins, unless keeping the node as a leaf is
+   cheaper.  Large meshes are split serially until there are enough
+   subtrees to go round, and the subtrees are built on separate threads
+   (see parallel.h); the tree does not depend on the thread count.
+
+   Nodes are 32 bytes.  An inner node's children are next to each
+   other, so it only stores the first, and a visit reads both boxes from
+   one place.  The triangles are copied into leaf order as a corner and
+   two edges, ready for the Moller-Trumbore test; both sides of a
+   triangle are hit.
+
+   intersectBvh and occludedBvh trace one ray.  The ...Array versions
+   split a stream of rays across threads and, at MATRIX_SIMD_AVX2 (see
+   matrix.h), trace each run of 8 rays as a packet: the 8 go down the
+   tree together, each node's box and each leaf's triangles are tested
+   against all 8 at once, and a subtree is skipped only when every ray
+   misses it.  Packets pay off for coherent rays, such as neighboring
+   pixels' camera rays or shadow rays toward one light, so order the
+   stream that way; for scattered rays the packet visits the union of
+   the rays' nodes.  Below AVX2 each ray is traced alone. */
+
+#ifndef BVH_H
+#define BVH_H
+
+#define BVH_BINS       16
+#define BVH_MAX_DEPTH  64
+
+typedef struct {
+  float boundsMin[3];
+  unsigned int leftFirst;   /* Inner node: left child, right is next; leaf: first triangle */
+  float boundsMax[3];
+  unsigned int count;       /* Leaf: its triangles; 0 for an inner node */
+} BvhNode;
+
+typedef struct {
+  float corner[3], edge1[3], edge2[3];
+} BvhTriangle;
+
+typedef struct {
+  BvhNode *nodes;
+  int nodeCount;
+  BvhTriangle *triangles;     /* Leaf order */
+  unsigned int *original;     /* Leaf order: index of each triangle in the mesh */
+  int triangleCount;
+} Bvh;
+
+typedef struct {
+  float origin[3];
+  float direction[3];         /* Need not be unit length; t is in its units */
+  float tMin, tMax;
+} BvhRay;
+
+typedef struct {
+  float t;
+  float u, v;                 /* Weights of the triangle's second and third vertices */
+  int triangle;               /* In the mesh's numbering; -1 for a miss */
+} BvhHit;
+
+/* Build a BVH over triangle list indices[0..indexCount) whose positions
+   are 3 floats at positions + v*stride floats.  Release it with freeBvh.
+   Returns 1, or 0 if there are no triangles. */
+int buildBvh(Bvh *bvh, const float *positions, int stride,
+             const unsigned int *indices, int indexCount);
+
+void freeBvh(Bvh *bvh);
+
+/* Sum of the SAH costs of the tree's nodes relative to its root's area:
+   expected node visits plus triangle tests for a random ray that hits
+   the root box. */
+double getBvhCost(const Bvh *bvh);
+
+/* The closest hit with tMin < t < tMax.  Returns 1 on a hit. */
+int intersectBvh(const Bvh *bvh, const BvhRay *ray, BvhHit *hit);
+
+/* Whether anything is hit with tMin < t < tMax; stops at the first hit. */
+int occludedBvh(const Bvh *bvh, const BvhRay *ray);
+
+void intersectBvhArray(const Bvh *bvh, const BvhRay *rays, BvhHit *hits, int count);
+void occludedBvhArray(const Bvh *bvh, const BvhRay *rays, int *occluded, int count);
+
+#endif /* BVH_H */
@@ -11,6 +11,10 @@ using namespace std;
 #include <d3d9.h>      /* Direct3D9 API: Can't include this?  Is DirectX SDK installed? */
 #include "DXUT.h"      /* DirectX Utility Toolkit (part of the DirectX SDK) */
 #include "matrix.h"
+#include "quaternion.h"
+#include "frustum.h"
+#include "sphere.h"
+#include "lod.h"
 #include "materials.h"
 
 #include <Cg/cg.h>     /* Cg Core API: Can't include this?  Is Cg Toolkit installed! */
@@ -34,10 +38,35 @@ CGbuffer     transform_buffer, * material_buffer, lightSet_buffer, lightSetPerVi
 /* Initial scene state */
 static int myAnimating = 0;
 int currentLight = 0;
-float eyeAngle = 1.6f;
-int object_material[2] = { 0, 3 };
+float eyeAngle = 1.6f;     /* Starting angle of the eye's orbit, in radians. */
+float eyeRotation[4];      /* Rotation part of the view matrix. */
+#define EYE_DISTANCE 8.0f
+
+/* Scene objects: one sphere per entry, translated along X. */
+#define OBJECT_COUNT 2
+#define SPHERE_RADIUS 2.0f
+/* Finest level of the sphere's LOD chain; coarser levels halve it. */
+#define SPHERE_SLICES 80
+#define SPHERE_STACKS 80
+/* Each frame an object gets the coarsest level within this many pixels
+   of the true sphere, going coarser only well under it (see lod.h). */
+#define SPHERE_LOD_PIXEL_ERROR 0.5f
+#define SPHERE_LOD_HYSTERESIS  0.25f
+static const float object_translate[OBJECT_COUNT] = { 3.2f, -3.2f };
+
+/* World-space bounding spheres for culling, as structure-of-arrays:
+   centers (object_translate[i], 0, 0). */
+static const float object_bound_y[OBJECT_COUNT] = { 0.0f, 0.0f };
+static const float object_bound_z[OBJECT_COUNT] = { 0.0f, 0.0f };
+static const float object_bound_radius[OBJECT_COUNT] = { SPHERE_RADIUS, SPHERE_RADIUS };
+int object_material[OBJECT_COUNT] = { 0, 3 };
+/* Level of detail each object was drawn with last frame; -1 before the first. */
+static int object_lod[OBJECT_COUNT] = { -1, -1 };
 
 int material_buffer_index;
+/* Material whose buffer the fragment program has, or -1; objects of one
+   material drawn in a row bind it once (see BindMaterialBuffer). */
+static int bound_material = -1;
 int transform_buffer_offset;
 int lightSetPerView_offset;
 
@@ -47,7 +76,10 @@ struct MY_V3F
 };
 
 static PDIRECT3DVERTEXBUFFER9 myVertexBuffer = NULL;
-vector< MY_V3F > vertexList;
+static PDIRECT3DINDEXBUFFER9 myIndexBuffer = NULL;
+static int mySphereVertexCount, mySphereIndexCount;
+static LodChain mySphereLod;
+static int myViewportHeight;
 
 const double myPi = 3.14159265358979323846;
 
@@ -59,6 +91,9 @@ typedef struct
   float4x4 modelview_projection;
 } Transform;
 
+/* Distance in floats between the same matrix of consecutive Transforms. */
+#define TRANSFORM_STRIDE ( (int)( sizeof( Transform ) / sizeof( float ) ) )
+
 #define MAX_LIGHTS 8
 
 // D3D9 uses OpenGL's GP4 profile float4 alignment
@@ -103,9 +138,10 @@ void CALLBACK OnLostDevice(void*);
 void CALLBACK OnFrameMove(IDirect3DDevice9*, double, float, void*);
 void CALLBACK KeyboardProc(UINT, bool, bool, void*);
 
+void InitEyeOrbit();
 void InitBuffers();
 void InitLight( LightSet * lightSet, int index );
-void DrawLitSphere( const float projectionMatrix[16], const float viewMatrix[16], int object, float xTranslate, IDirect3DDevice9* pDev, IDirect3DVertexBuffer9 *vb );
+void DrawLitSphere( Transform *transform, int object, IDirect3DDevice9* pDev, IDirect3DVertexBuffer9 *vb );
 
 int main(int argc, char **argv)
 {
@@ -118,6 +154,7 @@ int main(int argc, char **argv)
   DXUTSetCallbackFrameMove(OnFrameMove);
   DXUTSetCallbackKeyboard(KeyboardProc);
   DXUTCreateWindow(L"cgfx_buffer_lighting");
+  InitEyeOrbit();
 
   bool windowed = true;
   DXUTCreateDevice(D3DADAPTER_DEFAULT, windowed, 640, 480);
@@ -206,69 +243,47 @@ HRESULT initCg(void)
     return S_OK;
 }
 
-HRESULT initSphereVertexBuffer(IDirect3DDevice9* pDev, float radius, int slices, int stacks)
+HRESULT initSphereBuffers(IDirect3DDevice9* pDev, float radius, int slices, int stacks)
 {
-    const float PI = 3.1415926f;
-	float phiStep = PI / stacks;
-	int rings = stacks - 1;
-    for( int i = 1; i <= rings; ++i )
-    {
-        float phi = i * phiStep;
-        float phi2 = (i - 1) * phiStep;
+    /* 16-bit indices when they can address every vertex. */
+    int index16;
+    MY_V3F* pVertices;
+    void* pIndices;
 
-        float thetaStep = 2.0f * PI / slices;
-        for( int j = 0; j <= slices; ++j )
-        {
-            MY_V3F vert;
-            float theta = j * thetaStep;
-            float theta2 = (j-1) * thetaStep;
-
-            vert.x = radius * sinf( phi ) * cosf( theta );
-            vert.y = radius * cosf( phi );
-            vert.z = radius * sinf( phi ) * sinf( theta );
-		    vertexList.push_back( vert );
-
-            vert.x = radius * sinf( phi2 ) * cosf( theta );
-            vert.y = radius * cosf( phi2 );
-            vert.z = radius * sinf( phi2 ) * sinf( theta );
-		    vertexList.push_back( vert );
-
-            vert.x = radius * sinf( phi2 ) * cosf( theta2 );
-            vert.y = radius * cosf( phi2 );
-            vert.z = radius * sinf( phi2 ) * sinf( theta2 );
-		    vertexList.push_back( vert );
-
-            vert.x = radius * sinf( phi ) * cosf( theta );
-            vert.y = radius * cosf( phi );
-            vert.z = radius * sinf( phi ) * sinf( theta );
-		    vertexList.push_back( vert );
-
-            vert.x = radius * sinf( phi ) * cosf( theta2 );
-            vert.y = radius * cosf( phi );
-            vert.z = radius * sinf( phi ) * sinf( theta2 );
-		    vertexList.push_back( vert );
-
-            vert.x = radius * sinf( phi2 ) * cosf( theta2 );
-            vert.y = radius * cosf( phi2 );
-            vert.z = radius * sinf( phi2 ) * sinf( theta2 );
-			vertexList.push_back( vert );		
-		}
-    }
+    /* Every level of the chain in one vertex buffer and one index buffer. */
+    getSphereLodChain( &mySphereLod, slices, stacks, LOD_MAX_LEVELS );
+    mySphereVertexCount = mySphereLod.vertexCount;
+    mySphereIndexCount = mySphereLod.indexCount;
+    index16 = mySphereLod.levels[0].vertexCount <= 65536;
 
-	if( FAILED( pDev->CreateVertexBuffer( (UINT)vertexList.size() * sizeof(MY_V3F), 0, D3DFVF_XYZ, D3DPOOL_DEFAULT, &myVertexBuffer, NULL ) ) )
+    if( FAILED( pDev->CreateVertexBuffer( (UINT)mySphereVertexCount * sizeof(MY_V3F), 0, D3DFVF_XYZ, D3DPOOL_DEFAULT, &myVertexBuffer, NULL ) ) )
+    {
+        return E_FAIL;
+    }
+    if( FAILED( pDev->CreateIndexBuffer( (UINT)mySphereIndexCount * (index16 ? sizeof(WORD) : sizeof(DWORD)), 0,
+                                         index16 ? D3DFMT_INDEX16 : D3DFMT_INDEX32, D3DPOOL_DEFAULT, &myIndexBuffer, NULL ) ) )
     {
         return E_FAIL;
     }
 
-    MY_V3F* pVertices;
+    /* Generate straight into the locked buffers. */
     if( FAILED( myVertexBuffer->Lock( 0, 0, /* map entire buffer */
                                       (VOID**)&pVertices, 0) ) )
     {
         return E_FAIL;
     }
+    if( FAILED( myIndexBuffer->Lock( 0, 0, &pIndices, 0 ) ) )
+    {
+        myVertexBuffer->Unlock();
+        return E_FAIL;
+    }
 
-	memcpy( pVertices, &vertexList[0], vertexList.size() * sizeof(MY_V3F) );
+    if( index16 )
+        makeSphereLod16( &mySphereLod, &pVertices->x, (unsigned short*)pIndices, radius );
+    else
+        makeSphereLod( &mySphereLod, &pVertices->x, (unsigned int*)pIndices, radius );
 
+    myIndexBuffer->Unlock();
     myVertexBuffer->Unlock();
     return S_OK;
 }
@@ -289,12 +304,17 @@ HRESULT CALLBACK OnResetDevice( IDirect3DDevice9* pDev, const D3DSURFACE_DESC* b
       firstTime = 0;
     }
 
-    if (FAILED(initSphereVertexBuffer(pDev, 2, 20, 20)))
+    /* Bind the material buffer again after a reset rather than trust
+       the program to have kept it. */
+    bound_material = -1;
+
+    if (FAILED(initSphereBuffers(pDev, SPHERE_RADIUS, SPHERE_SLICES, SPHERE_STACKS)))
       return E_FAIL;
 
 	double fieldOfView = 70.0;  // In degrees
     double width = backBuf->Width;
     double height = backBuf->Height;
+    myViewportHeight = (int) backBuf->Height;
     double aspectRatio = width / height;
     makePerspectiveMatrix( fieldOfView, aspectRatio,
                            1.0, 20.0,  /* Znear and Zfar */
@@ -306,14 +326,17 @@ HRESULT CALLBACK OnResetDevice( IDirect3DDevice9* pDev, const D3DSURFACE_DESC* b
 void CALLBACK OnLostDevice( void * userContext )
 {
   myVertexBuffer->Release();
+  myIndexBuffer->Release();
   cgD3D9SetDevice(NULL);
 }
 
 
 void CALLBACK OnFrameRender( IDirect3DDevice9* pDev, double time, float elapsedTime, void * userContext )
 {
-    float eyePosition[4];
-    float viewMatrix[16];
+    float viewMatrix[16], viewProjectionMatrix[16], frustumPlanes[24], eyeMatrix[16];
+    float modelMatrix[OBJECT_COUNT][16];
+    Transform transform[OBJECT_COUNT];
+    int visible[OBJECT_COUNT], visibleCount;
 
     // Clear the back buffer        
 	pDev->Clear(0, NULL, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER, D3DXCOLOR( 0.1f, 0.3f, 0.6f, 1.0f ), 1.0f, 0);
@@ -323,17 +346,10 @@ void CALLBACK OnFrameRender( IDirect3DDevice9* pDev, double time, float elapsedT
     if (FAILED(pDev->BeginScene())) 
       return;
 
-    // Update latest eye position.
-    eyePosition[0] = 8.0f * cos( eyeAngle );
-    eyePosition[1] = 0.0f;
-    eyePosition[2] = -8.0f * sin( eyeAngle );
-    eyePosition[3] = 1.0f;
-
-    // Compute current view matrix.
-    makeLookAtMatrix( eyePosition[0], eyePosition[1], eyePosition[2],   /* eye position */
-                      0, 0, 0,                                          /* view center */
-                      0, 1, 0,                                          /* up vector */
-                      viewMatrix );
+    // Compute current view matrix: rotate the world, then back it away
+    // from the eye, which looks down -Z at the origin.
+    static const float eyeOffset[3] = { 0, 0, -EYE_DISTANCE };
+    makeRigidMatrix( eyeRotation, eyeOffset, viewMatrix );
 
     // For each light, convert its world-space position to eye-space
     for( int i = 0; i < 2; ++i ) 
@@ -345,18 +361,57 @@ void CALLBACK OnFrameRender( IDirect3DDevice9* pDev, double time, float elapsedT
     // Update light set per-view buffer
     cgSetBufferSubData( lightSetPerView_buffer, lightSetPerView_offset, sizeof( lightSetPerView_eye ), &lightSetPerView_eye );
     
-    DrawLitSphere( myProjectionMatrix, viewMatrix, 0, 3.2f, pDev, myVertexBuffer );
-    DrawLitSphere( myProjectionMatrix, viewMatrix, 1, -3.2f, pDev, myVertexBuffer );
+    // Build every object's transforms in two batched multiplies:
+    //   modelview[i] = V * M[i],  modelview_projection[i] = P * modelview[i]
+    for( int i = 0; i < OBJECT_COUNT; ++i )
+        makeTranslateMatrix( object_translate[i], 0, 0, modelMatrix[i] );
+    multMatrixArrayStrided( transform[0].modelview, TRANSFORM_STRIDE,
+                            viewMatrix, 0,
+                            modelMatrix[0], 16, OBJECT_COUNT );
+    multMatrixArrayStrided( transform[0].modelview_projection, TRANSFORM_STRIDE,
+                            myProjectionMatrix, 0,
+                            transform[0].modelview, TRANSFORM_STRIDE, OBJECT_COUNT );
+
+    // Draw only the objects whose bounding sphere touches the view frustum.
+    multMatrix( viewProjectionMatrix, myProjectionMatrix, viewMatrix );
+    makeFrustumPlanes( viewProjectionMatrix, frustumPlanes );
+    visibleCount = cullSpheres( visible, frustumPlanes,
+                                object_translate, object_bound_y, object_bound_z,
+                                object_bound_radius, OBJECT_COUNT );
+
+    // Pick each object's level of detail from its size on screen.  The
+    // eye's world-space position is the translation of the inverse view.
+    invertRigidMatrix( eyeMatrix, viewMatrix );
+    const float eyePosition[3] = { eyeMatrix[3], eyeMatrix[7], eyeMatrix[11] };
+    selectLodArray( object_lod, &mySphereLod, myProjectionMatrix, myViewportHeight, eyePosition,
+                    object_translate, object_bound_y, object_bound_z, object_bound_radius,
+                    OBJECT_COUNT, SPHERE_LOD_PIXEL_ERROR, SPHERE_LOD_HYSTERESIS );
+
+    for( int i = 0; i < visibleCount; ++i )
+        DrawLitSphere( &transform[visible[i]], visible[i], pDev, myVertexBuffer );
 
 	pDev->EndScene();
 }
 
+// The eye orbits the origin in the XZ plane starting at eyeAngle, looking
+// at the origin with +Y up.  That view is the rotation by eyeAngle + pi/2
+// radians about Y in makeRotateMatrix's convention.
+void InitEyeOrbit()
+{
+    makeRotateQuaternion( (float)( ( eyeAngle + myPi / 2 ) * 180.0 / myPi ), 0, 1, 0, eyeRotation );
+}
+
+// Advancing the orbit by 0.01 radians turns the world the other way about
+// Y, which is one quaternion multiply on the right.  Renormalizing keeps
+// rounding from accumulating into a scaled view.
 void advanceAnimation()
 {
-    eyeAngle += 0.01f;
+    static float step[4];
 
-    if( eyeAngle > 2 * myPi )
-        eyeAngle -= 2 * myPi;
+    if( step[3] == 0.0f )
+        makeRotateQuaternion( (float)( 0.01 * 180.0 / myPi ), 0, 1, 0, step );
+    multQuaternion( eyeRotation, eyeRotation, step );
+    normalizeQuaternion( eyeRotation );
 }
 
 void CALLBACK OnFrameMove( IDirect3DDevice9* pDev, double time, float elapsedTime, void* userContext )
@@ -448,9 +503,13 @@ void InitLight( LightSet * lightSet, int index )
 
 void BindMaterialBuffer( int object )
 {
+    if( object_material[object] == bound_material )
+        return;
+
     CGprogram myCgFragmentProgram = cgGetPassProgram( cgGetFirstPass( myCgTechnique ), CG_FRAGMENT_DOMAIN );
     cgSetProgramBuffer( myCgFragmentProgram, material_buffer_index, material_buffer[object_material[object]] );
     checkForCgError( "set material buffer" );
+    bound_material = object_material[object];
 }
 
 void UpdateTransformBuffer( Transform *transform )
@@ -460,34 +519,36 @@ void UpdateTransformBuffer( Transform *transform )
 }
 
 
-HRESULT drawSphere( IDirect3DDevice9* pDev, IDirect3DVertexBuffer9 *vb )
+HRESULT drawSphere( IDirect3DDevice9* pDev, IDirect3DVertexBuffer9 *vb, int lod )
 {
+    const LodLevel *level = &mySphereLod.levels[lod];
     HRESULT hr = S_OK;
 
     hr = pDev->SetStreamSource(0, vb, 0, sizeof(MY_V3F));
     if( FAILED( hr ) )
         return hr;
 
+    hr = pDev->SetIndices( myIndexBuffer );
+    if( FAILED( hr ) )
+        return hr;
+
     hr = pDev->SetFVF( D3DFVF_XYZ );
     if( FAILED( hr ) )
         return hr;
 
-    hr = pDev->DrawPrimitive( D3DPT_TRIANGLELIST, 0, (UINT) vertexList.size() / 3 );
+    hr = pDev->DrawIndexedPrimitive( D3DPT_TRIANGLELIST, level->vertexStart, 0, (UINT) level->vertexCount,
+                                     (UINT) level->indexStart, (UINT) level->indexCount / 3 );
   
     return hr;
 }
 
-void DrawLitSphere( const float projectionMatrix[16], const float viewMatrix[16], int object, float xTranslate, IDirect3DDevice9* pDev, IDirect3DVertexBuffer9 *vb )
+void DrawLitSphere( Transform *transform, int object, IDirect3DDevice9* pDev, IDirect3DVertexBuffer9 *vb )
 {
-    Transform transform;
-    float modelMatrix[16];
-
-    makeTranslateMatrix( xTranslate, 0, 0, modelMatrix );
-    multMatrix( transform.modelview, viewMatrix, modelMatrix );
-    multMatrix( transform.modelview_projection, projectionMatrix, transform.modelview );
-    invertMatrix( transform.inverse_modelview, transform.modelview );
+    // The modelview is a rigid view times a translation, so it is a
+    // rigid-body transform and needs no general inverse.
+    invertRigidMatrix( transform->inverse_modelview, transform->modelview );
   
-    UpdateTransformBuffer( &transform );
+    UpdateTransformBuffer( transform );
     BindMaterialBuffer( object );
 
     CGpass pass = cgGetFirstPass( myCgTechnique );
@@ -495,7 +556,7 @@ void DrawLitSphere( const float projectionMatrix[16], const float viewMatrix[16]
     {
         cgSetPassState( pass );
     
-           drawSphere( pDev, myVertexBuffer );
+           drawSphere( pDev, myVertexBuffer, object_lod[object] );
     
         cgResetPassState( pass );
         pass = cgGetNextPass( pass );
@@ -0,0 +1,557 @@
+/* compress.c - Compact vertex formats: quantized positions, 16-bit texture coordinates, octahedral normals. */
+
+/* Octahedral encoding projects a unit vector onto the octahedron
+   |x| + |y| + |z| = 1 and, for the lower half (z < 0), folds each
+   triangle out across its edge of the square, so the whole sphere maps
+   onto [-1, 1] x [-1, 1].  Decoding sets z = 1 - |x| - |y|, folds back
+   where z < 0, and normalizes.
+
+   Half floats are converted with integer tricks (after Fabian Giesen's
+   float_to_half_fast3_rtne and half_to_float_fast4) that round to
+   nearest even and handle denormals, infinities, and NaNs without
+   branches, so the SSE2 versions are the same expressions on four lanes.
+
+   Values are quantized by rounding half away from zero, written as a
+   truncation of x + copysign(0.5, x), which SSE2 does without a rounding
+   mode change.  The scalar and SSE2 versions evaluate the same
+   expressions in the same order, so with SSE2 scalar math (x64, or
+   /arch:SSE2) they give the same bits. */
+
+#include <math.h>
+#include <string.h>
+
+#include "compress.h"
+#include "matrix.h"
+#include "matrix_simd.h"
+
+#define COMPRESS_SNORM_MAX  32767.0f
+#define COMPRESS_UNORM_MAX  65535.0f
+
+static int roundToInt(float x)
+{
+  return (int) (x + (x < 0 ? -0.5f : 0.5f));
+}
+
+static float clampFloat(float x, float lo, float hi)
+{
+  return x < lo ? lo : x > hi ? hi : x;
+}
+
+unsigned short floatToHalf(float f)
+{
+  const unsigned int f16max = (127 + 16) << 23, f32infty = 255 << 23,
+                     denormMagic = ((127 - 15) + (23 - 10) + 1) << 23;
+  unsigned int u, sign, h;
+  float magic;
+
+  memcpy(&u, &f, 4);
+  memcpy(&magic, &denormMagic, 4);
+  sign = u & 0x80000000u;
+  u ^= sign;
+  if (u >= f16max) {
+    /* Too large: infinity; NaNs stay (quiet) NaNs. */
+    h = u > f32infty ? 0x7e00 : 0x7c00;
+  } else if (u < (113 << 23)) {
+    /* Denormal half: let the float adder shift and round the mantissa. */
+    float a;
+
+    memcpy(&a, &u, 4);
+    a += magic;
+    memcpy(&u, &a, 4);
+    h = u - denormMagic;
+  } else {
+    /* Rebias the exponent and round the mantissa to nearest even. */
+    unsigned int odd = (u >> 13) & 1;
+
+    u += ((unsigned int) (15 - 127) << 23) + 0xfff;
+    u += odd;
+    h = u >> 13;
+  }
+  return (unsigned short) (h | sign >> 16);
+}
+
+float halfToFloat(unsigned short h)
+{
+  const unsigned int shiftedExp = 0x7c00 << 13, magicBits = 113 << 23;
+  unsigned int u = (h & 0x7fffu) << 13, exp = u & shiftedExp;
+  float f, magic;
+
+  u += (127 - 15) << 23;
+  if (exp == shiftedExp) {
+    u += (128 - 16) << 23;        /* Infinity or NaN */
+  } else if (exp == 0) {
+    u += 1 << 23;                 /* Zero or denormal: renormalize */
+    memcpy(&f, &u, 4);
+    memcpy(&magic, &magicBits, 4);
+    f -= magic;
+    memcpy(&u, &f, 4);
+  }
+  u |= (h & 0x8000u) << 16;
+  memcpy(&f, &u, 4);
+  return f;
+}
+
+static void encodeOctahedral(short out[2], float x, float y, float z)
+{
+  float l = fabs(x) + fabs(y) + fabs(z), inv = l > 0 ? 1 / l : 0,
+        ox = x * inv, oy = y * inv;
+
+  if (z < 0) {
+    float fx = (1 - fabs(oy)) * (ox < 0 ? -1.0f : 1.0f),
+          fy = (1 - fabs(ox)) * (oy < 0 ? -1.0f : 1.0f);
+
+    ox = fx;
+    oy = fy;
+  }
+  out[0] = (short) roundToInt(clampFloat(ox, -1, 1) * COMPRESS_SNORM_MAX);
+  out[1] = (short) roundToInt(clampFloat(oy, -1, 1) * COMPRESS_SNORM_MAX);
+}
+
+static float snormToFloat(int q)
+{
+  float f = q * (1 / COMPRESS_SNORM_MAX);
+
+  return f < -1 ? -1 : f;
+}
+
+static void decodeOctahedral(float n[3], const short in[2])
+{
+  float x = snormToFloat(in[0]), y = snormToFloat(in[1]),
+        z = 1 - fabs(x) - fabs(y), t = -z > 0 ? -z : 0, inv;
+
+  x = x < 0 ? x + t : x - t;
+  y = y < 0 ? y + t : y - t;
+  inv = 1 / (float) sqrt((double) (x*x + y*y + z*z));
+  n[0] = x * inv;
+  n[1] = y * inv;
+  n[2] = z * inv;
+}
+
+void getPackedMeshInfo(PackedMeshInfo *info, const MeshVertex *vertices, int count,
+                       PackTexCoordFormat texCoordFormat)
+{
+  float lo[5], hi[5];
+  int i, k;
+
+  for (k = 0; k < 5; k++) {
+    lo[k] = 0;
+    hi[k] = 0;
+  }
+  for (i = 0; i < count; i++) {
+    const float v[5] = { vertices[i].position[0], vertices[i].position[1],
+                         vertices[i].position[2], vertices[i].texCoord[0],
+                         vertices[i].texCoord[1] };
+
+    for (k = 0; k < 5; k++) {
+      if (i == 0 || v[k] < lo[k])
+        lo[k] = v[k];
+      if (i == 0 || v[k] > hi[k])
+        hi[k] = v[k];
+    }
+  }
+  for (k = 0; k < 3; k++) {
+    info->positionScale[k] = (hi[k] - lo[k]) * 0.5f;
+    info->positionBias[k] = (hi[k] + lo[k]) * 0.5f;
+  }
+  for (k = 0; k < 2; k++) {
+    info->texCoordScale[k] = hi[k+3] - lo[k+3];
+    info->texCoordBias[k] = lo[k+3];
+  }
+  info->texCoordFormat = texCoordFormat;
+}
+
+/* Multipliers that take a position or texture coordinate, less its bias,
+   to the packed range; 0 for a flat axis. */
+static void getPackScales(float positionScale[3], float texCoordScale[2],
+                          const PackedMeshInfo *info)
+{
+  int k;
+
+  for (k = 0; k < 3; k++)
+    positionScale[k] = info->positionScale[k] > 0 ? 1 / info->positionScale[k] : 0;
+  for (k = 0; k < 2; k++)
+    texCoordScale[k] = info->texCoordScale[k] > 0 ? 1 / info->texCoordScale[k] : 0;
+}
+
+static void packVerticesScalar(PackedVertex *out, const MeshVertex *vertices, int count,
+                               const PackedMeshInfo *info)
+{
+  float positionScale[3], texCoordScale[2];
+  int i, k;
+
+  getPackScales(positionScale, texCoordScale, info);
+  for (i = 0; i < count; i++) {
+    const MeshVertex *v = &vertices[i];
+    PackedVertex *p = &out[i];
+
+    for (k = 0; k < 3; k++)
+      p->position[k] = (short) roundToInt(clampFloat(
+        (v->position[k] - info->positionBias[k]) * positionScale[k], -1, 1) * COMPRESS_SNORM_MAX);
+    p->position[3] = (short) COMPRESS_SNORM_MAX;
+    encodeOctahedral(p->normal, v->normal[0], v->normal[1], v->normal[2]);
+    for (k = 0; k < 2; k++) {
+      if (info->texCoordFormat == PACK_TEXCOORD_HALF)
+        p->texCoord[k] = floatToHalf(v->texCoord[k]);
+      else
+        p->texCoord[k] = (unsigned short) roundToInt(clampFloat(
+          (v->texCoord[k] - info->texCoordBias[k]) * texCoordScale[k], 0, 1) * COMPRESS_UNORM_MAX);
+    }
+  }
+}
+
+static void unpackVerticesScalar(MeshVertex *out, const PackedVertex *packed, int count,
+                                 const PackedMeshInfo *info)
+{
+  int i, k;
+
+  for (i = 0; i < count; i++) {
+    const PackedVertex *p = &packed[i];
+    MeshVertex *v = &out[i];
+
+    for (k = 0; k < 3; k++)
+      v->position[k] = snormToFloat(p->position[k]) * info->positionScale[k] +
+                       info->positionBias[k];
+    decodeOctahedral(v->normal, p->normal);
+    for (k = 0; k < 2; k++) {
+      if (info->texCoordFormat == PACK_TEXCOORD_HALF)
+        v->texCoord[k] = halfToFloat(p->texCoord[k]);
+      else
+        v->texCoord[k] = p->texCoord[k] * (1 / COMPRESS_UNORM_MAX) * info->texCoordScale[k] +
+                         info->texCoordBias[k];
+    }
+  }
+}
+
+#ifdef MATRIX_HAVE_SSE
+
+/* Round half away from zero to 32-bit integers. */
+MATRIX_TARGET_SSE
+static inline __m128i roundToIntSSE(__m128 x)
+{
+  const __m128 half = _mm_set1_ps(0.5f), signBit = _mm_set1_ps(-0.0f);
+
+  return _mm_cvttps_epi32(_mm_add_ps(x, _mm_or_ps(half, _mm_and_ps(x, signBit))));
+}
+
+MATRIX_TARGET_SSE
+static inline __m128 clampSSE(__m128 x, float lo, float hi)
+{
+  return _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(lo)), _mm_set1_ps(hi));
+}
+
+/* Low 16 bits of lo and hi in each 32-bit lane: lo | hi << 16. */
+MATRIX_TARGET_SSE
+static inline __m128i packPairSSE(__m128i lo, __m128i hi)
+{
+  return _mm_or_si128(_mm_and_si128(lo, _mm_set1_epi32(0xffff)), _mm_slli_epi32(hi, 16));
+}
+
+MATRIX_TARGET_SSE
+static inline __m128 absSSE(__m128 x)
+{
+  return _mm_andnot_ps(_mm_set1_ps(-0.0f), x);
+}
+
+/* -a where x < 0, else a; a must not be negative. */
+MATRIX_TARGET_SSE
+static inline __m128 signOfSSE(__m128 a, __m128 x)
+{
+  return _mm_or_ps(a, _mm_and_ps(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_set1_ps(-0.0f)));
+}
+
+MATRIX_TARGET_SSE
+static inline __m128i floatToHalfSSE(__m128 f)
+{
+  const __m128i f16max = _mm_set1_epi32((127 + 16) << 23),
+                f32infty = _mm_set1_epi32(255 << 23),
+                denormMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23),
+                normalMin = _mm_set1_epi32(113 << 23),
+                signMask = _mm_set1_epi32((int) 0x80000000u);
+  __m128i u = _mm_castps_si128(f), sign = _mm_and_si128(u, signMask),
+          large, denormal, special, small, normal, odd, h;
+
+  u = _mm_xor_si128(u, sign);
+  large = _mm_cmpgt_epi32(u, _mm_sub_epi32(f16max, _mm_set1_epi32(1)));
+  denormal = _mm_cmplt_epi32(u, normalMin);
+
+  special = _mm_or_si128(_mm_set1_epi32(0x7c00),
+                         _mm_and_si128(_mm_cmpgt_epi32(u, f32infty), _mm_set1_epi32(0x0200)));
+  small = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(u),
+                                                    _mm_castsi128_ps(denormMagic))),
+                        denormMagic);
+  odd = _mm_and_si128(_mm_srli_epi32(u, 13), _mm_set1_epi32(1));
+  normal = _mm_add_epi32(u, _mm_set1_epi32((int) (((unsigned int) (15 - 127) << 23) + 0xfff)));
+  normal = _mm_srli_epi32(_mm_add_epi32(normal, odd), 13);
+
+  h = _mm_or_si128(_mm_and_si128(denormal, small), _mm_andnot_si128(denormal, normal));
+  h = _mm_or_si128(_mm_and_si128(large, special), _mm_andnot_si128(large, h));
+  return _mm_or_si128(h, _mm_srli_epi32(sign, 16));
+}
+
+/* h holds one half in the low 16 bits of each lane. */
+MATRIX_TARGET_SSE
+static inline __m128 halfToFloatSSE(__m128i h)
+{
+  const __m128i shiftedExp = _mm_set1_epi32(0x7c00 << 13);
+  __m128i u = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x7fff)), 13),
+          exp = _mm_and_si128(u, shiftedExp),
+          special = _mm_cmpeq_epi32(exp, shiftedExp),
+          denormal = _mm_cmpeq_epi32(exp, _mm_setzero_si128());
+  __m128 renormalized;
+
+  u = _mm_add_epi32(u, _mm_set1_epi32((127 - 15) << 23));
+  u = _mm_add_epi32(u, _mm_and_si128(special, _mm_set1_epi32((128 - 16) << 23)));
+  renormalized = _mm_sub_ps(_mm_castsi128_ps(_mm_add_epi32(u, _mm_set1_epi32(1 << 23))),
+                            _mm_castsi128_ps(_mm_set1_epi32(113 << 23)));
+  u = _mm_or_si128(_mm_and_si128(denormal, _mm_castps_si128(renormalized)),
+                   _mm_andnot_si128(denormal, u));
+  u = _mm_or_si128(u, _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16));
+  return _mm_castsi128_ps(u);
+}
+
+/* Octahedral codes of four unit vectors, packed as x | y << 16. */
+MATRIX_TARGET_SSE
+static inline __m128i encodeOctahedralSSE(__m128 x, __m128 y, __m128 z)
+{
+  const __m128 one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps(),
+               snormMax = _mm_set1_ps(COMPRESS_SNORM_MAX);
+  __m128 l = _mm_add_ps(_mm_add_ps(absSSE(x), absSSE(y)), absSSE(z)),
+         inv = _mm_and_ps(_mm_cmpgt_ps(l, zero), _mm_div_ps(one, l)),
+         ox = _mm_mul_ps(x, inv), oy = _mm_mul_ps(y, inv),
+         fx = signOfSSE(_mm_sub_ps(one, absSSE(oy)), ox),
+         fy = signOfSSE(_mm_sub_ps(one, absSSE(ox)), oy),
+         lower = _mm_cmplt_ps(z, zero);
+
+  ox = _mm_or_ps(_mm_and_ps(lower, fx), _mm_andnot_ps(lower, ox));
+  oy = _mm_or_ps(_mm_and_ps(lower, fy), _mm_andnot_ps(lower, oy));
+  return packPairSSE(roundToIntSSE(_mm_mul_ps(clampSSE(ox, -1, 1), snormMax)),
+                     roundToIntSSE(_mm_mul_ps(clampSSE(oy, -1, 1), snormMax)));
+}
+
+/* Signed low and high 16 bits of each lane as normalized floats. */
+MATRIX_TARGET_SSE
+static inline void snormPairToFloatSSE(__m128 *lo, __m128 *hi, __m128i pair)
+{
+  const __m128 scale = _mm_set1_ps(1 / COMPRESS_SNORM_MAX), minusOne = _mm_set1_ps(-1.0f);
+
+  *lo = _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(pair, 16), 16)),
+                              scale), minusOne);
+  *hi = _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(pair, 16)), scale), minusOne);
+}
+
+MATRIX_TARGET_SSE
+static inline void decodeOctahedralSSE(__m128 *nx, __m128 *ny, __m128 *nz, __m128i code)
+{
+  __m128 x, y, z, t, inv;
+
+  snormPairToFloatSSE(&x, &y, code);
+  z = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(1.0f), absSSE(x)), absSSE(y));
+  t = _mm_max_ps(_mm_sub_ps(_mm_setzero_ps(), z), _mm_setzero_ps());
+  /* x < 0 ? x + t : x - t, as x - (x < 0 ? -t : t). */
+  x = _mm_sub_ps(x, signOfSSE(t, x));
+  y = _mm_sub_ps(y, signOfSSE(t, y));
+  inv = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(
+          _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z))));
+  *nx = _mm_mul_ps(x, inv);
+  *ny = _mm_mul_ps(y, inv);
+  *nz = _mm_mul_ps(z, inv);
+}
+
+MATRIX_TARGET_SSE
+static int packVerticesSSE(PackedVertex *out, const MeshVertex *vertices, int count,
+                           const PackedMeshInfo *info)
+{
+  float positionScale[3], texCoordScale[2];
+  const __m128 snormMax = _mm_set1_ps(COMPRESS_SNORM_MAX),
+               unormMax = _mm_set1_ps(COMPRESS_UNORM_MAX);
+  const __m128i w = _mm_set1_epi32((int) COMPRESS_SNORM_MAX << 16);
+  int n, k;
+
+  getPackScales(positionScale, texCoordScale, info);
+  for (n = 0; n + 4 <= count; n += 4) {
+    const float *v = vertices[n].position;
+    __m128 a0 = _mm_loadu_ps(v+0),  b0 = _mm_loadu_ps(v+4),
+           a1 = _mm_loadu_ps(v+8),  b1 = _mm_loadu_ps(v+12),
+           a2 = _mm_loadu_ps(v+16), b2 = _mm_loadu_ps(v+20),
+           a3 = _mm_loadu_ps(v+24), b3 = _mm_loadu_ps(v+28);
+    __m128i q[3], d0, d1, d2, d3;
+    __m128 p[3], u, t;
+
+    /* Rows become px py pz nx and ny nz u v. */
+    _MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+    _MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+    p[0] = a0;
+    p[1] = a1;
+    p[2] = a2;
+
+    for (k = 0; k < 3; k++)
+      q[k] = roundToIntSSE(_mm_mul_ps(clampSSE(_mm_mul_ps(
+               _mm_sub_ps(p[k], _mm_set1_ps(info->positionBias[k])),
+               _mm_set1_ps(positionScale[k])), -1, 1), snormMax));
+    d0 = packPairSSE(q[0], q[1]);
+    d1 = _mm_or_si128(_mm_and_si128(q[2], _mm_set1_epi32(0xffff)), w);
+    d2 = encodeOctahedralSSE(a3, b0, b1);
+    if (info->texCoordFormat == PACK_TEXCOORD_HALF) {
+      d3 = packPairSSE(floatToHalfSSE(b2), floatToHalfSSE(b3));
+    } else {
+      u = _mm_mul_ps(_mm_sub_ps(b2, _mm_set1_ps(info->texCoordBias[0])),
+                     _mm_set1_ps(texCoordScale[0]));
+      t = _mm_mul_ps(_mm_sub_ps(b3, _mm_set1_ps(info->texCoordBias[1])),
+                     _mm_set1_ps(texCoordScale[1]));
+      d3 = packPairSSE(roundToIntSSE(_mm_mul_ps(clampSSE(u, 0, 1), unormMax)),
+                       roundToIntSSE(_mm_mul_ps(clampSSE(t, 0, 1), unormMax)));
+    }
+
+    /* Each lane is one vertex's dword; transpose to one vertex per row. */
+    a0 = _mm_castsi128_ps(d0);
+    a1 = _mm_castsi128_ps(d1);
+    a2 = _mm_castsi128_ps(d2);
+    a3 = _mm_castsi128_ps(d3);
+    _MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+    _mm_storeu_ps((float *) &out[n+0], a0);
+    _mm_storeu_ps((float *) &out[n+1], a1);
+    _mm_storeu_ps((float *) &out[n+2], a2);
+    _mm_storeu_ps((float *) &out[n+3], a3);
+  }
+  return n;
+}
+
+MATRIX_TARGET_SSE
+static int unpackVerticesSSE(MeshVertex *out, const PackedVertex *packed, int count,
+                             const PackedMeshInfo *info)
+{
+  const __m128 unormScale = _mm_set1_ps(1 / COMPRESS_UNORM_MAX);
+  const __m128i low16 = _mm_set1_epi32(0xffff);
+  int n, k;
+
+  for (n = 0; n + 4 <= count; n += 4) {
+    __m128 d0 = _mm_loadu_ps((const float *) &packed[n+0]),
+           d1 = _mm_loadu_ps((const float *) &packed[n+1]),
+           d2 = _mm_loadu_ps((const float *) &packed[n+2]),
+           d3 = _mm_loadu_ps((const float *) &packed[n+3]);
+    __m128 p[3], w, nx, ny, nz, u, t;
+    __m128i uv;
+    float *v = out[n].position;
+
+    _MM_TRANSPOSE4_PS(d0, d1, d2, d3);
+    snormPairToFloatSSE(&p[0], &p[1], _mm_castps_si128(d0));
+    snormPairToFloatSSE(&p[2], &w, _mm_castps_si128(d1));
+    for (k = 0; k < 3; k++)
+      p[k] = _mm_add_ps(_mm_mul_ps(p[k], _mm_set1_ps(info->positionScale[k])),
+                        _mm_set1_ps(info->positionBias[k]));
+    decodeOctahedralSSE(&nx, &ny, &nz, _mm_castps_si128(d2));
+    uv = _mm_castps_si128(d3);
+    if (info->texCoordFormat == PACK_TEXCOORD_HALF) {
+      u = halfToFloatSSE(_mm_and_si128(uv, low16));
+      t = halfToFloatSSE(_mm_srli_epi32(uv, 16));
+    } else {
+      u = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(uv, low16)), unormScale),
+                                _mm_set1_ps(info->texCoordScale[0])),
+                     _mm_set1_ps(info->texCoordBias[0]));
+      t = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(uv, 16)), unormScale),
+                                _mm_set1_ps(info->texCoordScale[1])),
+                     _mm_set1_ps(info->texCoordBias[1]));
+    }
+
+    _MM_TRANSPOSE4_PS(p[0], p[1], p[2], nx);
+    _MM_TRANSPOSE4_PS(ny, nz, u, t);
+    _mm_storeu_ps(v+0, p[0]);
+    _mm_storeu_ps(v+4, ny);
+    _mm_storeu_ps(v+8, p[1]);
+    _mm_storeu_ps(v+12, nz);
+    _mm_storeu_ps(v+16, p[2]);
+    _mm_storeu_ps(v+20, u);
+    _mm_storeu_ps(v+24, nx);
+    _mm_storeu_ps(v+28, t);
+  }
+  return n;
+}
+
+MATRIX_TARGET_SSE
+static int encodeOctahedralArraySSE(short *out, const float *v, int stride, int count)
+{
+  int n;
+
+  for (n = 0; n + 4 <= count; n += 4) {
+    const float *a = v + n*stride, *b = a + stride, *c = b + stride, *d = c + stride;
+
+    _mm_storeu_si128((__m128i *) (out + 2*n), encodeOctahedralSSE(
+      _mm_set_ps(d[0], c[0], b[0], a[0]), _mm_set_ps(d[1], c[1], b[1], a[1]),
+      _mm_set_ps(d[2], c[2], b[2], a[2])));
+  }
+  return n;
+}
+
+MATRIX_TARGET_SSE
+static int decodeOctahedralArraySSE(float *v, int stride, const short *in, int count)
+{
+  int n, i;
+
+  for (n = 0; n + 4 <= count; n += 4) {
+    float x[4], y[4], z[4];
+    __m128 nx, ny, nz;
+
+    decodeOctahedralSSE(&nx, &ny, &nz, _mm_loadu_si128((const __m128i *) (in + 2*n)));
+    _mm_storeu_ps(x, nx);
+    _mm_storeu_ps(y, ny);
+    _mm_storeu_ps(z, nz);
+    for (i = 0; i < 4; i++) {
+      float *p = v + (n+i)*stride;
+
+      p[0] = x[i];
+      p[1] = y[i];
+      p[2] = z[i];
+    }
+  }
+  return n;
+}
+
+#endif /* MATRIX_HAVE_SSE */
+
+void packVertices(PackedVertex *out, const MeshVertex *vertices, int count,
+                  const PackedMeshInfo *info)
+{
+  int done = 0;
+
+#ifdef MATRIX_HAVE_SSE
+  if (getMatrixSimdLevel() >= MATRIX_SIMD_SSE)
+    done = packVerticesSSE(out, vertices, count, info);
+#endif
+  packVerticesScalar(out + done, vertices + done, count - done, info);
+}
+
+void unpackVertices(MeshVertex *out, const PackedVertex *packed, int count,
+                    const PackedMeshInfo *info)
+{
+  int done = 0;
+
+#ifdef MATRIX_HAVE_SSE
+  if (getMatrixSimdLevel() >= MATRIX_SIMD_SSE)
+    done = unpackVerticesSSE(out, packed, count, info);
+#endif
+  unpackVerticesScalar(out + done, packed + done, count - done, info);
+}
+
+void encodeOctahedralArray(short *out, const float *v, int stride, int count)
+{
+  int i = 0;
+
+#ifdef MATRIX_HAVE_SSE
+  if (getMatrixSimdLevel() >= MATRIX_SIMD_SSE)
+    i = encodeOctahedralArraySSE(out, v, stride, count);
+#endif
+  for (; i < count; i++)
+    encodeOctahedral(out + 2*i, v[i*stride], v[i*stride + 1], v[i*stride + 2]);
+}
+
+void decodeOctahedralArray(float *v, int stride, const short *in, int count)
+{
+  int i = 0;
+
+#ifdef MATRIX_HAVE_SSE
+  if (getMatrixSimdLevel() >= MATRIX_SIMD_SSE)
+    i = decodeOctahedralArraySSE(v, stride, in, count);
+#endif
+  for (; i < count; i++)
+    decodeOctahedral(v + i*stride, in + 2*i);
+}
@@ -0,0 +1,77 @@
+/* compress.h - Compact vertex formats: quantized positions, 16-bit texture coordinates, octahedral normals. */
+
+/* A MeshVertex is 32 bytes of floats.  A PackedVertex holds the same
+   vertex in 16 bytes, in types a Direct3D 9 vertex declaration reads
+   directly:
+
+     position  D3DDECLTYPE_SHORT4N   x, y, z in [-1, 1] across the mesh's
+                                     box, w = 1; the vertex shader (or the
+                                     world matrix) applies the box's
+                                     scale and bias
+     normal    D3DDECLTYPE_SHORT2N   octahedral: the unit sphere folded
+                                     onto a square, unfolded in the shader
+     texCoord  D3DDECLTYPE_FLOAT16_2 half floats, or
+               D3DDECLTYPE_USHORT2N  [0, 1] across the mesh's range of
+                                     texture coordinates, with a scale
+                                     and bias like the position's
+
+   Quantizing costs at most half a step: 1/65534 of the box's size for
+   positions, 1/131070 of the range for 16-bit texture coordinates, and
+   0.004 degrees for normals.  Half floats keep 11 bits of mantissa,
+   enough for texture coordinates that stay within a few repeats.
+
+   Tangents, or any other unit vectors, pack into two shorts each with
+   encodeOctahedralArray.
+
+   packVertices and unpackVertices work on four vertices at a time with
+   SSE2 at MATRIX_SIMD_SSE and above (see matrix.h); the scalar versions
+   give the same results. */
+
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include "mesh.h"
+
+typedef struct {
+  short position[4];
+  short normal[2];
+  unsigned short texCoord[2];
+} PackedVertex;
+
+typedef enum {
+  PACK_TEXCOORD_HALF    = 0,
+  PACK_TEXCOORD_UNORM16 = 1
+} PackTexCoordFormat;
+
+/* What a mesh's packed vertices decode with:
+   position = packed * positionScale + positionBias, and for
+   PACK_TEXCOORD_UNORM16 texCoord = packed * texCoordScale + texCoordBias,
+   with packed as the normalized value the vertex declaration reads. */
+typedef struct {
+  float positionScale[3], positionBias[3];
+  float texCoordScale[2], texCoordBias[2];
+  PackTexCoordFormat texCoordFormat;
+} PackedMeshInfo;
+
+/* Fit info to vertices[0..count). */
+void getPackedMeshInfo(PackedMeshInfo *info, const MeshVertex *vertices, int count,
+                       PackTexCoordFormat texCoordFormat);
+
+void packVertices(PackedVertex *out, const MeshVertex *vertices, int count,
+                  const PackedMeshInfo *info);
+
+/* The CPU's decode, for code that needs the vertices back as floats. */
+void unpackVertices(MeshVertex *out, const PackedVertex *packed, int count,
+                    const PackedMeshInfo *info);
+
+/* out[2*i], out[2*i+1] = octahedral code of the unit vector at
+   v + i*stride floats. */
+void encodeOctahedralArray(short *out, const float *v, int stride, int count);
+
+/* The unit vector of each code, written to v + i*stride floats. */
+void decodeOctahedralArray(float *v, int stride, const short *in, int count);
+
+unsigned short floatToHalf(float f);
+float halfToFloat(unsigned short h);
+
+#endif /* COMPRESS_H */
@@ -0,0 +1,438 @@
+/* daefile.c - COLLADA (.dae) scenes read as a stream of the values a renderer needs. */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "daefile.h"
+#include "matrix.h"
+#include "matrix_simd.h"
+#include "objfile.h"
+
+/* Zero bytes kept after the buffered text, so a number's 16-byte load
+   (after its sign) never reads past the buffer. */
+#define DAE_PADDING 32
+
+/* Numbers longer than this may be cut at a refill. */
+#define DAE_NUMBER_SIZE 64
+
+/* What an open element is to the reader. */
+enum {
+  DAE_SCOPE_OTHER = 0,
+  DAE_SCOPE_OWNER,    /* node, material, effect: named in events inside it */
+  DAE_SCOPE_PARAM     /* setparam, newparam: its value is a DAE_PARAM */
+};
+
+static int isSpace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/* Keep the unread text, move it to the front of the buffer, and read
+   more after it.  Return 0 if nothing more can be read. */
+static int refill(DaeReader *r)
+{
+  size_t kept = r->end - r->p, n;
+
+  if (r->eof || kept == DAE_BUFFER_SIZE)
+    return 0;
+  memmove(r->buffer, r->p, kept);
+  n = fread(r->buffer + kept, 1, DAE_BUFFER_SIZE - kept, r->file);
+  r->p = r->buffer;
+  r->end = r->buffer + kept + n;
+  memset(r->buffer + kept + n, 0, DAE_PADDING);
+  r->eof = n < DAE_BUFFER_SIZE - kept;
+  return n > 0;
+}
+
+/* At least n bytes at p unless the file ends first. */
+static void ensure(DaeReader *r, size_t n)
+{
+  while ((size_t) (r->end - r->p) < n && refill(r))
+    ;
+}
+
+/* Move p to the next c, dropping the text before it; 0 if there is none. */
+static int skipTo(DaeReader *r, char c)
+{
+  for (;;) {
+    const char *q = (const char *) memchr(r->p, c, r->end - r->p);
+
+    if (q) {
+      r->p = q;
+      return 1;
+    }
+    r->p = r->end;
+    if (!refill(r))
+      return 0;
+  }
+}
+
+/* Move p past the next s; 0 if there is none. */
+static int skipPast(DaeReader *r, const char *s)
+{
+  size_t n = strlen(s);
+
+  for (;;) {
+    const char *q;
+
+    for (q = r->p; q + n <= r->end; q++)
+      if (*q == s[0] && memcmp(q, s, n) == 0) {
+        r->p = q + n;
+        return 1;
+      }
+    if ((size_t) (r->end - r->p) >= n)
+      r->p = r->end - (n - 1);
+    if (!refill(r))
+      return 0;
+  }
+}
+
+/* Whether the next markup, after any text, is an end tag. */
+static int isEndTagNext(DaeReader *r)
+{
+  if (!skipTo(r, '<'))
+    return 0;
+  ensure(r, 2);
+  return r->p[1] == '/';
+}
+
+/* Buffer the whole tag at p and return its '>', or NULL. */
+static const char *bufferTag(DaeReader *r)
+{
+  size_t from = 1;
+
+  for (;;) {
+    const char *q = (const char *) memchr(r->p + from, '>', r->end - r->p - from);
+
+    if (q)
+      return q;
+    from = r->end - r->p;
+    if (!refill(r))
+      return NULL;
+  }
+}
+
+static void copyName(char *out, const char *begin, const char *end)
+{
+  size_t n = end - begin < DAE_NAME_SIZE ? end - begin : DAE_NAME_SIZE - 1;
+
+  memcpy(out, begin, n);
+  out[n] = 0;
+}
+
+/* The value of attribute name in the tag [p, end) into out; 0 if it has none. */
+static int getAttribute(char *out, const char *p, const char *end, const char *name)
+{
+  size_t n = strlen(name);
+
+  while (p < end) {
+    const char *nameEnd, *value, *valueEnd;
+
+    while (p < end && !isSpace(*p))
+      p++;
+    while (p < end && isSpace(*p))
+      p++;
+    for (nameEnd = p; nameEnd < end && *nameEnd != '=' && !isSpace(*nameEnd); nameEnd++)
+      ;
+    for (value = nameEnd; value < end && *value != '"' && *value != '\''; value++)
+      ;
+    if (value == end)
+      return 0;
+    valueEnd = (const char *) memchr(value + 1, *value, end - value - 1);
+    if (!valueEnd)
+      return 0;
+    if ((size_t) (nameEnd - p) == n && memcmp(p, name, n) == 0) {
+      copyName(out, value + 1, valueEnd);
+      return 1;
+    }
+    p = valueEnd;
+  }
+  return 0;
+}
+
+/* How many numbers a param value element holds: float 1, floatN N,
+   floatNxM N*M; 0 for any other element. */
+static int getParamSize(const char *element)
+{
+  const char *s = element + 5;
+
+  if (strncmp(element, "float", 5) != 0)
+    return 0;
+  if (s[0] == 0)
+    return 1;
+  if (s[0] >= '2' && s[0] <= '4' && s[1] == 0)
+    return s[0] - '0';
+  if (s[0] >= '2' && s[0] <= '4' && s[1] == 'x' && s[2] >= '2' && s[2] <= '4' && s[3] == 0)
+    return (s[0] - '0') * (s[2] - '0');
+  return 0;
+}
+
+#ifdef MATRIX_HAVE_SSE
+
+static const double myPowersOfTen[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15
+};
+
+static int countTrailingZeros(unsigned int x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctz(x);
+#elif defined(_MSC_VER)
+  unsigned long i;
+
+  _BitScanForward(&i, x);
+  return (int) i;
+#else
+  int n = 0;
+
+  for (; !(x & 1); x >>= 1)
+    n++;
+  return n;
+#endif
+}
+
+/* parseObjFloat for a number of at most 15 digits, an optional point
+   and no exponent, from one 16-byte load: the digits before the point
+   move up a byte over it, so all of them sit in bytes 1..15 after a
+   zero, and two rounds of multiply-adds join them into two 8-digit
+   halves.  The mantissa is exact, so dividing by one power of ten
+   rounds as parseObjFloat does.  Anything else goes to parseObjFloat.
+   Reads 17 bytes from p whatever end is. */
+MATRIX_TARGET_SSE
+static const char *parseFloatSSE(const char *p, const char *end, float *value)
+{
+  const char *start = p;
+  int negative = *p == '-';
+  __m128i c, d, index, isDigit, before, lo, hi, pairs, quads, halves;
+  int mask, dots, length, point, digits, fraction;
+  double mantissa;
+
+  p += negative || *p == '+';
+  c = _mm_loadu_si128((const __m128i *) p);
+  d = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+  isDigit = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+  mask = _mm_movemask_epi8(isDigit);
+  dots = _mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8('.')));
+  if ((mask | dots) == 0xffff)
+    return parseObjFloat(start, end, value);
+  length = countTrailingZeros(~(mask | dots));
+  dots &= (1 << length) - 1;
+  digits = length - (dots != 0);
+  if (digits == 0 || (dots & (dots - 1)) != 0 || p[length] == 'e' || p[length] == 'E' ||
+      p + length > end)
+    return parseObjFloat(start, end, value);
+  point = dots ? countTrailingZeros(dots) : length;
+  fraction = dots ? length - point - 1 : 0;
+
+  index = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  isDigit = _mm_and_si128(isDigit, _mm_cmpgt_epi8(_mm_set1_epi8((char) length), index));
+  d = _mm_and_si128(d, isDigit);
+  before = _mm_cmpgt_epi8(_mm_set1_epi8((char) (point + 1)), index);
+  d = _mm_or_si128(_mm_and_si128(before, _mm_slli_si128(d, 1)), _mm_andnot_si128(before, d));
+
+  lo = _mm_madd_epi16(_mm_unpacklo_epi8(d, _mm_setzero_si128()),
+                      _mm_setr_epi16(10, 1, 10, 1, 10, 1, 10, 1));
+  hi = _mm_madd_epi16(_mm_unpackhi_epi8(d, _mm_setzero_si128()),
+                      _mm_setr_epi16(10, 1, 10, 1, 10, 1, 10, 1));
+  pairs = _mm_packs_epi32(lo, hi);
+  quads = _mm_madd_epi16(pairs, _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1));
+  halves = _mm_madd_epi16(_mm_packs_epi32(quads, quads),
+                          _mm_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1));
+
+  /* The last digit is in byte digits, worth 10^(15 - digits). */
+  mantissa = _mm_cvtsi128_si32(halves) * 1e8 + _mm_cvtsi128_si32(_mm_srli_si128(halves, 4));
+  mantissa /= myPowersOfTen[15 - digits + fraction];
+  *value = (float) (negative ? -mantissa : mantissa);
+  return p + length;
+}
+
+#endif /* MATRIX_HAVE_SSE */
+
+/* Up to count numbers of the element text at p into values; stops at
+   the next tag.  Return how many, setting r->failed on a malformed one. */
+static int parseFloats(DaeReader *r, float *values, int count)
+{
+  int sse = 0, i;
+
+#ifdef MATRIX_HAVE_SSE
+  sse = getMatrixSimdLevel() >= MATRIX_SIMD_SSE;
+#endif
+  for (i = 0; i < count; i++) {
+    const char *q;
+
+    for (;;) {
+      while (r->p < r->end && isSpace(*r->p))
+        r->p++;
+      if (r->p < r->end || !refill(r))
+        break;
+    }
+    if (r->p == r->end || *r->p == '<')
+      break;
+    if (r->end - r->p < DAE_NUMBER_SIZE)
+      ensure(r, DAE_NUMBER_SIZE);
+#ifdef MATRIX_HAVE_SSE
+    if (sse)
+      q = parseFloatSSE(r->p, r->end, &values[i]);
+    else
+#endif
+      q = parseObjFloat(r->p, r->end, &values[i]);
+    if (!q || (q < r->end && !isSpace(*q) && *q != '<')) {
+      r->failed = 1;
+      break;
+    }
+    r->p = q;
+  }
+  (void) sse;
+  return i;
+}
+
+int openDaeFile(DaeReader *reader, const char *path)
+{
+  memset(reader, 0, sizeof(*reader));
+  reader->file = fopen(path, "rb");
+  if (!reader->file)
+    return 0;
+  reader->buffer = new char[DAE_BUFFER_SIZE + DAE_PADDING];
+  reader->p = reader->end = reader->buffer;
+  memset(reader->buffer, 0, DAE_PADDING);
+  return 1;
+}
+
+void closeDaeFile(DaeReader *reader)
+{
+  if (reader->file)
+    fclose(reader->file);
+  delete [] reader->buffer;
+  memset(reader, 0, sizeof(*reader));
+}
+
+/* The id of the innermost open node, material or effect. */
+static const char *getOwner(const DaeReader *r)
+{
+  int i;
+
+  for (i = r->depth - 1; i >= 0; i--)
+    if (r->scopes[i].kind == DAE_SCOPE_OWNER)
+      return r->scopes[i].id;
+  return "";
+}
+
+int readDaeEvent(DaeReader *r, DaeEvent *event)
+{
+  memset(event, 0, sizeof(*event));
+  r->arrayLeft = 0;
+  while (!r->failed) {
+    const char *tag, *tagEnd, *nameEnd;
+    const DaeScope *parent = r->depth > 0 ? &r->scopes[r->depth - 1] : NULL;
+    DaeScope *scope;
+    int closed, size;
+
+    /* Text between tags is skipped, the float_array's too. */
+    if (!skipTo(r, '<')) {
+      r->failed = r->depth != 0;
+      return 0;
+    }
+    ensure(r, 9);
+    if (r->p[1] == '/') {
+      if (!skipTo(r, '>') || r->depth == 0)
+        break;
+      r->depth--;
+      r->p++;
+      continue;
+    }
+    if (r->p[1] == '?' || r->p[1] == '!') {
+      if (!skipPast(r, strncmp(r->p, "<!--", 4) == 0 ? "-->" :
+                       strncmp(r->p, "<![CDATA[", 9) == 0 ? "]]>" :
+                       r->p[1] == '?' ? "?>" : ">"))
+        break;
+      continue;
+    }
+
+    tagEnd = bufferTag(r);
+    if (!tagEnd)
+      break;
+    tag = r->p + 1;
+    for (nameEnd = tag; nameEnd < tagEnd && !isSpace(*nameEnd) && *nameEnd != '/'; nameEnd++)
+      ;
+    closed = tagEnd[-1] == '/';
+    copyName(event->element, tag, nameEnd);
+    strcpy(event->owner, getOwner(r));
+    if (!closed) {
+      if (r->depth == DAE_MAX_DEPTH)
+        break;
+      scope = &r->scopes[r->depth++];
+      scope->kind = DAE_SCOPE_OTHER;
+      scope->id[0] = 0;
+    } else {
+      scope = NULL;
+    }
+    r->p = tagEnd + 1;
+
+    if (strcmp(event->element, "node") == 0 || strcmp(event->element, "material") == 0 ||
+        strcmp(event->element, "effect") == 0) {
+      if (scope) {
+        scope->kind = DAE_SCOPE_OWNER;
+        getAttribute(scope->id, nameEnd, tagEnd, "id");
+      }
+      if (event->element[0] == 'n') {
+        event->type = DAE_NODE;
+        getAttribute(event->id, nameEnd, tagEnd, "id");
+        return 1;
+      }
+    } else if (strcmp(event->element, "setparam") == 0 ||
+               strcmp(event->element, "newparam") == 0) {
+      if (scope) {
+        scope->kind = DAE_SCOPE_PARAM;
+        if (!getAttribute(scope->id, nameEnd, tagEnd, "ref"))
+          getAttribute(scope->id, nameEnd, tagEnd, "sid");
+      }
+    } else if (strncmp(event->element, "instance_", 9) == 0 ||
+               strcmp(event->element, "import") == 0) {
+      event->type = DAE_INSTANCE;
+      if (!getAttribute(event->url, nameEnd, tagEnd, "url"))
+        getAttribute(event->url, nameEnd, tagEnd, "target");
+      if (!getAttribute(event->id, nameEnd, tagEnd, "name") &&
+          !getAttribute(event->id, nameEnd, tagEnd, "symbol"))
+        getAttribute(event->id, nameEnd, tagEnd, "sid");
+      return 1;
+    } else if (strcmp(event->element, "matrix") == 0 && scope) {
+      event->type = DAE_MATRIX;
+      event->count = parseFloats(r, event->values, 16);
+      if (event->count != 16 || !isEndTagNext(r))
+        break;
+      return 1;
+    } else if (strcmp(event->element, "float_array") == 0 && scope) {
+      char count[DAE_NAME_SIZE];
+
+      event->type = DAE_FLOAT_ARRAY;
+      getAttribute(event->id, nameEnd, tagEnd, "id");
+      if (!getAttribute(count, nameEnd, tagEnd, "count") || (event->count = atoi(count)) < 0)
+        break;
+      r->arrayLeft = event->count;
+      return 1;
+    } else if (parent && parent->kind == DAE_SCOPE_PARAM && scope &&
+               (size = getParamSize(event->element)) > 0) {
+      event->type = DAE_PARAM;
+      strcpy(event->id, parent->id);
+      event->count = parseFloats(r, event->values, size);
+      if (event->count != size || !isEndTagNext(r))
+        break;
+      return 1;
+    }
+  }
+  r->failed = 1;
+  return 0;
+}
+
+int readDaeFloats(DaeReader *reader, float *values, int count)
+{
+  int n;
+
+  if (count > reader->arrayLeft)
+    count = reader->arrayLeft;
+  n = parseFloats(reader, values, count);
+  reader->arrayLeft -= n;
+  if (n < count)
+    reader->failed = 1;
+  return n;
+}
@@ -0,0 +1,97 @@
+/* daefile.h - COLLADA (.dae) scenes read as a stream of the values a renderer needs. */
+
+/* FX Composer saves a project's scene as COLLADA: nodes with <matrix>
+   transforms and <instance_...> references to geometry, lights, cameras
+   and materials, materials whose <setparam> values feed an effect that
+   <import>s an .fx file, and geometry as <float_array> text.
+
+   A DaeReader pulls these out one event at a time without building a
+   tree.  The file is read through a fixed buffer of DAE_BUFFER_SIZE
+   bytes and the open elements are kept in a fixed stack, so memory stays
+   the same whatever the file's size.  Each event is one of
+
+     DAE_NODE         a <node>; id is its id, owner its parent node's
+     DAE_MATRIX       a <matrix> of its node (owner): 16 values, row by
+                      row as matrix.h keeps them, translation in values[3],
+                      [7] and [11]
+     DAE_INSTANCE     an <instance_...> element, or an effect's <import>:
+                      element is its name, url its url (or target), id its
+                      name (or symbol, or sid), owner the enclosing node,
+                      material or effect
+     DAE_PARAM        a float, floatN or floatNxM value of a <setparam> or
+                      <newparam>: id is its ref (or sid), owner the
+                      material or effect, values its count numbers
+     DAE_FLOAT_ARRAY  a <float_array>: id and count from its attributes;
+                      its numbers go straight into the caller's buffer
+                      with readDaeFloats before the next readDaeEvent
+                      (or are skipped)
+
+   Numbers are parsed as parseObjFloat (objfile.h) does, giving the same
+   floats; with SSE2 at MATRIX_SIMD_SSE and above (see matrix.h) one with
+   at most 15 digits and no exponent is read 16 characters at a time.
+
+   This is not a validating parser: end tags are not matched against
+   start tags, entities are not expanded, a tag must fit in the buffer,
+   and names, ids and urls longer than DAE_NAME_SIZE - 1 are cut. */
+
+#ifndef DAEFILE_H
+#define DAEFILE_H
+
+#include <stdio.h>
+
+#define DAE_BUFFER_SIZE 65536
+#define DAE_MAX_DEPTH 64
+#define DAE_NAME_SIZE 128
+
+typedef enum {
+  DAE_NODE = 1,
+  DAE_MATRIX,
+  DAE_INSTANCE,
+  DAE_PARAM,
+  DAE_FLOAT_ARRAY
+} DaeEventType;
+
+typedef struct {
+  DaeEventType type;
+  char element[DAE_NAME_SIZE];   /* "node", "matrix", "instance_light", "float4x4", ... */
+  char id[DAE_NAME_SIZE];
+  char url[DAE_NAME_SIZE];
+  char owner[DAE_NAME_SIZE];     /* Id of the enclosing node, material or effect, or "" */
+  float values[16];
+  int count;                     /* Of values, or of the float_array's numbers */
+} DaeEvent;
+
+typedef struct {
+  char kind;                     /* What the element is to the reader (daefile.cpp) */
+  char id[DAE_NAME_SIZE];
+} DaeScope;
+
+typedef struct {
+  FILE *file;
+  char *buffer;                  /* DAE_BUFFER_SIZE bytes, then zeros */
+  const char *p, *end;           /* Unread text in buffer */
+  int eof, failed;
+  int depth;
+  DaeScope scopes[DAE_MAX_DEPTH];
+  int arrayLeft;                 /* Numbers of the float_array not yet read */
+} DaeReader;
+
+/* Open path for reading; close it with closeDaeFile.  Return 1 on
+   success and 0 if the file cannot be opened. */
+int openDaeFile(DaeReader *reader, const char *path);
+
+void closeDaeFile(DaeReader *reader);
+
+/* Read the next event into event.  Return 1 for an event and 0 at the
+   end of the document, or on an error: then reader->failed is set (a
+   malformed number, a wrong count of values, an unclosed element or
+   comment, a tag longer than the buffer, or nesting deeper than
+   DAE_MAX_DEPTH). */
+int readDaeEvent(DaeReader *reader, DaeEvent *event);
+
+/* Read up to count numbers of the DAE_FLOAT_ARRAY just returned into
+   values, following on from any read before, and return how many.
+   Fewer numbers in the text than the array's count sets reader->failed. */
+int readDaeFloats(DaeReader *reader, float *values, int count);
+
+#endif /* DAEFILE_H */
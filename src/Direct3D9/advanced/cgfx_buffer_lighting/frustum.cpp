@@ -0,0 +1,291 @@
+/* frustum.c - View frustum planes and culling of bounding spheres and boxes. */
+
+/* A sphere is outside when its center is more than its radius behind any
+   plane.  A box is outside when its corner farthest along a plane's
+   normal (the "positive vertex", picked per plane from the signs of the
+   normal) is behind that plane.  Visible indices are appended without
+   branches: every index is written, and the output position only
+   advances past the visible ones. */
+
+#include <math.h>
+
+#include "matrix.h"
+#include "frustum.h"
+#include "matrix_precision.h"
+#include "matrix_simd.h"
+
+/* Gribb and Hartmann: a clip-space point is inside when -w <= x <= w,
+   and so on, so with rows r0..r3 of m the planes are r3 + r0, r3 - r0,
+   r3 + r1, r3 - r1, r3 + r2, and r3 - r2. */
+void makeFrustumPlanes(const float m[16], float planes[24])
+{
+  int i, j;
+
+  for (i=0; i<6; i++) {
+    MatrixReal sign = (i & 1) ? -1 : 1;
+    MatrixReal p[4], mag;
+
+    for (j=0; j<4; j++)
+      p[j] = (MatrixReal) m[12+j] + sign * m[(i/2)*4+j];
+    mag = (MatrixReal) sqrt((MatrixWide) p[0]*p[0] + (MatrixWide) p[1]*p[1] +
+                            (MatrixWide) p[2]*p[2]);
+    if (mag == 0)
+      mag = 1;
+    for (j=0; j<4; j++)
+      planes[i*4+j] = (float) (p[j] / mag);
+  }
+}
+
+static int cullSpheresScalar(int *visible, int base, const float planes[24],
+                             const float *x, const float *y, const float *z, const float *r,
+                             int count)
+{
+  int n, i, k = 0;
+
+  for (n=0; n<count; n++) {
+    int inside = 1;
+
+    for (i=0; i<6; i++) {
+      const float *p = planes + i*4;
+      float d = p[0]*x[n] + p[1]*y[n] + p[2]*z[n] + p[3];
+
+      inside &= d + r[n] >= 0;
+    }
+    visible[k] = base + n;
+    k += inside;
+  }
+  return k;
+}
+
+/* Per plane, the box corner farthest along the normal. */
+static void positiveVertices(const float *corner[6][3], const float planes[24],
+                             const float *minX, const float *minY, const float *minZ,
+                             const float *maxX, const float *maxY, const float *maxZ)
+{
+  int i;
+
+  for (i=0; i<6; i++) {
+    corner[i][0] = planes[i*4+0] >= 0 ? maxX : minX;
+    corner[i][1] = planes[i*4+1] >= 0 ? maxY : minY;
+    corner[i][2] = planes[i*4+2] >= 0 ? maxZ : minZ;
+  }
+}
+
+static int cullBoxesScalar(int *visible, int base, const float planes[24],
+                           const float *corner[6][3], int offset, int count)
+{
+  int n, i, k = 0;
+
+  for (n=offset; n<offset+count; n++) {
+    int inside = 1;
+
+    for (i=0; i<6; i++) {
+      const float *p = planes + i*4;
+      float d = p[0]*corner[i][0][n] + p[1]*corner[i][1][n] + p[2]*corner[i][2][n] + p[3];
+
+      inside &= d >= 0;
+    }
+    visible[k] = base + n;
+    k += inside;
+  }
+  return k;
+}
+
+#ifdef MATRIX_HAVE_SSE
+
+static int appendVisible4(int *visible, int base, int mask)
+{
+  int i, k = 0;
+
+  for (i=0; i<4; i++) {
+    visible[k] = base + i;
+    k += (mask >> i) & 1;
+  }
+  return k;
+}
+
+/* *done is set to how many volumes were tested; the return value is how
+   many indices were written. */
+MATRIX_TARGET_SSE
+static int cullSpheresSSE(int *visible, const float planes[24],
+                          const float *x, const float *y, const float *z, const float *r,
+                          int count, int *done)
+{
+  const __m128 zero = _mm_setzero_ps();
+  __m128 p[6][4];
+  int n, i, k = 0;
+
+  for (i=0; i<24; i++)
+    p[i/4][i%4] = _mm_set1_ps(planes[i]);
+
+  for (n=0; n+4<=count; n+=4) {
+    __m128 vx = _mm_loadu_ps(x+n), vy = _mm_loadu_ps(y+n),
+           vz = _mm_loadu_ps(z+n), vr = _mm_loadu_ps(r+n);
+    __m128 inside = _mm_cmpeq_ps(zero, zero);
+
+    for (i=0; i<6; i++) {
+      __m128 d = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(p[i][0], vx), _mm_mul_ps(p[i][1], vy)),
+                                       _mm_mul_ps(p[i][2], vz)), p[i][3]);
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, vr), zero));
+    }
+    k += appendVisible4(visible + k, n, _mm_movemask_ps(inside));
+  }
+  *done = n;
+  return k;
+}
+
+MATRIX_TARGET_SSE
+static int cullBoxesSSE(int *visible, const float planes[24],
+                        const float *corner[6][3], int count, int *done)
+{
+  const __m128 zero = _mm_setzero_ps();
+  __m128 p[6][4];
+  int n, i, k = 0;
+
+  for (i=0; i<24; i++)
+    p[i/4][i%4] = _mm_set1_ps(planes[i]);
+
+  for (n=0; n+4<=count; n+=4) {
+    __m128 inside = _mm_cmpeq_ps(zero, zero);
+
+    for (i=0; i<6; i++) {
+      __m128 d = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+                   _mm_mul_ps(p[i][0], _mm_loadu_ps(corner[i][0]+n)),
+                   _mm_mul_ps(p[i][1], _mm_loadu_ps(corner[i][1]+n))),
+                   _mm_mul_ps(p[i][2], _mm_loadu_ps(corner[i][2]+n))), p[i][3]);
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(d, zero));
+    }
+    k += appendVisible4(visible + k, n, _mm_movemask_ps(inside));
+  }
+  *done = n;
+  return k;
+}
+
+#endif /* MATRIX_HAVE_SSE */
+
+#ifdef MATRIX_HAVE_AVX2
+
+static int appendVisible8(int *visible, int base, int mask)
+{
+  int i, k = 0;
+
+  for (i=0; i<8; i++) {
+    visible[k] = base + i;
+    k += (mask >> i) & 1;
+  }
+  return k;
+}
+
+MATRIX_TARGET_AVX2
+static int cullSpheresAVX2(int *visible, const float planes[24],
+                           const float *x, const float *y, const float *z, const float *r,
+                           int count, int *done)
+{
+  const __m256 zero = _mm256_setzero_ps();
+  __m256 p[6][4];
+  int n, i, k = 0;
+
+  for (i=0; i<24; i++)
+    p[i/4][i%4] = _mm256_set1_ps(planes[i]);
+
+  for (n=0; n+8<=count; n+=8) {
+    __m256 vx = _mm256_loadu_ps(x+n), vy = _mm256_loadu_ps(y+n),
+           vz = _mm256_loadu_ps(z+n), vr = _mm256_loadu_ps(r+n);
+    __m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+
+    for (i=0; i<6; i++) {
+      __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(p[i][0], vx),
+                                                           _mm256_mul_ps(p[i][1], vy)),
+                                             _mm256_mul_ps(p[i][2], vz)), p[i][3]);
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(d, vr), zero, _CMP_GE_OQ));
+    }
+    k += appendVisible8(visible + k, n, _mm256_movemask_ps(inside));
+  }
+  *done = n;
+  return k;
+}
+
+MATRIX_TARGET_AVX2
+static int cullBoxesAVX2(int *visible, const float planes[24],
+                         const float *corner[6][3], int count, int *done)
+{
+  const __m256 zero = _mm256_setzero_ps();
+  __m256 p[6][4];
+  int n, i, k = 0;
+
+  for (i=0; i<24; i++)
+    p[i/4][i%4] = _mm256_set1_ps(planes[i]);
+
+  for (n=0; n+8<=count; n+=8) {
+    __m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+
+    for (i=0; i<6; i++) {
+      __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+                   _mm256_mul_ps(p[i][0], _mm256_loadu_ps(corner[i][0]+n)),
+                   _mm256_mul_ps(p[i][1], _mm256_loadu_ps(corner[i][1]+n))),
+                   _mm256_mul_ps(p[i][2], _mm256_loadu_ps(corner[i][2]+n))), p[i][3]);
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, zero, _CMP_GE_OQ));
+    }
+    k += appendVisible8(visible + k, n, _mm256_movemask_ps(inside));
+  }
+  *done = n;
+  return k;
+}
+
+#endif /* MATRIX_HAVE_AVX2 */
+
+int cullSpheres(int *visible, const float planes[24],
+                const float *x, const float *y, const float *z, const float *r,
+                int count)
+{
+  int done = 0, k = 0;
+
+  if (count <= 0)
+    return 0;
+
+  switch (getMatrixSimdLevel()) {
+#ifdef MATRIX_HAVE_AVX2
+  case MATRIX_SIMD_AVX2:
+    k = cullSpheresAVX2(visible, planes, x, y, z, r, count, &done);
+    break;
+#endif
+#ifdef MATRIX_HAVE_SSE
+  case MATRIX_SIMD_SSE:
+    k = cullSpheresSSE(visible, planes, x, y, z, r, count, &done);
+    break;
+#endif
+  default:
+    break;
+  }
+  return k + cullSpheresScalar(visible + k, done, planes,
+                               x + done, y + done, z + done, r + done, count - done);
+}
+
+int cullBoxes(int *visible, const float planes[24],
+              const float *minX, const float *minY, const float *minZ,
+              const float *maxX, const float *maxY, const float *maxZ,
+              int count)
+{
+  const float *corner[6][3];
+  int done = 0, k = 0;
+
+  if (count <= 0)
+    return 0;
+
+  positiveVertices(corner, planes, minX, minY, minZ, maxX, maxY, maxZ);
+  switch (getMatrixSimdLevel()) {
+#ifdef MATRIX_HAVE_AVX2
+  case MATRIX_SIMD_AVX2:
+    k = cullBoxesAVX2(visible, planes, corner, count, &done);
+    break;
+#endif
+#ifdef MATRIX_HAVE_SSE
+  case MATRIX_SIMD_SSE:
+    k = cullBoxesSSE(visible, planes, corner, count, &done);
+    break;
+#endif
+  default:
+    break;
+  }
+  return k + cullBoxesScalar(visible + k, 0, planes, corner, done, count - done);
+}
@@ -0,0 +1,41 @@
+/* frustum.h - View frustum planes and culling of bounding spheres and boxes. */
+
+/* Planes are 4 floats (a, b, c, d) with the normal (a, b, c) pointing into
+   the frustum and normalized, so a*x + b*y + c*z + d is the signed
+   distance of (x, y, z) from the plane, positive inside.  The six planes
+   of a frustum are stored left, right, bottom, top, near, far, in 24
+   consecutive floats.
+
+   The bounding volumes are structure-of-arrays: sphere i is
+   (x[i], y[i], z[i]) with radius r[i], box i spans minX[i]..maxX[i] and
+   so on.  The culling routines test a volume against each plane
+   separately, so a volume near a frustum corner that misses the frustum
+   can still be reported visible; a volume reported culled is always
+   outside.  They use an SSE or AVX2 kernel at the level chosen by
+   setMatrixSimdLevel (see matrix.h); every kernel rounds the distances
+   as the scalar code does, so all levels cull the same volumes. */
+
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+/* Frustum planes of a row-major projection (or projection times
+   modelview) matrix m, such as makePerspectiveMatrix times
+   makeLookAtMatrix, with OpenGL's clip-space depth of -1 to 1.  With m a
+   projection matrix the planes are in eye space, with m = P*V in world
+   space, with m = P*V*M in the model's space. */
+void makeFrustumPlanes(const float m[16], float planes[24]);
+
+/* Write the indices of the spheres that may be visible to visible, in
+   increasing order, and return how many there are.  visible must have
+   room for count indices. */
+int cullSpheres(int *visible, const float planes[24],
+                const float *x, const float *y, const float *z, const float *r,
+                int count);
+
+/* Same for axis-aligned boxes. */
+int cullBoxes(int *visible, const float planes[24],
+              const float *minX, const float *minY, const float *minZ,
+              const float *maxX, const float *maxY, const float *maxZ,
+              int count);
+
+#endif /* FRUSTUM_H */
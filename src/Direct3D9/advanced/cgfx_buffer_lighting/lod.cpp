@@ -0,0 +1,252 @@
+/* lod.c - Level-of-detail chains for meshes, picked by projected screen size. */
+
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#include "lod.h"
+#include "sphere.h"
+
+static const double myPi = 3.14159265358979323846;
+
+void initLodChain(LodChain *chain)
+{
+  memset(chain, 0, sizeof(*chain));
+}
+
+int addLodLevel(LodChain *chain, int vertexCount, int indexCount, float error)
+{
+  LodLevel *level;
+
+  if (chain->levelCount == LOD_MAX_LEVELS)
+    return -1;
+  assert(chain->levelCount == 0 || error >= chain->levels[chain->levelCount-1].error);
+  level = &chain->levels[chain->levelCount];
+  level->vertexStart = chain->vertexCount;
+  level->vertexCount = vertexCount;
+  level->indexStart = chain->indexCount;
+  level->indexCount = indexCount;
+  level->uSteps = level->vSteps = 0;
+  level->error = error;
+  chain->vertexCount += vertexCount;
+  chain->indexCount += indexCount;
+  return chain->levelCount++;
+}
+
+/* Add levels of uSteps by vSteps, halving both each time, while they stay
+   at least minU and minV.  error(u, v) is the level's error. */
+template <typename Error>
+static void addHalvingLevels(LodChain *chain, int uSteps, int vSteps, int minU, int minV,
+                             int levelCount, int (*vertexCount)(int, int),
+                             int (*indexCount)(int, int), Error error)
+{
+  int i;
+
+  initLodChain(chain);
+  for (i = 0; i < levelCount && uSteps >= minU && vSteps >= minV; i++) {
+    int level = addLodLevel(chain, vertexCount(uSteps, vSteps), indexCount(uSteps, vSteps),
+                            error(uSteps, vSteps));
+
+    if (level < 0)
+      break;
+    chain->levels[level].uSteps = uSteps;
+    chain->levels[level].vSteps = vSteps;
+    uSteps = (uSteps + 1) / 2;
+    vSteps = (vSteps + 1) / 2;
+  }
+}
+
+/* Sphere: the middle of the widest quad, at the equator, sits
+   1 - cos(pi/slices) cos(pi/(2 stacks)) radii inside the sphere. */
+struct SphereError
+{
+  float operator()(int slices, int stacks) const
+  {
+    return (float) (1 - cos(myPi / slices) * cos(myPi / (2 * stacks)));
+  }
+};
+
+void getSphereLodChain(LodChain *chain, int slices, int stacks, int levelCount)
+{
+  addHalvingLevels(chain, slices, stacks, 3, 2, levelCount,
+                   getSphereVertexCount, getSphereIndexCount, SphereError());
+}
+
+template <typename Index>
+static void sphereLod(const LodChain *chain, float *xyz, Index *indices, float radius,
+                      void (*make)(float *, Index *, float, int, int))
+{
+  int i;
+
+  for (i = 0; i < chain->levelCount; i++) {
+    const LodLevel *level = &chain->levels[i];
+
+    make(xyz + 3 * level->vertexStart, indices + level->indexStart,
+         radius, level->uSteps, level->vSteps);
+  }
+}
+
+void makeSphereLod(const LodChain *chain, float *xyz, unsigned int *indices, float radius)
+{
+  sphereLod(chain, xyz, indices, radius, makeSphere);
+}
+
+void makeSphereLod16(const LodChain *chain, float *xyz, unsigned short *indices, float radius)
+{
+  int i;
+
+  for (i = 0; i < chain->levelCount; i++)
+    assert(chain->levels[i].vertexCount <= 65536);
+  sphereLod(chain, xyz, indices, radius, makeSphere16);
+}
+
+static int surfaceVertexCount(int uSteps, int vSteps)
+{
+  return (uSteps + 1) * (vSteps + 1);
+}
+
+static int surfaceListIndexCount(int uSteps, int vSteps)
+{
+  return getSurfaceIndexCount(uSteps, vSteps, SURFACE_TRIANGLE_LIST);
+}
+
+static float distance3(const float a[3], const float b[3])
+{
+  float dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+
+  return sqrtf(dx*dx + dy*dy + dz*dz);
+}
+
+/* Surface: for each grid cell, the surface at the middle of its u edge,
+   its v edge, and its bd diagonal (the one tessellateSurface splits the
+   cell along) against the middle of the straight line there. */
+struct SurfaceError
+{
+  const ParametricSurface *surface;
+  float boundingRadius;
+
+  float operator()(int uSteps, int vSteps) const
+  {
+    const SurfaceMesh *mesh = getSurfaceMesh(surface, uSteps, vSteps, SURFACE_TRIANGLE_LIST);
+    const int rowLength = uSteps + 1, cells = uSteps * vSteps;
+    float u[SURFACE_BATCH], v[SURFACE_BATCH], line[SURFACE_BATCH][3], worst = 0;
+    SurfaceVertex out[SURFACE_BATCH];
+    int sample, count = 0;
+
+    for (sample = 0; sample < 3 * cells; sample++) {
+      int cell = sample / 3, i = cell % uSteps, j = cell / uSteps, k,
+          a = j*rowLength + i, b = a + rowLength, d = a + 1;
+      /* Edge ad, edge ab, or diagonal bd. */
+      const int ends[3][2] = { { a, d }, { a, b }, { b, d } };
+      const float *p = mesh->vertices[ends[sample % 3][0]].position,
+                  *q = mesh->vertices[ends[sample % 3][1]].position;
+
+      u[count] = (i + (sample % 3 == 1 ? 0.0f : 0.5f)) / uSteps;
+      v[count] = (j + (sample % 3 == 0 ? 0.0f : 0.5f)) / vSteps;
+      for (k = 0; k < 3; k++)
+        line[count][k] = (p[k] + q[k]) / 2;
+      out[count].texCoord[0] = u[count];
+      out[count].texCoord[1] = v[count];
+
+      if (++count == SURFACE_BATCH || sample == 3 * cells - 1) {
+        surface->evaluate(out, u, v, count, surface->params);
+        for (k = 0; k < count; k++) {
+          float e = distance3(out[k].position, line[k]);
+
+          if (e > worst)
+            worst = e;
+        }
+        count = 0;
+      }
+    }
+    return worst / boundingRadius;
+  }
+};
+
+void getSurfaceLodChain(LodChain *chain, const ParametricSurface *surface, float boundingRadius,
+                        int uSteps, int vSteps, int levelCount)
+{
+  SurfaceError error;
+  int i;
+
+  error.surface = surface;
+  error.boundingRadius = boundingRadius;
+  addHalvingLevels(chain, uSteps, vSteps, 3, 3, levelCount,
+                   surfaceVertexCount, surfaceListIndexCount, error);
+
+  /* Coarser grids of a curved surface are never more accurate, but the
+     samples may say so by a rounding error. */
+  for (i = 1; i < chain->levelCount; i++)
+    if (chain->levels[i].error < chain->levels[i-1].error)
+      chain->levels[i].error = chain->levels[i-1].error;
+}
+
+void makeSurfaceLod(const LodChain *chain, const ParametricSurface *surface,
+                    SurfaceVertex *vertices, unsigned int *indices)
+{
+  int i;
+
+  for (i = 0; i < chain->levelCount; i++) {
+    const LodLevel *level = &chain->levels[i];
+    const SurfaceMesh *mesh = getSurfaceMesh(surface, level->uSteps, level->vSteps,
+                                             SURFACE_TRIANGLE_LIST);
+
+    assert(mesh->vertexCount == level->vertexCount && mesh->indexCount == level->indexCount);
+    memcpy(vertices + level->vertexStart, mesh->vertices,
+           mesh->vertexCount * sizeof(SurfaceVertex));
+    memcpy(indices + level->indexStart, mesh->indices,
+           mesh->indexCount * sizeof(unsigned int));
+  }
+}
+
+float getProjectedRadius(const float projection[16], int viewportHeight,
+                         float distance, float radius)
+{
+  float d2 = distance * distance - radius * radius;
+
+  /* The sphere's silhouette is a cone of half-angle asin(r/d), whose
+     tangent is r/sqrt(d^2 - r^2); projection[5] is cot(fovy/2). */
+  if (d2 <= 0)
+    return FLT_MAX;
+  return projection[5] * radius / sqrtf(d2) * 0.5f * viewportHeight;
+}
+
+/* Coarsest level from first on whose error is at most tolerance pixels. */
+static int coarsestWithin(const LodChain *chain, int first, float projectedRadius,
+                          float tolerance)
+{
+  int level = first;
+
+  while (level + 1 < chain->levelCount &&
+         chain->levels[level+1].error * projectedRadius <= tolerance)
+    level++;
+  return level;
+}
+
+int selectLod(const LodChain *chain, float projectedRadius, float pixelError,
+              float hysteresis, int current)
+{
+  int level = coarsestWithin(chain, 0, projectedRadius, pixelError);
+
+  /* Only go coarser once the error is well under the tolerance. */
+  if (current >= 0 && current < level)
+    level = coarsestWithin(chain, current, projectedRadius, pixelError * (1 - hysteresis));
+  return level;
+}
+
+void selectLodArray(int *levels, const LodChain *chain,
+                    const float projection[16], int viewportHeight, const float eye[3],
+                    const float *x, const float *y, const float *z, const float *r,
+                    int count, float pixelError, float hysteresis)
+{
+  int i;
+
+  for (i = 0; i < count; i++) {
+    float dx = x[i] - eye[0], dy = y[i] - eye[1], dz = z[i] - eye[2],
+          radius = getProjectedRadius(projection, viewportHeight,
+                                      sqrtf(dx*dx + dy*dy + dz*dz), r[i]);
+
+    levels[i] = selectLod(chain, radius, pixelError, hysteresis, levels[i]);
+  }
+}
@@ -0,0 +1,95 @@
+/* lod.h - Level-of-detail chains for meshes, picked by projected screen size. */
+
+/* A LodChain holds the levels of one mesh, finest first, packed into a
+   single vertex array and a single index array so all of them share one
+   vertex buffer and one index buffer.  Level i's indices count from its
+   first vertex, so it is drawn with
+     DrawIndexedPrimitive(D3DPT_TRIANGLELIST, vertexStart, 0, vertexCount,
+                          indexStart, indexCount/3)
+   and 16-bit indices are enough whenever each level has at most 65536
+   vertices.
+
+   Every level records its error: the farthest its triangles get from the
+   true shape, as a fraction of the mesh's bounding radius.  Projected to
+   the screen, that is error times the bounding sphere's radius in
+   pixels, so selectLod picks the coarsest level whose error stays under a
+   pixel tolerance.  To keep objects hovering near a threshold from
+   popping back and forth, moving to a coarser level needs the error to be
+   a further hysteresis fraction under the tolerance; moving to a finer
+   one happens at once.
+
+   Spheres (sphere.h) and parametric surfaces (tessellate.h) get chains by
+   halving their steps level by level.  Any other mesh, such as a loaded
+   model simplified offline, is added level by level with addLodLevel. */
+
+#ifndef LOD_H
+#define LOD_H
+
+#include "tessellate.h"
+
+#define LOD_MAX_LEVELS 8
+
+typedef struct {
+  int vertexStart, vertexCount;   /* In the chain's vertices */
+  int indexStart, indexCount;     /* In the chain's indices, counting from vertexStart */
+  int uSteps, vSteps;             /* Slices and stacks, or surface steps; 0 if neither */
+  float error;                    /* In bounding radii */
+} LodLevel;
+
+typedef struct {
+  LodLevel levels[LOD_MAX_LEVELS];   /* Finest first */
+  int levelCount;
+  int vertexCount, indexCount;       /* Of all levels */
+} LodChain;
+
+void initLodChain(LodChain *chain);
+
+/* Append a level after the existing ones and return its number, or -1 if
+   the chain is full.  Its error must be at least the previous level's. */
+int addLodLevel(LodChain *chain, int vertexCount, int indexCount, float error);
+
+/* Sphere chain: slices by stacks, then half as many of each (rounded up)
+   for each further level, for at most levelCount levels and while a
+   sphere of at least 3 slices and 2 stacks remains. */
+void getSphereLodChain(LodChain *chain, int slices, int stacks, int levelCount);
+
+/* Fill xyz (3 floats per vertex) and indices with every level of a
+   sphere chain, as makeSphere and makeSphere16 do for one sphere. */
+void makeSphereLod(const LodChain *chain, float *xyz, unsigned int *indices, float radius);
+void makeSphereLod16(const LodChain *chain, float *xyz, unsigned short *indices, float radius);
+
+/* Surface chain: uSteps by vSteps, halved (rounded up) for each further
+   level while both stay at least 3.  Each level's error is measured by
+   evaluating the surface at the middle of every grid cell and of its
+   edges; boundingRadius is the radius of a sphere about the surface's
+   origin that holds it (M + N for a torus). */
+void getSurfaceLodChain(LodChain *chain, const ParametricSurface *surface, float boundingRadius,
+                        int uSteps, int vSteps, int levelCount);
+
+/* Fill vertices and indices with every level of a surface chain as
+   triangle lists.  The levels come from getSurfaceMesh's cache. */
+void makeSurfaceLod(const LodChain *chain, const ParametricSurface *surface,
+                    SurfaceVertex *vertices, unsigned int *indices);
+
+/* Radius in pixels of a bounding sphere of the given radius whose center
+   is distance away from the eye, drawn with a row-major perspective
+   projection such as makePerspectiveMatrix on a viewport viewportHeight
+   pixels high.  Huge when the eye is inside the sphere. */
+float getProjectedRadius(const float projection[16], int viewportHeight,
+                         float distance, float radius);
+
+/* Level to draw for a bounding sphere projectedRadius pixels across, with
+   at most pixelError pixels of error, given the level drawn last frame
+   (-1 if none).  hysteresis is a fraction such as 0.25. */
+int selectLod(const LodChain *chain, float projectedRadius, float pixelError,
+              float hysteresis, int current);
+
+/* selectLod for count objects with world-space bounding spheres
+   (x[i], y[i], z[i]) of radius r[i] seen from eye.  levels holds each
+   object's current level (-1 if none) and is updated in place. */
+void selectLodArray(int *levels, const LodChain *chain,
+                    const float projection[16], int viewportHeight, const float eye[3],
+                    const float *x, const float *y, const float *z, const float *r,
+                    int count, float pixelError, float hysteresis);
+
+#endif /* LOD_H */
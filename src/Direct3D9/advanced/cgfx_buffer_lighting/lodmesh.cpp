@@ -0,0 +1,203 @@
+/* lodmesh.c - A mesh's level-of-detail chain in one compact binary file. */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "lodmesh.h"
+
+static const char myMagic[4] = { 'L', 'O', 'D', 'M' };
+
+#define LODMESH_VERSION     1
+#define LODMESH_HEADER_SIZE 28
+#define LODMESH_LEVEL_SIZE  20
+
+static int uses16BitIndices(const LodChain *chain)
+{
+  int i;
+
+  for (i = 0; i < chain->levelCount; i++)
+    if (chain->levels[i].vertexCount > 65536)
+      return 0;
+  return 1;
+}
+
+long getLodMeshFileSize(const LodChain *chain)
+{
+  return LODMESH_HEADER_SIZE + (long) chain->levelCount * LODMESH_LEVEL_SIZE +
+         (long) chain->vertexCount * 8 * 4 +
+         (long) chain->indexCount * (uses16BitIndices(chain) ? 2 : 4);
+}
+
+/* Values are written a byte at a time so the file is little-endian
+   whatever the machine. */
+
+static void putU32(FILE *file, unsigned int v)
+{
+  unsigned char b[4] = { (unsigned char) v, (unsigned char) (v >> 8),
+                         (unsigned char) (v >> 16), (unsigned char) (v >> 24) };
+
+  fwrite(b, 1, 4, file);
+}
+
+static void putFloat(FILE *file, float f)
+{
+  unsigned int v;
+
+  memcpy(&v, &f, 4);
+  putU32(file, v);
+}
+
+static int getU32(FILE *file, unsigned int *v)
+{
+  unsigned char b[4];
+
+  if (fread(b, 1, 4, file) != 4)
+    return 0;
+  *v = b[0] | b[1] << 8 | b[2] << 16 | (unsigned int) b[3] << 24;
+  return 1;
+}
+
+static int getFloat(FILE *file, float *f)
+{
+  unsigned int v;
+
+  if (!getU32(file, &v))
+    return 0;
+  memcpy(f, &v, 4);
+  return 1;
+}
+
+int writeLodMesh(const char *path, const LodMesh *mesh)
+{
+  const LodChain *chain = &mesh->chain;
+  int index16 = uses16BitIndices(chain), i, k, ok;
+  FILE *file = fopen(path, "wb");
+
+  if (!file)
+    return 0;
+  fwrite(myMagic, 1, 4, file);
+  putU32(file, LODMESH_VERSION);
+  putU32(file, chain->levelCount);
+  putU32(file, chain->vertexCount);
+  putU32(file, chain->indexCount);
+  putU32(file, index16 ? 2 : 4);
+  putFloat(file, mesh->radius);
+  for (i = 0; i < chain->levelCount; i++) {
+    const LodLevel *level = &chain->levels[i];
+
+    putU32(file, level->vertexStart);
+    putU32(file, level->vertexCount);
+    putU32(file, level->indexStart);
+    putU32(file, level->indexCount);
+    putFloat(file, level->error);
+  }
+  for (i = 0; i < chain->vertexCount; i++) {
+    const MeshVertex *v = &mesh->vertices[i];
+
+    for (k = 0; k < 3; k++)
+      putFloat(file, v->position[k]);
+    for (k = 0; k < 3; k++)
+      putFloat(file, v->normal[k]);
+    for (k = 0; k < 2; k++)
+      putFloat(file, v->texCoord[k]);
+  }
+  for (i = 0; i < chain->indexCount; i++) {
+    unsigned int v = mesh->indices[i];
+
+    if (index16) {
+      unsigned char b[2] = { (unsigned char) v, (unsigned char) (v >> 8) };
+
+      fwrite(b, 1, 2, file);
+    } else {
+      putU32(file, v);
+    }
+  }
+  ok = !ferror(file);
+  return fclose(file) == 0 && ok;
+}
+
+int readLodMesh(const char *path, LodMesh *mesh)
+{
+  FILE *file = fopen(path, "rb");
+  char magic[4];
+  unsigned int version, levelCount, vertexCount, indexCount, indexSize, i;
+  int k, ok = 1;
+
+  memset(mesh, 0, sizeof(*mesh));
+  if (!file)
+    return 0;
+  if (fread(magic, 1, 4, file) != 4 || memcmp(magic, myMagic, 4) != 0 ||
+      !getU32(file, &version) || version != LODMESH_VERSION ||
+      !getU32(file, &levelCount) || levelCount > LOD_MAX_LEVELS ||
+      !getU32(file, &vertexCount) || !getU32(file, &indexCount) ||
+      !getU32(file, &indexSize) || (indexSize != 2 && indexSize != 4) ||
+      !getFloat(file, &mesh->radius) ||
+      vertexCount > 0x7fffffffu / sizeof(MeshVertex) ||
+      indexCount > 0x7fffffffu / sizeof(unsigned int)) {
+    fclose(file);
+    return 0;
+  }
+
+  initLodChain(&mesh->chain);
+  for (i = 0; i < levelCount && ok; i++) {
+    LodLevel *level = &mesh->chain.levels[i];
+    unsigned int v[4];
+
+    for (k = 0; k < 4 && ok; k++)
+      ok = getU32(file, &v[k]);
+    ok = ok && getFloat(file, &level->error);
+    /* Each level's ranges must lie inside the arrays. */
+    ok = ok && v[0] <= vertexCount && v[1] <= vertexCount - v[0] &&
+         v[2] <= indexCount && v[3] <= indexCount - v[2];
+    level->vertexStart = (int) v[0];
+    level->vertexCount = (int) v[1];
+    level->indexStart = (int) v[2];
+    level->indexCount = (int) v[3];
+  }
+  mesh->chain.levelCount = (int) levelCount;
+  mesh->chain.vertexCount = (int) vertexCount;
+  mesh->chain.indexCount = (int) indexCount;
+
+  if (ok) {
+    mesh->vertices = new MeshVertex[vertexCount];
+    mesh->indices = new unsigned int[indexCount];
+  }
+  for (i = 0; i < vertexCount && ok; i++) {
+    MeshVertex *v = &mesh->vertices[i];
+
+    for (k = 0; k < 3 && ok; k++)
+      ok = getFloat(file, &v->position[k]);
+    for (k = 0; k < 3 && ok; k++)
+      ok = getFloat(file, &v->normal[k]);
+    for (k = 0; k < 2 && ok; k++)
+      ok = getFloat(file, &v->texCoord[k]);
+  }
+  for (i = 0; i < indexCount && ok; i++) {
+    unsigned char b[2];
+
+    if (indexSize == 2) {
+      ok = fread(b, 1, 2, file) == 2;
+      mesh->indices[i] = b[0] | b[1] << 8;
+    } else {
+      ok = getU32(file, &mesh->indices[i]);
+    }
+  }
+  /* Every index must name a vertex of its own level. */
+  for (i = 0; i < levelCount && ok; i++) {
+    const LodLevel *level = &mesh->chain.levels[i];
+
+    for (k = 0; k < level->indexCount && ok; k++)
+      ok = mesh->indices[level->indexStart + k] < (unsigned int) level->vertexCount;
+  }
+  fclose(file);
+  if (!ok)
+    freeLodMesh(mesh);
+  return ok;
+}
+
+void freeLodMesh(LodMesh *mesh)
+{
+  delete [] mesh->vertices;
+  delete [] mesh->indices;
+  memset(mesh, 0, sizeof(*mesh));
+}
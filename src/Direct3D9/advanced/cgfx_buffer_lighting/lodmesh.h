@@ -0,0 +1,48 @@
+/* lodmesh.h - A mesh's level-of-detail chain in one compact binary file. */
+
+/* The file is the chain's levels, then every level's vertices, then
+   every level's indices, laid out as lod.h describes, so a loader can
+   copy the two arrays straight into one vertex buffer and one index
+   buffer.  Indices are 16 bits when every level has at most 65536
+   vertices.  All values are little-endian:
+
+     char     magic[4]     "LODM"
+     uint32   version      1
+     uint32   levelCount
+     uint32   vertexCount  of all levels
+     uint32   indexCount   of all levels
+     uint32   indexSize    2 or 4 bytes
+     float    radius       bounding radius the errors are fractions of
+     levelCount times:
+       uint32 vertexStart, vertexCount, indexStart, indexCount
+       float  error
+     MeshVertex vertices[vertexCount]   8 floats each
+     uint16 or uint32 indices[indexCount] */
+
+#ifndef LODMESH_H
+#define LODMESH_H
+
+#include "lod.h"
+#include "mesh.h"
+
+typedef struct {
+  LodChain chain;
+  float radius;
+  MeshVertex *vertices;     /* chain.vertexCount */
+  unsigned int *indices;    /* chain.indexCount */
+} LodMesh;
+
+/* Bytes writeLodMesh writes for chain. */
+long getLodMeshFileSize(const LodChain *chain);
+
+/* Return 1 on success and 0 if the file cannot be written. */
+int writeLodMesh(const char *path, const LodMesh *mesh);
+
+/* Read a file written by writeLodMesh into a new mesh; release it with
+   freeLodMesh.  Return 1 on success and 0 if the file cannot be read or
+   is not a valid LOD mesh. */
+int readLodMesh(const char *path, LodMesh *mesh);
+
+void freeLodMesh(LodMesh *mesh);
+
+#endif /* LODMESH_H */
@@ -0,0 +1,129 @@
+/* mapfile.c - Read-only views of whole files, memory mapped where the system allows. */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "mapfile.h"
+
+#if defined(_WIN32)
+# define WIN32_LEAN_AND_MEAN
+# include <windows.h>
+# define MAPFILE_WINDOWS 1
+#elif defined(__unix__) || defined(__APPLE__)
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+# define MAPFILE_POSIX 1
+#endif
+
+/* The fallback: read the whole file into a new buffer. */
+static int readWholeFile(MappedFile *file, const char *path)
+{
+  FILE *f = fopen(path, "rb");
+  char *buffer = NULL;
+  long size;
+
+  if (!f)
+    return 0;
+  if (fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) != 0) {
+    fclose(f);
+    return 0;
+  }
+  if (size > 0) {
+    buffer = new char[size];
+    if (fread(buffer, 1, size, f) != (size_t) size) {
+      delete [] buffer;
+      fclose(f);
+      return 0;
+    }
+  }
+  fclose(f);
+  file->data = buffer;
+  file->size = (size_t) size;
+  file->handle = buffer;
+  file->mapped = 0;
+  return 1;
+}
+
+int mapFile(MappedFile *file, const char *path)
+{
+  memset(file, 0, sizeof(*file));
+#if defined(MAPFILE_WINDOWS)
+  {
+    HANDLE f = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    ULARGE_INTEGER size;
+    HANDLE mapping;
+    const void *view;
+
+    if (f == INVALID_HANDLE_VALUE)
+      return 0;
+    size.LowPart = GetFileSize(f, &size.HighPart);
+    if (size.LowPart == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) {
+      CloseHandle(f);
+      return 0;
+    }
+    if (size.QuadPart == 0) {
+      CloseHandle(f);
+      return 1;
+    }
+    /* Files too big for the address space are left to the fallback to fail. */
+    mapping = size.HighPart == 0 || sizeof(size_t) > 4 ?
+              CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    CloseHandle(f);
+    if (mapping) {
+      view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      if (view) {
+        file->data = (const char *) view;
+        file->size = (size_t) size.QuadPart;
+        file->handle = mapping;
+        file->mapped = 1;
+        return 1;
+      }
+      CloseHandle(mapping);
+    }
+  }
+#elif defined(MAPFILE_POSIX)
+  {
+    int f = open(path, O_RDONLY);
+    struct stat info;
+    void *view;
+
+    if (f < 0)
+      return 0;
+    if (fstat(f, &info) != 0) {
+      close(f);
+      return 0;
+    }
+    if (info.st_size == 0) {
+      close(f);
+      return 1;
+    }
+    view = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, f, 0);
+    close(f);
+    if (view != MAP_FAILED) {
+      file->data = (const char *) view;
+      file->size = (size_t) info.st_size;
+      file->mapped = 1;
+      return 1;
+    }
+  }
+#endif
+  return readWholeFile(file, path);
+}
+
+void unmapFile(MappedFile *file)
+{
+  if (file->mapped) {
+#if defined(MAPFILE_WINDOWS)
+    UnmapViewOfFile(file->data);
+    CloseHandle((HANDLE) file->handle);
+#elif defined(MAPFILE_POSIX)
+    munmap((void *) file->data, file->size);
+#endif
+  } else {
+    delete [] (char *) file->handle;
+  }
+  memset(file, 0, sizeof(*file));
+}
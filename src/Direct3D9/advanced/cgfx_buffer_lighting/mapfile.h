@@ -0,0 +1,27 @@
+/* mapfile.h - Read-only views of whole files, memory mapped where the system allows. */
+
+/* mapFile maps the file with MapViewOfFile on Windows and mmap elsewhere,
+   so pages are read on first touch and shared with the file cache
+   instead of being copied into the program's memory.  Where neither is
+   available, or mapping fails (some network drives, special files), the
+   file is read into an allocated buffer instead; callers see the same
+   thing either way. */
+
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include <stddef.h>
+
+typedef struct {
+  const char *data;     /* NULL for an empty file */
+  size_t size;
+  void *handle;         /* Mapping object, or the buffer read into */
+  int mapped;
+} MappedFile;
+
+/* Return 1 on success and 0 if the file cannot be opened or read. */
+int mapFile(MappedFile *file, const char *path);
+
+void unmapFile(MappedFile *file);
+
+#endif /* MAPFILE_H */
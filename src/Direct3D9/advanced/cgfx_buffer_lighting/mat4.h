@@ -0,0 +1,597 @@
+/* mat4.h - Header-only 4x4 matrix and 4-component vector types. */
+
+/* Mat4<T> holds the same 16 row-major elements as the float m[16] arrays
+   used by matrix.h (Mat4::load and Mat4::store convert), and matrix.cpp
+   implements its routines on top of these types.
+
+   Products of matrices are expression templates: P*V*M builds a small
+   node that remembers its operands instead of computing two 16-element
+   temporaries.  The work happens when the expression is
+
+     - multiplied by a column vector:  P*V*M*v  is evaluated as
+       P*(V*(M*v)), three matrix-vector products and no matrix temporary;
+
+     - assigned to a Mat4:  each row of the result is one row of P pushed
+       through V and then M, so only a 4-element row is ever live;
+
+     - inverted:  inverse(P*V*M, out) evaluates once, then inverts.
+
+   Expressions keep references to the Mat4 operands they name, so use them
+   within one statement (or store the result in a Mat4) rather than keeping
+   an expression around after its operands have gone away.
+
+   MatrixConvention (near the end) builds view and projection matrices for
+   either API's handedness, depth range, and storage order.
+
+   The make...() builders and the Mat4/Vec4 constructors are constexpr when
+   the compiler supports it (C++11, or Visual C++ 2015 and newer); older
+   compilers get ordinary inline functions with the same results. */
+
+#ifndef MAT4_H
+#define MAT4_H
+
+#include <assert.h>
+#include <math.h>
+
+#if defined(_MSC_VER) ? _MSC_VER >= 1900 : __cplusplus >= 201103L
+# define MAT4_HAVE_CONSTEXPR 1
+# define MAT4_CONSTEXPR constexpr
+#else
+# define MAT4_CONSTEXPR inline
+#endif
+
+template <typename T>
+struct Vec4
+{
+  T x, y, z, w;
+
+  Vec4() {}
+  MAT4_CONSTEXPR Vec4(T x_, T y_, T z_, T w_) : x(x_), y(y_), z(z_), w(w_) {}
+
+  template <typename U>
+  static Vec4 load(const U v[4])
+  {
+    return Vec4((T) v[0], (T) v[1], (T) v[2], (T) v[3]);
+  }
+
+  template <typename U>
+  void store(U v[4]) const
+  {
+    v[0] = (U) x;  v[1] = (U) y;  v[2] = (U) z;  v[3] = (U) w;
+  }
+
+  T &operator[](int i) { return (&x)[i]; }
+  const T &operator[](int i) const { return (&x)[i]; }
+};
+
+template <typename T>
+MAT4_CONSTEXPR T dot(const Vec4<T> &a, const Vec4<T> &b)
+{
+  return a.x*b.x + a.y*b.y + a.z*b.z + a.w*b.w;
+}
+
+/* Base of every matrix expression.  E provides
+
+     Vec4<T> row(int i) const            row i of the expression
+     Vec4<T> col(int i) const            column i of the expression
+     Vec4<T> leftMul(const Vec4<T> &r)   r (a row vector) times the expression
+     Vec4<T> rightMul(const Vec4<T> &c)  the expression times c (a column vector)
+*/
+template <typename T, typename E>
+struct Mat4Expr
+{
+  MAT4_CONSTEXPR const E &self() const { return static_cast<const E &>(*this); }
+};
+
+template <typename T>
+struct Mat4 : public Mat4Expr<T, Mat4<T> >
+{
+  T m[16];
+
+  Mat4() {}
+
+#ifdef MAT4_HAVE_CONSTEXPR
+  constexpr Mat4(T m00, T m01, T m02, T m03,
+                 T m10, T m11, T m12, T m13,
+                 T m20, T m21, T m22, T m23,
+                 T m30, T m31, T m32, T m33)
+    : m{ m00, m01, m02, m03,  m10, m11, m12, m13,
+         m20, m21, m22, m23,  m30, m31, m32, m33 } {}
+#else
+  Mat4(T m00, T m01, T m02, T m03,
+       T m10, T m11, T m12, T m13,
+       T m20, T m21, T m22, T m23,
+       T m30, T m31, T m32, T m33)
+  {
+    m[0]  = m00;  m[1]  = m01;  m[2]  = m02;  m[3]  = m03;
+    m[4]  = m10;  m[5]  = m11;  m[6]  = m12;  m[7]  = m13;
+    m[8]  = m20;  m[9]  = m21;  m[10] = m22;  m[11] = m23;
+    m[12] = m30;  m[13] = m31;  m[14] = m32;  m[15] = m33;
+  }
+#endif
+
+#ifdef MAT4_HAVE_CONSTEXPR
+  constexpr Mat4(const Vec4<T> &r0, const Vec4<T> &r1,
+                 const Vec4<T> &r2, const Vec4<T> &r3)
+    : m{ r0.x, r0.y, r0.z, r0.w,  r1.x, r1.y, r1.z, r1.w,
+         r2.x, r2.y, r2.z, r2.w,  r3.x, r3.y, r3.z, r3.w } {}
+#else
+  Mat4(const Vec4<T> &r0, const Vec4<T> &r1,
+       const Vec4<T> &r2, const Vec4<T> &r3)
+  {
+    r0.store(m+0);  r1.store(m+4);  r2.store(m+8);  r3.store(m+12);
+  }
+#endif
+
+  /* Evaluate an expression.  All four rows are computed before any is
+     stored, so A = A*B is safe. */
+  template <typename E>
+  Mat4(const Mat4Expr<T, E> &e)
+  {
+    assign(e.self());
+  }
+
+  template <typename E>
+  Mat4 &operator=(const Mat4Expr<T, E> &e)
+  {
+    assign(e.self());
+    return *this;
+  }
+
+  template <typename U>
+  static Mat4 load(const U a[16])
+  {
+    Mat4 r;
+    for (int i=0; i<16; i++)
+      r.m[i] = (T) a[i];
+    return r;
+  }
+
+  template <typename U>
+  void store(U a[16]) const
+  {
+    for (int i=0; i<16; i++)
+      a[i] = (U) m[i];
+  }
+
+  MAT4_CONSTEXPR T operator()(int r, int c) const { return m[r*4+c]; }
+  T &operator()(int r, int c) { return m[r*4+c]; }
+
+  MAT4_CONSTEXPR Vec4<T> row(int i) const
+  {
+    return Vec4<T>(m[i*4+0], m[i*4+1], m[i*4+2], m[i*4+3]);
+  }
+
+  MAT4_CONSTEXPR Vec4<T> col(int i) const
+  {
+    return Vec4<T>(m[0*4+i], m[1*4+i], m[2*4+i], m[3*4+i]);
+  }
+
+  /* Sums run over k = 0..3 in order, like multMatrix, so evaluating an
+     expression gives the same floats as the equivalent multMatrix calls
+     when T is the type multMatrix sums in (see MATRIX_PRECISION in
+     matrix.h). */
+  MAT4_CONSTEXPR Vec4<T> leftMul(const Vec4<T> &r) const
+  {
+    return Vec4<T>(r.x*m[0] + r.y*m[4] + r.z*m[8]  + r.w*m[12],
+                   r.x*m[1] + r.y*m[5] + r.z*m[9]  + r.w*m[13],
+                   r.x*m[2] + r.y*m[6] + r.z*m[10] + r.w*m[14],
+                   r.x*m[3] + r.y*m[7] + r.z*m[11] + r.w*m[15]);
+  }
+
+  MAT4_CONSTEXPR Vec4<T> rightMul(const Vec4<T> &c) const
+  {
+    return Vec4<T>(m[0]*c.x  + m[1]*c.y  + m[2]*c.z  + m[3]*c.w,
+                   m[4]*c.x  + m[5]*c.y  + m[6]*c.z  + m[7]*c.w,
+                   m[8]*c.x  + m[9]*c.y  + m[10]*c.z + m[11]*c.w,
+                   m[12]*c.x + m[13]*c.y + m[14]*c.z + m[15]*c.w);
+  }
+
+private:
+  template <typename E>
+  void assign(const E &e)
+  {
+    Vec4<T> r0 = e.row(0), r1 = e.row(1), r2 = e.row(2), r3 = e.row(3);
+
+    r0.store(m+0);  r1.store(m+4);  r2.store(m+8);  r3.store(m+12);
+  }
+};
+
+typedef Vec4<float>  Vec4f;
+typedef Vec4<double> Vec4d;
+typedef Mat4<float>  Mat4f;
+typedef Mat4<double> Mat4d;
+
+/* Expression nodes hold Mat4 operands by reference and other nodes by
+   value, so a node never refers to a temporary node that has already been
+   destroyed. */
+template <typename T, typename E>
+struct Mat4Operand
+{
+  typedef const E type;
+};
+
+template <typename T>
+struct Mat4Operand<T, Mat4<T> >
+{
+  typedef const Mat4<T> &type;
+};
+
+/* L * R */
+template <typename T, typename L, typename R>
+struct Mat4Product : public Mat4Expr<T, Mat4Product<T, L, R> >
+{
+  typename Mat4Operand<T, L>::type l;
+  typename Mat4Operand<T, R>::type r;
+
+  MAT4_CONSTEXPR Mat4Product(const L &l_, const R &r_) : l(l_), r(r_) {}
+
+  MAT4_CONSTEXPR Vec4<T> row(int i) const { return r.leftMul(l.row(i)); }
+  MAT4_CONSTEXPR Vec4<T> col(int i) const { return l.rightMul(r.col(i)); }
+  MAT4_CONSTEXPR Vec4<T> leftMul(const Vec4<T> &v) const { return r.leftMul(l.leftMul(v)); }
+  MAT4_CONSTEXPR Vec4<T> rightMul(const Vec4<T> &v) const { return l.rightMul(r.rightMul(v)); }
+};
+
+/* Transpose of E */
+template <typename T, typename E>
+struct Mat4Transpose : public Mat4Expr<T, Mat4Transpose<T, E> >
+{
+  typename Mat4Operand<T, E>::type e;
+
+  MAT4_CONSTEXPR explicit Mat4Transpose(const E &e_) : e(e_) {}
+
+  MAT4_CONSTEXPR Vec4<T> row(int i) const { return e.col(i); }
+  MAT4_CONSTEXPR Vec4<T> col(int i) const { return e.row(i); }
+  MAT4_CONSTEXPR Vec4<T> leftMul(const Vec4<T> &v) const { return e.rightMul(v); }
+  MAT4_CONSTEXPR Vec4<T> rightMul(const Vec4<T> &v) const { return e.leftMul(v); }
+};
+
+template <typename T, typename L, typename R>
+MAT4_CONSTEXPR Mat4Product<T, L, R> operator*(const Mat4Expr<T, L> &l, const Mat4Expr<T, R> &r)
+{
+  return Mat4Product<T, L, R>(l.self(), r.self());
+}
+
+/* Matrix expression times column vector, evaluated right to left. */
+template <typename T, typename E>
+MAT4_CONSTEXPR Vec4<T> operator*(const Mat4Expr<T, E> &e, const Vec4<T> &v)
+{
+  return e.self().rightMul(v);
+}
+
+/* Row vector times matrix expression, evaluated left to right. */
+template <typename T, typename E>
+MAT4_CONSTEXPR Vec4<T> operator*(const Vec4<T> &v, const Mat4Expr<T, E> &e)
+{
+  return e.self().leftMul(v);
+}
+
+template <typename T, typename E>
+MAT4_CONSTEXPR Mat4Transpose<T, E> transpose(const Mat4Expr<T, E> &e)
+{
+  return Mat4Transpose<T, E>(e.self());
+}
+
+/* Perspective divide of a transformed position; w becomes 1. */
+template <typename T>
+MAT4_CONSTEXPR Vec4<T> perspectiveDivide(const Vec4<T> &v)
+{
+  return Vec4<T>(v.x / v.w, v.y / v.w, v.z / v.w, T(1));
+}
+
+/* Builders.  Each gives the same matrix as its make...Matrix counterpart in
+   matrix.h, with the trigonometry and normalization left to the caller so
+   the builder itself can be constexpr. */
+
+template <typename T>
+MAT4_CONSTEXPR Mat4<T> makeIdentityMat4()
+{
+  return Mat4<T>(1, 0, 0, 0,
+                 0, 1, 0, 0,
+                 0, 0, 1, 0,
+                 0, 0, 0, 1);
+}
+
+/* glTranslatef */
+template <typename T>
+MAT4_CONSTEXPR Mat4<T> makeTranslateMat4(T x, T y, T z)
+{
+  return Mat4<T>(1, 0, 0, x,
+                 0, 1, 0, y,
+                 0, 0, 1, z,
+                 0, 0, 0, 1);
+}
+
+/* glScalef */
+template <typename T>
+MAT4_CONSTEXPR Mat4<T> makeScaleMat4(T x, T y, T z)
+{
+  return Mat4<T>(x, 0, 0, 0,
+                 0, y, 0, 0,
+                 0, 0, z, 0,
+                 0, 0, 0, 1);
+}
+
+/* gluLookAt, given the unit x, y, and z axes of the eye space (x, y, and z
+   of each Vec4; w is ignored) and the eye position. */
+template <typename T>
+MAT4_CONSTEXPR Mat4<T> makeLookAtMat4(const Vec4<T> &x, const Vec4<T> &y, const Vec4<T> &z,
+                                      T eyex, T eyey, T eyez)
+{
+  return Mat4<T>(x.x, x.y, x.z, -x.x*eyex + -x.y*eyey + -x.z*eyez,
+                 y.x, y.y, y.z, -y.x*eyex + -y.y*eyey + -y.z*eyez,
+                 z.x, z.y, z.z, -z.x*eyex + -z.y*eyey + -z.z*eyez,
+                 0, 0, 0, 1);
+}
+
+/* Rotation about the unit axis (ax, ay, az), given the sine and cosine of
+   the angle, laid out exactly as makeRotateMatrix lays it out. */
+template <typename T>
+MAT4_CONSTEXPR Mat4<T> makeRotateMat4(T sine, T cosine, T ax, T ay, T az)
+{
+  return Mat4<T>(ax*ax + cosine*(1 - ax*ax),
+                 ax*ay*(1 - cosine) + az*sine,
+                 az*ax*(1 - cosine) - ay*sine,
+                 0,
+                 ax*ay*(1 - cosine) - az*sine,
+                 ay*ay + cosine*(1 - ay*ay),
+                 ay*az*(1 - cosine) + ax*sine,
+                 0,
+                 az*ax*(1 - cosine) + ay*sine,
+                 ay*az*(1 - cosine) - ax*sine,
+                 az*az + cosine*(1 - az*az),
+                 0,
+                 0, 0, 0, 1);
+}
+
+/* Conventions.
+
+   Direct3D and OpenGL samples disagree in three ways, and all three show
+   up in the view and projection matrices:
+
+     handedness   the eye looks down -z (right-handed, like gluLookAt) or
+                  down +z (left-handed, like D3DXMatrixLookAtLH);
+
+     depth range  clip-space z from -1 to 1 (OpenGL) or 0 to 1 (Direct3D)
+                  maps to the depth buffer;
+
+     storage      a matrix is handed to the API row by row
+                  (cgSetMatrixParameterfr, glLoadTransposeMatrixf) or
+                  column by column (cgSetMatrixParameterfc, glLoadMatrixf).
+
+   MatrixConvention<Handedness, DepthRange, Storage> bundles one choice of
+   each.  The choices are types, so the builders below have no run-time
+   branches, and store() writes each element straight to its place in the
+   chosen order instead of building a row-major matrix and transposing it.
+   Mat4 itself is always row-major with column vectors. */
+
+struct RightHanded { enum { zSign = -1 }; };
+struct LeftHanded  { enum { zSign = 1 }; };
+
+/* Clip z = zSign * zScale * eye z + zOffset * eye w. */
+struct DepthMinusOneToOne
+{
+  template <typename T>
+  static MAT4_CONSTEXPR T zScale(T zNear, T zFar) { return (zFar + zNear) / (zFar - zNear); }
+  template <typename T>
+  static MAT4_CONSTEXPR T zOffset(T zNear, T zFar) { return -2 * zNear * zFar / (zFar - zNear); }
+};
+
+struct DepthZeroToOne
+{
+  template <typename T>
+  static MAT4_CONSTEXPR T zScale(T zNear, T zFar) { return zFar / (zFar - zNear); }
+  template <typename T>
+  static MAT4_CONSTEXPR T zOffset(T zNear, T zFar) { return -(zFar / (zFar - zNear)) * zNear; }
+};
+
+/* Index of element (row, col) in the float[16] handed to the API. */
+struct RowMajorStorage
+{
+  static MAT4_CONSTEXPR int index(int row, int col) { return row*4 + col; }
+};
+
+struct ColumnMajorStorage
+{
+  static MAT4_CONSTEXPR int index(int row, int col) { return col*4 + row; }
+};
+
+template <typename Handedness, typename DepthRange, typename Storage>
+struct MatrixConvention
+{
+  /* Perspective projection, given cotangent = 1/tan(fieldOfView/2). */
+  template <typename T>
+  static MAT4_CONSTEXPR Mat4<T> perspective(T cotangent, T aspectRatio, T zNear, T zFar)
+  {
+    return Mat4<T>(cotangent / aspectRatio, 0, 0, 0,
+                   0, cotangent, 0, 0,
+                   0, 0, T(Handedness::zSign) * DepthRange::zScale(zNear, zFar),
+                         DepthRange::zOffset(zNear, zFar),
+                   0, 0, T(Handedness::zSign), 0);
+  }
+
+  /* Same, from the vertical field of view in degrees (gluPerspective).
+     Computed in T, so perspectiveFov<double> is the most accurate way to
+     get a float matrix. */
+  template <typename T>
+  static Mat4<T> perspectiveFov(double fieldOfView, double aspectRatio,
+                                double zNear, double zFar)
+  {
+    T radians = T(fieldOfView) / 2 * T(3.14159265358979323846) / 180;
+    T sine = sin(radians);
+
+    /* Should be non-zero to avoid division by zero. */
+    assert(zFar - zNear);
+    assert(sine);
+    assert(aspectRatio);
+    return perspective(cos(radians) / sine, T(aspectRatio), T(zNear), T(zFar));
+  }
+
+  /* View matrix from eye and center positions and an up vector
+     (gluLookAt), computed in T. */
+  template <typename T>
+  static Mat4<T> lookAt(double eyex, double eyey, double eyez,
+                        double centerx, double centery, double centerz,
+                        double upx, double upy, double upz)
+  {
+    T x[3], y[3], z[3], mag;
+
+    /* Eye-space z points back at the eye (right-handed) or ahead of it
+       (left-handed). */
+    if (Handedness::zSign < 0) {
+      z[0] = T(eyex) - T(centerx);
+      z[1] = T(eyey) - T(centery);
+      z[2] = T(eyez) - T(centerz);
+    } else {
+      z[0] = T(centerx) - T(eyex);
+      z[1] = T(centery) - T(eyey);
+      z[2] = T(centerz) - T(eyez);
+    }
+    /* Normalize Z. */
+    mag = sqrt(z[0]*z[0] + z[1]*z[1] + z[2]*z[2]);
+    if (mag) {
+      z[0] /= mag;
+      z[1] /= mag;
+      z[2] /= mag;
+    }
+
+    /* Up vector makes Y vector. */
+    y[0] = T(upx);
+    y[1] = T(upy);
+    y[2] = T(upz);
+
+    /* X vector = Y cross Z. */
+    x[0] =  y[1]*z[2] - y[2]*z[1];
+    x[1] = -y[0]*z[2] + y[2]*z[0];
+    x[2] =  y[0]*z[1] - y[1]*z[0];
+
+    /* Recompute Y = Z cross X. */
+    y[0] =  z[1]*x[2] - z[2]*x[1];
+    y[1] = -z[0]*x[2] + z[2]*x[0];
+    y[2] =  z[0]*x[1] - z[1]*x[0];
+
+    /* Normalize X. */
+    mag = sqrt(x[0]*x[0] + x[1]*x[1] + x[2]*x[2]);
+    if (mag) {
+      x[0] /= mag;
+      x[1] /= mag;
+      x[2] /= mag;
+    }
+
+    /* Normalize Y. */
+    mag = sqrt(y[0]*y[0] + y[1]*y[1] + y[2]*y[2]);
+    if (mag) {
+      y[0] /= mag;
+      y[1] /= mag;
+      y[2] /= mag;
+    }
+
+    return makeLookAtMat4(Vec4<T>(x[0], x[1], x[2], 0),
+                          Vec4<T>(y[0], y[1], y[2], 0),
+                          Vec4<T>(z[0], z[1], z[2], 0),
+                          T(eyex), T(eyey), T(eyez));
+  }
+
+  /* Write a matrix expression in this convention's storage order. */
+  template <typename T, typename E, typename U>
+  static void store(const Mat4Expr<T, E> &e, U m[16])
+  {
+    const Mat4<T> a(e);
+    int r, c;
+
+    for (r=0; r<4; r++)
+      for (c=0; c<4; c++)
+        m[Storage::index(r, c)] = (U) a.m[r*4+c];
+  }
+
+  template <typename T, typename U>
+  static Mat4<T> load(const U m[16])
+  {
+    Mat4<T> a;
+    int r, c;
+
+    for (r=0; r<4; r++)
+      for (c=0; c<4; c++)
+        a.m[r*4+c] = (T) m[Storage::index(r, c)];
+    return a;
+  }
+};
+
+/* OpenGLConvention gives the matrices of gluLookAt and gluPerspective, as
+   matrix.h does.  Direct3DConvention gives those of D3DXMatrixLookAtLH and
+   D3DXMatrixPerspectiveFovLH (transposed for column vectors).  Both are
+   stored row-major for cgSetMatrixParameterfr. */
+typedef MatrixConvention<RightHanded, DepthMinusOneToOne, RowMajorStorage> OpenGLConvention;
+typedef MatrixConvention<LeftHanded, DepthZeroToOne, RowMajorStorage> Direct3DConvention;
+
+/* gluPerspective, given cotangent = 1/tan(fieldOfView/2). */
+template <typename T>
+MAT4_CONSTEXPR Mat4<T> makePerspectiveMat4(T cotangent, T aspectRatio, T zNear, T zFar)
+{
+  return OpenGLConvention::perspective(cotangent, aspectRatio, zNear, zFar);
+}
+
+/* Invert any matrix expression by cofactors (2x2 minors of the top two
+   and bottom two rows).  Returns false and leaves out unchanged if the
+   matrix is singular.  out may be an operand of e. */
+template <typename T, typename E>
+bool inverse(const Mat4Expr<T, E> &e, Mat4<T> &out)
+{
+  const Mat4<T> a(e);
+  const T *m = a.m;
+  T s0 = m[0]*m[5]  - m[4]*m[1];
+  T s1 = m[0]*m[6]  - m[4]*m[2];
+  T s2 = m[0]*m[7]  - m[4]*m[3];
+  T s3 = m[1]*m[6]  - m[5]*m[2];
+  T s4 = m[1]*m[7]  - m[5]*m[3];
+  T s5 = m[2]*m[7]  - m[6]*m[3];
+  T c5 = m[10]*m[15] - m[14]*m[11];
+  T c4 = m[9]*m[15]  - m[13]*m[11];
+  T c3 = m[9]*m[14]  - m[13]*m[10];
+  T c2 = m[8]*m[15]  - m[12]*m[11];
+  T c1 = m[8]*m[14]  - m[12]*m[10];
+  T c0 = m[8]*m[13]  - m[12]*m[9];
+  T det = s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0;
+  T invDet;
+
+  if (!(det > 0 || det < 0))
+    return false;
+  invDet = T(1) / det;
+
+  out = Mat4<T>(( m[5]*c5  - m[6]*c4  + m[7]*c3)  * invDet,
+                (-m[1]*c5  + m[2]*c4  - m[3]*c3)  * invDet,
+                ( m[13]*s5 - m[14]*s4 + m[15]*s3) * invDet,
+                (-m[9]*s5  + m[10]*s4 - m[11]*s3) * invDet,
+
+                (-m[4]*c5  + m[6]*c2  - m[7]*c1)  * invDet,
+                ( m[0]*c5  - m[2]*c2  + m[3]*c1)  * invDet,
+                (-m[12]*s5 + m[14]*s2 - m[15]*s1) * invDet,
+                ( m[8]*s5  - m[10]*s2 + m[11]*s1) * invDet,
+
+                ( m[4]*c4  - m[5]*c2  + m[7]*c0)  * invDet,
+                (-m[0]*c4  + m[1]*c2  - m[3]*c0)  * invDet,
+                ( m[12]*s4 - m[13]*s2 + m[15]*s0) * invDet,
+                (-m[8]*s4  + m[9]*s2  - m[11]*s0) * invDet,
+
+                (-m[4]*c3  + m[5]*c1  - m[6]*c0)  * invDet,
+                ( m[0]*c3  - m[1]*c1  + m[2]*c0)  * invDet,
+                (-m[12]*s3 + m[13]*s1 - m[14]*s0) * invDet,
+                ( m[8]*s3  - m[9]*s1  + m[10]*s0) * invDet);
+  return true;
+}
+
+/* Inverse of a rigid-body (rotation plus translation) expression: the
+   transposed rotation and the rotated, negated translation. */
+template <typename T, typename E>
+Mat4<T> inverseRigid(const Mat4Expr<T, E> &e)
+{
+  const Mat4<T> a(e);
+  const T *m = a.m;
+
+  return Mat4<T>(m[0], m[4], m[8],  -(m[0]*m[3] + m[4]*m[7] + m[8]*m[11]),
+                 m[1], m[5], m[9],  -(m[1]*m[3] + m[5]*m[7] + m[9]*m[11]),
+                 m[2], m[6], m[10], -(m[2]*m[3] + m[6]*m[7] + m[10]*m[11]),
+                 0, 0, 0, 1);
+}
+
+#endif /* MAT4_H */
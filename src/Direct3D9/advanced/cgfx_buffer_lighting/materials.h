@@ -1,6 +1,9 @@
 
 /* materials.h - static data for various materials */
 
+#ifndef MATERIALS_H
+#define MATERIALS_H
+
 typedef struct {
   float ambient[4];
   float diffuse[4];
@@ -15,3 +18,5 @@ typedef struct {
 
 extern const MaterialInfo materialInfo[];
 extern const int materialInfoCount;
+
+#endif /* MATERIALS_H */
@@ -6,53 +6,50 @@
    use glLoadTransposeMatrixf, etc. (rather than simply glLoadMatrixf). */
 
 /* The implementation of these routines favors accuracy, portability, and
-   read-ability rather than high performance. */
+   read-ability rather than high performance.  The batched and SIMD
+   routines at the end of the file are the exception.
+
+   Most of the single-matrix routines are thin wrappers over the Mat4 and
+   Vec4 types in mat4.h, which give the same results.  They compute in
+   MatrixReal and MatrixAccum (see matrix_precision.h), as chosen by
+   MATRIX_PRECISION. */
 
 #include <assert.h>
 #include <math.h>
 #include <stdio.h>
 
+#include "matrix.h"
+#include "mat4.h"
+#include "matrix_precision.h"
+#include "matrix_simd.h"
+#include "parallel.h"
+#include "sincos.h"
+
 static const double myPi = 3.14159265358979323846;
 
+typedef Mat4<MatrixAccum> Mat4a;
+typedef Vec4<MatrixAccum> Vec4a;
+
+const char *getMatrixPrecisionName(void)
+{
+#if MATRIX_PRECISION == MATRIX_PRECISION_SPLIT
+  return "split";
+#elif MATRIX_PRECISION == MATRIX_PRECISION_FLOAT
+  return "float";
+#elif MATRIX_PRECISION == MATRIX_PRECISION_MIXED
+  return "mixed";
+#else
+  return "double";
+#endif
+}
+
 void makePerspectiveMatrix(double fieldOfView,
                            double aspectRatio,
                            double zNear, double zFar,
                            float m[16])
 {
-  double sine, cotangent, deltaZ;
-  double radians = fieldOfView / 2.0 * myPi / 180.0;
-  
-  deltaZ = zFar - zNear;
-  sine = sin(radians);
-  /* Should be non-zero to avoid division by zero. */
-  assert(deltaZ);
-  assert(sine);
-  assert(aspectRatio);
-  cotangent = cos(radians) / sine;
-
-  /* First row */
-  m[0*4+0] = (float) (cotangent / aspectRatio);
-  m[0*4+1] = 0.0;
-  m[0*4+2] = 0.0;
-  m[0*4+3] = 0.0;
-  
-  /* Second row */
-  m[1*4+0] = 0.0;
-  m[1*4+1] = (float) cotangent;
-  m[1*4+2] = 0.0;
-  m[1*4+3] = 0.0;
-  
-  /* Third row */
-  m[2*4+0] = 0.0;
-  m[2*4+1] = 0.0;
-  m[2*4+2] = (float) (-(zFar + zNear) / deltaZ);
-  m[2*4+3] = (float) (-2 * zNear * zFar / deltaZ);
-  
-  /* Fourth row */
-  m[3*4+0] = 0.0;
-  m[3*4+1] = 0.0;
-  m[3*4+2] = -1;
-  m[3*4+3] = 0;
+  OpenGLConvention::store(
+    OpenGLConvention::perspectiveFov<MatrixReal>(fieldOfView, aspectRatio, zNear, zFar), m);
 }
 
 /* Build a row-major (C-style) 4x4 matrix transform based on the
@@ -62,92 +59,29 @@ void makeLookAtMatrix(double eyex, double eyey, double eyez,
                       double upx, double upy, double upz,
                       float m[16])
 {
-  double x[3], y[3], z[3], mag;
-
-  /* Difference eye and center vectors to make Z vector. */
-  z[0] = eyex - centerx;
-  z[1] = eyey - centery;
-  z[2] = eyez - centerz;
-  /* Normalize Z. */
-  mag = sqrt(z[0]*z[0] + z[1]*z[1] + z[2]*z[2]);
-  if (mag) {
-    z[0] /= mag;
-    z[1] /= mag;
-    z[2] /= mag;
-  }
-
-  /* Up vector makes Y vector. */
-  y[0] = upx;
-  y[1] = upy;
-  y[2] = upz;
-
-  /* X vector = Y cross Z. */
-  x[0] =  y[1]*z[2] - y[2]*z[1];
-  x[1] = -y[0]*z[2] + y[2]*z[0];
-  x[2] =  y[0]*z[1] - y[1]*z[0];
-
-  /* Recompute Y = Z cross X. */
-  y[0] =  z[1]*x[2] - z[2]*x[1];
-  y[1] = -z[0]*x[2] + z[2]*x[0];
-  y[2] =  z[0]*x[1] - z[1]*x[0];
-
-  /* Normalize X. */
-  mag = sqrt(x[0]*x[0] + x[1]*x[1] + x[2]*x[2]);
-  if (mag) {
-    x[0] /= mag;
-    x[1] /= mag;
-    x[2] /= mag;
-  }
-
-  /* Normalize Y. */
-  mag = sqrt(y[0]*y[0] + y[1]*y[1] + y[2]*y[2]);
-  if (mag) {
-    y[0] /= mag;
-    y[1] /= mag;
-    y[2] /= mag;
-  }
-
-  /* Build resulting view matrix. */
-  m[0*4+0] = (float) x[0];  m[0*4+1] = (float) x[1];
-  m[0*4+2] = (float) x[2];  m[0*4+3] = (float) (-x[0]*eyex + -x[1]*eyey + -x[2]*eyez);
-
-  m[1*4+0] = (float) y[0];  m[1*4+1] = (float) y[1];
-  m[1*4+2] = (float) y[2];  m[1*4+3] = (float) (-y[0]*eyex + -y[1]*eyey + -y[2]*eyez);
-
-  m[2*4+0] = (float) z[0];  m[2*4+1] = (float) z[1];
-  m[2*4+2] = (float) z[2];  m[2*4+3] = (float) (-z[0]*eyex + -z[1]*eyey + -z[2]*eyez);
-
-  m[3*4+0] = 0.0;   m[3*4+1] = 0.0;  m[3*4+2] = 0.0;  m[3*4+3] = 1.0;
+  OpenGLConvention::store(
+    OpenGLConvention::lookAt<MatrixReal>(eyex, eyey, eyez,
+                                         centerx, centery, centerz,
+                                         upx, upy, upz), m);
 }
 
 /* Simple 4x4 matrix by 4x4 matrix multiply. */
 void multMatrix(float dst[16],
                 const float src1[16], const float src2[16])
 {
-  float tmp[16];
-  int i, j;
-
-  for (i=0; i<4; i++) {
-    for (j=0; j<4; j++) {
-      tmp[i*4+j] = src1[i*4+0] * src2[0*4+j] +
-                   src1[i*4+1] * src2[1*4+j] +
-                   src1[i*4+2] * src2[2*4+j] +
-                   src1[i*4+3] * src2[3*4+j];
-    }
-  }
-  /* Copy result to dst (so dst can also be src1 or src2). */
-  for (i=0; i<16; i++)
-    dst[i] = tmp[i];
+  /* The operands are copied in first, so dst can also be src1 or src2. */
+  Mat4a(Mat4a::load(src1) * Mat4a::load(src2)).store(dst);
 }
 
-/* Normalize a 3-component vector. */
-void normalizeDirection(float v[3])
+template <typename T>
+static void normalize3(T v[3])
 {
-  float mag;
+  T mag;
 
-  mag = (float) sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+  mag = (T) sqrt((MatrixAccum) v[0]*v[0] + (MatrixAccum) v[1]*v[1] +
+                 (MatrixAccum) v[2]*v[2]);
   if (mag) {
-    float oneOverMag = 1.0f / mag;
+    T oneOverMag = 1 / mag;
 
     v[0] *= oneOverMag;
     v[1] *= oneOverMag;
@@ -155,69 +89,59 @@ void normalizeDirection(float v[3])
   }
 }
 
+/* Normalize a 3-component vector. */
+void normalizeDirection(float v[3])
+{
+  normalize3(v);
+}
+
+/* The angle and its sine and cosine are in MatrixReal, but with
+   MATRIX_PRECISION_SPLIT the rotation is built from them in float, as
+   makeRotateMatrix always has. */
+#if MATRIX_PRECISION == MATRIX_PRECISION_SPLIT
+typedef float RotateReal;
+#else
+typedef MatrixReal RotateReal;
+#endif
+
 /* Build a row-major (C-style) 4x4 matrix transform based on the
    parameters for glRotatef. */
 void makeRotateMatrix(float angle,
                       float ax, float ay, float az,
                       float m[16])
 {
-  double radians;
-  float sine, cosine, ab, bc, ca, tx, ty, tz;
-  float axis[3];
+  MatrixReal radians;
+  RotateReal sine, cosine;
+  RotateReal axis[3];
 
   axis[0] = ax;
   axis[1] = ay;
   axis[2] = az;
-  normalizeDirection(axis);
-
-  radians = angle * myPi / 180.0;
-  sine = (float) sin(radians);
-  cosine = (float) cos(radians);
-  ab = axis[0] * axis[1] * (1 - cosine);
-  bc = axis[1] * axis[2] * (1 - cosine);
-  ca = axis[2] * axis[0] * (1 - cosine);
-  tx = axis[0] * axis[0];
-  ty = axis[1] * axis[1];
-  tz = axis[2] * axis[2];
-
-  m[0]  = tx + cosine * (1 - tx);
-  m[1]  = ab + axis[2] * sine;
-  m[2]  = ca - axis[1] * sine;
-  m[3]  = 0.0f;
-  m[4]  = ab - axis[2] * sine;
-  m[5]  = ty + cosine * (1 - ty);
-  m[6]  = bc + axis[0] * sine;
-  m[7]  = 0.0f;
-  m[8]  = ca + axis[1] * sine;
-  m[9]  = bc - axis[0] * sine;
-  m[10] = tz + cosine * (1 - tz);
-  m[11] = 0;
-  m[12] = 0;
-  m[13] = 0;
-  m[14] = 0;
-  m[15] = 1;
+  normalize3(axis);
+
+  radians = angle * (MatrixReal) myPi / 180;
+  sine = (RotateReal) sin(radians);
+  cosine = (RotateReal) cos(radians);
+  makeRotateMat4(sine, cosine, axis[0], axis[1], axis[2]).store(m);
 }
 
 /* Build a row-major (C-style) 4x4 matrix transform based on the
    parameters for glTranslatef. */
 void makeTranslateMatrix(float x, float y, float z, float m[16])
 {
-  m[0]  = 1;  m[1]  = 0;  m[2]  = 0;  m[3]  = x;
-  m[4]  = 0;  m[5]  = 1;  m[6]  = 0;  m[7]  = y;
-  m[8]  = 0;  m[9]  = 0;  m[10] = 1;  m[11] = z;
-  m[12] = 0;  m[13] = 0;  m[14] = 0;  m[15] = 1;
+  makeTranslateMat4(x, y, z).store(m);
 }
 
 /* Invert a row-major (C-style) 4x4 matrix. */
 void invertMatrix(float out[16], const float m[16])
 {
 /* Assumes matrices are ROW major. */
-#define SWAP_ROWS(a, b) { double *_tmp = a; (a)=(b); (b)=_tmp; }
+#define SWAP_ROWS(a, b) { MatrixReal *_tmp = a; (a)=(b); (b)=_tmp; }
 #define MAT(m,r,c) (m)[(r)*4+(c)]
 
-  double wtmp[4][8];
-  double m0, m1, m2, m3, s;
-  double *r0, *r1, *r2, *r3;
+  MatrixReal wtmp[4][8];
+  MatrixReal m0, m1, m2, m3, s;
+  MatrixReal *r0, *r1, *r2, *r3;
 
   r0 = wtmp[0], r1 = wtmp[1], r2 = wtmp[2], r3 = wtmp[3];
 
@@ -292,11 +216,11 @@ void invertMatrix(float out[16], const float m[16])
     assert(!"could not invert matrix");
   }
 
-  s = 1.0/r3[3];              /* Now back substitute row 3. */
+  s = 1/r3[3];              /* Now back substitute row 3. */
   r3[4] *= s; r3[5] *= s; r3[6] *= s; r3[7] *= s;
 
   m2 = r2[3];                 /* Now back substitute row 2. */
-  s  = 1.0/r2[2];
+  s  = 1/r2[2];
   r2[4] = s * (r2[4] - r3[4] * m2), r2[5] = s * (r2[5] - r3[5] * m2),
   r2[6] = s * (r2[6] - r3[6] * m2), r2[7] = s * (r2[7] - r3[7] * m2);
   m1 = r1[3];
@@ -307,7 +231,7 @@ void invertMatrix(float out[16], const float m[16])
   r0[6] -= r3[6] * m0, r0[7] -= r3[7] * m0;
 
   m1 = r1[2];                 /* Now back substitute row 1. */
-  s  = 1.0/r1[1];
+  s  = 1/r1[1];
   r1[4] = s * (r1[4] - r2[4] * m1), r1[5] = s * (r1[5] - r2[5] * m1),
   r1[6] = s * (r1[6] - r2[6] * m1), r1[7] = s * (r1[7] - r2[7] * m1);
   m0 = r0[2];
@@ -315,7 +239,7 @@ void invertMatrix(float out[16], const float m[16])
   r0[6] -= r2[6] * m0, r0[7] -= r2[7] * m0;
 
   m0 = r0[1];                 /* Now back substitute row 0. */
-  s  = 1.0/r0[0];
+  s  = 1/r0[0];
   r0[4] = s * (r0[4] - r1[4] * m0), r0[5] = s * (r0[5] - r1[5] * m0),
   r0[6] = s * (r0[6] - r1[6] * m0), r0[7] = s * (r0[7] - r1[7] * m0);
 
@@ -332,20 +256,72 @@ void invertMatrix(float out[16], const float m[16])
 #undef SWAP_ROWS
 }
 
+/* Invert an affine matrix (bottom row [ 0 0 0 1 ]). */
+int invertAffineMatrix(float out[16], const float m[16])
+{
+#define A(r,c) ((MatrixReal) m[(r)*4+(c)])
+  MatrixReal c0[3], c1[3], c2[3], inv[9], invDet;
+  MatrixWide det, t[3];
+  int i;
+
+  /* The inverse of the upper 3x3 A is the transpose of its cofactor
+     matrix over det(A), and the cofactor rows are cross products of
+     pairs of rows of A. */
+  c0[0] = A(1,1)*A(2,2) - A(1,2)*A(2,1);
+  c0[1] = A(1,2)*A(2,0) - A(1,0)*A(2,2);
+  c0[2] = A(1,0)*A(2,1) - A(1,1)*A(2,0);
+  c1[0] = A(2,1)*A(0,2) - A(2,2)*A(0,1);
+  c1[1] = A(2,2)*A(0,0) - A(2,0)*A(0,2);
+  c1[2] = A(2,0)*A(0,1) - A(2,1)*A(0,0);
+  c2[0] = A(0,1)*A(1,2) - A(0,2)*A(1,1);
+  c2[1] = A(0,2)*A(1,0) - A(0,0)*A(1,2);
+  c2[2] = A(0,0)*A(1,1) - A(0,1)*A(1,0);
+
+  det = (MatrixWide) A(0,0)*c0[0] + (MatrixWide) A(0,1)*c0[1] +
+        (MatrixWide) A(0,2)*c0[2];
+  if (!(fabs(det) > 0))
+    return 0;
+  invDet = (MatrixReal) (1 / det);
+
+  for (i=0; i<3; i++) {
+    inv[i*3+0] = c0[i]*invDet;
+    inv[i*3+1] = c1[i]*invDet;
+    inv[i*3+2] = c2[i]*invDet;
+  }
+
+  /* New translation is -A^-1 * t, computed before out (which may be m)
+     is written. */
+  for (i=0; i<3; i++)
+    t[i] = -((MatrixWide) inv[i*3+0]*A(0,3) +
+             (MatrixWide) inv[i*3+1]*A(1,3) +
+             (MatrixWide) inv[i*3+2]*A(2,3));
+
+  for (i=0; i<3; i++) {
+    out[i*4+0] = (float) inv[i*3+0];
+    out[i*4+1] = (float) inv[i*3+1];
+    out[i*4+2] = (float) inv[i*3+2];
+    out[i*4+3] = (float) t[i];
+  }
+
+  out[12] = 0;  out[13] = 0;  out[14] = 0;  out[15] = 1;
+  return 1;
+#undef A
+}
+
+/* Invert a rigid-body (rotation plus translation) matrix. */
+void invertRigidMatrix(float out[16], const float m[16])
+{
+  inverseRigid(Mat4<MatrixWide>::load(m)).store(out);
+}
+
 /* Simple 4x4 matrix by 4-component column vector multiply and perform perspective divide. */
 void transformPosition(float dst[4],
                        const float mat[16], const float vec[4])
 {
-  double tmp[4], invW;
+  Vec4a tmp = Mat4a::load(mat) * Vec4a::load(vec);
+  MatrixAccum invW = 1 / tmp.w;
   int i;
 
-  for (i=0; i<4; i++) {
-    tmp[i] = mat[i*4+0] * vec[0] +
-             mat[i*4+1] * vec[1] +
-             mat[i*4+2] * vec[2] +
-             mat[i*4+3] * vec[3];
-  }
-  invW = 1 / tmp[3];
   /* Apply perspective divide and copy to dst (so dst can vec). */
   for (i=0; i<3; i++) {
     dst[i] = (float) (tmp[i] * invW);
@@ -357,18 +333,7 @@ void transformPosition(float dst[4],
 void transformVector(float dst[4],
                      const float mat[16], const float vec[4])
 {
-  double tmp[4];
-  int i;
-
-  for (i=0; i<4; i++) {
-    tmp[i] = mat[i*4+0] * vec[0] +
-             mat[i*4+1] * vec[1] +
-             mat[i*4+2] * vec[2] +
-             mat[i*4+3] * vec[3];
-  }
-  for (i=0; i<4; i++) {
-    dst[i] = (float) tmp[i];
-  }
+  (Mat4a::load(mat) * Vec4a::load(vec)).store(dst);
 }
 
 
@@ -377,17 +342,11 @@ void transformDirection(float dst[3],
                         const float mat[16],
                         const float vec[3])
 {
-  double tmp[3];
-  int i;
+  Vec4a tmp = Mat4a::load(mat) * Vec4a(vec[0], vec[1], vec[2], 0);
 
-  for (i=0; i<3; i++) {
-    tmp[i] = mat[i*4+0] * vec[0] +
-             mat[i*4+1] * vec[1] +
-             mat[i*4+2] * vec[2];
-  }
-  for (i=0; i<3; i++) {
-    dst[i] = (float) tmp[i];
-  }
+  dst[0] = (float) tmp.x;
+  dst[1] = (float) tmp.y;
+  dst[2] = (float) tmp.z;
 }
 
 void printMatrix(const char *name, const float mat[16])
@@ -414,16 +373,735 @@ void printDirection(const char *name, const float vec[4])
 }
 
 void transposeMatrix(float dst[16], const float mat[16])
+{
+  Mat4f(transpose(Mat4f::load(mat))).store(dst);
+}
+
+/* Batched and SIMD routines.
+
+   Unlike the routines above, these favor throughput: they work in single
+   precision and the inner kernel is picked once at run time from plain C,
+   SSE, or AVX2+FMA. */
+
+static MatrixSimdLevel detectMatrixSimdSupport(void)
+{
+  MatrixSimdLevel level = MATRIX_SIMD_SCALAR;
+
+#ifdef MATRIX_HAVE_SSE
+  int info[4], maxLeaf;
+# ifdef _MSC_VER
+#  define MATRIX_CPUID(leaf) __cpuidex(info, leaf, 0)
+# else
+#  define MATRIX_CPUID(leaf) __cpuid_count(leaf, 0, info[0], info[1], info[2], info[3])
+# endif
+
+  MATRIX_CPUID(0);
+  maxLeaf = info[0];
+  MATRIX_CPUID(1);
+  if (info[3] & (1 << 26))          /* SSE2 */
+    level = MATRIX_SIMD_SSE;
+# ifdef MATRIX_HAVE_AVX2
+  /* AVX2 also needs FMA, and OSXSAVE with the OS saving the YMM state. */
+  if ((info[2] & (1 << 12)) && (info[2] & (1 << 27)) && maxLeaf >= 7) {
+    unsigned int xcr0;              /* The low half, which has the SSE and AVX bits */
+#  ifdef _MSC_VER
+    xcr0 = (unsigned int) _xgetbv(0);
+#  else
+    unsigned int hi;
+    __asm__ __volatile__("xgetbv" : "=a"(xcr0), "=d"(hi) : "c"(0));
+    (void) hi;
+#  endif
+    if ((xcr0 & 6) == 6) {
+      MATRIX_CPUID(7);
+      if (info[1] & (1 << 5))       /* AVX2 */
+        level = MATRIX_SIMD_AVX2;
+    }
+  }
+# endif
+# undef MATRIX_CPUID
+#endif
+
+  return level;
+}
+
+static int myMatrixSimdSupport = -1;
+static int myMatrixSimdLevel = -1;
+
+MatrixSimdLevel getMatrixSimdSupport(void)
+{
+  if (myMatrixSimdSupport < 0)
+    myMatrixSimdSupport = detectMatrixSimdSupport();
+  return (MatrixSimdLevel) myMatrixSimdSupport;
+}
+
+MatrixSimdLevel getMatrixSimdLevel(void)
+{
+  if (myMatrixSimdLevel < 0)
+    myMatrixSimdLevel = getMatrixSimdSupport();
+  return (MatrixSimdLevel) myMatrixSimdLevel;
+}
+
+void setMatrixSimdLevel(MatrixSimdLevel level)
+{
+  MatrixSimdLevel support = getMatrixSimdSupport();
+
+  myMatrixSimdLevel = level > support ? support : level;
+}
+
+const char *getMatrixSimdLevelName(MatrixSimdLevel level)
+{
+  switch (level) {
+  case MATRIX_SIMD_SCALAR: return "scalar";
+  case MATRIX_SIMD_SSE:    return "sse";
+  case MATRIX_SIMD_AVX2:   return "avx2";
+  }
+  return "unknown";
+}
+
+static void multMatrixArrayScalar(float *dst, int dstStride,
+                                  const float *src1, int src1Stride,
+                                  const float *src2, int src2Stride,
+                                  int count)
 {
   float tmp[16];
-  int i, j;
+  int n, i, j;
 
-  for (i=0; i<4; i++) {
-    for (j=0; j<4; j++) {
-      tmp[i*4+j] = mat[j*4+i];
+  for (n=0; n<count; n++) {
+    for (i=0; i<4; i++) {
+      for (j=0; j<4; j++) {
+        tmp[i*4+j] = src1[i*4+0] * src2[0*4+j] +
+                     src1[i*4+1] * src2[1*4+j] +
+                     src1[i*4+2] * src2[2*4+j] +
+                     src1[i*4+3] * src2[3*4+j];
+      }
+    }
+    for (i=0; i<16; i++)
+      dst[i] = tmp[i];
+    dst += dstStride;
+    src1 += src1Stride;
+    src2 += src2Stride;
+  }
+}
+
+#ifdef MATRIX_HAVE_SSE
+
+/* Row i of the product is the sum over k of src1[i][k] times row k of
+   src2.  All of src2 is held in registers before dst is written, and
+   each src1 row is read before the matching dst row is stored, so dst
+   may alias either source. */
+MATRIX_TARGET_SSE
+static void multMatrixArraySSE(float *dst, int dstStride,
+                               const float *src1, int src1Stride,
+                               const float *src2, int src2Stride,
+                               int count)
+{
+  __m128 b0 = _mm_loadu_ps(src2+0), b1 = _mm_loadu_ps(src2+4),
+         b2 = _mm_loadu_ps(src2+8), b3 = _mm_loadu_ps(src2+12);
+  int n, i;
+
+  for (n=0; n<count; n++) {
+    if (n > 0 && src2Stride) {
+      b0 = _mm_loadu_ps(src2+0);
+      b1 = _mm_loadu_ps(src2+4);
+      b2 = _mm_loadu_ps(src2+8);
+      b3 = _mm_loadu_ps(src2+12);
+    }
+    for (i=0; i<4; i++) {
+      __m128 a = _mm_loadu_ps(src1+i*4);
+      __m128 r = _mm_mul_ps(_mm_shuffle_ps(a, a, 0x00), b0);
+      r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a, a, 0x55), b1));
+      r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a, a, 0xaa), b2));
+      r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a, a, 0xff), b3));
+      _mm_storeu_ps(dst+i*4, r);
+    }
+    dst += dstStride;
+    src1 += src1Stride;
+    src2 += src2Stride;
+  }
+}
+
+#endif /* MATRIX_HAVE_SSE */
+
+#ifdef MATRIX_HAVE_AVX2
+
+/* Same scheme as the SSE kernel, two rows at a time: each src2 row is
+   duplicated into both 128-bit lanes, and an in-lane shuffle of two
+   src1 rows broadcasts src1[i][k] to the low lane and src1[i+1][k] to
+   the high lane. */
+MATRIX_TARGET_AVX2
+static void multMatrixArrayAVX2(float *dst, int dstStride,
+                                const float *src1, int src1Stride,
+                                const float *src2, int src2Stride,
+                                int count)
+{
+  __m256 b0 = _mm256_broadcast_ps((const __m128 *) (src2+0)),
+         b1 = _mm256_broadcast_ps((const __m128 *) (src2+4)),
+         b2 = _mm256_broadcast_ps((const __m128 *) (src2+8)),
+         b3 = _mm256_broadcast_ps((const __m128 *) (src2+12));
+  int n;
+
+  for (n=0; n<count; n++) {
+    __m256 a01, a23, r01, r23;
+
+    if (n > 0 && src2Stride) {
+      b0 = _mm256_broadcast_ps((const __m128 *) (src2+0));
+      b1 = _mm256_broadcast_ps((const __m128 *) (src2+4));
+      b2 = _mm256_broadcast_ps((const __m128 *) (src2+8));
+      b3 = _mm256_broadcast_ps((const __m128 *) (src2+12));
+    }
+    a01 = _mm256_loadu_ps(src1+0);
+    a23 = _mm256_loadu_ps(src1+8);
+
+    r01 = _mm256_mul_ps(_mm256_shuffle_ps(a01, a01, 0x00), b0);
+    r23 = _mm256_mul_ps(_mm256_shuffle_ps(a23, a23, 0x00), b0);
+    r01 = _mm256_fmadd_ps(_mm256_shuffle_ps(a01, a01, 0x55), b1, r01);
+    r23 = _mm256_fmadd_ps(_mm256_shuffle_ps(a23, a23, 0x55), b1, r23);
+    r01 = _mm256_fmadd_ps(_mm256_shuffle_ps(a01, a01, 0xaa), b2, r01);
+    r23 = _mm256_fmadd_ps(_mm256_shuffle_ps(a23, a23, 0xaa), b2, r23);
+    r01 = _mm256_fmadd_ps(_mm256_shuffle_ps(a01, a01, 0xff), b3, r01);
+    r23 = _mm256_fmadd_ps(_mm256_shuffle_ps(a23, a23, 0xff), b3, r23);
+
+    _mm256_storeu_ps(dst+0, r01);
+    _mm256_storeu_ps(dst+8, r23);
+    dst += dstStride;
+    src1 += src1Stride;
+    src2 += src2Stride;
+  }
+}
+
+#endif /* MATRIX_HAVE_AVX2 */
+
+void multMatrixArrayStrided(float *dst, int dstStride,
+                            const float *src1, int src1Stride,
+                            const float *src2, int src2Stride,
+                            int count)
+{
+  if (count <= 0)
+    return;
+
+  switch (getMatrixSimdLevel()) {
+#ifdef MATRIX_HAVE_AVX2
+  case MATRIX_SIMD_AVX2:
+    multMatrixArrayAVX2(dst, dstStride, src1, src1Stride, src2, src2Stride, count);
+    return;
+#endif
+#ifdef MATRIX_HAVE_SSE
+  case MATRIX_SIMD_SSE:
+    multMatrixArraySSE(dst, dstStride, src1, src1Stride, src2, src2Stride, count);
+    return;
+#endif
+  default:
+    multMatrixArrayScalar(dst, dstStride, src1, src1Stride, src2, src2Stride, count);
+    return;
+  }
+}
+
+void multMatrixArray(float *dst,
+                     const float *src1, const float *src2,
+                     int count)
+{
+  multMatrixArrayStrided(dst, 16, src1, 16, src2, 16, count);
+}
+
+/* General inverse by 2x2 blocks.  Splitting the matrix into
+
+     | A B |
+     | C D |
+
+   the inverse's blocks are adjugate products of A, B, C, D divided by the
+   full determinant, so every cofactor is formed from 2x2 determinants
+   that are shared between blocks.  The scalar and SSE versions evaluate
+   the same expressions. */
+
+static int invertMatrixCofactorScalar(float out[16], const float m[16])
+{
+  Mat4f inv;
+
+  if (!inverse(Mat4f::load(m), inv))
+    return 0;
+  inv.store(out);
+  return 1;
+}
+
+#ifdef MATRIX_HAVE_SSE
+
+/* 2x2 matrices are held in one register as ( m00 m01 m10 m11 ). */
+#define SWIZZLE(v, x, y, z, w) _mm_shuffle_ps(v, v, _MM_SHUFFLE(w, z, y, x))
+#define SHUFFLE(a, b, x, y, z, w) _mm_shuffle_ps(a, b, _MM_SHUFFLE(w, z, y, x))
+
+/* a * b */
+MATRIX_TARGET_SSE
+static inline __m128 mat2Mul(__m128 a, __m128 b)
+{
+  return _mm_add_ps(_mm_mul_ps(a, SWIZZLE(b, 0,3,0,3)),
+                    _mm_mul_ps(SWIZZLE(a, 1,0,3,2), SWIZZLE(b, 2,1,2,1)));
+}
+
+/* adjugate(a) * b */
+MATRIX_TARGET_SSE
+static inline __m128 mat2AdjMul(__m128 a, __m128 b)
+{
+  return _mm_sub_ps(_mm_mul_ps(SWIZZLE(a, 3,3,0,0), b),
+                    _mm_mul_ps(SWIZZLE(a, 1,1,2,2), SWIZZLE(b, 2,3,0,1)));
+}
+
+/* a * adjugate(b) */
+MATRIX_TARGET_SSE
+static inline __m128 mat2MulAdj(__m128 a, __m128 b)
+{
+  return _mm_sub_ps(_mm_mul_ps(a, SWIZZLE(b, 3,0,3,0)),
+                    _mm_mul_ps(SWIZZLE(a, 1,0,3,2), SWIZZLE(b, 2,1,2,1)));
+}
+
+MATRIX_TARGET_SSE
+static int invertMatrixCofactorSSE(float out[16], const float m[16])
+{
+  __m128 r0 = _mm_loadu_ps(m+0), r1 = _mm_loadu_ps(m+4),
+         r2 = _mm_loadu_ps(m+8), r3 = _mm_loadu_ps(m+12);
+  __m128 A = _mm_movelh_ps(r0, r1), B = _mm_movehl_ps(r1, r0),
+         C = _mm_movelh_ps(r2, r3), D = _mm_movehl_ps(r3, r2);
+  __m128 detSub, detA, detB, detC, detD, dC, aB, X, Y, Z, W, detM, tr, rcp;
+  float det;
+
+  /* det(A), det(B), det(C), det(D) in one go. */
+  detSub = _mm_sub_ps(_mm_mul_ps(SHUFFLE(r0, r2, 0,2,0,2), SHUFFLE(r1, r3, 1,3,1,3)),
+                      _mm_mul_ps(SHUFFLE(r0, r2, 1,3,1,3), SHUFFLE(r1, r3, 0,2,0,2)));
+  detA = SWIZZLE(detSub, 0,0,0,0);
+  detB = SWIZZLE(detSub, 1,1,1,1);
+  detC = SWIZZLE(detSub, 2,2,2,2);
+  detD = SWIZZLE(detSub, 3,3,3,3);
+
+  dC = mat2AdjMul(D, C);
+  aB = mat2AdjMul(A, B);
+  X = _mm_sub_ps(_mm_mul_ps(detD, A), mat2Mul(B, dC));
+  W = _mm_sub_ps(_mm_mul_ps(detA, D), mat2Mul(C, aB));
+  Y = _mm_sub_ps(_mm_mul_ps(detB, C), mat2MulAdj(D, aB));
+  Z = _mm_sub_ps(_mm_mul_ps(detC, B), mat2MulAdj(A, dC));
+
+  /* det(M) = det(A)det(D) + det(B)det(C) - trace(adj(A)B adj(D)C) */
+  detM = _mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC));
+  tr = _mm_mul_ps(aB, SWIZZLE(dC, 0,2,1,3));
+  tr = _mm_add_ps(tr, SWIZZLE(tr, 2,3,0,1));
+  tr = _mm_add_ps(tr, SWIZZLE(tr, 1,0,3,2));
+  detM = _mm_sub_ps(detM, tr);
+
+  det = _mm_cvtss_f32(detM);
+  if (!(fabs(det) > 0))
+    return 0;
+
+  /* Fold the 2x2 adjugate signs into the reciprocal determinant. */
+  rcp = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), detM);
+  X = _mm_mul_ps(X, rcp);
+  Y = _mm_mul_ps(Y, rcp);
+  Z = _mm_mul_ps(Z, rcp);
+  W = _mm_mul_ps(W, rcp);
+
+  _mm_storeu_ps(out+0,  SHUFFLE(X, Y, 3,1,3,1));
+  _mm_storeu_ps(out+4,  SHUFFLE(X, Y, 2,0,2,0));
+  _mm_storeu_ps(out+8,  SHUFFLE(Z, W, 3,1,3,1));
+  _mm_storeu_ps(out+12, SHUFFLE(Z, W, 2,0,2,0));
+  return 1;
+}
+
+#undef SWIZZLE
+#undef SHUFFLE
+
+#endif /* MATRIX_HAVE_SSE */
+
+int invertMatrixCofactor(float out[16], const float m[16])
+{
+#ifdef MATRIX_HAVE_SSE
+  if (getMatrixSimdLevel() >= MATRIX_SIMD_SSE)
+    return invertMatrixCofactorSSE(out, m);
+#endif
+  return invertMatrixCofactorScalar(out, m);
+}
+
+/* Vertex array transforms.
+
+   All variants funnel into one structure-of-arrays kernel per instruction
+   set.  Each output row is a dot product of a matrix row with (x, y, z, w),
+   so the matrix elements are splatted once and 4 (SSE) or 8 (AVX2)
+   vertices are transformed per iteration, with the perspective divide done
+   in the same registers.  Interleaved input is transposed through small
+   on-stack SoA blocks. */
+
+enum { XFORM_VECTOR, XFORM_POSITION, XFORM_DIRECTION };
+
+/* Below this many vertices per thread the thread start-up dominates. */
+static const int myTransformMinPerThread = 1 << 16;
+
+/* Vertices per on-stack block for the interleaved routines. */
+#define TRANSFORM_BLOCK 256
+
+typedef struct {
+  int mode;
+  const float *mat;
+  const float *x, *y, *z, *w;
+  float *dstX, *dstY, *dstZ, *dstW;
+} TransformJob;
+
+static void transformSoAScalar(const TransformJob *job, int begin, int end)
+{
+  const float *m = job->mat;
+  int i;
+
+  for (i=begin; i<end; i++) {
+    float x = job->x[i], y = job->y[i], z = job->z[i];
+    float w = job->mode == XFORM_DIRECTION ? 0.0f : (job->w ? job->w[i] : 1.0f);
+    float tx = m[0]*x  + m[1]*y  + m[2]*z  + m[3]*w;
+    float ty = m[4]*x  + m[5]*y  + m[6]*z  + m[7]*w;
+    float tz = m[8]*x  + m[9]*y  + m[10]*z + m[11]*w;
+
+    if (job->mode == XFORM_VECTOR) {
+      job->dstW[i] = m[12]*x + m[13]*y + m[14]*z + m[15]*w;
+    } else if (job->mode == XFORM_POSITION) {
+      float invW = 1.0f / (m[12]*x + m[13]*y + m[14]*z + m[15]*w);
+      tx *= invW;
+      ty *= invW;
+      tz *= invW;
+    }
+    job->dstX[i] = tx;
+    job->dstY[i] = ty;
+    job->dstZ[i] = tz;
+  }
+}
+
+#ifdef MATRIX_HAVE_SSE
+
+MATRIX_TARGET_SSE
+static void transformSoASSE(const TransformJob *job, int begin, int end)
+{
+  const float *mat = job->mat;
+  const int mode = job->mode;
+  __m128 m[16];
+  int i;
+
+  for (i=0; i<16; i++)
+    m[i] = _mm_set1_ps(mat[i]);
+
+  for (i=begin; i+4<=end; i+=4) {
+    __m128 x = _mm_loadu_ps(job->x+i), y = _mm_loadu_ps(job->y+i),
+           z = _mm_loadu_ps(job->z+i), w, tx, ty, tz, tw;
+
+    if (mode == XFORM_DIRECTION)
+      w = _mm_setzero_ps();
+    else
+      w = job->w ? _mm_loadu_ps(job->w+i) : _mm_set1_ps(1.0f);
+    tx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0], x), _mm_mul_ps(m[1], y)),
+                    _mm_add_ps(_mm_mul_ps(m[2], z), _mm_mul_ps(m[3], w)));
+    ty = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[4], x), _mm_mul_ps(m[5], y)),
+                    _mm_add_ps(_mm_mul_ps(m[6], z), _mm_mul_ps(m[7], w)));
+    tz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[8], x), _mm_mul_ps(m[9], y)),
+                    _mm_add_ps(_mm_mul_ps(m[10], z), _mm_mul_ps(m[11], w)));
+    if (mode != XFORM_DIRECTION) {
+      tw = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[12], x), _mm_mul_ps(m[13], y)),
+                      _mm_add_ps(_mm_mul_ps(m[14], z), _mm_mul_ps(m[15], w)));
+      if (mode == XFORM_VECTOR) {
+        _mm_storeu_ps(job->dstW+i, tw);
+      } else {
+        __m128 invW = _mm_div_ps(_mm_set1_ps(1.0f), tw);
+        tx = _mm_mul_ps(tx, invW);
+        ty = _mm_mul_ps(ty, invW);
+        tz = _mm_mul_ps(tz, invW);
+      }
+    }
+    _mm_storeu_ps(job->dstX+i, tx);
+    _mm_storeu_ps(job->dstY+i, ty);
+    _mm_storeu_ps(job->dstZ+i, tz);
+  }
+  transformSoAScalar(job, i, end);
+}
+
+#endif /* MATRIX_HAVE_SSE */
+
+#ifdef MATRIX_HAVE_AVX2
+
+MATRIX_TARGET_AVX2
+static void transformSoAAVX2(const TransformJob *job, int begin, int end)
+{
+  const float *mat = job->mat;
+  const int mode = job->mode;
+  __m256 m[16];
+  int i;
+
+  for (i=0; i<16; i++)
+    m[i] = _mm256_set1_ps(mat[i]);
+
+  for (i=begin; i+8<=end; i+=8) {
+    __m256 x = _mm256_loadu_ps(job->x+i), y = _mm256_loadu_ps(job->y+i),
+           z = _mm256_loadu_ps(job->z+i), w, tx, ty, tz, tw;
+
+    if (mode == XFORM_DIRECTION)
+      w = _mm256_setzero_ps();
+    else
+      w = job->w ? _mm256_loadu_ps(job->w+i) : _mm256_set1_ps(1.0f);
+    tx = _mm256_fmadd_ps(m[3], w, _mm256_fmadd_ps(m[2], z,
+           _mm256_fmadd_ps(m[1], y, _mm256_mul_ps(m[0], x))));
+    ty = _mm256_fmadd_ps(m[7], w, _mm256_fmadd_ps(m[6], z,
+           _mm256_fmadd_ps(m[5], y, _mm256_mul_ps(m[4], x))));
+    tz = _mm256_fmadd_ps(m[11], w, _mm256_fmadd_ps(m[10], z,
+           _mm256_fmadd_ps(m[9], y, _mm256_mul_ps(m[8], x))));
+    if (mode != XFORM_DIRECTION) {
+      tw = _mm256_fmadd_ps(m[15], w, _mm256_fmadd_ps(m[14], z,
+             _mm256_fmadd_ps(m[13], y, _mm256_mul_ps(m[12], x))));
+      if (mode == XFORM_VECTOR) {
+        _mm256_storeu_ps(job->dstW+i, tw);
+      } else {
+        __m256 invW = _mm256_div_ps(_mm256_set1_ps(1.0f), tw);
+        tx = _mm256_mul_ps(tx, invW);
+        ty = _mm256_mul_ps(ty, invW);
+        tz = _mm256_mul_ps(tz, invW);
+      }
+    }
+    _mm256_storeu_ps(job->dstX+i, tx);
+    _mm256_storeu_ps(job->dstY+i, ty);
+    _mm256_storeu_ps(job->dstZ+i, tz);
+  }
+  transformSoAScalar(job, i, end);
+}
+
+#endif /* MATRIX_HAVE_AVX2 */
+
+static void transformSoARange(const TransformJob *job, int begin, int end)
+{
+  switch (getMatrixSimdLevel()) {
+#ifdef MATRIX_HAVE_AVX2
+  case MATRIX_SIMD_AVX2:
+    transformSoAAVX2(job, begin, end);
+    return;
+#endif
+#ifdef MATRIX_HAVE_SSE
+  case MATRIX_SIMD_SSE:
+    transformSoASSE(job, begin, end);
+    return;
+#endif
+  default:
+    transformSoAScalar(job, begin, end);
+    return;
+  }
+}
+
+/* parallelFor work item for the SoA routines. */
+struct TransformSoATask {
+  const TransformJob *job;
+
+  void operator()(int begin, int end) const
+  {
+    transformSoARange(job, begin, end);
+  }
+};
+
+static void transformSoA(const TransformJob *job, int count)
+{
+  TransformSoATask task = { job };
+
+  /* Resolve the kernel before any worker thread asks for it. */
+  getMatrixSimdLevel();
+  parallelFor(count, myTransformMinPerThread, 8, task);
+}
+
+void transformVectorArraySoA(float *dstX, float *dstY, float *dstZ, float *dstW,
+                             const float mat[16],
+                             const float *x, const float *y, const float *z,
+                             const float *w,
+                             int count)
+{
+  TransformJob job = { XFORM_VECTOR, mat, x, y, z, w, dstX, dstY, dstZ, dstW };
+
+  transformSoA(&job, count);
+}
+
+void transformPositionArraySoA(float *dstX, float *dstY, float *dstZ,
+                               const float mat[16],
+                               const float *x, const float *y, const float *z,
+                               const float *w,
+                               int count)
+{
+  TransformJob job = { XFORM_POSITION, mat, x, y, z, w, dstX, dstY, dstZ, NULL };
+
+  transformSoA(&job, count);
+}
+
+void transformDirectionArraySoA(float *dstX, float *dstY, float *dstZ,
+                                const float mat[16],
+                                const float *x, const float *y, const float *z,
+                                int count)
+{
+  TransformJob job = { XFORM_DIRECTION, mat, x, y, z, NULL, dstX, dstY, dstZ, NULL };
+
+  transformSoA(&job, count);
+}
+
+/* Copy n packed 3-float vertices into separate x, y, z arrays and back.
+   The SSE versions transpose four vertices (three registers) at a time. */
+static int deinterleave3Scalar(const float *src, int srcStride,
+                               float *x, float *y, float *z, int i, int n)
+{
+  for (src += (size_t) i * srcStride; i<n; i++, src += srcStride) {
+    x[i] = src[0];
+    y[i] = src[1];
+    z[i] = src[2];
+  }
+  return n;
+}
+
+static int interleave3Scalar(float *dst, int dstStride,
+                             const float *x, const float *y, const float *z, int i, int n)
+{
+  for (dst += (size_t) i * dstStride; i<n; i++, dst += dstStride) {
+    dst[0] = x[i];
+    dst[1] = y[i];
+    dst[2] = z[i];
+  }
+  return n;
+}
+
+#ifdef MATRIX_HAVE_SSE
+
+#define SHUFFLE(a, b, x, y, z, w) _mm_shuffle_ps(a, b, _MM_SHUFFLE(w, z, y, x))
+
+/* Returns how many vertices (a multiple of 4) were converted. */
+MATRIX_TARGET_SSE
+static int deinterleave3SSE(const float *src, float *x, float *y, float *z, int n)
+{
+  int i;
+
+  for (i=0; i+4<=n; i+=4, src += 12) {
+    /* a = x0 y0 z0 x1,  b = y1 z1 x2 y2,  c = z2 x3 y3 z3 */
+    __m128 a = _mm_loadu_ps(src), b = _mm_loadu_ps(src+4), c = _mm_loadu_ps(src+8);
+    __m128 xy23 = SHUFFLE(b, c, 2,3,1,2);      /* x2 y2 x3 y3 */
+    __m128 yz01 = SHUFFLE(a, b, 1,2,0,1);      /* y0 z0 y1 z1 */
+    __m128 z3 = SHUFFLE(c, c, 0,3,0,3);        /* z2 z3 z2 z3 */
+
+    _mm_storeu_ps(x+i, SHUFFLE(a, xy23, 0,3,0,2));
+    _mm_storeu_ps(y+i, SHUFFLE(yz01, xy23, 0,2,1,3));
+    _mm_storeu_ps(z+i, SHUFFLE(yz01, z3, 1,3,0,1));
+  }
+  return i;
+}
+
+MATRIX_TARGET_SSE
+static int interleave3SSE(float *dst, const float *x, const float *y, const float *z, int n)
+{
+  int i;
+
+  for (i=0; i+4<=n; i+=4, dst += 12) {
+    __m128 vx = _mm_loadu_ps(x+i), vy = _mm_loadu_ps(y+i), vz = _mm_loadu_ps(z+i);
+    __m128 xy01 = _mm_unpacklo_ps(vx, vy);     /* x0 y0 x1 y1 */
+    __m128 xy23 = _mm_unpackhi_ps(vx, vy);     /* x2 y2 x3 y3 */
+    __m128 zx = SHUFFLE(vz, xy01, 0,0,2,2);    /* z0 z0 x1 x1 */
+    __m128 yz = SHUFFLE(xy01, vz, 3,3,1,1);    /* y1 y1 z1 z1 */
+    __m128 zxy = SHUFFLE(vz, xy23, 2,2,2,3);   /* z2 z2 x3 y3 */
+    __m128 yz3 = SHUFFLE(xy23, vz, 3,3,3,3);   /* y3 y3 z3 z3 */
+
+    _mm_storeu_ps(dst,   SHUFFLE(xy01, zx, 0,1,0,2));
+    _mm_storeu_ps(dst+4, SHUFFLE(yz, xy23, 0,2,0,1));
+    _mm_storeu_ps(dst+8, SHUFFLE(zxy, yz3, 0,2,0,2));
+  }
+  return i;
+}
+
+#undef SHUFFLE
+
+#endif /* MATRIX_HAVE_SSE */
+
+/* parallelFor work item for the interleaved routines. */
+struct TransformInterleavedTask {
+  int mode;
+  float *dst;
+  int dstStride;
+  const float *mat;
+  const float *src;
+  int srcStride;
+
+  void operator()(int begin, int end) const
+  {
+    float x[TRANSFORM_BLOCK], y[TRANSFORM_BLOCK], z[TRANSFORM_BLOCK];
+    TransformJob job = { mode, mat, x, y, z, NULL, x, y, z, NULL };
+    int simd = getMatrixSimdLevel() >= MATRIX_SIMD_SSE;
+    int block, i, n;
+
+    for (block = begin; block < end; block += TRANSFORM_BLOCK) {
+      const float *s = src + (size_t) block * srcStride;
+      float *d = dst + (size_t) block * dstStride;
+
+      n = end - block < TRANSFORM_BLOCK ? end - block : TRANSFORM_BLOCK;
+      i = 0;
+#ifdef MATRIX_HAVE_SSE
+      if (srcStride == 3 && simd)
+        i = deinterleave3SSE(s, x, y, z, n);
+#endif
+      deinterleave3Scalar(s, srcStride, x, y, z, i, n);
+
+      transformSoARange(&job, 0, n);
+
+      i = 0;
+#ifdef MATRIX_HAVE_SSE
+      if (dstStride == 3 && simd)
+        i = interleave3SSE(d, x, y, z, n);
+#endif
+      interleave3Scalar(d, dstStride, x, y, z, i, n);
     }
   }
-  for (i=0; i<16; i++) {
-    dst[i] = tmp[i];
+};
+
+static void transformInterleaved(int mode,
+                                 float *dst, int dstStride,
+                                 const float mat[16],
+                                 const float *src, int srcStride,
+                                 int count)
+{
+  TransformInterleavedTask task = { mode, dst, dstStride, mat, src, srcStride };
+
+  getMatrixSimdLevel();
+  parallelFor(count, myTransformMinPerThread, TRANSFORM_BLOCK, task);
+}
+
+void transformPositionArray(float *dst, int dstStride,
+                            const float mat[16],
+                            const float *src, int srcStride,
+                            int count)
+{
+  transformInterleaved(XFORM_POSITION, dst, dstStride, mat, src, srcStride, count);
+}
+
+void transformDirectionArray(float *dst, int dstStride,
+                             const float mat[16],
+                             const float *src, int srcStride,
+                             int count)
+{
+  transformInterleaved(XFORM_DIRECTION, dst, dstStride, mat, src, srcStride, count);
+}
+
+/* Angles are converted a block at a time so the sines and cosines can be
+   computed in one sinCosArray call without a heap allocation. */
+#define ROTATE_BLOCK 256
+
+void makeRotateMatrixArray(float *dst, int dstStride,
+                           const float *angle,
+                           const float *axis, int axisStride,
+                           int count)
+{
+  const float degreesToRadians = (float) (myPi / 180.0);
+  float radians[ROTATE_BLOCK], sine[ROTATE_BLOCK], cosine[ROTATE_BLOCK];
+  int begin, n, i;
+
+  for (begin=0; begin<count; begin+=ROTATE_BLOCK) {
+    n = count - begin < ROTATE_BLOCK ? count - begin : ROTATE_BLOCK;
+    for (i=0; i<n; i++)
+      radians[i] = angle[begin+i] * degreesToRadians;
+    sinCosArray(sine, cosine, radians, n, SINCOS_FULL);
+    for (i=0; i<n; i++) {
+      const float *a = axis + (begin+i)*axisStride;
+      float unit[3];
+
+      unit[0] = a[0];
+      unit[1] = a[1];
+      unit[2] = a[2];
+      normalizeDirection(unit);
+      makeRotateMat4(sine[i], cosine[i], unit[0], unit[1], unit[2]).store(dst);
+      dst += dstStride;
+    }
   }
 }
@@ -15,9 +15,49 @@
 
    */
 
+#ifndef MATRIX_H
+#define MATRIX_H
+
 #include <assert.h>
 #include <math.h>
 
+/* Precision.
+
+   The single-matrix routines take and return floats whatever precision
+   they compute in.  Compile matrix.cpp, quaternion.cpp, and frustum.cpp
+   with MATRIX_PRECISION defined to one of these to choose it:
+
+     MATRIX_PRECISION_SPLIT   builders and inverses in double, matrix and
+                              vector products in float, as these routines
+                              always have (the default);
+
+     MATRIX_PRECISION_FLOAT   everything in float, with no conversions:
+                              the fastest builders and inverses, and the
+                              least accurate;
+
+     MATRIX_PRECISION_MIXED   builders and inverses in float, but sums of
+                              products (matrix and vector products, dot
+                              products, lengths) in double;
+
+     MATRIX_PRECISION_DOUBLE  everything in double, rounded to float once
+                              per result element: the most accurate, and
+                              several times slower per call.
+
+   The batched routines further down always work in float. */
+
+#define MATRIX_PRECISION_FLOAT   0
+#define MATRIX_PRECISION_MIXED   1
+#define MATRIX_PRECISION_DOUBLE  2
+#define MATRIX_PRECISION_SPLIT   3
+
+#ifndef MATRIX_PRECISION
+# define MATRIX_PRECISION MATRIX_PRECISION_SPLIT
+#endif
+
+/* "split", "float", "mixed", or "double": the precision matrix.cpp was
+   built with. */
+const char *getMatrixPrecisionName(void);
+
 void makePerspectiveMatrix(double fieldOfView,
                            double aspectRatio,
                            double zNear, double zFar,
@@ -50,6 +90,22 @@ void makeTranslateMatrix(float x, float y, float z, float m[16]);
 /* Invert a row-major (C-style) 4x4 matrix. */
 void invertMatrix(float out[16], const float m[16]);
 
+/* Invert an affine matrix, one whose bottom row is [ 0 0 0 1 ] (rotation,
+   scale, shear, and translation, but no projection).  Returns 1 on
+   success, or 0 and leaves out unchanged if the matrix is singular. */
+int invertAffineMatrix(float out[16], const float m[16]);
+
+/* Invert a rigid-body matrix: an affine matrix whose upper-left 3x3 is a
+   pure rotation (orthonormal, no scale), such as a look-at view matrix
+   times translations and rotations.  The inverse is just the transposed
+   rotation and the rotated, negated translation. */
+void invertRigidMatrix(float out[16], const float m[16]);
+
+/* Invert any 4x4 matrix in single precision using cofactors (SSE when
+   available) instead of Gauss-Jordan elimination.  Returns 1 on success,
+   or 0 and leaves out unchanged if the matrix is singular. */
+int invertMatrixCofactor(float out[16], const float m[16]);
+
 /* Transpose a 4x4 matrix. */
 void transposeMatrix(float dst[16], const float mat[16]);
 
@@ -69,3 +125,90 @@ void transformDirection(float dst[3],
 void printMatrix(const char *name, const float mat[16]);
 void printVector(const char *name, const float vec[4]);
 void printDirection(const char *name, const float vec[4]);
+
+/* Batched routines.
+
+   The ...Array routines process many matrices per call and use an SSE or
+   AVX2 kernel when the CPU supports one, otherwise plain C.  The kernel is
+   chosen once at run time; setMatrixSimdLevel can force a lower level (to
+   compare kernels, for example). */
+
+typedef enum {
+  MATRIX_SIMD_SCALAR = 0,
+  MATRIX_SIMD_SSE    = 1,
+  MATRIX_SIMD_AVX2   = 2
+} MatrixSimdLevel;
+
+/* Best level this CPU and build can run. */
+MatrixSimdLevel getMatrixSimdSupport(void);
+
+/* Level currently used by the batched routines. */
+MatrixSimdLevel getMatrixSimdLevel(void);
+
+/* Select a level; requests above getMatrixSimdSupport() are clamped. */
+void setMatrixSimdLevel(MatrixSimdLevel level);
+
+const char *getMatrixSimdLevelName(MatrixSimdLevel level);
+
+/* dst[i] = src1[i] * src2[i] for count consecutive 16-float matrices.
+   dst[i] may be the same matrix as src1[i] or src2[i]. */
+void multMatrixArray(float *dst,
+                     const float *src1, const float *src2,
+                     int count);
+
+/* Same as multMatrixArray, but matrix i of each array starts i*stride
+   floats after the first one.  A stride of 16 means tightly packed, a
+   larger stride steps through an array of structs, and a stride of 0
+   reuses the same matrix for every i (say, one view matrix times many
+   model matrices). */
+void multMatrixArrayStrided(float *dst, int dstStride,
+                            const float *src1, int src1Stride,
+                            const float *src2, int src2Stride,
+                            int count);
+
+/* Array versions of transformVector, transformPosition, and
+   transformDirection for structure-of-arrays input: vertex i is
+   (x[i], y[i], z[i], w[i]).  A NULL w means w = 1 for every vertex.
+   Outputs may be the same arrays as the inputs.  Large arrays are split
+   across threads (see parallel.h). */
+void transformVectorArraySoA(float *dstX, float *dstY, float *dstZ, float *dstW,
+                             const float mat[16],
+                             const float *x, const float *y, const float *z,
+                             const float *w,
+                             int count);
+
+/* Includes the perspective divide; only x, y, and z are written. */
+void transformPositionArraySoA(float *dstX, float *dstY, float *dstZ,
+                               const float mat[16],
+                               const float *x, const float *y, const float *z,
+                               const float *w,
+                               int count);
+
+void transformDirectionArraySoA(float *dstX, float *dstY, float *dstZ,
+                                const float mat[16],
+                                const float *x, const float *y, const float *z,
+                                int count);
+
+/* Interleaved versions for 3-float vertices such as MY_V3F (w = 1 for
+   positions).  Vertex i starts i*stride floats into its array; dst may be
+   src when the strides match. */
+void transformPositionArray(float *dst, int dstStride,
+                            const float mat[16],
+                            const float *src, int srcStride,
+                            int count);
+
+void transformDirectionArray(float *dst, int dstStride,
+                             const float mat[16],
+                             const float *src, int srcStride,
+                             int count);
+
+/* makeRotateMatrix for count angles (in degrees), with axis i at
+   axis + i*axisStride (0 shares one axis).  The sines and cosines come
+   from sinCosArray (see sincos.h) at full precision, so the results are
+   within a few ulp of makeRotateMatrix's. */
+void makeRotateMatrixArray(float *dst, int dstStride,
+                           const float *angle,
+                           const float *axis, int axisStride,
+                           int count);
+
+#endif /* MATRIX_H */
@@ -0,0 +1,34 @@
+/* matrix_precision.h - Working types for the MATRIX_PRECISION setting. */
+
+/* Internal to matrix.cpp, quaternion.cpp, and frustum.cpp.  MatrixReal is
+   the type of element arithmetic (building, normalizing, eliminating),
+   MatrixAccum the type that sums of products are accumulated in, and
+   MatrixWide the wider of the two, for the sums inside builders and
+   inverses.  See matrix.h for the settings. */
+
+#ifndef MATRIX_PRECISION_H
+#define MATRIX_PRECISION_H
+
+#include "matrix.h"
+
+#if MATRIX_PRECISION == MATRIX_PRECISION_SPLIT
+typedef double MatrixReal;
+typedef float  MatrixAccum;
+typedef double MatrixWide;
+#elif MATRIX_PRECISION == MATRIX_PRECISION_FLOAT
+typedef float  MatrixReal;
+typedef float  MatrixAccum;
+typedef float  MatrixWide;
+#elif MATRIX_PRECISION == MATRIX_PRECISION_MIXED
+typedef float  MatrixReal;
+typedef double MatrixAccum;
+typedef double MatrixWide;
+#elif MATRIX_PRECISION == MATRIX_PRECISION_DOUBLE
+typedef double MatrixReal;
+typedef double MatrixAccum;
+typedef double MatrixWide;
+#else
+# error "MATRIX_PRECISION must be MATRIX_PRECISION_SPLIT, _FLOAT, _MIXED, or _DOUBLE"
+#endif
+
+#endif /* MATRIX_PRECISION_H */
@@ -0,0 +1,36 @@
+/* matrix_simd.h - Instruction set selection shared by the batched routines. */
+
+/* Internal to matrix.cpp, quaternion.cpp, sincos.cpp, frustum.cpp,
+   compress.cpp, bvh.cpp, and daefile.cpp.  Defines MATRIX_HAVE_SSE and
+   MATRIX_HAVE_AVX2 when the compiler can emit those kernels, and the
+   MATRIX_TARGET_... markers to put in front of each kernel.  Whether
+   the CPU can run them is decided at run time by getMatrixSimdLevel. */
+
+#ifndef MATRIX_SIMD_H
+#define MATRIX_SIMD_H
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+# define MATRIX_HAVE_SSE 1
+# include <emmintrin.h>
+# if !defined(_MSC_VER) || _MSC_VER >= 1700  /* AVX2 intrinsics need VS2012 or newer */
+#  define MATRIX_HAVE_AVX2 1
+#  include <immintrin.h>
+# endif
+# ifdef _MSC_VER
+#  include <intrin.h>
+# else
+#  include <cpuid.h>
+# endif
+#endif
+
+/* GCC and Clang only emit AVX2 code for functions that ask for it, so the
+   rest of the program can still run on older CPUs.  MSVC needs no marking. */
+#if defined(__GNUC__) || defined(__clang__)
+# define MATRIX_TARGET_SSE  __attribute__((target("sse2")))
+# define MATRIX_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+# define MATRIX_TARGET_SSE
+# define MATRIX_TARGET_AVX2
+#endif
+
+#endif /* MATRIX_SIMD_H */
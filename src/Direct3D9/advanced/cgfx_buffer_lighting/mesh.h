@@ -0,0 +1,15 @@
+/* mesh.h - The vertex of meshes loaded from files. */
+
+#ifndef MESH_H
+#define MESH_H
+
+/* One corner of a loaded mesh: an OBJ "v/vt/vn" triple.  Equal corners
+   share one vertex; corners at the same position with different normals
+   or texture coordinates are separate vertices, which makes a seam. */
+typedef struct {
+  float position[3];
+  float normal[3];
+  float texCoord[2];
+} MeshVertex;
+
+#endif /* MESH_H */
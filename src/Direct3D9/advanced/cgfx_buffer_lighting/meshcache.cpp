@@ -0,0 +1,279 @@
+/* meshcache.c - A binary mesh file laid out as it sits in memory, loaded by mapping it. */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "meshcache.h"
+
+static const char myMagic[4] = { 'M', 'S', 'H', 'C' };
+
+/* The file's records are these structures byte for byte, so their sizes
+   must not depend on the compiler: every field is 4 bytes, or chars. */
+typedef char MeshCacheHeaderSize[sizeof(MeshCacheHeader) == 84 ? 1 : -1];
+typedef char MeshCacheStreamSize[sizeof(MeshCacheStream) == 60 ? 1 : -1];
+typedef char MeshCacheIndexBufferSize[sizeof(MeshCacheIndexBuffer) == 16 ? 1 : -1];
+typedef char MeshCacheSubmeshSize[sizeof(MeshCacheSubmesh) == 48 ? 1 : -1];
+typedef char MeshCacheMaterialSize[sizeof(MeshCacheMaterial) == 128 ? 1 : -1];
+typedef char MeshCacheLodSize[sizeof(MeshCacheLod) == 16 ? 1 : -1];
+
+typedef struct {
+  MeshCacheHeader header;
+  unsigned int streamOffsets[MESHCACHE_MAX_STREAMS];
+  unsigned int indexOffsets[MESHCACHE_MAX_INDEX_BUFFERS];
+} MeshCacheLayout;
+
+static int isLittleEndian(void)
+{
+  unsigned int one = 1;
+  unsigned char first;
+
+  memcpy(&first, &one, 1);
+  return first == 1;
+}
+
+/* Append an aligned block of count records of size bytes at *offset,
+   returning its start, or 0 if the file would pass 4 GB. */
+static unsigned int placeBlock(unsigned int *offset, unsigned int count, unsigned int size)
+{
+  unsigned int start = (*offset + MESHCACHE_ALIGNMENT - 1) & ~(MESHCACHE_ALIGNMENT - 1u);
+
+  if (start < *offset || (size > 0 && count > (0xffffffffu - start) / size))
+    return 0;
+  *offset = start + count * size;
+  return start;
+}
+
+static int placeTable(MeshCacheTable *table, unsigned int *offset, int count, unsigned int size)
+{
+  table->count = (unsigned int) count;
+  table->offset = placeBlock(offset, table->count, size);
+  return table->offset != 0;
+}
+
+/* The header and every block's offset; 0 if the file would pass 4 GB. */
+static int layOutMeshCache(MeshCacheLayout *layout, const MeshCacheContents *c)
+{
+  MeshCacheHeader *h = &layout->header;
+  unsigned int offset = sizeof(MeshCacheHeader);
+  int i, ok;
+
+  memset(layout, 0, sizeof(*layout));
+  memcpy(h->magic, myMagic, 4);
+  h->version = MESHCACHE_VERSION;
+  memcpy(h->boundsMin, c->boundsMin, sizeof(h->boundsMin));
+  memcpy(h->boundsMax, c->boundsMax, sizeof(h->boundsMax));
+  h->radius = c->radius;
+  ok = placeTable(&h->streams, &offset, c->streamCount, sizeof(MeshCacheStream)) &&
+       placeTable(&h->indexBuffers, &offset, c->indexBufferCount, sizeof(MeshCacheIndexBuffer)) &&
+       placeTable(&h->submeshes, &offset, c->submeshCount, sizeof(MeshCacheSubmesh)) &&
+       placeTable(&h->materials, &offset, c->materialCount, sizeof(MeshCacheMaterial)) &&
+       placeTable(&h->lods, &offset, c->lodCount, sizeof(MeshCacheLod));
+  for (i = 0; i < c->streamCount && ok; i++) {
+    layout->streamOffsets[i] = placeBlock(&offset, c->streams[i].vertexCount,
+                                          c->streams[i].stride);
+    ok = layout->streamOffsets[i] != 0;
+  }
+  for (i = 0; i < c->indexBufferCount && ok; i++) {
+    layout->indexOffsets[i] = placeBlock(&offset, c->indexBuffers[i].indexCount,
+                                         c->indexBuffers[i].indexSize);
+    ok = layout->indexOffsets[i] != 0;
+  }
+  h->fileSize = offset;
+  return ok;
+}
+
+/* Whether every count and range in c lies inside its arrays. */
+static int isValidContents(const MeshCacheContents *c)
+{
+  int i;
+
+  if (c->streamCount < 1 || c->streamCount > MESHCACHE_MAX_STREAMS ||
+      c->indexBufferCount < 0 || c->indexBufferCount > MESHCACHE_MAX_INDEX_BUFFERS ||
+      c->submeshCount < 0 || c->materialCount < 0 || c->lodCount < 0)
+    return 0;
+  for (i = 0; i < c->streamCount; i++) {
+    const MeshCacheStream *s = &c->streams[i];
+
+    if (!(s->format == MESHCACHE_MESH_VERTEX && s->stride == sizeof(MeshVertex)) &&
+        !(s->format == MESHCACHE_PACKED_VERTEX && s->stride == sizeof(PackedVertex)))
+      return 0;
+    /* Streams are parallel. */
+    if (s->vertexCount != c->streams[0].vertexCount)
+      return 0;
+  }
+  for (i = 0; i < c->indexBufferCount; i++) {
+    unsigned int size = c->indexBuffers[i].indexSize;
+
+    if (size != 2 && size != 4)
+      return 0;
+  }
+  for (i = 0; i < c->submeshCount; i++) {
+    const MeshCacheSubmesh *s = &c->submeshes[i];
+    unsigned int vertexCount = c->streams[0].vertexCount, indexCount;
+
+    if (s->indexBuffer >= (unsigned int) c->indexBufferCount)
+      return 0;
+    indexCount = c->indexBuffers[s->indexBuffer].indexCount;
+    if (s->indexStart > indexCount || s->indexCount > indexCount - s->indexStart ||
+        s->vertexStart > vertexCount || s->vertexCount > vertexCount - s->vertexStart ||
+        s->material < -1 || s->material >= c->materialCount)
+      return 0;
+    /* Indices of 16 bits reach at most 65536 vertices past vertexStart. */
+    if (c->indexBuffers[s->indexBuffer].indexSize == 2 && s->vertexCount > 65536)
+      return 0;
+  }
+  for (i = 0; i < c->lodCount; i++) {
+    const MeshCacheLod *lod = &c->lods[i];
+
+    if (lod->submeshStart > (unsigned int) c->submeshCount ||
+        lod->submeshCount > (unsigned int) c->submeshCount - lod->submeshStart)
+      return 0;
+  }
+  return 1;
+}
+
+unsigned int getMeshCacheFileSize(const MeshCacheContents *contents)
+{
+  MeshCacheLayout layout;
+
+  return layOutMeshCache(&layout, contents) ? layout.header.fileSize : 0;
+}
+
+/* Write size bytes at offset, padding with zeros from where the file is. */
+static void writeBlock(FILE *file, unsigned int *at, unsigned int offset,
+                       const void *data, size_t size)
+{
+  static const char zeros[MESHCACHE_ALIGNMENT] = { 0 };
+
+  fwrite(zeros, 1, offset - *at, file);
+  if (size > 0)
+    fwrite(data, 1, size, file);
+  *at = offset + (unsigned int) size;
+}
+
+int writeMeshCache(const char *path, const MeshCacheContents *contents)
+{
+  MeshCacheLayout layout;
+  MeshCacheStream streams[MESHCACHE_MAX_STREAMS];
+  MeshCacheIndexBuffer indexBuffers[MESHCACHE_MAX_INDEX_BUFFERS];
+  const MeshCacheHeader *h = &layout.header;
+  unsigned int at = 0;
+  FILE *file;
+  int i, ok;
+
+  if (!isLittleEndian() || !isValidContents(contents) ||
+      !layOutMeshCache(&layout, contents))
+    return 0;
+  file = fopen(path, "wb");
+  if (!file)
+    return 0;
+  for (i = 0; i < contents->streamCount; i++) {
+    streams[i] = contents->streams[i];
+    streams[i].offset = layout.streamOffsets[i];
+  }
+  for (i = 0; i < contents->indexBufferCount; i++) {
+    indexBuffers[i] = contents->indexBuffers[i];
+    indexBuffers[i].offset = layout.indexOffsets[i];
+  }
+  writeBlock(file, &at, 0, h, sizeof(*h));
+  writeBlock(file, &at, h->streams.offset, streams,
+             contents->streamCount * sizeof(MeshCacheStream));
+  writeBlock(file, &at, h->indexBuffers.offset, indexBuffers,
+             contents->indexBufferCount * sizeof(MeshCacheIndexBuffer));
+  writeBlock(file, &at, h->submeshes.offset, contents->submeshes,
+             contents->submeshCount * sizeof(MeshCacheSubmesh));
+  writeBlock(file, &at, h->materials.offset, contents->materials,
+             contents->materialCount * sizeof(MeshCacheMaterial));
+  writeBlock(file, &at, h->lods.offset, contents->lods,
+             contents->lodCount * sizeof(MeshCacheLod));
+  for (i = 0; i < contents->streamCount; i++)
+    writeBlock(file, &at, layout.streamOffsets[i], contents->streamData[i],
+               (size_t) streams[i].vertexCount * streams[i].stride);
+  for (i = 0; i < contents->indexBufferCount; i++)
+    writeBlock(file, &at, layout.indexOffsets[i], contents->indexData[i],
+               (size_t) indexBuffers[i].indexCount * indexBuffers[i].indexSize);
+  ok = !ferror(file) && at == h->fileSize;
+  return fclose(file) == 0 && ok;
+}
+
+/* Whether count records of size bytes at offset lie inside a file of
+   fileSize bytes, starting on an aligned offset. */
+static int isInside(unsigned int offset, unsigned int count, unsigned int size,
+                    unsigned int fileSize)
+{
+  return offset % MESHCACHE_ALIGNMENT == 0 && offset <= fileSize &&
+         (size == 0 || count <= (fileSize - offset) / size);
+}
+
+int openMeshCache(MeshCache *cache, const char *path)
+{
+  MeshCacheContents *c = &cache->contents;
+  const MeshCacheHeader *h;
+  const char *base;
+  unsigned int size;
+  int i, ok;
+
+  memset(cache, 0, sizeof(*cache));
+  if (!isLittleEndian() || !mapFile(&cache->file, path))
+    return 0;
+  base = cache->file.data;
+  size = (unsigned int) cache->file.size;
+  h = (const MeshCacheHeader *) base;
+  ok = cache->file.size >= sizeof(MeshCacheHeader) && cache->file.size == size &&
+       memcmp(h->magic, myMagic, 4) == 0 && h->version == MESHCACHE_VERSION &&
+       h->fileSize == size &&
+       h->streams.count <= MESHCACHE_MAX_STREAMS &&
+       h->indexBuffers.count <= MESHCACHE_MAX_INDEX_BUFFERS &&
+       isInside(h->streams.offset, h->streams.count, sizeof(MeshCacheStream), size) &&
+       isInside(h->indexBuffers.offset, h->indexBuffers.count,
+                sizeof(MeshCacheIndexBuffer), size) &&
+       isInside(h->submeshes.offset, h->submeshes.count, sizeof(MeshCacheSubmesh), size) &&
+       isInside(h->materials.offset, h->materials.count, sizeof(MeshCacheMaterial), size) &&
+       isInside(h->lods.offset, h->lods.count, sizeof(MeshCacheLod), size);
+  if (!ok) {
+    closeMeshCache(cache);
+    return 0;
+  }
+
+  /* Everything is a pointer into the file; nothing is copied but the
+     few stream and index buffer records. */
+  memcpy(c->boundsMin, h->boundsMin, sizeof(c->boundsMin));
+  memcpy(c->boundsMax, h->boundsMax, sizeof(c->boundsMax));
+  c->radius = h->radius;
+  c->streamCount = (int) h->streams.count;
+  memcpy(c->streams, base + h->streams.offset, c->streamCount * sizeof(MeshCacheStream));
+  for (i = 0; i < c->streamCount && ok; i++) {
+    const MeshCacheStream *s = &c->streams[i];
+
+    ok = isInside(s->offset, s->vertexCount, s->stride, size);
+    c->streamData[i] = base + s->offset;
+  }
+  c->indexBufferCount = (int) h->indexBuffers.count;
+  memcpy(c->indexBuffers, base + h->indexBuffers.offset,
+         c->indexBufferCount * sizeof(MeshCacheIndexBuffer));
+  for (i = 0; i < c->indexBufferCount && ok; i++) {
+    const MeshCacheIndexBuffer *b = &c->indexBuffers[i];
+
+    ok = isInside(b->offset, b->indexCount, b->indexSize, size);
+    c->indexData[i] = base + b->offset;
+  }
+  c->submeshes = (const MeshCacheSubmesh *) (base + h->submeshes.offset);
+  c->submeshCount = (int) h->submeshes.count;
+  c->materials = (const MeshCacheMaterial *) (base + h->materials.offset);
+  c->materialCount = (int) h->materials.count;
+  c->lods = (const MeshCacheLod *) (base + h->lods.offset);
+  c->lodCount = (int) h->lods.count;
+  for (i = 0; i < c->materialCount && ok; i++)
+    ok = memchr(c->materials[i].name, 0, MESHCACHE_NAME_SIZE) != NULL;
+  if (!ok || !isValidContents(c)) {
+    closeMeshCache(cache);
+    return 0;
+  }
+  return 1;
+}
+
+void closeMeshCache(MeshCache *cache)
+{
+  unmapFile(&cache->file);
+  memset(cache, 0, sizeof(*cache));
+}
@@ -0,0 +1,145 @@
+/* meshcache.h - A binary mesh file laid out as it sits in memory, loaded by mapping it. */
+
+/* Where lodmesh.h reads its file value by value into new arrays, a mesh
+   cache file is used where it lies: openMeshCache maps it (see
+   mapfile.h), checks the header and tables, and points the contents'
+   arrays into the mapping.  Vertex and index data go straight from
+   there into a locked vertex or index buffer with one memcpy, or, with
+   the tables, into a renderer's own structures without any copy.
+
+   The file is the structures below, little-endian, in this order:
+
+     MeshCacheHeader
+     tables: streams, index buffers, submeshes, materials, LOD levels
+     every stream's vertices, then every index buffer's indices
+
+   Each table and array starts on a multiple of MESHCACHE_ALIGNMENT
+   bytes from the start of the file, which a mapping starts on a page,
+   so vertices are cache-line aligned for SIMD loads.  (When the file
+   cannot be mapped and is read instead, the buffer is only as aligned
+   as new[] makes it.)
+
+   A file holds one mesh.  Its vertex streams are parallel: vertex i of
+   every stream describes the same corner, once as MeshVertex and, say,
+   once as compress.h's PackedVertex.  Its submeshes are index ranges
+   drawn with one material each; like lod.h's levels, a submesh's
+   indices count from its first vertex, so it is drawn with
+
+     DrawIndexedPrimitive(D3DPT_TRIANGLELIST, vertexStart, 0, vertexCount,
+                          indexStart, indexCount/3)
+
+   LOD level i is a run of submeshes, finest level first; coarser levels
+   index the same vertices as the finest.
+
+   The version changes whenever the layout does; files of another
+   version do not open.  Big-endian machines cannot use the mapping as
+   is, so they cannot open any file. */
+
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include "compress.h"
+#include "mapfile.h"
+#include "materials.h"
+#include "mesh.h"
+
+#define MESHCACHE_VERSION      1
+#define MESHCACHE_ALIGNMENT    64
+#define MESHCACHE_MAX_STREAMS  4
+#define MESHCACHE_MAX_INDEX_BUFFERS 4
+#define MESHCACHE_NAME_SIZE    64
+
+typedef enum {
+  MESHCACHE_MESH_VERTEX   = 0,    /* MeshVertex, 32 bytes */
+  MESHCACHE_PACKED_VERTEX = 1     /* PackedVertex, 16 bytes, decoded with packing */
+} MeshCacheVertexFormat;
+
+typedef struct {
+  unsigned int count;
+  unsigned int offset;     /* Bytes from the start of the file */
+} MeshCacheTable;
+
+typedef struct {
+  char magic[4];           /* "MSHC" */
+  unsigned int version;    /* MESHCACHE_VERSION */
+  unsigned int fileSize;
+  unsigned int reserved;
+  float boundsMin[3], boundsMax[3];
+  float radius;            /* Of a sphere about the box's center holding every vertex */
+  MeshCacheTable streams, indexBuffers, submeshes, materials, lods;
+} MeshCacheHeader;
+
+typedef struct {
+  unsigned int format;     /* MeshCacheVertexFormat */
+  unsigned int stride;     /* Bytes per vertex */
+  unsigned int vertexCount;
+  unsigned int offset;
+  PackedMeshInfo packing;  /* For MESHCACHE_PACKED_VERTEX */
+} MeshCacheStream;
+
+typedef struct {
+  unsigned int indexSize;  /* 2 or 4 */
+  unsigned int indexCount;
+  unsigned int offset;
+  unsigned int reserved;
+} MeshCacheIndexBuffer;
+
+typedef struct {
+  unsigned int indexBuffer;
+  unsigned int indexStart, indexCount;     /* Counting from vertexStart */
+  unsigned int vertexStart, vertexCount;
+  int material;                            /* -1 for none */
+  float boundsMin[3], boundsMax[3];
+} MeshCacheSubmesh;
+
+typedef struct {
+  char name[MESHCACHE_NAME_SIZE];          /* Zero-terminated */
+  MaterialData data;
+} MeshCacheMaterial;
+
+typedef struct {
+  float error;                             /* In bounding radii, as in lod.h */
+  unsigned int submeshStart, submeshCount;
+  unsigned int reserved;
+} MeshCacheLod;
+
+/* A mesh's arrays, wherever they are: the writer's input, or pointers
+   into an open file. */
+typedef struct {
+  float boundsMin[3], boundsMax[3], radius;
+  MeshCacheStream streams[MESHCACHE_MAX_STREAMS];   /* offset is unused here */
+  const void *streamData[MESHCACHE_MAX_STREAMS];
+  int streamCount;
+  MeshCacheIndexBuffer indexBuffers[MESHCACHE_MAX_INDEX_BUFFERS];
+  const void *indexData[MESHCACHE_MAX_INDEX_BUFFERS];
+  int indexBufferCount;
+  const MeshCacheSubmesh *submeshes;
+  int submeshCount;
+  const MeshCacheMaterial *materials;
+  int materialCount;
+  const MeshCacheLod *lods;
+  int lodCount;
+} MeshCacheContents;
+
+typedef struct {
+  MeshCacheContents contents;
+  MappedFile file;
+} MeshCache;
+
+/* Bytes writeMeshCache writes for contents. */
+unsigned int getMeshCacheFileSize(const MeshCacheContents *contents);
+
+/* Write contents to path.  Return 1 on success and 0 if the file cannot
+   be written or contents would not open again (a range outside its
+   arrays, too many streams). */
+int writeMeshCache(const char *path, const MeshCacheContents *contents);
+
+/* Map path and point cache->contents into it; release it with
+   closeMeshCache.  Return 1 on success and 0 if the file cannot be
+   read, is not a mesh cache of this version, or has a table or range
+   outside the file.  Indices are not checked one by one. */
+int openMeshCache(MeshCache *cache, const char *path);
+
+void closeMeshCache(MeshCache *cache);
+
+#endif /* MESHCACHE_H */
@@ -0,0 +1,207 @@
+/* mtlfile.c - Wavefront MTL material libraries read into MaterialData. */
+
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "mapfile.h"
+#include "mtlfile.h"
+#include "objfile.h"
+
+const MaterialData defaultMtlMaterial = {
+  { 0.2f, 0.2f, 0.2f, 1 },    /* ambient */
+  { 0.8f, 0.8f, 0.8f, 1 },    /* diffuse */
+  {    0,    0,    0, 1 },    /* specular */
+  {    0,    0,    0, 0 }     /* shine */
+};
+
+static int isSpace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char *skipSpace(const char *p, const char *end)
+{
+  while (p < end && isSpace(*p))
+    p++;
+  return p;
+}
+
+/* Whether the line at p starts with keyword followed by a space. */
+static int isKeyword(const char *p, const char *end, const char *keyword)
+{
+  size_t n = strlen(keyword);
+
+  return (size_t) (end - p) > n && memcmp(p, keyword, n) == 0 && isSpace(p[n]);
+}
+
+/* Up to count numbers after the keyword; return how many, or -1 if a
+   word is not a number. */
+static int parseNumbers(const char *p, const char *end, float *values, int count)
+{
+  int n = 0;
+
+  for (p = skipSpace(p, end); p < end && n < count; p = skipSpace(p, end)) {
+    p = parseObjFloat(p, end, &values[n]);
+    if (!p || (p < end && !isSpace(*p)))
+      return -1;
+    n++;
+  }
+  return n;
+}
+
+/* An r [g b] color into rgb; 0 if the line holds something else. */
+static int parseColor(const char *p, const char *end, float *rgb, int *failed)
+{
+  float v[3];
+  int n;
+
+  p = skipSpace(p, end);
+  if (p < end && !(*p == '-' || *p == '+' || *p == '.' || (*p >= '0' && *p <= '9')))
+    return 0;   /* "spectral" or "xyz" */
+  n = parseNumbers(p, end, v, 3);
+  if (n != 1 && n != 3) {
+    *failed = 1;
+    return 0;
+  }
+  rgb[0] = v[0];
+  rgb[1] = n == 3 ? v[1] : v[0];
+  rgb[2] = n == 3 ? v[2] : v[0];
+  return 1;
+}
+
+static char *copyName(const char *begin, const char *end)
+{
+  char *s = new char[end - begin + 1];
+
+  memcpy(s, begin, end - begin);
+  s[end - begin] = 0;
+  return s;
+}
+
+int parseMtlText(const char *text, size_t size, MtlFile *mtl)
+{
+  std::vector<std::string> names;
+  std::vector<MaterialData> materials;
+  const char *p = text, *end = text + size;
+  MaterialData *m = NULL;
+  int failed = 0, i;
+
+  memset(mtl, 0, sizeof(*mtl));
+  while (p < end && !failed) {
+    const char *lineEnd = (const char *) memchr(p, '\n', end - p);
+    const char *q;
+    float v;
+
+    if (!lineEnd)
+      lineEnd = end;
+    q = skipSpace(p, lineEnd);
+    if (isKeyword(q, lineEnd, "newmtl")) {
+      const char *name = skipSpace(q + 6, lineEnd), *nameEnd = lineEnd;
+
+      while (nameEnd > name && isSpace(nameEnd[-1]))
+        nameEnd--;
+      names.push_back(std::string(name, nameEnd));
+      materials.push_back(defaultMtlMaterial);
+      m = &materials.back();
+    } else if (m && isKeyword(q, lineEnd, "Ka")) {
+      parseColor(q + 2, lineEnd, m->ambient, &failed);
+    } else if (m && isKeyword(q, lineEnd, "Kd")) {
+      parseColor(q + 2, lineEnd, m->diffuse, &failed);
+    } else if (m && isKeyword(q, lineEnd, "Ks")) {
+      parseColor(q + 2, lineEnd, m->specular, &failed);
+    } else if (m && isKeyword(q, lineEnd, "Ns")) {
+      failed = parseNumbers(q + 2, lineEnd, &m->shine[0], 1) != 1;
+    } else if (m && isKeyword(q, lineEnd, "d")) {
+      failed = parseNumbers(q + 1, lineEnd, &m->diffuse[3], 1) != 1;
+    } else if (m && isKeyword(q, lineEnd, "Tr")) {
+      failed = parseNumbers(q + 2, lineEnd, &v, 1) != 1;
+      m->diffuse[3] = 1 - v;
+    }
+    p = lineEnd + (lineEnd < end);
+  }
+  if (failed)
+    return 0;
+
+  mtl->count = (int) names.size();
+  mtl->names = new char *[mtl->count + 1];
+  mtl->materials = new MaterialData[mtl->count + 1];
+  for (i = 0; i < mtl->count; i++) {
+    mtl->names[i] = copyName(names[i].c_str(), names[i].c_str() + names[i].size());
+    mtl->materials[i] = materials[i];
+  }
+  return 1;
+}
+
+int readMtlFile(const char *path, MtlFile *mtl)
+{
+  MappedFile file;
+  int ok;
+
+  memset(mtl, 0, sizeof(*mtl));
+  if (!mapFile(&file, path))
+    return 0;
+  ok = parseMtlText(file.data, file.size, mtl);
+  unmapFile(&file);
+  return ok;
+}
+
+void freeMtlFile(MtlFile *mtl)
+{
+  int i;
+
+  for (i = 0; i < mtl->count; i++)
+    delete [] mtl->names[i];
+  delete [] mtl->names;
+  delete [] mtl->materials;
+  memset(mtl, 0, sizeof(*mtl));
+}
+
+int findMtlMaterial(const MtlFile *mtl, const char *name)
+{
+  int i;
+
+  for (i = 0; i < mtl->count; i++)
+    if (strcmp(mtl->names[i], name) == 0)
+      return i;
+  return -1;
+}
+
+/* Orders materials by their bytes, then by number, so equal ones are
+   adjacent and the first of each run appeared first. */
+struct MaterialOrder {
+  const MaterialData *materials;
+
+  bool operator()(int a, int b) const
+  {
+    int c = memcmp(&materials[a], &materials[b], sizeof(MaterialData));
+
+    return c != 0 ? c < 0 : a < b;
+  }
+};
+
+int mergeMaterials(int *remap, MaterialData *unique, const MaterialData *materials, int count)
+{
+  std::vector<int> order(count), first(count);
+  MaterialOrder less;
+  int distinct = 0, i, k;
+
+  less.materials = materials;
+  for (i = 0; i < count; i++)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), less);
+  for (k = 0; k < count; k++)
+    first[order[k]] = k > 0 && memcmp(&materials[order[k-1]], &materials[order[k]],
+                                      sizeof(MaterialData)) == 0 ?
+                      first[order[k-1]] : order[k];
+  for (i = 0; i < count; i++) {
+    if (first[i] == i) {
+      unique[distinct] = materials[i];
+      remap[i] = distinct++;
+    } else {
+      remap[i] = remap[first[i]];
+    }
+  }
+  return distinct;
+}
@@ -0,0 +1,58 @@
+/* mtlfile.h - Wavefront MTL material libraries read into MaterialData. */
+
+/* An OBJ file's mtllib line names an MTL file whose newmtl blocks give
+   the colors its usemtl names stand for.  readMtlFile keeps what the
+   lighting shader's MaterialData (materials.h) holds:
+
+     Ka r g b    ambient, alpha 1
+     Kd r g b    diffuse; its alpha is d, or 1 - Tr
+     Ks r g b    specular, alpha 1
+     Ns n        shine[0], the specular exponent
+
+   A color with one number is gray.  What a block leaves out keeps
+   defaultMtlMaterial's value; textures, illumination models, and the
+   spectral and CIE XYZ color forms are ignored.
+
+   Libraries often repeat a material under several names (one per
+   object in an exporter's scene), so mergeMaterials finds the
+   distinct ones: a renderer makes one material buffer per distinct
+   material and, with submeshes sorted by it (see objmesh.h), binds
+   each once per frame instead of once per draw. */
+
+#ifndef MTLFILE_H
+#define MTLFILE_H
+
+#include <stddef.h>
+
+#include "materials.h"
+
+typedef struct {
+  char **names;             /* In file order */
+  MaterialData *materials;
+  int count;
+} MtlFile;
+
+/* Gray: ambient 0.2, diffuse 0.8, no specular highlight. */
+extern const MaterialData defaultMtlMaterial;
+
+/* Read path into mtl; release it with freeMtlFile.  Return 1 on success
+   and 0 if the file cannot be read or has a malformed number. */
+int readMtlFile(const char *path, MtlFile *mtl);
+
+/* Same for MTL text already in memory. */
+int parseMtlText(const char *text, size_t size, MtlFile *mtl);
+
+void freeMtlFile(MtlFile *mtl);
+
+/* The material called name, or -1.  A name defined twice means its
+   first definition, as most loaders read it. */
+int findMtlMaterial(const MtlFile *mtl, const char *name);
+
+/* Number the distinct values of materials[0..count) in order of first
+   appearance, write each material's number to remap and one copy of
+   each distinct value to unique (room for count), and return how many
+   there are.  Materials are equal when their floats are bit for bit
+   (so 0 and -0 differ, which no MTL exporter writes). */
+int mergeMaterials(int *remap, MaterialData *unique, const MaterialData *materials, int count);
+
+#endif /* MTLFILE_H */
@@ -0,0 +1,526 @@
+/* objfile.c - Wavefront OBJ files parsed in parallel from a memory-mapped view. */
+
+/* Each piece of the text is parsed into its own arrays.  A piece cannot
+   know how many v, vt, and vn lines come before it, so a negative index
+   is stored counted from the piece's first element of its kind and the
+   corner is listed for fixing once the pieces are joined; positive
+   indices are already absolute. */
+
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "objfile.h"
+#include "mapfile.h"
+#include "parallel.h"
+
+/* Pieces below which more threads are not worth it, and pieces per
+   thread, so one slow piece does not hold the rest up. */
+static const size_t myMinPieceBytes = 256 * 1024;
+static const int myPiecesPerThread = 4;
+
+static const double myPowersOfTen[23] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+enum { OBJ_POSITION, OBJ_TEXCOORD, OBJ_NORMAL };
+enum { OBJ_NAME_OBJECT, OBJ_NAME_MATERIAL, OBJ_NAME_LIBRARY };
+
+static int isDigit(char c)
+{
+  return (unsigned char) (c - '0') < 10;
+}
+
+static int isSpace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+const char *parseObjFloat(const char *p, const char *end, float *value)
+{
+  double mantissa = 0, result;
+  int negative = 0, digits = 0, significant = 0, exponent = 0;
+
+  if (p < end && (*p == '-' || *p == '+'))
+    negative = *p++ == '-';
+
+  /* Digits past the 15th cannot change a float; they only move the
+     decimal point. */
+  for (; p < end && isDigit(*p); p++, digits++) {
+    if (significant < 15) {
+      mantissa = mantissa * 10 + (*p - '0');
+      significant += mantissa != 0;
+    } else {
+      exponent++;
+    }
+  }
+  if (p < end && *p == '.')
+    for (p++; p < end && isDigit(*p); p++, digits++)
+      if (significant < 15) {
+        mantissa = mantissa * 10 + (*p - '0');
+        significant += mantissa != 0;
+        exponent--;
+      }
+  if (digits == 0)
+    return NULL;
+
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    const char *q = p + 1;
+    int negativeExponent = 0, e = 0;
+
+    if (q < end && (*q == '-' || *q == '+'))
+      negativeExponent = *q++ == '-';
+    if (q < end && isDigit(*q)) {
+      for (; q < end && isDigit(*q); q++)
+        if (e < 10000)
+          e = e * 10 + (*q - '0');
+      exponent += negativeExponent ? -e : e;
+      p = q;
+    }
+  }
+
+  /* Both operands are exact, so this rounds once. */
+  if (mantissa == 0)
+    result = 0;
+  else if (exponent >= 0 && exponent <= 22)
+    result = mantissa * myPowersOfTen[exponent];
+  else if (exponent < 0 && exponent >= -22)
+    result = mantissa / myPowersOfTen[-exponent];
+  else {
+    result = mantissa;
+    for (; exponent > 0 && result < 1e300; exponent -= 22)
+      result *= myPowersOfTen[exponent < 22 ? exponent : 22];
+    for (; exponent < 0 && result > 0; exponent += 22)
+      result /= myPowersOfTen[-exponent < 22 ? -exponent : 22];
+  }
+  *value = (float) (negative ? -result : result);
+  return p;
+}
+
+/* A signed decimal integer; NULL if there is none. */
+static const char *parseInt(const char *p, const char *end, int *value)
+{
+  int negative = 0, n = 0;
+  const char *start;
+
+  if (p < end && *p == '-')
+    negative = 1, p++;
+  for (start = p; p < end && isDigit(*p); p++)
+    if (n < 200000000)        /* Larger is out of range anyway */
+      n = n * 10 + (*p - '0');
+  if (p == start)
+    return NULL;
+  *value = negative ? -n : n;
+  return p;
+}
+
+static const char *skipSpace(const char *p, const char *end)
+{
+  while (p < end && isSpace(*p))
+    p++;
+  return p;
+}
+
+typedef struct {
+  int face;             /* In the piece */
+  int kind;             /* OBJ_NAME_... */
+  const char *name;
+  int length;
+} ObjPieceName;
+
+struct ObjPiece
+{
+  const char *begin, *end;
+  std::vector<float> attributes[3];      /* OBJ_POSITION, ... */
+  std::vector<int> indices[3];
+  std::vector<int> relative[3];          /* Corners with a negative index of each kind */
+  std::vector<int> faceSizes;
+  std::vector<ObjPieceName> names;
+  int failed;
+};
+
+/* Up to count floats into attribute; fewer than least is a failure.
+   Missing ones (down to least) are 0. */
+static const char *parseFloats(const char *p, const char *end, std::vector<float> &attribute,
+                               int count, int least)
+{
+  for (int i = 0; i < count; i++) {
+    float f = 0;
+    const char *q;
+
+    p = skipSpace(p, end);
+    q = parseObjFloat(p, end, &f);
+    if (!q) {
+      if (i < least)
+        return NULL;
+      f = 0;
+    } else {
+      p = q;
+    }
+    attribute.push_back(f);
+  }
+  return p;
+}
+
+/* One corner's index of a kind, counted from 0; a negative one counts
+   back from the piece's elements so far and is listed for fixing. */
+static int addIndex(ObjPiece *piece, int kind, int n, int elementSize)
+{
+  std::vector<int> &indices = piece->indices[kind];
+
+  if (n > 0) {
+    indices.push_back(n - 1);
+  } else if (n < 0) {
+    piece->relative[kind].push_back((int) indices.size());
+    indices.push_back((int) piece->attributes[kind].size() / elementSize + n);
+  } else {
+    return 0;
+  }
+  return 1;
+}
+
+static int parseFace(ObjPiece *piece, const char *p, const char *end)
+{
+  static const int elementSize[3] = { 3, 2, 3 };
+  int size = 0;
+
+  for (;;) {
+    int n, kind;
+
+    p = skipSpace(p, end);
+    if (p == end)
+      break;
+    if (!(p = parseInt(p, end, &n)) || !addIndex(piece, OBJ_POSITION, n, 3))
+      return 0;
+    for (kind = OBJ_TEXCOORD; kind <= OBJ_NORMAL; kind++) {
+      if (p < end && *p == '/' && p + 1 < end && (isDigit(p[1]) || p[1] == '-')) {
+        if (!(p = parseInt(p + 1, end, &n)) || !addIndex(piece, kind, n, elementSize[kind]))
+          return 0;
+      } else {
+        piece->indices[kind].push_back(-1);
+        if (p < end && *p == '/')
+          p++;
+      }
+    }
+    if (p < end && !isSpace(*p))
+      return 0;
+    size++;
+  }
+  if (size > 0)
+    piece->faceSizes.push_back(size);
+  return 1;
+}
+
+/* The rest of the line, without surrounding space, as a name. */
+static void addName(ObjPiece *piece, int kind, const char *p, const char *end)
+{
+  ObjPieceName name;
+
+  p = skipSpace(p, end);
+  while (end > p && isSpace(end[-1]))
+    end--;
+  name.face = (int) piece->faceSizes.size();
+  name.kind = kind;
+  name.name = p;
+  name.length = (int) (end - p);
+  piece->names.push_back(name);
+}
+
+static int startsWord(const char *p, const char *end, const char *word, int length)
+{
+  return end - p > length && memcmp(p, word, length) == 0 && isSpace(p[length]);
+}
+
+static void parsePiece(ObjPiece *piece)
+{
+  const char *p = piece->begin, *end = piece->end;
+
+  while (p < end && !piece->failed) {
+    const char *lineEnd = (const char *) memchr(p, '\n', end - p), *q;
+
+    if (!lineEnd)
+      lineEnd = end;
+    q = skipSpace(p, lineEnd);
+    p = lineEnd + 1;
+    if (lineEnd - q < 2)
+      continue;
+
+    if (q[0] == 'v') {
+      if (isSpace(q[1]))
+        q = parseFloats(q + 2, lineEnd, piece->attributes[OBJ_POSITION], 3, 3);
+      else if (q[1] == 't' && lineEnd - q > 2 && isSpace(q[2]))
+        q = parseFloats(q + 3, lineEnd, piece->attributes[OBJ_TEXCOORD], 2, 1);
+      else if (q[1] == 'n' && lineEnd - q > 2 && isSpace(q[2]))
+        q = parseFloats(q + 3, lineEnd, piece->attributes[OBJ_NORMAL], 3, 3);
+      if (!q)
+        piece->failed = 1;
+    } else if (q[0] == 'f' && isSpace(q[1])) {
+      if (!parseFace(piece, q + 2, lineEnd))
+        piece->failed = 1;
+    } else if ((q[0] == 'o' || q[0] == 'g') && isSpace(q[1])) {
+      addName(piece, OBJ_NAME_OBJECT, q + 2, lineEnd);
+    } else if (startsWord(q, lineEnd, "usemtl", 6)) {
+      addName(piece, OBJ_NAME_MATERIAL, q + 7, lineEnd);
+    } else if (startsWord(q, lineEnd, "mtllib", 6)) {
+      addName(piece, OBJ_NAME_LIBRARY, q + 7, lineEnd);
+    }
+  }
+}
+
+typedef struct {
+  int attributes[3];    /* Elements, not floats */
+  int corners, faces;
+} ObjPieceBase;
+
+struct ParsePieceTask
+{
+  ObjPiece *pieces;
+
+  void operator()(int begin, int end) const
+  {
+    for (int i = begin; i < end; i++)
+      parsePiece(&pieces[i]);
+  }
+};
+
+/* Copy each piece to its place, fix its relative indices, and check them. */
+struct JoinPieceTask
+{
+  ObjPiece *pieces;
+  const ObjPieceBase *bases;
+  const ObjPieceBase *total;
+  ObjFile *obj;
+
+  void operator()(int begin, int end) const
+  {
+    static const int elementSize[3] = { 3, 2, 3 };
+    float *attributes[3] = { obj->positions, obj->texCoords, obj->normals };
+    int *indices[3] = { obj->positionIndices, obj->texCoordIndices, obj->normalIndices };
+
+    for (int i = begin; i < end; i++) {
+      ObjPiece *piece = &pieces[i];
+      const ObjPieceBase *base = &bases[i];
+      int corner = base->corners, k;
+      size_t j;
+
+      for (k = 0; k < 3; k++) {
+        std::vector<int> &index = piece->indices[k];
+
+        if (!piece->attributes[k].empty())
+          memcpy(attributes[k] + (size_t) base->attributes[k] * elementSize[k],
+                 &piece->attributes[k][0], piece->attributes[k].size() * sizeof(float));
+        for (j = 0; j < piece->relative[k].size(); j++)
+          index[piece->relative[k][j]] += base->attributes[k];
+        for (j = 0; j < index.size(); j++)
+          if (index[j] >= total->attributes[k])
+            piece->failed = 1;
+        if (!index.empty())
+          memcpy(indices[k] + base->corners, &index[0], index.size() * sizeof(int));
+      }
+      for (j = 0; j < piece->faceSizes.size(); j++) {
+        obj->faceStarts[base->faces + j] = corner;
+        corner += piece->faceSizes[j];
+      }
+    }
+  }
+};
+
+static char *copyName(const std::string &name)
+{
+  char *s = new char[name.size() + 1];
+
+  memcpy(s, name.c_str(), name.size() + 1);
+  return s;
+}
+
+static void addRange(std::vector<ObjRange> &ranges, int first, int last, int object, int material)
+{
+  ObjRange r;
+
+  if (last <= first)
+    return;
+  if (!ranges.empty() && ranges.back().object == object && ranges.back().material == material) {
+    ranges.back().faceCount += last - first;
+    return;
+  }
+  r.firstFace = first;
+  r.faceCount = last - first;
+  r.object = object;
+  r.material = material;
+  ranges.push_back(r);
+}
+
+/* Number the object and material names and cut the faces into ranges. */
+static void joinNames(ObjFile *obj, const std::vector<ObjPiece> &pieces,
+                      const std::vector<ObjPieceBase> &bases)
+{
+  std::map<std::string, int> numbers[2];
+  std::vector<std::string> names[2];
+  std::vector<ObjRange> ranges;
+  int current[2] = { -1, -1 }, first = 0, k;
+  std::string library;
+  bool haveLibrary = false;
+
+  for (size_t i = 0; i < pieces.size(); i++)
+    for (size_t j = 0; j < pieces[i].names.size(); j++) {
+      const ObjPieceName &n = pieces[i].names[j];
+      std::string name(n.name, n.length);
+      int face = bases[i].faces + n.face;
+      std::map<std::string, int>::iterator found;
+
+      if (n.kind == OBJ_NAME_LIBRARY) {
+        if (!haveLibrary)
+          library = name;
+        haveLibrary = true;
+        continue;
+      }
+      addRange(ranges, first, face, current[0], current[1]);
+      first = face;
+      found = numbers[n.kind].find(name);
+      if (found == numbers[n.kind].end()) {
+        found = numbers[n.kind].insert(std::make_pair(name, (int) names[n.kind].size())).first;
+        names[n.kind].push_back(name);
+      }
+      current[n.kind] = found->second;
+    }
+  addRange(ranges, first, obj->faceCount, current[0], current[1]);
+
+  obj->rangeCount = (int) ranges.size();
+  obj->ranges = new ObjRange[ranges.size() + 1];
+  if (!ranges.empty())
+    memcpy(obj->ranges, &ranges[0], ranges.size() * sizeof(ObjRange));
+  for (k = 0; k < 2; k++) {
+    char **out = new char *[names[k].size() + 1];
+
+    for (size_t i = 0; i < names[k].size(); i++)
+      out[i] = copyName(names[k][i]);
+    if (k == OBJ_NAME_OBJECT) {
+      obj->objectNames = out;
+      obj->objectCount = (int) names[k].size();
+    } else {
+      obj->materialNames = out;
+      obj->materialCount = (int) names[k].size();
+    }
+  }
+  obj->materialLibrary = haveLibrary ? copyName(library) : NULL;
+}
+
+int parseObjText(const char *text, size_t size, ObjFile *obj)
+{
+  std::vector<ObjPiece> pieces;
+  std::vector<ObjPieceBase> bases;
+  ObjPieceBase total;
+  ParsePieceTask parseTask;
+  JoinPieceTask joinTask;
+  size_t pieceCount = size / myMinPieceBytes, start = 0;
+  int i, k, failed = 0;
+
+  memset(obj, 0, sizeof(*obj));
+  if (pieceCount > (size_t) (getParallelThreadCount() * myPiecesPerThread))
+    pieceCount = getParallelThreadCount() * myPiecesPerThread;
+  if (pieceCount < 1)
+    pieceCount = 1;
+
+  /* Each piece starts after a line break, at or after its share. */
+  pieces.resize(pieceCount);
+  for (i = 0; i < (int) pieceCount; i++) {
+    size_t stop = i + 1 < (int) pieceCount ? size / pieceCount * (i + 1) : size;
+
+    if (stop < start)
+      stop = start;
+    while (stop < size && text[stop - 1] != '\n')
+      stop++;
+    pieces[i].begin = text + start;
+    pieces[i].end = text + stop;
+    pieces[i].failed = 0;
+    start = stop;
+  }
+  parseTask.pieces = &pieces[0];
+  parallelFor((int) pieceCount, 1, 1, parseTask);
+
+  /* Where each piece's elements go. */
+  bases.resize(pieceCount);
+  memset(&total, 0, sizeof(total));
+  for (i = 0; i < (int) pieceCount; i++) {
+    static const int elementSize[3] = { 3, 2, 3 };
+
+    bases[i] = total;
+    for (k = 0; k < 3; k++) {
+      total.attributes[k] += (int) pieces[i].attributes[k].size() / elementSize[k];
+      /* A negative index reaching back before the file's first element. */
+      for (size_t j = 0; j < pieces[i].relative[k].size(); j++)
+        if (pieces[i].indices[k][pieces[i].relative[k][j]] + bases[i].attributes[k] < 0)
+          failed = 1;
+    }
+    total.corners += (int) pieces[i].indices[OBJ_POSITION].size();
+    total.faces += (int) pieces[i].faceSizes.size();
+    failed |= pieces[i].failed;
+  }
+  if (failed)
+    return 0;
+
+  obj->positionCount = total.attributes[OBJ_POSITION];
+  obj->texCoordCount = total.attributes[OBJ_TEXCOORD];
+  obj->normalCount = total.attributes[OBJ_NORMAL];
+  obj->cornerCount = total.corners;
+  obj->faceCount = total.faces;
+  obj->positions = new float[3 * (size_t) obj->positionCount];
+  obj->texCoords = new float[2 * (size_t) obj->texCoordCount];
+  obj->normals = new float[3 * (size_t) obj->normalCount];
+  obj->positionIndices = new int[obj->cornerCount];
+  obj->texCoordIndices = new int[obj->cornerCount];
+  obj->normalIndices = new int[obj->cornerCount];
+  obj->faceStarts = new int[obj->faceCount + 1];
+  obj->faceStarts[obj->faceCount] = obj->cornerCount;
+
+  joinTask.pieces = &pieces[0];
+  joinTask.bases = &bases[0];
+  joinTask.total = &total;
+  joinTask.obj = obj;
+  parallelFor((int) pieceCount, 1, 1, joinTask);
+  for (i = 0; i < (int) pieceCount; i++)
+    failed |= pieces[i].failed;
+  joinNames(obj, pieces, bases);
+  if (failed) {
+    freeObjFile(obj);
+    return 0;
+  }
+  return 1;
+}
+
+int readObjFile(const char *path, ObjFile *obj)
+{
+  MappedFile file;
+  int ok;
+
+  memset(obj, 0, sizeof(*obj));
+  if (!mapFile(&file, path))
+    return 0;
+  ok = parseObjText(file.data, file.size, obj);
+  unmapFile(&file);
+  return ok;
+}
+
+void freeObjFile(ObjFile *obj)
+{
+  int i;
+
+  delete [] obj->positions;
+  delete [] obj->texCoords;
+  delete [] obj->normals;
+  delete [] obj->positionIndices;
+  delete [] obj->texCoordIndices;
+  delete [] obj->normalIndices;
+  delete [] obj->faceStarts;
+  delete [] obj->ranges;
+  for (i = 0; i < obj->objectCount; i++)
+    delete [] obj->objectNames[i];
+  delete [] obj->objectNames;
+  for (i = 0; i < obj->materialCount; i++)
+    delete [] obj->materialNames[i];
+  delete [] obj->materialNames;
+  delete [] obj->materialLibrary;
+  memset(obj, 0, sizeof(*obj));
+}
@@ -0,0 +1,80 @@
+/* objfile.h - Wavefront OBJ files parsed in parallel from a memory-mapped view. */
+
+/* readObjFile maps the file (see mapfile.h), cuts it into pieces at line
+   breaks, parses the pieces on separate threads (see parallel.h), and
+   joins their results, so the output is the same whatever the thread
+   count.  Numbers are parsed by hand, without the C library's locale
+   or per-call overhead: integers exactly, and floats by gathering up to
+   15 significant digits and scaling once by a power of ten, which gives
+   the float nearest the text except, rarely, for a value within a hair
+   of halfway between two floats.
+
+   The result is the file's own data, one array per attribute and one
+   per index stream (a structure of arrays), with faces still polygons
+   and v, vt, and vn still numbered separately:
+
+     positions      v lines, 3 floats each (a w is dropped)
+     texCoords      vt lines, 2 floats each (a missing v is 0)
+     normals        vn lines, 3 floats each
+     positionIndices, texCoordIndices, normalIndices
+                    one per face corner, counted from 0; -1 where a
+                    corner has no texture coordinate or normal.  All
+                    four face forms (v, v/vt, v//vn, v/vt/vn) and
+                    negative indices (counting back from the latest of
+                    their kind) are understood.
+     faceStarts     face f is corners faceStarts[f] to faceStarts[f+1] - 1
+     ranges         runs of faces with one object (o or g) and one
+                    material (usemtl)
+
+   Points, lines, curves, smoothing groups, and line continuations are
+   ignored. */
+
+#ifndef OBJFILE_H
+#define OBJFILE_H
+
+#include <stddef.h>
+
+typedef struct {
+  int firstFace, faceCount;
+  int object;           /* Into objectNames; -1 before the first o or g */
+  int material;         /* Into materialNames; -1 before the first usemtl */
+} ObjRange;
+
+typedef struct {
+  float *positions;
+  int positionCount;
+  float *texCoords;
+  int texCoordCount;
+  float *normals;
+  int normalCount;
+  int *positionIndices;    /* Per corner */
+  int *texCoordIndices;
+  int *normalIndices;
+  int cornerCount;
+  int *faceStarts;      /* faceCount + 1 */
+  int faceCount;
+  ObjRange *ranges;     /* In file order, together covering every face */
+  int rangeCount;
+  char **objectNames;
+  int objectCount;
+  char **materialNames;
+  int materialCount;
+  char *materialLibrary;   /* The first mtllib's file name, or NULL */
+} ObjFile;
+
+/* Read path into obj; release it with freeObjFile.  Return 1 on
+   success and 0 if the file cannot be read or has a malformed number
+   or an index out of range. */
+int readObjFile(const char *path, ObjFile *obj);
+
+/* Same for OBJ text already in memory. */
+int parseObjText(const char *text, size_t size, ObjFile *obj);
+
+void freeObjFile(ObjFile *obj);
+
+/* Parse a decimal number (sign, digits, fraction, exponent) starting at
+   p and ending before end, as readObjFile does.  Return the character
+   after it, or NULL if there is no number there. */
+const char *parseObjFloat(const char *p, const char *end, float *value);
+
+#endif /* OBJFILE_H */
@@ -0,0 +1,438 @@
+/* objmesh.c - Triangle meshes with one submesh per object and material, built from parsed OBJ files. */
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "compress.h"
+#include "lod.h"
+#include "meshcache.h"
+#include "objmesh.h"
+#include "simplify.h"
+
+/* Submeshes are not simplified below this many triangles. */
+static const int myMinLodTriangles = 64;
+
+static int sameCorner(const ObjFile *obj, int a, int b)
+{
+  return obj->positionIndices[a] == obj->positionIndices[b] &&
+         obj->texCoordIndices[a] == obj->texCoordIndices[b] &&
+         obj->normalIndices[a] == obj->normalIndices[b];
+}
+
+static void makeVertex(MeshVertex *v, const ObjFile *obj, int corner)
+{
+  int t = obj->texCoordIndices[corner], n = obj->normalIndices[corner];
+
+  memset(v, 0, sizeof(*v));
+  memcpy(v->position, &obj->positions[3 * (size_t) obj->positionIndices[corner]],
+         sizeof(v->position));
+  if (t >= 0)
+    memcpy(v->texCoord, &obj->texCoords[2 * (size_t) t], sizeof(v->texCoord));
+  if (n >= 0)
+    memcpy(v->normal, &obj->normals[3 * (size_t) n], sizeof(v->normal));
+}
+
+/* Mixes a corner's v/vt/vn into a hash table slot number. */
+static unsigned int hashCorner(const ObjFile *obj, int corner)
+{
+  unsigned int h = (unsigned int) obj->positionIndices[corner] * 0x9e3779b1u ^
+                   (unsigned int) obj->texCoordIndices[corner] * 0x85ebca77u ^
+                   (unsigned int) obj->normalIndices[corner] * 0xc2b2ae3du;
+
+  return h ^ h >> 16;
+}
+
+/* Twice the signed area of 2D triangle a, b, c: positive if counterclockwise. */
+static double cross2(const double *a, const double *b, const double *c)
+{
+  return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+}
+
+/* Whether live[at] is an ear of the polygon live[0..count) of 2D points xy. */
+static int isEar(const int *live, int count, int at, const double *xy)
+{
+  const double *a = &xy[2 * live[(at + count - 1) % count]];
+  const double *b = &xy[2 * live[at]], *c = &xy[2 * live[(at + 1) % count]];
+  int k;
+
+  if (cross2(a, b, c) <= 0)
+    return 0;
+  for (k = 0; k < count; k++) {
+    const double *p = &xy[2 * live[k]];
+
+    /* Corners at the triangle's own points (a polygon touching itself)
+       do not block it. */
+    if ((p[0] == a[0] && p[1] == a[1]) || (p[0] == b[0] && p[1] == b[1]) ||
+        (p[0] == c[0] && p[1] == c[1]))
+      continue;
+    if (cross2(a, b, p) >= 0 && cross2(b, c, p) >= 0 && cross2(c, a, p) >= 0)
+      return 0;
+  }
+  return 1;
+}
+
+int triangulatePolygon(int *triangles, const float *points, int pointCount)
+{
+  double normal[3] = { 0, 0, 0 }, stackXy[2 * 16];
+  int stackLive[16], *live = stackLive, count = pointCount, written = 0, i, u, v, axis;
+  std::vector<double> heapXy;
+  std::vector<int> heapLive;
+  double *xy = stackXy;
+
+  if (pointCount < 3)
+    return 0;
+  if (pointCount > 16) {
+    heapXy.resize(2 * pointCount);
+    heapLive.resize(pointCount);
+    xy = &heapXy[0];
+    live = &heapLive[0];
+  }
+
+  /* Newell's normal; flatten along its largest component, keeping the
+     polygon counterclockwise. */
+  for (i = 0; i < pointCount; i++) {
+    const float *a = &points[3*i], *b = &points[3 * ((i + 1) % pointCount)];
+
+    normal[0] += ((double) a[1] - b[1]) * ((double) a[2] + b[2]);
+    normal[1] += ((double) a[2] - b[2]) * ((double) a[0] + b[0]);
+    normal[2] += ((double) a[0] - b[0]) * ((double) a[1] + b[1]);
+  }
+  axis = fabs(normal[0]) > fabs(normal[1]) ? 0 : 1;
+  axis = fabs(normal[2]) > fabs(normal[axis]) ? 2 : axis;
+  u = (axis + 1) % 3;
+  v = (axis + 2) % 3;
+  if (normal[axis] < 0) {
+    int t = u;
+
+    u = v;
+    v = t;
+  }
+  for (i = 0; i < pointCount; i++) {
+    xy[2*i] = points[3*i + u];
+    xy[2*i + 1] = points[3*i + v];
+    live[i] = i;
+  }
+
+  while (count > 3) {
+    int cut = -1, k;
+
+    for (k = 1; k <= count && cut < 0; k++)
+      if (isEar(live, count, k % count, xy))
+        cut = k % count;
+    if (cut < 0)
+      cut = 1;
+    triangles[written++] = live[(cut + count - 1) % count];
+    triangles[written++] = live[cut];
+    triangles[written++] = live[(cut + 1) % count];
+    for (k = cut; k < count - 1; k++)
+      live[k] = live[k+1];
+    count--;
+  }
+  triangles[written++] = live[0];
+  triangles[written++] = live[1];
+  triangles[written++] = live[2];
+  return written / 3;
+}
+
+int buildObjMesh(ObjMesh *mesh, const ObjFile *obj)
+{
+  std::vector<int> slots, vertexOf, polygon;
+  std::vector<float> points;
+  long indexCount = 0;
+  int i, submesh = 0, vertexCount = 0;
+
+  memset(mesh, 0, sizeof(*mesh));
+  for (i = 0; i < obj->faceCount; i++) {
+    int size = obj->faceStarts[i+1] - obj->faceStarts[i];
+
+    if (size >= 3)
+      indexCount += 3 * (long) (size - 2);
+  }
+  if (indexCount > 0x7fffffffL / (long) sizeof(unsigned int))
+    return 0;
+
+  /* No mesh has more vertices than corners. */
+  mesh->vertices = new MeshVertex[obj->cornerCount > 0 ? obj->cornerCount : 1];
+  mesh->indices = new unsigned int[indexCount > 0 ? indexCount : 1];
+  mesh->submeshes = new ObjSubmesh[obj->rangeCount > 0 ? obj->rangeCount : 1];
+  vertexOf.resize(obj->cornerCount);
+
+  for (i = 0; i < obj->rangeCount; i++) {
+    const ObjRange *range = &obj->ranges[i];
+    int first = obj->faceStarts[range->firstFace];
+    int last = obj->faceStarts[range->firstFace + range->faceCount];
+    ObjSubmesh *s = &mesh->submeshes[submesh];
+    unsigned int mask = 15;
+    int c, f, k;
+
+    s->vertexStart = vertexCount;
+    s->indexStart = mesh->indexCount;
+    s->object = range->object;
+    s->material = range->material;
+
+    /* Each slot holds the first corner of its v/vt/vn, or -1; at most
+       half of them are used, so probe runs stay short. */
+    while ((int) mask < 2 * (last - first))
+      mask = mask << 1 | 1;
+    slots.assign(mask + 1, -1);
+    for (c = first; c < last; c++) {
+      unsigned int h = hashCorner(obj, c) & mask;
+
+      while (slots[h] >= 0 && !sameCorner(obj, slots[h], c))
+        h = (h + 1) & mask;
+      if (slots[h] < 0) {
+        slots[h] = c;
+        makeVertex(&mesh->vertices[vertexCount], obj, c);
+        vertexOf[c] = vertexCount++ - s->vertexStart;
+      } else {
+        vertexOf[c] = vertexOf[slots[h]];
+      }
+    }
+
+    for (f = range->firstFace; f < range->firstFace + range->faceCount; f++) {
+      int start = obj->faceStarts[f], size = obj->faceStarts[f+1] - start;
+      unsigned int *out = &mesh->indices[mesh->indexCount];
+
+      if (size == 3) {
+        out[0] = (unsigned int) vertexOf[start];
+        out[1] = (unsigned int) vertexOf[start + 1];
+        out[2] = (unsigned int) vertexOf[start + 2];
+        mesh->indexCount += 3;
+      } else if (size > 3) {
+        points.resize(3 * size);
+        polygon.resize(3 * (size - 2));
+        for (k = 0; k < size; k++)
+          memcpy(&points[3*k], &obj->positions[3 * (size_t) obj->positionIndices[start + k]],
+                 3 * sizeof(float));
+        k = 3 * triangulatePolygon(&polygon[0], &points[0], size);
+        mesh->indexCount += k;
+        while (k-- > 0)
+          out[k] = (unsigned int) vertexOf[start + polygon[k]];
+      }
+    }
+    s->vertexCount = vertexCount - s->vertexStart;
+    s->indexCount = mesh->indexCount - s->indexStart;
+    if (s->indexCount > 0)
+      submesh++;
+    else
+      vertexCount = s->vertexStart;
+  }
+  mesh->vertexCount = vertexCount;
+  mesh->submeshCount = submesh;
+  return 1;
+}
+
+void freeObjMesh(ObjMesh *mesh)
+{
+  delete [] mesh->vertices;
+  delete [] mesh->indices;
+  delete [] mesh->submeshes;
+  memset(mesh, 0, sizeof(*mesh));
+}
+
+void getObjMaterials(MaterialData *materials, const ObjFile *obj, const MtlFile *mtl)
+{
+  int i;
+
+  for (i = 0; i < obj->materialCount; i++) {
+    int m = mtl ? findMtlMaterial(mtl, obj->materialNames[i]) : -1;
+
+    materials[i] = m >= 0 ? mtl->materials[m] : defaultMtlMaterial;
+  }
+}
+
+/* Orders submeshes by their material's key, then by position. */
+struct SubmeshOrder {
+  const int *materialKey;
+
+  int getKey(const ObjSubmesh &s) const
+  {
+    return s.material >= 0 ? materialKey[s.material] : -1;
+  }
+
+  bool operator()(const ObjSubmesh &a, const ObjSubmesh &b) const
+  {
+    return getKey(a) < getKey(b);
+  }
+};
+
+void sortObjMeshByMaterial(ObjMesh *mesh, const int *materialKey)
+{
+  SubmeshOrder less;
+
+  less.materialKey = materialKey;
+  std::stable_sort(mesh->submeshes, mesh->submeshes + mesh->submeshCount, less);
+}
+
+/* Box of vertices[0..count), and the radius of the sphere about its
+   center holding them. */
+static float getBounds(float lo[3], float hi[3], const MeshVertex *vertices, int count)
+{
+  double r2 = 0;
+  int i, k;
+
+  for (k = 0; k < 3; k++) {
+    lo[k] = count > 0 ? 1e30f : 0;
+    hi[k] = count > 0 ? -1e30f : 0;
+  }
+  for (i = 0; i < count; i++)
+    for (k = 0; k < 3; k++) {
+      lo[k] = std::min(lo[k], vertices[i].position[k]);
+      hi[k] = std::max(hi[k], vertices[i].position[k]);
+    }
+  for (i = 0; i < count; i++) {
+    double d2 = 0;
+
+    for (k = 0; k < 3; k++) {
+      double d = vertices[i].position[k] - 0.5 * ((double) lo[k] + hi[k]);
+
+      d2 += d * d;
+    }
+    r2 = std::max(r2, d2);
+  }
+  return (float) sqrt(r2);
+}
+
+/* Half the diagonal of a box, the radius simplifyMesh measures in. */
+static float getHalfDiagonal(const float lo[3], const float hi[3])
+{
+  double d2 = 0;
+  int k;
+
+  for (k = 0; k < 3; k++)
+    d2 += ((double) hi[k] - lo[k]) * ((double) hi[k] - lo[k]);
+  return (float) (0.5 * sqrt(d2));
+}
+
+int writeObjMeshCache(const char *path, const ObjFile *obj, const ObjMesh *mesh,
+                      const MtlFile *mtl, int flags, int lodLevels)
+{
+  std::vector<MaterialData> objMaterials(obj->materialCount + 1), unique(obj->materialCount + 1);
+  std::vector<int> materialOf(obj->materialCount + 1);
+  int materialCount;
+  MeshCacheContents contents;
+  std::vector<MeshCacheSubmesh> submeshes;
+  std::vector<MeshCacheMaterial> materials;
+  std::vector<MeshCacheLod> lods;
+  std::vector<unsigned int> indices(mesh->indices, mesh->indices + mesh->indexCount);
+  std::vector<unsigned short> indices16;
+  std::vector<PackedVertex> packed;
+  int index16 = 1, i, level;
+
+  memset(&contents, 0, sizeof(contents));
+  contents.radius = getBounds(contents.boundsMin, contents.boundsMax,
+                              mesh->vertices, mesh->vertexCount);
+
+  getObjMaterials(&objMaterials[0], obj, mtl);
+  materialCount = mergeMaterials(&materialOf[0], &unique[0], &objMaterials[0],
+                                 obj->materialCount);
+
+  /* Level 0: the submeshes as built. */
+  for (i = 0; i < mesh->submeshCount; i++) {
+    const ObjSubmesh *o = &mesh->submeshes[i];
+    MeshCacheSubmesh s;
+
+    memset(&s, 0, sizeof(s));
+    s.indexStart = o->indexStart;
+    s.indexCount = o->indexCount;
+    s.vertexStart = o->vertexStart;
+    s.vertexCount = o->vertexCount;
+    s.material = o->material >= 0 ? materialOf[o->material] : -1;
+    getBounds(s.boundsMin, s.boundsMax, mesh->vertices + o->vertexStart, o->vertexCount);
+    submeshes.push_back(s);
+    index16 = index16 && o->vertexCount <= 65536;
+  }
+  lods.resize(1);
+  lods[0].error = 0;
+  lods[0].submeshStart = 0;
+  lods[0].submeshCount = mesh->submeshCount;
+
+  /* Further levels halve each submesh of the level before, over the
+     same vertices. */
+  for (level = 1; level < lodLevels && level < LOD_MAX_LEVELS; level++) {
+    const MeshCacheLod *previous = &lods[level-1];
+    MeshCacheLod lod;
+    long before = 0, after = 0;
+    size_t firstIndex = indices.size();
+
+    lod.error = previous->error;
+    lod.submeshStart = (unsigned int) submeshes.size();
+    lod.submeshCount = previous->submeshCount;
+    lod.reserved = 0;
+    for (i = 0; i < (int) previous->submeshCount; i++) {
+      MeshCacheSubmesh s = submeshes[previous->submeshStart + i];
+      std::vector<unsigned int> out(s.indexCount > 0 ? s.indexCount : 1);
+      const MeshVertex *v = mesh->vertices + s.vertexStart;
+      float error = 0, scale = contents.radius > 0 ?
+        getHalfDiagonal(s.boundsMin, s.boundsMax) / contents.radius : 0;
+      int count = (int) s.indexCount;
+
+      /* Small submeshes stay as they are rather than vanish. */
+      if (count > 3 * myMinLodTriangles)
+        count = simplifyMesh(&out[0], &indices[s.indexStart], count, v, (int) s.vertexCount,
+                             std::max(count / 6, myMinLodTriangles) * 3, 0, &error);
+      else if (count > 0)
+        std::copy(&indices[s.indexStart], &indices[s.indexStart] + count, out.begin());
+
+      before += s.indexCount;
+      after += count;
+      s.indexStart = (unsigned int) indices.size();
+      s.indexCount = (unsigned int) count;
+      indices.insert(indices.end(), out.begin(), out.begin() + count);
+      submeshes.push_back(s);
+      lod.error = std::max(lod.error, error * scale);
+    }
+    if (after > before - before / 4) {
+      indices.resize(firstIndex);
+      submeshes.resize(lod.submeshStart);
+      break;
+    }
+    lods.push_back(lod);
+  }
+
+  /* Each distinct material is named after the first name merged into it. */
+  materials.resize(materialCount);
+  for (i = obj->materialCount - 1; i >= 0; i--) {
+    MeshCacheMaterial *m = &materials[materialOf[i]];
+
+    memset(m, 0, sizeof(*m));
+    strncpy(m->name, obj->materialNames[i], MESHCACHE_NAME_SIZE - 1);
+    m->data = unique[materialOf[i]];
+  }
+
+  contents.streams[0].format = MESHCACHE_MESH_VERTEX;
+  contents.streams[0].stride = sizeof(MeshVertex);
+  contents.streams[0].vertexCount = mesh->vertexCount;
+  contents.streamData[0] = mesh->vertices;
+  contents.streamCount = 1;
+  if (flags & OBJMESH_CACHE_PACKED) {
+    MeshCacheStream *stream = &contents.streams[contents.streamCount];
+
+    stream->format = MESHCACHE_PACKED_VERTEX;
+    stream->stride = sizeof(PackedVertex);
+    stream->vertexCount = mesh->vertexCount;
+    getPackedMeshInfo(&stream->packing, mesh->vertices, mesh->vertexCount,
+                      PACK_TEXCOORD_UNORM16);
+    packed.resize(mesh->vertexCount > 0 ? mesh->vertexCount : 1);
+    packVertices(&packed[0], mesh->vertices, mesh->vertexCount, &stream->packing);
+    contents.streamData[contents.streamCount++] = &packed[0];
+  }
+  contents.indexBuffers[0].indexSize = index16 ? 2 : 4;
+  contents.indexBuffers[0].indexCount = (unsigned int) indices.size();
+  if (index16) {
+    indices16.assign(indices.begin(), indices.end());
+    contents.indexData[0] = indices16.empty() ? NULL : &indices16[0];
+  } else {
+    contents.indexData[0] = indices.empty() ? NULL : &indices[0];
+  }
+  contents.indexBufferCount = 1;
+  contents.submeshes = submeshes.empty() ? NULL : &submeshes[0];
+  contents.submeshCount = (int) submeshes.size();
+  contents.materials = materials.empty() ? NULL : &materials[0];
+  contents.materialCount = (int) materials.size();
+  contents.lods = &lods[0];
+  contents.lodCount = (int) lods.size();
+  return writeMeshCache(path, &contents);
+}
@@ -0,0 +1,92 @@
+/* objmesh.h - Triangle meshes with one submesh per object and material, built from parsed OBJ files. */
+
+/* buildObjMesh turns an ObjFile (objfile.h), whose faces are polygons
+   indexing v, vt, and vn separately, into what a vertex buffer and an
+   index buffer hold: MeshVertex corners and a triangle list.  Every
+   ObjRange with faces becomes a submesh, laid out as lod.h lays out its
+   levels: its own run of vertices and a run of indices counting from
+   its first vertex, so it is drawn with
+
+     DrawIndexedPrimitive(D3DPT_TRIANGLELIST, vertexStart, 0, vertexCount,
+                          indexStart, indexCount/3)
+
+   and 16-bit indices suffice for any submesh of at most 65536 vertices.
+   Within a submesh, corners with equal v/vt/vn share one vertex,
+   numbered in order of first use; they are found with an
+   open-addressing hash table on the three indices, one probe per
+   corner when the table is half empty.  Triangles pass straight
+   through and larger polygons are split by triangulatePolygon.
+
+   Corners without a texture coordinate get (0, 0); corners without a
+   normal get (0, 0, 0). */
+
+#ifndef OBJMESH_H
+#define OBJMESH_H
+
+#include "mesh.h"
+#include "mtlfile.h"
+#include "objfile.h"
+
+typedef struct {
+  int vertexStart, vertexCount;   /* In the mesh's vertices */
+  int indexStart, indexCount;     /* In the mesh's indices, counting from vertexStart */
+  int object;                     /* Into the ObjFile's objectNames, or -1 */
+  int material;                   /* Into the ObjFile's materialNames, or -1 */
+} ObjSubmesh;
+
+typedef struct {
+  MeshVertex *vertices;
+  int vertexCount;
+  unsigned int *indices;
+  int indexCount;
+  ObjSubmesh *submeshes;          /* In the ObjFile's range order */
+  int submeshCount;
+} ObjMesh;
+
+/* Build mesh from obj; release it with freeObjMesh.  Return 1 on
+   success and 0 if obj is too large for int counts. */
+int buildObjMesh(ObjMesh *mesh, const ObjFile *obj);
+
+void freeObjMesh(ObjMesh *mesh);
+
+/* Split the polygon of points[0..pointCount) (3 floats each, in order
+   around it) into pointCount - 2 triangles by ear clipping, writing
+   their corners' numbers to triangles.  The polygon is flattened onto
+   the plane facing its Newell normal, and at each step the first ear
+   (a convex corner with no other corner in its triangle) from the
+   second remaining corner on is cut, so convex polygons give the same
+   fan as corner 0 would, and concave ones have no triangle outside
+   them.  Where no ear exists (a self-intersecting or collapsed
+   polygon) the second corner is cut anyway.  Triangles keep the
+   polygon's winding.  Returns the number of triangles. */
+int triangulatePolygon(int *triangles, const float *points, int pointCount);
+
+/* The MaterialData of each of obj's usemtl names: mtl's material of
+   that name, or defaultMtlMaterial where mtl (which may be NULL) has
+   none.  materials has room for obj->materialCount. */
+void getObjMaterials(MaterialData *materials, const ObjFile *obj, const MtlFile *mtl);
+
+/* Reorder mesh's submeshes by materialKey[material] (with -1 for
+   submeshes without a material), keeping file order among equal keys,
+   so that drawing them in order changes material only when the key
+   does.  With keys from mergeMaterials (mtlfile.h), that is once per
+   distinct material.  Only the submesh table moves; vertices and
+   indices stay where they are. */
+void sortObjMeshByMaterial(ObjMesh *mesh, const int *materialKey);
+
+#define OBJMESH_CACHE_PACKED 1   /* Add a PackedVertex stream (compress.h) */
+
+/* Write mesh, built from obj, to a mesh cache file (meshcache.h): one
+   MeshVertex stream, a PackedVertex stream with OBJMESH_CACHE_PACKED,
+   one index buffer (16-bit where every submesh allows it), the
+   distinct materials of obj's usemtl names (see getObjMaterials and
+   mergeMaterials), each named after the first name it has, and up to
+   lodLevels LOD levels.  Level 0 is mesh's submeshes; each further
+   level simplifies every submesh of the one before to half its
+   triangles (simplify.h), but not below 64, and levels stop early once
+   one saves less than a quarter of its triangles.  Return 1 on success
+   and 0 if the file cannot be written. */
+int writeObjMeshCache(const char *path, const ObjFile *obj, const ObjMesh *mesh,
+                      const MtlFile *mtl, int flags, int lodLevels);
+
+#endif /* OBJMESH_H */
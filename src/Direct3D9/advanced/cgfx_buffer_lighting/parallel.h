@@ -0,0 +1,91 @@
+/* parallel.h - Minimal fork-join helper for splitting a loop across threads. */
+
+/* parallelFor hands contiguous index ranges to short-lived std::threads and
+   waits for all of them.  It is meant for big, evenly sized loops (millions
+   of vertices, thousands of triangles per piece) where starting a few
+   threads costs far less than the work.  Compilers without std::thread
+   (Visual C++ 2010 and older, pre-C++11 modes) simply run the loop on the
+   calling thread. */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#if defined(_MSC_VER) ? _MSC_VER >= 1700 : __cplusplus >= 201103L
+# define PARALLEL_HAVE_THREADS 1
+# include <thread>
+# include <vector>
+#endif
+
+/* Maximum number of threads parallelFor uses; 0 means one per hardware
+   thread. */
+inline int &parallelThreadSetting(void)
+{
+  static int threads = 0;
+  return threads;
+}
+
+inline void setParallelThreadCount(int threads)
+{
+  parallelThreadSetting() = threads < 0 ? 0 : threads;
+}
+
+inline int getParallelThreadCount(void)
+{
+  int threads = parallelThreadSetting();
+
+#ifdef PARALLEL_HAVE_THREADS
+  if (threads == 0)
+    threads = (int) std::thread::hardware_concurrency();
+#else
+  threads = 1;
+#endif
+  return threads > 0 ? threads : 1;
+}
+
+/* Call fn(begin, end) for pieces covering [0, count).  No piece is smaller
+   than minPerThread items (except the last), and every piece but the last
+   starts and ends on a multiple of align so SIMD loops stay aligned with
+   the piece boundaries.  fn must be safe to call concurrently on disjoint
+   ranges. */
+template <typename Fn>
+void parallelFor(int count, int minPerThread, int align, Fn fn)
+{
+  int threads = getParallelThreadCount(), piece, begin, t;
+
+  if (count <= 0)
+    return;
+  if (minPerThread < 1)
+    minPerThread = 1;
+  if (align < 1)
+    align = 1;
+  if (threads > count / minPerThread)
+    threads = count / minPerThread;
+  if (threads <= 1) {
+    fn(0, count);
+    return;
+  }
+
+  piece = (count + threads - 1) / threads;
+  piece = (piece + align - 1) / align * align;
+
+#ifdef PARALLEL_HAVE_THREADS
+  {
+    std::vector<std::thread> workers;
+
+    /* The calling thread takes the first piece itself. */
+    for (t = 1, begin = piece; begin < count; t++, begin += piece) {
+      int end = begin + piece < count ? begin + piece : count;
+      workers.push_back(std::thread(fn, begin, end));
+    }
+    fn(0, piece < count ? piece : count);
+    for (t = 0; t < (int) workers.size(); t++)
+      workers[t].join();
+  }
+#else
+  for (begin = 0; begin < count; begin += piece)
+    fn(begin, begin + piece < count ? begin + piece : count);
+  (void) t;
+#endif
+}
+
+#endif /* PARALLEL_H */
@@ -0,0 +1,697 @@
+/* quaternion.c - Quaternion and dual-quaternion routines for rotations and rigid transforms. */
+
+/* See quaternion.h for the layout and conventions.  Like matrix.cpp, the
+   single-quaternion routines favor accuracy and read-ability; the array
+   routines at the end of the file favor throughput. */
+
+#include <math.h>
+
+#include "matrix.h"
+#include "quaternion.h"
+#include "sincos.h"
+#include "matrix_precision.h"
+#include "matrix_simd.h"
+
+static const double myPi = 3.14159265358979323846;
+
+/* p = a*b (the Hamilton product); p may be a or b. */
+static void quatMult(float p[4], const float a[4], const float b[4])
+{
+  float x = a[3]*b[0] + a[0]*b[3] + a[1]*b[2] - a[2]*b[1],
+        y = a[3]*b[1] - a[0]*b[2] + a[1]*b[3] + a[2]*b[0],
+        z = a[3]*b[2] + a[0]*b[1] - a[1]*b[0] + a[2]*b[3],
+        w = a[3]*b[3] - a[0]*b[0] - a[1]*b[1] - a[2]*b[2];
+
+  p[0] = x;
+  p[1] = y;
+  p[2] = z;
+  p[3] = w;
+}
+
+/* makeRotateMatrix's matrix is the rotation by -angle for column vectors,
+   hence the negated half angle. */
+void makeRotateQuaternion(float angle,
+                          float ax, float ay, float az,
+                          float q[4])
+{
+  MatrixReal halfRadians, sine;
+  float axis[3];
+
+  axis[0] = ax;
+  axis[1] = ay;
+  axis[2] = az;
+  normalizeDirection(axis);
+
+  halfRadians = -angle * (MatrixReal) myPi / 360;
+  sine = sin(halfRadians);
+  q[0] = (float) (axis[0] * sine);
+  q[1] = (float) (axis[1] * sine);
+  q[2] = (float) (axis[2] * sine);
+  q[3] = (float) cos(halfRadians);
+}
+
+void makeIdentityQuaternion(float q[4])
+{
+  q[0] = q[1] = q[2] = 0;
+  q[3] = 1;
+}
+
+/* Shepperd's method: divide by the largest of |x|, |y|, |z|, |w| so the
+   result stays accurate for every rotation angle. */
+void makeMatrixQuaternion(const float m[16], float q[4])
+{
+#define M(r,c) ((MatrixReal) m[(r)*4+(c)])
+  MatrixReal trace = M(0,0) + M(1,1) + M(2,2);
+  MatrixReal s;
+
+  if (trace > 0) {
+    s = 2 * sqrt(trace + 1);
+    q[0] = (float) ((M(2,1) - M(1,2)) / s);
+    q[1] = (float) ((M(0,2) - M(2,0)) / s);
+    q[2] = (float) ((M(1,0) - M(0,1)) / s);
+    q[3] = (float) (s / 4);
+  } else if (M(0,0) > M(1,1) && M(0,0) > M(2,2)) {
+    s = 2 * sqrt(1 + M(0,0) - M(1,1) - M(2,2));
+    q[0] = (float) (s / 4);
+    q[1] = (float) ((M(0,1) + M(1,0)) / s);
+    q[2] = (float) ((M(0,2) + M(2,0)) / s);
+    q[3] = (float) ((M(2,1) - M(1,2)) / s);
+  } else if (M(1,1) > M(2,2)) {
+    s = 2 * sqrt(1 + M(1,1) - M(0,0) - M(2,2));
+    q[0] = (float) ((M(0,1) + M(1,0)) / s);
+    q[1] = (float) (s / 4);
+    q[2] = (float) ((M(1,2) + M(2,1)) / s);
+    q[3] = (float) ((M(0,2) - M(2,0)) / s);
+  } else {
+    s = 2 * sqrt(1 + M(2,2) - M(0,0) - M(1,1));
+    q[0] = (float) ((M(0,2) + M(2,0)) / s);
+    q[1] = (float) ((M(1,2) + M(2,1)) / s);
+    q[2] = (float) (s / 4);
+    q[3] = (float) ((M(1,0) - M(0,1)) / s);
+  }
+#undef M
+}
+
+void multQuaternion(float dst[4], const float a[4], const float b[4])
+{
+  quatMult(dst, a, b);
+}
+
+void normalizeQuaternion(float q[4])
+{
+  float mag = (float) sqrt(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
+
+  if (mag) {
+    float oneOverMag = 1.0f / mag;
+
+    q[0] *= oneOverMag;
+    q[1] *= oneOverMag;
+    q[2] *= oneOverMag;
+    q[3] *= oneOverMag;
+  }
+}
+
+void invertQuaternion(float out[4], const float q[4])
+{
+  float norm = q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3];
+  float oneOverNorm = norm ? 1.0f / norm : 0.0f;
+
+  out[0] = -q[0] * oneOverNorm;
+  out[1] = -q[1] * oneOverNorm;
+  out[2] = -q[2] * oneOverNorm;
+  out[3] =  q[3] * oneOverNorm;
+}
+
+void slerpQuaternion(float dst[4], const float a[4], const float b[4], float t)
+{
+  MatrixAccum cosine = (MatrixAccum) a[0]*b[0] + (MatrixAccum) a[1]*b[1] +
+                       (MatrixAccum) a[2]*b[2] + (MatrixAccum) a[3]*b[3];
+  MatrixReal theta, sine, wa, wb;
+  int i;
+
+  /* q and -q are the same rotation; flip b to take the shorter arc. */
+  if (cosine < 0)
+    cosine = -cosine, wb = -1;
+  else
+    wb = 1;
+
+  /* Nearly parallel: sin(theta) is too small to divide by, and the arc
+     is straight enough for nlerp. */
+  if (cosine > 0.9995) {
+    nlerpQuaternion(dst, a, b, t);
+    return;
+  }
+
+  theta = acos((MatrixReal) cosine);
+  sine = sin(theta);
+  wa = sin((1 - t) * theta) / sine;
+  wb *= sin(t * theta) / sine;
+  for (i=0; i<4; i++)
+    dst[i] = (float) (wa * a[i] + wb * b[i]);
+}
+
+void nlerpQuaternion(float dst[4], const float a[4], const float b[4], float t)
+{
+  float cosine = a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3];
+  float wa = 1 - t, wb = cosine < 0 ? -t : t;
+  int i;
+
+  for (i=0; i<4; i++)
+    dst[i] = wa * a[i] + wb * b[i];
+  normalizeQuaternion(dst);
+}
+
+/* v' = v + w*t + u x t, with u the vector part of q and t = 2 u x v. */
+void rotateDirection(float dst[3], const float q[4], const float vec[3])
+{
+  float tx = 2 * (q[1]*vec[2] - q[2]*vec[1]),
+        ty = 2 * (q[2]*vec[0] - q[0]*vec[2]),
+        tz = 2 * (q[0]*vec[1] - q[1]*vec[0]);
+  float x = vec[0] + q[3]*tx + (q[1]*tz - q[2]*ty),
+        y = vec[1] + q[3]*ty + (q[2]*tx - q[0]*tz),
+        z = vec[2] + q[3]*tz + (q[0]*ty - q[1]*tx);
+
+  dst[0] = x;
+  dst[1] = y;
+  dst[2] = z;
+}
+
+/* Matrix for the rotation r and, if d is not NULL, the translation
+   2*d*conj(r)/|r|^2 of a dual quaternion.  Dividing by |r|^2 (folded into
+   s) keeps the result a rigid transform for unnormalized input.  The SIMD
+   kernels below evaluate the same expressions, the AVX2 one with fused
+   multiply-adds. */
+static void rigidMatrix(float m[16], const float r[4], const float d[4])
+{
+  float x = r[0], y = r[1], z = r[2], w = r[3];
+  float norm = x*x + y*y + z*z + w*w;
+  float s = norm > 0 ? 2 / norm : 0;
+  float xs = x*s, ys = y*s, zs = z*s;
+  float wx = w*xs, wy = w*ys, wz = w*zs,
+        xx = x*xs, xy = x*ys, xz = x*zs,
+        yy = y*ys, yz = y*zs, zz = z*zs;
+
+  m[0] = 1 - (yy + zz);  m[1] = xy - wz;        m[2] = xz + wy;
+  m[4] = xy + wz;        m[5] = 1 - (xx + zz);  m[6] = yz - wx;
+  m[8] = xz - wy;        m[9] = yz + wx;        m[10] = 1 - (xx + yy);
+
+  if (d) {
+    m[3]  = s * ((d[0]*w - d[3]*x) + (d[2]*y - d[1]*z));
+    m[7]  = s * ((d[1]*w - d[3]*y) + (d[0]*z - d[2]*x));
+    m[11] = s * ((d[2]*w - d[3]*z) + (d[1]*x - d[0]*y));
+  } else {
+    m[3] = m[7] = m[11] = 0;
+  }
+  m[12] = m[13] = m[14] = 0;
+  m[15] = 1;
+}
+
+void makeQuaternionMatrix(const float q[4], float m[16])
+{
+  rigidMatrix(m, q, 0);
+}
+
+void makeRigidMatrix(const float q[4], const float t[3], float m[16])
+{
+  rigidMatrix(m, q, 0);
+  m[3]  = t[0];
+  m[7]  = t[1];
+  m[11] = t[2];
+}
+
+/* The dual part is (t/2)*q, with t as the pure quaternion (t, 0). */
+void makeDualQuaternion(const float q[4], const float t[3], float dq[8])
+{
+  float pure[4];
+
+  pure[0] = 0.5f * t[0];
+  pure[1] = 0.5f * t[1];
+  pure[2] = 0.5f * t[2];
+  pure[3] = 0;
+  quatMult(dq+4, pure, q);
+  dq[0] = q[0];
+  dq[1] = q[1];
+  dq[2] = q[2];
+  dq[3] = q[3];
+}
+
+/* (ar + e ad)(br + e bd) = ar br + e (ar bd + ad br), since e^2 = 0. */
+void multDualQuaternion(float dst[8], const float a[8], const float b[8])
+{
+  float real[4], dual1[4], dual2[4];
+  int i;
+
+  quatMult(real, a, b);
+  quatMult(dual1, a, b+4);
+  quatMult(dual2, a+4, b);
+  for (i=0; i<4; i++) {
+    dst[i] = real[i];
+    dst[i+4] = dual1[i] + dual2[i];
+  }
+}
+
+void normalizeDualQuaternion(float dq[8])
+{
+  float mag = (float) sqrt(dq[0]*dq[0] + dq[1]*dq[1] + dq[2]*dq[2] + dq[3]*dq[3]);
+
+  if (mag) {
+    float oneOverMag = 1.0f / mag;
+    int i;
+
+    for (i=0; i<8; i++)
+      dq[i] *= oneOverMag;
+  }
+}
+
+void nlerpDualQuaternion(float dst[8], const float a[8], const float b[8], float t)
+{
+  float cosine = a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3];
+  float wa = 1 - t, wb = cosine < 0 ? -t : t;
+  int i;
+
+  for (i=0; i<8; i++)
+    dst[i] = wa * a[i] + wb * b[i];
+  normalizeDualQuaternion(dst);
+}
+
+void makeDualQuaternionMatrix(const float dq[8], float m[16])
+{
+  rigidMatrix(m, dq, dq+4);
+}
+
+/* Batched routines. */
+
+#define ROTATE_BLOCK 256
+
+void makeRotateQuaternionArray(float *q,
+                               const float *angle,
+                               const float *axis, int axisStride,
+                               int count)
+{
+  const float halfDegreesToRadians = (float) (-myPi / 360.0);
+  float halfRadians[ROTATE_BLOCK], sine[ROTATE_BLOCK], cosine[ROTATE_BLOCK];
+  int begin, n, i;
+
+  for (begin=0; begin<count; begin+=ROTATE_BLOCK) {
+    n = count - begin < ROTATE_BLOCK ? count - begin : ROTATE_BLOCK;
+    for (i=0; i<n; i++)
+      halfRadians[i] = angle[begin+i] * halfDegreesToRadians;
+    sinCosArray(sine, cosine, halfRadians, n, SINCOS_FULL);
+    for (i=0; i<n; i++) {
+      const float *a = axis + (begin+i)*axisStride;
+      float unit[3];
+
+      unit[0] = a[0];
+      unit[1] = a[1];
+      unit[2] = a[2];
+      normalizeDirection(unit);
+      q[0] = unit[0] * sine[i];
+      q[1] = unit[1] * sine[i];
+      q[2] = unit[2] * sine[i];
+      q[3] = cosine[i];
+      q += 4;
+    }
+  }
+}
+
+static void multQuaternionArrayScalar(float *dst,
+                                      const float *src1, int src1Stride,
+                                      const float *src2, int src2Stride,
+                                      int count)
+{
+  int n;
+
+  for (n=0; n<count; n++) {
+    quatMult(dst, src1, src2);
+    dst += 4;
+    src1 += src1Stride;
+    src2 += src2Stride;
+  }
+}
+
+void nlerpQuaternionArray(float *dst,
+                          const float *src1, const float *src2,
+                          float t, int count)
+{
+  int n;
+
+  for (n=0; n<count; n++)
+    nlerpQuaternion(dst + 4*n, src1 + 4*n, src2 + 4*n, t);
+}
+
+static void rigidMatrixArrayScalar(float *dst, int dstStride,
+                                   const float *q, int qStride,
+                                   int dual, int count)
+{
+  int n;
+
+  for (n=0; n<count; n++) {
+    rigidMatrix(dst, q, dual ? q+4 : 0);
+    dst += dstStride;
+    q += qStride;
+  }
+}
+
+#ifdef MATRIX_HAVE_SSE
+
+/* Four quaternions at a time.  A 4x4 transpose turns them into one
+   register each of x, y, z, and w; the matrix elements are then formed
+   for all four at once, and a transpose per row turns them back into
+   rows of four separate matrices. */
+MATRIX_TARGET_SSE
+static int rigidMatrixArraySSE(float *dst, int dstStride,
+                               const float *q, int qStride,
+                               int dual, int count)
+{
+  const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f),
+               zero = _mm_setzero_ps(), lastRow = _mm_set_ps(1, 0, 0, 0);
+  int n;
+
+  for (n=0; n+4<=count; n+=4) {
+    __m128 x = _mm_loadu_ps(q),           y = _mm_loadu_ps(q+qStride),
+           z = _mm_loadu_ps(q+2*qStride), w = _mm_loadu_ps(q+3*qStride);
+    __m128 norm, s, xs, ys, zs, wx, wy, wz, xx, xy, xz, yy, yz, zz;
+    __m128 r0c0, r0c1, r0c2, r1c0, r1c1, r1c2, r2c0, r2c1, r2c2, tx, ty, tz;
+    int k;
+
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+
+    norm = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+                                 _mm_mul_ps(z, z)), _mm_mul_ps(w, w));
+    s = _mm_and_ps(_mm_div_ps(two, norm), _mm_cmpgt_ps(norm, zero));
+    xs = _mm_mul_ps(x, s);  ys = _mm_mul_ps(y, s);  zs = _mm_mul_ps(z, s);
+    wx = _mm_mul_ps(w, xs); wy = _mm_mul_ps(w, ys); wz = _mm_mul_ps(w, zs);
+    xx = _mm_mul_ps(x, xs); xy = _mm_mul_ps(x, ys); xz = _mm_mul_ps(x, zs);
+    yy = _mm_mul_ps(y, ys); yz = _mm_mul_ps(y, zs); zz = _mm_mul_ps(z, zs);
+
+    r0c0 = _mm_sub_ps(one, _mm_add_ps(yy, zz));
+    r0c1 = _mm_sub_ps(xy, wz);
+    r0c2 = _mm_add_ps(xz, wy);
+    r1c0 = _mm_add_ps(xy, wz);
+    r1c1 = _mm_sub_ps(one, _mm_add_ps(xx, zz));
+    r1c2 = _mm_sub_ps(yz, wx);
+    r2c0 = _mm_sub_ps(xz, wy);
+    r2c1 = _mm_add_ps(yz, wx);
+    r2c2 = _mm_sub_ps(one, _mm_add_ps(xx, yy));
+
+    if (dual) {
+      __m128 dx = _mm_loadu_ps(q+4),           dy = _mm_loadu_ps(q+qStride+4),
+             dz = _mm_loadu_ps(q+2*qStride+4), dw = _mm_loadu_ps(q+3*qStride+4);
+
+      _MM_TRANSPOSE4_PS(dx, dy, dz, dw);
+      tx = _mm_mul_ps(s, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(dx, w), _mm_mul_ps(dw, x)),
+                                    _mm_sub_ps(_mm_mul_ps(dz, y), _mm_mul_ps(dy, z))));
+      ty = _mm_mul_ps(s, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(dy, w), _mm_mul_ps(dw, y)),
+                                    _mm_sub_ps(_mm_mul_ps(dx, z), _mm_mul_ps(dz, x))));
+      tz = _mm_mul_ps(s, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(dz, w), _mm_mul_ps(dw, z)),
+                                    _mm_sub_ps(_mm_mul_ps(dy, x), _mm_mul_ps(dx, y))));
+    } else {
+      tx = ty = tz = zero;
+    }
+
+    _MM_TRANSPOSE4_PS(r0c0, r0c1, r0c2, tx);
+    _MM_TRANSPOSE4_PS(r1c0, r1c1, r1c2, ty);
+    _MM_TRANSPOSE4_PS(r2c0, r2c1, r2c2, tz);
+    {
+      const __m128 row0[4] = { r0c0, r0c1, r0c2, tx },
+                   row1[4] = { r1c0, r1c1, r1c2, ty },
+                   row2[4] = { r2c0, r2c1, r2c2, tz };
+
+      for (k=0; k<4; k++) {
+        _mm_storeu_ps(dst+0,  row0[k]);
+        _mm_storeu_ps(dst+4,  row1[k]);
+        _mm_storeu_ps(dst+8,  row2[k]);
+        _mm_storeu_ps(dst+12, lastRow);
+        dst += dstStride;
+      }
+    }
+    q += 4*qStride;
+  }
+  return n;
+}
+
+/* Same transposes as above around the Hamilton product, term for term
+   in the order quatMult adds them. */
+MATRIX_TARGET_SSE
+static int multQuaternionArraySSE(float *dst,
+                                  const float *src1, int src1Stride,
+                                  const float *src2, int src2Stride,
+                                  int count)
+{
+  int n;
+
+  for (n=0; n+4<=count; n+=4) {
+    __m128 ax = _mm_loadu_ps(src1),              ay = _mm_loadu_ps(src1+src1Stride),
+           az = _mm_loadu_ps(src1+2*src1Stride), aw = _mm_loadu_ps(src1+3*src1Stride),
+           bx = _mm_loadu_ps(src2),              by = _mm_loadu_ps(src2+src2Stride),
+           bz = _mm_loadu_ps(src2+2*src2Stride), bw = _mm_loadu_ps(src2+3*src2Stride);
+    __m128 x, y, z, w;
+
+    _MM_TRANSPOSE4_PS(ax, ay, az, aw);
+    _MM_TRANSPOSE4_PS(bx, by, bz, bw);
+    x = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(aw, bx), _mm_mul_ps(ax, bw)),
+                              _mm_mul_ps(ay, bz)), _mm_mul_ps(az, by));
+    y = _mm_add_ps(_mm_add_ps(_mm_sub_ps(_mm_mul_ps(aw, by), _mm_mul_ps(ax, bz)),
+                              _mm_mul_ps(ay, bw)), _mm_mul_ps(az, bx));
+    z = _mm_add_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(aw, bz), _mm_mul_ps(ax, by)),
+                              _mm_mul_ps(ay, bx)), _mm_mul_ps(az, bw));
+    w = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_mul_ps(aw, bw), _mm_mul_ps(ax, bx)),
+                              _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    _mm_storeu_ps(dst+0,  x);
+    _mm_storeu_ps(dst+4,  y);
+    _mm_storeu_ps(dst+8,  z);
+    _mm_storeu_ps(dst+12, w);
+    dst += 16;
+    src1 += 4*src1Stride;
+    src2 += 4*src2Stride;
+  }
+  return n;
+}
+
+#endif /* MATRIX_HAVE_SSE */
+
+#ifdef MATRIX_HAVE_AVX2
+
+/* _MM_TRANSPOSE4_PS within each 128-bit lane. */
+#define QUAT_TRANSPOSE4_LANES(r0, r1, r2, r3) {  \
+    __m256 t0 = _mm256_unpacklo_ps(r0, r1),      \
+           t1 = _mm256_unpackhi_ps(r0, r1),      \
+           t2 = _mm256_unpacklo_ps(r2, r3),      \
+           t3 = _mm256_unpackhi_ps(r2, r3);      \
+    r0 = _mm256_shuffle_ps(t0, t2, 0x44);        \
+    r1 = _mm256_shuffle_ps(t0, t2, 0xee);        \
+    r2 = _mm256_shuffle_ps(t1, t3, 0x44);        \
+    r3 = _mm256_shuffle_ps(t1, t3, 0xee);        \
+  }
+
+MATRIX_TARGET_AVX2
+static inline __m256 loadQuatPair(const float *lo, const float *hi)
+{
+  return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(lo)),
+                              _mm_loadu_ps(hi), 1);
+}
+
+/* Same scheme as the SSE kernel for eight quaternions: quaternions i and
+   i+4 share a register, one per 128-bit lane, so the in-lane transposes
+   work on two independent groups of four. */
+MATRIX_TARGET_AVX2
+static int rigidMatrixArrayAVX2(float *dst, int dstStride,
+                                const float *q, int qStride,
+                                int dual, int count)
+{
+  const __m256 one = _mm256_set1_ps(1.0f), two = _mm256_set1_ps(2.0f),
+               zero = _mm256_setzero_ps();
+  const __m128 lastRow = _mm_set_ps(1, 0, 0, 0);
+  int n;
+
+  for (n=0; n+8<=count; n+=8) {
+    const float *hi = q + 4*qStride;
+    __m256 x = loadQuatPair(q,           hi),
+           y = loadQuatPair(q+qStride,   hi+qStride),
+           z = loadQuatPair(q+2*qStride, hi+2*qStride),
+           w = loadQuatPair(q+3*qStride, hi+3*qStride);
+    __m256 norm, s, xs, ys, zs, wx, wy, wz, xx, xy, xz, yy, yz, zz;
+    __m256 r0c0, r0c1, r0c2, r1c0, r1c1, r1c2, r2c0, r2c1, r2c2, tx, ty, tz;
+    int k;
+
+    QUAT_TRANSPOSE4_LANES(x, y, z, w);
+
+    norm = _mm256_fmadd_ps(x, x, _mm256_fmadd_ps(y, y,
+             _mm256_fmadd_ps(z, z, _mm256_mul_ps(w, w))));
+    s = _mm256_and_ps(_mm256_div_ps(two, norm), _mm256_cmp_ps(norm, zero, _CMP_GT_OQ));
+    xs = _mm256_mul_ps(x, s);  ys = _mm256_mul_ps(y, s);  zs = _mm256_mul_ps(z, s);
+    wx = _mm256_mul_ps(w, xs); wy = _mm256_mul_ps(w, ys); wz = _mm256_mul_ps(w, zs);
+    xx = _mm256_mul_ps(x, xs); xy = _mm256_mul_ps(x, ys); xz = _mm256_mul_ps(x, zs);
+    yy = _mm256_mul_ps(y, ys); yz = _mm256_mul_ps(y, zs); zz = _mm256_mul_ps(z, zs);
+
+    r0c0 = _mm256_sub_ps(one, _mm256_add_ps(yy, zz));
+    r0c1 = _mm256_sub_ps(xy, wz);
+    r0c2 = _mm256_add_ps(xz, wy);
+    r1c0 = _mm256_add_ps(xy, wz);
+    r1c1 = _mm256_sub_ps(one, _mm256_add_ps(xx, zz));
+    r1c2 = _mm256_sub_ps(yz, wx);
+    r2c0 = _mm256_sub_ps(xz, wy);
+    r2c1 = _mm256_add_ps(yz, wx);
+    r2c2 = _mm256_sub_ps(one, _mm256_add_ps(xx, yy));
+
+    if (dual) {
+      __m256 dx = loadQuatPair(q+4,           hi+4),
+             dy = loadQuatPair(q+qStride+4,   hi+qStride+4),
+             dz = loadQuatPair(q+2*qStride+4, hi+2*qStride+4),
+             dw = loadQuatPair(q+3*qStride+4, hi+3*qStride+4);
+
+      QUAT_TRANSPOSE4_LANES(dx, dy, dz, dw);
+      tx = _mm256_mul_ps(s, _mm256_add_ps(_mm256_fmsub_ps(dx, w, _mm256_mul_ps(dw, x)),
+                                          _mm256_fmsub_ps(dz, y, _mm256_mul_ps(dy, z))));
+      ty = _mm256_mul_ps(s, _mm256_add_ps(_mm256_fmsub_ps(dy, w, _mm256_mul_ps(dw, y)),
+                                          _mm256_fmsub_ps(dx, z, _mm256_mul_ps(dz, x))));
+      tz = _mm256_mul_ps(s, _mm256_add_ps(_mm256_fmsub_ps(dz, w, _mm256_mul_ps(dw, z)),
+                                          _mm256_fmsub_ps(dy, x, _mm256_mul_ps(dx, y))));
+    } else {
+      tx = ty = tz = zero;
+    }
+
+    QUAT_TRANSPOSE4_LANES(r0c0, r0c1, r0c2, tx);
+    QUAT_TRANSPOSE4_LANES(r1c0, r1c1, r1c2, ty);
+    QUAT_TRANSPOSE4_LANES(r2c0, r2c1, r2c2, tz);
+    {
+      const __m256 row0[4] = { r0c0, r0c1, r0c2, tx },
+                   row1[4] = { r1c0, r1c1, r1c2, ty },
+                   row2[4] = { r2c0, r2c1, r2c2, tz };
+      float *dstHi = dst + 4*dstStride;
+
+      for (k=0; k<4; k++) {
+        _mm_storeu_ps(dst+0,    _mm256_castps256_ps128(row0[k]));
+        _mm_storeu_ps(dst+4,    _mm256_castps256_ps128(row1[k]));
+        _mm_storeu_ps(dst+8,    _mm256_castps256_ps128(row2[k]));
+        _mm_storeu_ps(dst+12,   lastRow);
+        _mm_storeu_ps(dstHi+0,  _mm256_extractf128_ps(row0[k], 1));
+        _mm_storeu_ps(dstHi+4,  _mm256_extractf128_ps(row1[k], 1));
+        _mm_storeu_ps(dstHi+8,  _mm256_extractf128_ps(row2[k], 1));
+        _mm_storeu_ps(dstHi+12, lastRow);
+        dst += dstStride;
+        dstHi += dstStride;
+      }
+    }
+    dst += 4*dstStride;
+    q += 8*qStride;
+  }
+  return n;
+}
+
+MATRIX_TARGET_AVX2
+static int multQuaternionArrayAVX2(float *dst,
+                                   const float *src1, int src1Stride,
+                                   const float *src2, int src2Stride,
+                                   int count)
+{
+  int n;
+
+  for (n=0; n+8<=count; n+=8) {
+    const float *hi1 = src1 + 4*src1Stride, *hi2 = src2 + 4*src2Stride;
+    __m256 ax = loadQuatPair(src1,              hi1),
+           ay = loadQuatPair(src1+src1Stride,   hi1+src1Stride),
+           az = loadQuatPair(src1+2*src1Stride, hi1+2*src1Stride),
+           aw = loadQuatPair(src1+3*src1Stride, hi1+3*src1Stride),
+           bx = loadQuatPair(src2,              hi2),
+           by = loadQuatPair(src2+src2Stride,   hi2+src2Stride),
+           bz = loadQuatPair(src2+2*src2Stride, hi2+2*src2Stride),
+           bw = loadQuatPair(src2+3*src2Stride, hi2+3*src2Stride);
+    __m256 x, y, z, w;
+
+    QUAT_TRANSPOSE4_LANES(ax, ay, az, aw);
+    QUAT_TRANSPOSE4_LANES(bx, by, bz, bw);
+    x = _mm256_fnmadd_ps(az, by, _mm256_fmadd_ps(ay, bz, _mm256_fmadd_ps(ax, bw, _mm256_mul_ps(aw, bx))));
+    y = _mm256_fmadd_ps(az, bx, _mm256_fmadd_ps(ay, bw, _mm256_fnmadd_ps(ax, bz, _mm256_mul_ps(aw, by))));
+    z = _mm256_fmadd_ps(az, bw, _mm256_fnmadd_ps(ay, bx, _mm256_fmadd_ps(ax, by, _mm256_mul_ps(aw, bz))));
+    w = _mm256_fnmadd_ps(az, bz, _mm256_fnmadd_ps(ay, by, _mm256_fnmadd_ps(ax, bx, _mm256_mul_ps(aw, bw))));
+    QUAT_TRANSPOSE4_LANES(x, y, z, w);
+    /* Lane 0 holds quaternions 0-3, lane 1 quaternions 4-7. */
+    _mm256_storeu_ps(dst+0,  _mm256_permute2f128_ps(x, y, 0x20));
+    _mm256_storeu_ps(dst+8,  _mm256_permute2f128_ps(z, w, 0x20));
+    _mm256_storeu_ps(dst+16, _mm256_permute2f128_ps(x, y, 0x31));
+    _mm256_storeu_ps(dst+24, _mm256_permute2f128_ps(z, w, 0x31));
+    dst += 32;
+    src1 += 8*src1Stride;
+    src2 += 8*src2Stride;
+  }
+  return n;
+}
+
+#undef QUAT_TRANSPOSE4_LANES
+
+#endif /* MATRIX_HAVE_AVX2 */
+
+/* The SIMD kernels convert whole groups and return how many they did;
+   the scalar loop finishes the rest. */
+static void rigidMatrixArray(float *dst, int dstStride,
+                             const float *q, int qStride,
+                             int dual, int count)
+{
+  int done = 0;
+
+  if (count <= 0)
+    return;
+
+  switch (getMatrixSimdLevel()) {
+#ifdef MATRIX_HAVE_AVX2
+  case MATRIX_SIMD_AVX2:
+    done = rigidMatrixArrayAVX2(dst, dstStride, q, qStride, dual, count);
+    done += rigidMatrixArraySSE(dst + done*dstStride, dstStride,
+                                q + done*qStride, qStride, dual, count - done);
+    break;
+#endif
+#ifdef MATRIX_HAVE_SSE
+  case MATRIX_SIMD_SSE:
+    done = rigidMatrixArraySSE(dst, dstStride, q, qStride, dual, count);
+    break;
+#endif
+  default:
+    break;
+  }
+  rigidMatrixArrayScalar(dst + done*dstStride, dstStride,
+                         q + done*qStride, qStride, dual, count - done);
+}
+
+void makeQuaternionMatrixArray(float *dst, int dstStride,
+                               const float *q, int qStride,
+                               int count)
+{
+  rigidMatrixArray(dst, dstStride, q, qStride, 0, count);
+}
+
+void makeDualQuaternionMatrixArray(float *dst, int dstStride,
+                                   const float *dq, int dqStride,
+                                   int count)
+{
+  rigidMatrixArray(dst, dstStride, dq, dqStride, 1, count);
+}
+
+void multQuaternionArray(float *dst,
+                         const float *src1, int src1Stride,
+                         const float *src2, int src2Stride,
+                         int count)
+{
+  int done = 0;
+
+  if (count <= 0)
+    return;
+
+  switch (getMatrixSimdLevel()) {
+#ifdef MATRIX_HAVE_AVX2
+  case MATRIX_SIMD_AVX2:
+    done = multQuaternionArrayAVX2(dst, src1, src1Stride, src2, src2Stride, count);
+    break;
+#endif
+#ifdef MATRIX_HAVE_SSE
+  case MATRIX_SIMD_SSE:
+    done = multQuaternionArraySSE(dst, src1, src1Stride, src2, src2Stride, count);
+    break;
+#endif
+  default:
+    break;
+  }
+  multQuaternionArrayScalar(dst + 4*done, src1 + done*src1Stride, src1Stride,
+                            src2 + done*src2Stride, src2Stride, count - done);
+}
@@ -0,0 +1,126 @@
+/* quaternion.h - Quaternion and dual-quaternion routines for rotations and rigid transforms. */
+
+/* A quaternion is 4 floats (x, y, z, w): the vector part then the scalar
+   part.  A dual quaternion is 8 floats: the real quaternion (the rotation)
+   then the dual quaternion (half the translation times the rotation).
+
+   Conversions produce the same row-major (C-style) 4x4 matrices as
+   matrix.h, and composition follows the same order as multMatrix:
+   multQuaternion(dst, a, b) rotates by b first, then by a, just like
+   the matrix product a*b.
+
+   Compared to a 4x4 matrix, a rotation quaternion is a quarter of the
+   size, composes in 16 multiplies instead of 64, interpolates smoothly,
+   and is trivial to keep orthonormal, so it is the better form to keep
+   and animate; convert to a matrix once per frame for the shaders.
+
+   The philosophy of matrix.h applies: make routines put the result last,
+   multiply and interpolate routines put it first, and the result may be
+   a source parameter too. */
+
+#ifndef QUATERNION_H
+#define QUATERNION_H
+
+/* Quaternion for the same rotation as makeRotateMatrix with the same
+   parameters.  Note that makeRotateMatrix (and so this routine) rotates
+   column vectors by -angle degrees about the axis; its matrix is
+   glRotatef's laid out the other way around. */
+void makeRotateQuaternion(float angle,
+                          float ax, float ay, float az,
+                          float q[4]);
+
+void makeIdentityQuaternion(float q[4]);
+
+/* Quaternion for the rotation in the upper-left 3x3 of m, which must be
+   a pure rotation (orthonormal, no scale). */
+void makeMatrixQuaternion(const float m[16], float q[4]);
+
+/* dst = a*b, the rotation b followed by the rotation a. */
+void multQuaternion(float dst[4], const float a[4], const float b[4]);
+
+/* Scale q to unit length.  Repeatedly composed quaternions drift; one
+   normalize restores an exact rotation (compare re-orthonormalizing a
+   3x3 matrix). */
+void normalizeQuaternion(float q[4]);
+
+/* The inverse rotation.  For a unit quaternion this is the conjugate. */
+void invertQuaternion(float out[4], const float q[4]);
+
+/* Spherical linear interpolation from a (t = 0) to b (t = 1) along the
+   shorter arc, at constant angular speed.  Falls back to nlerp when a
+   and b are nearly equal. */
+void slerpQuaternion(float dst[4], const float a[4], const float b[4], float t);
+
+/* Normalized linear interpolation along the shorter arc: the same path
+   as slerp, slightly uneven in speed, much cheaper.  Good enough for
+   per-frame steps and blending. */
+void nlerpQuaternion(float dst[4], const float a[4], const float b[4], float t);
+
+/* Rotate a 3-component direction by q (which must be unit length);
+   same result as transformDirection with makeQuaternionMatrix(q). */
+void rotateDirection(float dst[3], const float q[4], const float vec[3]);
+
+/* Rotation matrix for q.  q need not be unit length; the rotation of the
+   normalized quaternion is used. */
+void makeQuaternionMatrix(const float q[4], float m[16]);
+
+/* Rigid-body matrix: rotate by q, then translate by t. */
+void makeRigidMatrix(const float q[4], const float t[3], float m[16]);
+
+/* Dual quaternions.  A rigid transform as 8 floats that composes like a
+   matrix product and can be blended without shearing (unlike blending
+   matrices). */
+
+/* Rotate by q, then translate by t; same transform as makeRigidMatrix. */
+void makeDualQuaternion(const float q[4], const float t[3], float dq[8]);
+
+/* dst = a*b, the transform b followed by the transform a. */
+void multDualQuaternion(float dst[8], const float a[8], const float b[8]);
+
+/* Scale dq so its real part has unit length. */
+void normalizeDualQuaternion(float dq[8]);
+
+/* Dual quaternion linear blending from a (t = 0) to b (t = 1), along the
+   shorter arc, normalized. */
+void nlerpDualQuaternion(float dst[8], const float a[8], const float b[8], float t);
+
+/* Rigid-body matrix for dq.  As with makeQuaternionMatrix, dq need not
+   be normalized. */
+void makeDualQuaternionMatrix(const float dq[8], float m[16]);
+
+/* Batched routines for many animated objects.  Quaternion i starts
+   i*stride floats into its array, matrix i starts i*dstStride floats into
+   dst (16 for packed matrices, more to step through an array of structs).
+   multQuaternionArray and the conversions use an SSE or AVX2 kernel at the
+   level chosen by setMatrixSimdLevel (see matrix.h). */
+
+/* dst[i] = src1[i] * src2[i] for count consecutive 4-float quaternions.
+   A stride of 0 reuses the same quaternion for every i. */
+void multQuaternionArray(float *dst,
+                         const float *src1, int src1Stride,
+                         const float *src2, int src2Stride,
+                         int count);
+
+/* dst[i] = nlerpQuaternion(src1[i], src2[i], t) for consecutive
+   4-float quaternions. */
+void nlerpQuaternionArray(float *dst,
+                          const float *src1, const float *src2,
+                          float t, int count);
+
+/* makeRotateQuaternion for count angles (in degrees), with axis i at
+   axis + i*axisStride (0 shares one axis); the quaternions are packed.
+   Uses sinCosArray at full precision (see sincos.h). */
+void makeRotateQuaternionArray(float *q,
+                               const float *angle,
+                               const float *axis, int axisStride,
+                               int count);
+
+void makeQuaternionMatrixArray(float *dst, int dstStride,
+                               const float *q, int qStride,
+                               int count);
+
+void makeDualQuaternionMatrixArray(float *dst, int dstStride,
+                                   const float *dq, int dqStride,
+                                   int count);
+
+#endif /* QUATERNION_H */
@@ -0,0 +1,724 @@
+/* simplify.c - Quadric error mesh simplification that keeps attribute seams. */
+
+/* Positions are numbered by a vertex: where vertices share a position,
+   the smallest of them stands for all.  Triangles keep their own
+   vertices, so a seam shows up as two triangles that share an edge's
+   positions but not its vertices.
+
+   Collapses wait in a heap, cheapest first.  Every position has a
+   version that changes whenever one of its triangles does; a collapse
+   whose position has moved on since it was costed is dropped when it
+   comes up, and the position gets a fresh one. */
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <queue>
+#include <vector>
+
+#include "simplify.h"
+#include "parallel.h"
+
+/* Positions below which more threads are not worth it. */
+static const int myPositionsMinPerThread = 8192;
+
+/* Weight of the plane through a seam or border edge, standing upright on
+   its triangle, against 1 for the plane of each triangle. */
+static const double myOpenEdgeWeight = 2;
+
+/* A collapse may not turn a triangle's normal more than about 75 degrees. */
+static const double myMinNormalCosine = 0.25;
+
+typedef struct {
+  double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+} Quadric;
+
+/* Add w times the squared distance to plane ax + by + cz + d = 0. */
+static void addPlane(Quadric *q, double a, double b, double c, double d, double w)
+{
+  q->a2 += w*a*a;
+  q->ab += w*a*b;
+  q->ac += w*a*c;
+  q->ad += w*a*d;
+  q->b2 += w*b*b;
+  q->bc += w*b*c;
+  q->bd += w*b*d;
+  q->c2 += w*c*c;
+  q->cd += w*c*d;
+  q->d2 += w*d*d;
+}
+
+static void addQuadric(Quadric *q, const Quadric *r)
+{
+  q->a2 += r->a2;
+  q->ab += r->ab;
+  q->ac += r->ac;
+  q->ad += r->ad;
+  q->b2 += r->b2;
+  q->bc += r->bc;
+  q->bd += r->bd;
+  q->c2 += r->c2;
+  q->cd += r->cd;
+  q->d2 += r->d2;
+}
+
+static double evaluateQuadric(const Quadric *q, const float p[3])
+{
+  double x = p[0], y = p[1], z = p[2],
+         e = q->a2*x*x + 2*q->ab*x*y + 2*q->ac*x*z + 2*q->ad*x +
+             q->b2*y*y + 2*q->bc*y*z + 2*q->bd*y +
+             q->c2*z*z + 2*q->cd*z + q->d2;
+
+  /* Rounding can make a sum of squares slightly negative. */
+  return e > 0 ? e : 0;
+}
+
+static void cross3(double n[3], const float a[3], const float b[3], const float c[3])
+{
+  double u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] },
+         v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+
+  n[0] = u[1]*v[2] - u[2]*v[1];
+  n[1] = u[2]*v[0] - u[0]*v[2];
+  n[2] = u[0]*v[1] - u[1]*v[0];
+}
+
+static double dot3(const double a[3], const double b[3])
+{
+  return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+typedef enum {
+  POSITION_MANIFOLD,   /* Inside a smooth stretch of surface */
+  POSITION_OPEN,       /* On one seam or border */
+  POSITION_LOCKED      /* Where seams meet, not manifold, or collapsed */
+} PositionKind;
+
+typedef enum {
+  EDGE_SMOOTH,         /* Two triangles sharing its vertices */
+  EDGE_OPEN,           /* One triangle, or two with different vertices */
+  EDGE_NONMANIFOLD     /* More than two triangles */
+} EdgeKind;
+
+/* A triangle around a position and its neighbor there. */
+typedef struct {
+  int position, triangle;
+} Link;
+
+static bool lessLink(const Link &a, const Link &b)
+{
+  return a.position != b.position ? a.position < b.position : a.triangle < b.triangle;
+}
+
+typedef struct {
+  const MeshVertex *vertices;
+  std::vector<unsigned int> corners;       /* 3 per triangle */
+  std::vector<char> alive;                 /* Per triangle */
+  std::vector<int> position;               /* Per vertex */
+  std::vector<std::vector<int> > around;   /* Per position: its triangles, some dead */
+  std::vector<Quadric> quadrics;           /* Per position */
+  std::vector<char> kind;                  /* Per position */
+  std::vector<int> version;                /* Per position */
+} Simplifier;
+
+typedef struct {
+  double cost;
+  int from, to, version;
+} Collapse;
+
+struct CheapestFirst
+{
+  bool operator()(const Collapse &a, const Collapse &b) const
+  {
+    return a.cost > b.cost;
+  }
+};
+
+static const float *positionOf(const Simplifier *s, int p)
+{
+  return s->vertices[p].position;
+}
+
+/* Triangle t's vertex at position p, or -1. */
+static int vertexAt(const Simplifier *s, int t, int p)
+{
+  const unsigned int *c = &s->corners[3*t];
+  int k;
+
+  for (k = 0; k < 3; k++)
+    if (s->position[c[k]] == p)
+      return (int) c[k];
+  return -1;
+}
+
+/* Neighbors of p, one link per triangle, sorted by neighbor. */
+static void getLinks(const Simplifier *s, int p, std::vector<Link> *links)
+{
+  size_t i;
+
+  links->clear();
+  for (i = 0; i < s->around[p].size(); i++) {
+    int t = s->around[p][i], k;
+
+    if (!s->alive[t])
+      continue;
+    for (k = 0; k < 3; k++) {
+      Link link;
+
+      link.position = s->position[s->corners[3*t + k]];
+      link.triangle = t;
+      if (link.position != p)
+        links->push_back(link);
+    }
+  }
+  std::sort(links->begin(), links->end(), lessLink);
+}
+
+/* Length of the run of links to the same neighbor starting at links[i]. */
+static size_t linkRun(const std::vector<Link> &links, size_t i)
+{
+  size_t j = i;
+
+  while (j < links.size() && links[j].position == links[i].position)
+    j++;
+  return j - i;
+}
+
+/* The edge from p to the neighbor of links[i..i+count). */
+static EdgeKind edgeKind(const Simplifier *s, int p, const Link *links, size_t count)
+{
+  int q = links[0].position;
+
+  if (count > 2)
+    return EDGE_NONMANIFOLD;
+  if (count == 1 ||
+      vertexAt(s, links[0].triangle, p) != vertexAt(s, links[1].triangle, p) ||
+      vertexAt(s, links[0].triangle, q) != vertexAt(s, links[1].triangle, q))
+    return EDGE_OPEN;
+  return EDGE_SMOOTH;
+}
+
+/* Quadric and kind of position p, from the original triangles. */
+struct QuadricTask
+{
+  Simplifier *s;
+
+  void operator()(int begin, int end) const
+  {
+    std::vector<Link> links;
+    int p;
+
+    for (p = begin; p < end; p++) {
+      Quadric *q = &s->quadrics[p];
+      int open = 0, locked = 0;
+      size_t i, n;
+
+      memset(q, 0, sizeof(*q));
+      if (s->position[p] != p || s->around[p].empty()) {
+        s->kind[p] = POSITION_LOCKED;
+        continue;
+      }
+      for (i = 0; i < s->around[p].size(); i++) {
+        const unsigned int *c = &s->corners[3 * s->around[p][i]];
+        double normal[3], length;
+
+        cross3(normal, s->vertices[c[0]].position, s->vertices[c[1]].position,
+               s->vertices[c[2]].position);
+        length = sqrt(dot3(normal, normal));
+        if (length > 0)
+          addPlane(q, normal[0] / length, normal[1] / length, normal[2] / length,
+                   -(normal[0] * s->vertices[c[0]].position[0] +
+                     normal[1] * s->vertices[c[0]].position[1] +
+                     normal[2] * s->vertices[c[0]].position[2]) / length, 1);
+      }
+
+      getLinks(s, p, &links);
+      for (i = 0; i < links.size(); i += n) {
+        EdgeKind edge;
+        size_t k;
+
+        n = linkRun(links, i);
+        edge = edgeKind(s, p, &links[i], n);
+        if (edge == EDGE_NONMANIFOLD)
+          locked = 1;
+        if (edge != EDGE_OPEN)
+          continue;
+        open++;
+
+        /* Keep the seam or border from bending: the plane through the
+           edge that stands upright on each triangle beside it. */
+        for (k = i; k < i + n; k++) {
+          const unsigned int *c = &s->corners[3 * links[k].triangle];
+          const float *a = positionOf(s, p), *b = positionOf(s, links[k].position);
+          double normal[3], e[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] }, m[3], length;
+
+          cross3(normal, s->vertices[c[0]].position, s->vertices[c[1]].position,
+                 s->vertices[c[2]].position);
+          m[0] = e[1]*normal[2] - e[2]*normal[1];
+          m[1] = e[2]*normal[0] - e[0]*normal[2];
+          m[2] = e[0]*normal[1] - e[1]*normal[0];
+          length = sqrt(dot3(m, m));
+          if (length > 0)
+            addPlane(q, m[0] / length, m[1] / length, m[2] / length,
+                     -(m[0]*a[0] + m[1]*a[1] + m[2]*a[2]) / length, myOpenEdgeWeight);
+        }
+      }
+
+      /* Different vertices without a seam between them, say a vertex
+         whose normal changes across an edge of the triangle fan only at
+         a point, cannot be kept apart by sliding along a seam. */
+      if (!locked && open == 0)
+        for (i = 1; i < s->around[p].size(); i++)
+          if (vertexAt(s, s->around[p][i], p) != vertexAt(s, s->around[p][0], p))
+            locked = 1;
+      s->kind[p] = (char) (locked ? POSITION_LOCKED :
+                           open == 0 ? POSITION_MANIFOLD :
+                           open == 2 ? POSITION_OPEN : POSITION_LOCKED);
+    }
+  }
+};
+
+/* Whether moving u onto its neighbor v, whose links are the run vLinks of
+   uLinks, keeps the mesh sound: every vertex of u has a vertex of v to
+   become, the two share no neighbors but the far corners of their
+   shared triangles, and no triangle turns over. */
+static bool canCollapse(const Simplifier *s, int u, int v,
+                        const std::vector<Link> &uLinks, const Link *vLinks, size_t vCount,
+                        std::vector<Link> *scratch)
+{
+  int fromVertex[2], toVertex[2], mapped = 0;
+  size_t i, j, k, shared = 0;
+
+  for (i = 0; i < vCount; i++) {
+    int a = vertexAt(s, vLinks[i].triangle, u), b = vertexAt(s, vLinks[i].triangle, v);
+
+    for (k = 0; k < (size_t) mapped; k++)
+      if (fromVertex[k] == a)
+        break;
+    if (k < (size_t) mapped) {
+      if (toVertex[k] != b)
+        return false;
+    } else {
+      fromVertex[mapped] = a;
+      toVertex[mapped++] = b;
+    }
+  }
+  for (i = 0; i < s->around[u].size(); i++) {
+    int t = s->around[u][i], a;
+
+    if (!s->alive[t])
+      continue;
+    a = vertexAt(s, t, u);
+    for (k = 0; k < (size_t) mapped; k++)
+      if (fromVertex[k] == a)
+        break;
+    if (k == (size_t) mapped)
+      return false;
+  }
+
+  /* Link condition. */
+  getLinks(s, v, scratch);
+  for (i = 0, j = 0; i < uLinks.size() && j < scratch->size(); ) {
+    if (uLinks[i].position < (*scratch)[j].position) {
+      i += linkRun(uLinks, i);
+    } else if ((*scratch)[j].position < uLinks[i].position) {
+      j += linkRun(*scratch, j);
+    } else {
+      shared++;
+      i += linkRun(uLinks, i);
+      j += linkRun(*scratch, j);
+    }
+  }
+  if (shared > vCount)
+    return false;
+
+  /* Flips. */
+  for (i = 0; i < s->around[u].size(); i++) {
+    int t = s->around[u][i];
+    const float *p[3], *moved[3];
+    double before[3], after[3], lengths;
+
+    if (!s->alive[t] || vertexAt(s, t, v) >= 0)
+      continue;
+    for (k = 0; k < 3; k++) {
+      int position = s->position[s->corners[3*t + k]];
+
+      p[k] = positionOf(s, position);
+      moved[k] = position == u ? positionOf(s, v) : p[k];
+    }
+    cross3(before, p[0], p[1], p[2]);
+    cross3(after, moved[0], moved[1], moved[2]);
+    lengths = sqrt(dot3(before, before) * dot3(after, after));
+    if (lengths == 0 || dot3(before, after) < myMinNormalCosine * lengths)
+      return false;
+  }
+  return true;
+}
+
+static bool lessCost(const Collapse &a, const Collapse &b)
+{
+  return a.cost < b.cost;
+}
+
+/* The cheapest sound collapse of u, if it has one.  Soundness takes far
+   longer to check than cost, so neighbors are checked cheapest first
+   and the first sound one wins. */
+static bool findCollapse(const Simplifier *s, int u, Collapse *best,
+                         std::vector<Link> *links, std::vector<Link> *scratch)
+{
+  Collapse candidates[64];
+  size_t i, n, runs[64];
+  int count = 0, k;
+
+  if (s->kind[u] == POSITION_LOCKED)
+    return false;
+  getLinks(s, u, links);
+  for (i = 0; i < links->size() && count < 64; i += n) {
+    int v = (*links)[i].position;
+    EdgeKind edge;
+    Quadric q;
+
+    n = linkRun(*links, i);
+    edge = edgeKind(s, u, &(*links)[i], n);
+    if (edge == EDGE_NONMANIFOLD)
+      continue;
+    /* Seams and borders only slide along themselves. */
+    if (s->kind[u] == POSITION_OPEN && (edge != EDGE_OPEN || s->kind[v] == POSITION_MANIFOLD))
+      continue;
+
+    q = s->quadrics[u];
+    addQuadric(&q, &s->quadrics[v]);
+    candidates[count].cost = evaluateQuadric(&q, positionOf(s, v));
+    candidates[count].from = u;
+    candidates[count].to = v;
+    candidates[count].version = s->version[u];
+    /* Where this neighbor's links start. */
+    runs[count++] = i;
+  }
+
+  /* Sort the candidates and their link runs together. */
+  for (k = 1; k < count; k++) {
+    Collapse c = candidates[k];
+    size_t r = runs[k];
+    int j;
+
+    for (j = k; j > 0 && lessCost(c, candidates[j-1]); j--) {
+      candidates[j] = candidates[j-1];
+      runs[j] = runs[j-1];
+    }
+    candidates[j] = c;
+    runs[j] = r;
+  }
+  for (k = 0; k < count; k++)
+    if (canCollapse(s, u, candidates[k].to, *links, &(*links)[runs[k]],
+                    linkRun(*links, runs[k]), scratch)) {
+      *best = candidates[k];
+      return true;
+    }
+  return false;
+}
+
+struct FirstCollapseTask
+{
+  const Simplifier *s;
+  Collapse *collapses;
+
+  void operator()(int begin, int end) const
+  {
+    std::vector<Link> links, scratch;
+    int p;
+
+    for (p = begin; p < end; p++)
+      if (!findCollapse(s, p, &collapses[p], &links, &scratch))
+        collapses[p].from = -1;
+  }
+};
+
+/* Move u onto v; returns the number of triangles removed. */
+static int collapse(Simplifier *s, int u, int v)
+{
+  int fromVertex[2], toVertex[2], mapped = 0, removed = 0;
+  size_t i;
+
+  for (i = 0; i < s->around[u].size(); i++) {
+    int t = s->around[u][i];
+
+    if (s->alive[t] && vertexAt(s, t, v) >= 0 && mapped < 2) {
+      int a = vertexAt(s, t, u), k;
+
+      for (k = 0; k < mapped; k++)
+        if (fromVertex[k] == a)
+          break;
+      if (k == mapped) {
+        fromVertex[mapped] = a;
+        toVertex[mapped++] = vertexAt(s, t, v);
+      }
+    }
+  }
+
+  for (i = 0; i < s->around[u].size(); i++) {
+    int t = s->around[u][i], k;
+
+    if (!s->alive[t])
+      continue;
+    if (vertexAt(s, t, v) >= 0) {
+      s->alive[t] = 0;
+      removed++;
+      continue;
+    }
+    for (k = 0; k < 3; k++) {
+      unsigned int *c = &s->corners[3*t + k];
+      int m;
+
+      if (s->position[*c] != u)
+        continue;
+      for (m = 0; m < mapped; m++)
+        if (fromVertex[m] == (int) *c)
+          *c = (unsigned int) toVertex[m];
+    }
+    s->around[v].push_back(t);
+  }
+  s->around[u].clear();
+  s->kind[u] = POSITION_LOCKED;
+  addQuadric(&s->quadrics[v], &s->quadrics[u]);
+  return removed;
+}
+
+static void dropDead(Simplifier *s, int p)
+{
+  std::vector<int> &around = s->around[p];
+  size_t i, n = 0;
+
+  for (i = 0; i < around.size(); i++)
+    if (s->alive[around[i]])
+      around[n++] = around[i];
+  around.resize(n);
+}
+
+static bool lessPosition(const MeshVertex *vertices, unsigned int a, unsigned int b)
+{
+  const float *p = vertices[a].position, *q = vertices[b].position;
+
+  if (p[0] != q[0])
+    return p[0] < q[0];
+  if (p[1] != q[1])
+    return p[1] < q[1];
+  if (p[2] != q[2])
+    return p[2] < q[2];
+  return a < b;
+}
+
+struct PositionOrder
+{
+  const MeshVertex *vertices;
+
+  bool operator()(unsigned int a, unsigned int b) const
+  {
+    return lessPosition(vertices, a, b);
+  }
+};
+
+int simplifyMesh(unsigned int *out, const unsigned int *indices, int indexCount,
+                 const MeshVertex *vertices, int vertexCount,
+                 int targetIndexCount, float targetError, float *error)
+{
+  const int triangleCount = indexCount / 3;
+  Simplifier s;
+  std::vector<unsigned int> order(vertexCount);
+  std::vector<Collapse> first(vertexCount);
+  std::priority_queue<Collapse, std::vector<Collapse>, CheapestFirst> heap;
+  std::vector<Link> links, scratch;
+  std::vector<int> affected;
+  PositionOrder positionOrder;
+  QuadricTask quadricTask;
+  FirstCollapseTask firstTask;
+  float lo[3], hi[3];
+  double radius, maxCost, worst = 0;
+  int alive = triangleCount, i, k, n;
+
+  s.vertices = vertices;
+  s.corners.assign(indices, indices + 3 * triangleCount);
+  s.alive.assign(triangleCount, 1);
+  s.position.resize(vertexCount);
+  s.around.resize(vertexCount);
+  s.quadrics.resize(vertexCount);
+  s.kind.resize(vertexCount);
+  s.version.assign(vertexCount, 0);
+
+  /* Number positions by their smallest vertex. */
+  for (i = 0; i < vertexCount; i++)
+    order[i] = (unsigned int) i;
+  positionOrder.vertices = vertices;
+  std::sort(order.begin(), order.end(), positionOrder);
+  for (i = 0; i < vertexCount; i = k) {
+    int smallest = (int) order[i];
+
+    for (k = i + 1; k < vertexCount &&
+                    memcmp(vertices[order[k]].position, vertices[order[i]].position,
+                           sizeof(vertices[0].position)) == 0; k++)
+      if ((int) order[k] < smallest)
+        smallest = (int) order[k];
+    for (n = i; n < k; n++)
+      s.position[order[n]] = smallest;
+  }
+
+  /* Bounding radius, and triangles around each position; triangles with
+     a repeated position draw nothing and go at once. */
+  for (k = 0; k < 3; k++) {
+    lo[k] = 1e30f;
+    hi[k] = -1e30f;
+  }
+  for (i = 0; i < triangleCount; i++) {
+    const unsigned int *c = &s.corners[3*i];
+    int a = s.position[c[0]], b = s.position[c[1]], d = s.position[c[2]];
+
+    if (a == b || b == d || d == a) {
+      s.alive[i] = 0;
+      alive--;
+      continue;
+    }
+    for (n = 0; n < 3; n++) {
+      s.around[s.position[c[n]]].push_back(i);
+      for (k = 0; k < 3; k++) {
+        lo[k] = std::min(lo[k], vertices[c[n]].position[k]);
+        hi[k] = std::max(hi[k], vertices[c[n]].position[k]);
+      }
+    }
+  }
+  radius = 0.5 * sqrt((double) (hi[0] - lo[0]) * (hi[0] - lo[0]) +
+                      (double) (hi[1] - lo[1]) * (hi[1] - lo[1]) +
+                      (double) (hi[2] - lo[2]) * (hi[2] - lo[2]));
+  maxCost = targetError > 0 ? (targetError * radius) * (targetError * radius) : -1;
+
+  quadricTask.s = &s;
+  parallelFor(vertexCount, myPositionsMinPerThread, 1, quadricTask);
+  firstTask.s = &s;
+  firstTask.collapses = &first[0];
+  parallelFor(vertexCount, myPositionsMinPerThread, 1, firstTask);
+  for (i = 0; i < vertexCount; i++)
+    if (first[i].from >= 0)
+      heap.push(first[i]);
+
+  while (alive * 3 > targetIndexCount && !heap.empty()) {
+    Collapse c = heap.top();
+    size_t j;
+
+    heap.pop();
+    if (c.version != s.version[c.from])
+      continue;
+    if (maxCost >= 0 && c.cost > maxCost)
+      break;
+
+    /* Still sound?  The neighborhood of c.to may have changed. */
+    getLinks(&s, c.from, &links);
+    for (j = 0; j < links.size() && links[j].position != c.to; j++)
+      ;
+    if (j == links.size() ||
+        !canCollapse(&s, c.from, c.to, links, &links[j], linkRun(links, j), &scratch)) {
+      s.version[c.from]++;
+      if (findCollapse(&s, c.from, &c, &links, &scratch))
+        heap.push(c);
+      continue;
+    }
+
+    alive -= collapse(&s, c.from, c.to);
+    if (c.cost > worst)
+      worst = c.cost;
+
+    /* Every position of the triangles now around c.to has new triangles. */
+    dropDead(&s, c.to);
+    affected.clear();
+    for (j = 0; j < s.around[c.to].size(); j++)
+      for (k = 0; k < 3; k++)
+        affected.push_back(s.position[s.corners[3 * s.around[c.to][j] + k]]);
+    std::sort(affected.begin(), affected.end());
+    affected.erase(std::unique(affected.begin(), affected.end()), affected.end());
+    for (j = 0; j < affected.size(); j++) {
+      Collapse next;
+
+      dropDead(&s, affected[j]);
+      s.version[affected[j]]++;
+      if (findCollapse(&s, affected[j], &next, &links, &scratch))
+        heap.push(next);
+    }
+  }
+
+  for (i = 0, n = 0; i < triangleCount; i++)
+    if (s.alive[i])
+      for (k = 0; k < 3; k++)
+        out[n++] = s.corners[3*i + k];
+  if (error)
+    *error = radius > 0 ? (float) (sqrt(worst) / radius) : 0;
+  return n;
+}
+
+int compactMesh(MeshVertex *out, unsigned int *indices, int indexCount,
+                const MeshVertex *vertices)
+{
+  std::vector<int> remap;
+  int i, count = 0;
+
+  for (i = 0; i < indexCount; i++) {
+    unsigned int v = indices[i];
+
+    if (v >= remap.size())
+      remap.resize(v + 1, -1);
+    if (remap[v] < 0) {
+      remap[v] = count;
+      out[count++] = vertices[v];
+    }
+    indices[i] = (unsigned int) remap[v];
+  }
+  return count;
+}
+
+static bool lessVertex(const MeshVertex &a, const MeshVertex &b)
+{
+  return memcmp(&a, &b, sizeof(MeshVertex)) < 0;
+}
+
+static bool sameVertex(const MeshVertex &a, const MeshVertex &b)
+{
+  return memcmp(&a, &b, sizeof(MeshVertex)) == 0;
+}
+
+int flatShadeMesh(MeshVertex *out, unsigned int *outIndices,
+                  const unsigned int *indices, int indexCount, const MeshVertex *vertices)
+{
+  std::vector<MeshVertex> corners(indexCount), unique;
+  int i, k;
+
+  for (i = 0; i + 2 < indexCount; i += 3) {
+    const MeshVertex *v[3] = { &vertices[indices[i]], &vertices[indices[i+1]],
+                               &vertices[indices[i+2]] };
+    double normal[3], given[3], length;
+
+    cross3(normal, v[0]->position, v[1]->position, v[2]->position);
+    length = sqrt(dot3(normal, normal));
+    for (k = 0; k < 3; k++)
+      given[k] = v[0]->normal[k] + v[1]->normal[k] + v[2]->normal[k];
+    /* Face the way the vertices' own normals do. */
+    if (dot3(normal, given) < 0)
+      length = -length;
+    for (k = 0; k < 3; k++) {
+      int j;
+
+      corners[i+k] = *v[k];
+      /* Rounded, so coplanar triangles share their vertices even when
+         their normals differ in the last bits. */
+      if (length != 0)
+        for (j = 0; j < 3; j++)
+          corners[i+k].normal[j] = (float) (floor(normal[j] / length * 4096 + 0.5) / 4096);
+    }
+  }
+
+  unique = corners;
+  std::sort(unique.begin(), unique.end(), lessVertex);
+  unique.erase(std::unique(unique.begin(), unique.end(), sameVertex), unique.end());
+  for (i = 0; i < indexCount; i++)
+    outIndices[i] = (unsigned int)
+      (std::lower_bound(unique.begin(), unique.end(), corners[i], lessVertex) - unique.begin());
+  std::copy(unique.begin(), unique.end(), out);
+  return (int) unique.size();
+}
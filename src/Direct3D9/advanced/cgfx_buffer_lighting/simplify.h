@@ -0,0 +1,53 @@
+/* simplify.h - Quadric error mesh simplification that keeps attribute seams. */
+
+/* simplifyMesh is Garland and Heckbert's edge collapse: every position
+   gets a quadric, the sum of the squared distances to the planes of the
+   triangles around it, and the cheapest collapses by that measure go
+   first.  Collapses are half-edge collapses: a position moves onto a
+   neighbor and its triangles take the neighbor's vertices, so the result
+   only indexes the input vertices and their normals and texture
+   coordinates stay exactly as they were.
+
+   Vertices at one position with different attributes form a seam.  A
+   position on a seam or on the mesh's border may only slide along that
+   seam or border, onto a neighbor on it, and all its vertices move
+   together, so seams and borders keep their shape and texture
+   coordinates never tear.  Where several seams meet, or the mesh is not
+   manifold, positions stay where they are.  Collapses that would flip a
+   triangle or fold the surface onto itself are skipped.
+
+   Building the quadrics and the first round of collapse costs is split
+   across threads (see parallel.h) for large meshes. */
+
+#ifndef SIMPLIFY_H
+#define SIMPLIFY_H
+
+#include "mesh.h"
+
+/* Simplify triangle list indices[0..indexCount) over vertices until at
+   most targetIndexCount indices remain, or until the next collapse would
+   be further than targetError from the original surface (0 for no
+   limit), and write the remaining triangles to out, which has room for
+   indexCount indices.  Errors are fractions of the mesh's bounding
+   radius (half its box's diagonal).  Returns the number of indices
+   written; *error, if not NULL, receives the largest error of a collapse
+   made. */
+int simplifyMesh(unsigned int *out, const unsigned int *indices, int indexCount,
+                 const MeshVertex *vertices, int vertexCount,
+                 int targetIndexCount, float targetError, float *error);
+
+/* Renumber the vertices indices[0..indexCount) uses in order of first
+   use, copying them to out, and return how many there are. */
+int compactMesh(MeshVertex *out, unsigned int *indices, int indexCount,
+                const MeshVertex *vertices);
+
+/* Give every triangle its face normal, as for a mesh drawn with flat
+   shading: write the vertices to out (room for indexCount) and the new
+   indices to outIndices, with equal vertices shared, and return the
+   number of vertices.  Simplifying such a mesh with its face normals as
+   attributes would find a seam at every edge, so flat meshes are
+   simplified without their normals and given new ones afterwards. */
+int flatShadeMesh(MeshVertex *out, unsigned int *outIndices,
+                  const unsigned int *indices, int indexCount, const MeshVertex *vertices);
+
+#endif /* SIMPLIFY_H */
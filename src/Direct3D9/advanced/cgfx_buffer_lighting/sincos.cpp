@@ -0,0 +1,258 @@
+/* sincos.c - Sine and cosine of many angles at once, at a chosen precision. */
+
+/* x = k*pi/2 + r with k the nearest integer to x*2/pi and |r| <= pi/4.
+   pi/2 is split Cody-Waite style into constants with few enough bits
+   that k times each is exact for |k| < 2^13, so r is accurate to the
+   last bit.  Then, by quadrant (k mod 4):
+
+     k = 0:  sin x =  sin r,  cos x =  cos r
+     k = 1:  sin x =  cos r,  cos x = -sin r
+     k = 2:  sin x = -sin r,  cos x = -cos r
+     k = 3:  sin x = -cos r,  cos x =  sin r
+
+   The polynomials are minimax fits on [-pi/4, pi/4]; the full ones are
+   Cephes' sinf and cosf.  The scalar, SSE, and AVX2 versions evaluate the
+   same expressions, the AVX2 one with fused multiply-adds. */
+
+#include <math.h>
+
+#include "matrix.h"
+#include "sincos.h"
+#include "matrix_simd.h"
+
+#define SINCOS_TWO_OVER_PI  0.636619772367581343f
+#define SINCOS_PIO2_1       1.5703125f
+#define SINCOS_PIO2_2       4.837512969970703125e-4f
+#define SINCOS_PIO2_3       7.54978995489188216e-8f
+#define SINCOS_PIO2_23      4.8382679694e-4f  /* SINCOS_PIO2_2 + SINCOS_PIO2_3 */
+#define SINCOS_MAX_ANGLE    8192.0f
+
+#define SINCOS_FULL_S1     -1.6666654611e-1f
+#define SINCOS_FULL_S2      8.3321608736e-3f
+#define SINCOS_FULL_S3     -1.9515295891e-4f
+#define SINCOS_FULL_C1      4.166664568298827e-2f
+#define SINCOS_FULL_C2     -1.388731625493765e-3f
+#define SINCOS_FULL_C3      2.443315711809948e-5f
+
+#define SINCOS_FAST_S1     -1.6662833806e-1f
+#define SINCOS_FAST_S2      8.1529923330e-3f
+#define SINCOS_FAST_C1     -4.9977630709e-1f
+#define SINCOS_FAST_C2      4.0488935863e-2f
+
+static void sinCosLibm(float x, float *s, float *c)
+{
+  double sine = sin(x), cosine = cos(x);
+
+  *s = (float) sine;
+  *c = (float) cosine;
+}
+
+void sinCos(float x, float *s, float *c, SincosPrecision precision)
+{
+  float k, r, z, sr, cr, sine, cosine;
+  int q;
+
+  if (!(fabs(x) <= SINCOS_MAX_ANGLE)) {
+    sinCosLibm(x, s, c);
+    return;
+  }
+
+  /* Round to nearest; the conversion truncates toward zero. */
+  k = x * SINCOS_TWO_OVER_PI;
+  q = (int) (k < 0 ? k - 0.5f : k + 0.5f);
+  k = (float) q;
+  r = x - k * SINCOS_PIO2_1;
+  if (precision == SINCOS_GRAPHICS) {
+    r = r - k * SINCOS_PIO2_23;
+    z = r * r;
+    sr = r + r * z * (SINCOS_FAST_S1 + z * SINCOS_FAST_S2);
+    cr = 1.0f + z * (SINCOS_FAST_C1 + z * SINCOS_FAST_C2);
+  } else {
+    r = r - k * SINCOS_PIO2_2;
+    r = r - k * SINCOS_PIO2_3;
+    z = r * r;
+    sr = r + r * z * (SINCOS_FULL_S1 + z * (SINCOS_FULL_S2 + z * SINCOS_FULL_S3));
+    cr = 1.0f - 0.5f * z + z * z * (SINCOS_FULL_C1 + z * (SINCOS_FULL_C2 + z * SINCOS_FULL_C3));
+  }
+
+  if (q & 1) {
+    sine = cr;
+    cosine = sr;
+  } else {
+    sine = sr;
+    cosine = cr;
+  }
+  *s = (q & 2) ? -sine : sine;
+  *c = ((q + 1) & 2) ? -cosine : cosine;
+}
+
+static void sinCosArrayScalar(float *s, float *c, const float *x, int count,
+                              SincosPrecision precision)
+{
+  int n;
+
+  for (n=0; n<count; n++)
+    sinCos(x[n], s+n, c+n, precision);
+}
+
+/* Lanes whose angle is out of range (or NaN) are redone with libm.  The
+   angles are saved first since s or c may be the same array as x. */
+static void sinCosFixup(float *s, float *c, const float *angles, int mask, int lanes)
+{
+  int i;
+
+  for (i=0; i<lanes; i++) {
+    if (mask & (1 << i))
+      sinCosLibm(angles[i], s+i, c+i);
+  }
+}
+
+#ifdef MATRIX_HAVE_SSE
+
+MATRIX_TARGET_SSE
+static int sinCosArraySSE(float *s, float *c, const float *x, int count,
+                          SincosPrecision precision)
+{
+  const __m128 twoOverPi = _mm_set1_ps(SINCOS_TWO_OVER_PI),
+               maxAngle = _mm_set1_ps(SINCOS_MAX_ANGLE),
+               absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)),
+               one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f);
+  const __m128i oneBit = _mm_set1_epi32(1), twoBit = _mm_set1_epi32(2);
+  int n;
+
+  for (n=0; n+4<=count; n+=4) {
+    __m128 v = _mm_loadu_ps(x+n);
+    __m128i q = _mm_cvtps_epi32(_mm_mul_ps(v, twoOverPi));
+    __m128 k = _mm_cvtepi32_ps(q);
+    __m128 r = _mm_sub_ps(v, _mm_mul_ps(k, _mm_set1_ps(SINCOS_PIO2_1)));
+    __m128 z, sr, cr, swap, sine, cosine;
+    int bad = _mm_movemask_ps(_mm_cmpnle_ps(_mm_and_ps(v, absMask), maxAngle));
+    float angles[4];
+
+    if (bad)
+      _mm_storeu_ps(angles, v);
+
+    if (precision == SINCOS_GRAPHICS) {
+      r = _mm_sub_ps(r, _mm_mul_ps(k, _mm_set1_ps(SINCOS_PIO2_23)));
+      z = _mm_mul_ps(r, r);
+      sr = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, z),
+             _mm_add_ps(_mm_set1_ps(SINCOS_FAST_S1), _mm_mul_ps(z, _mm_set1_ps(SINCOS_FAST_S2)))));
+      cr = _mm_add_ps(one, _mm_mul_ps(z,
+             _mm_add_ps(_mm_set1_ps(SINCOS_FAST_C1), _mm_mul_ps(z, _mm_set1_ps(SINCOS_FAST_C2)))));
+    } else {
+      r = _mm_sub_ps(r, _mm_mul_ps(k, _mm_set1_ps(SINCOS_PIO2_2)));
+      r = _mm_sub_ps(r, _mm_mul_ps(k, _mm_set1_ps(SINCOS_PIO2_3)));
+      z = _mm_mul_ps(r, r);
+      sr = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, z),
+             _mm_add_ps(_mm_set1_ps(SINCOS_FULL_S1), _mm_mul_ps(z,
+               _mm_add_ps(_mm_set1_ps(SINCOS_FULL_S2), _mm_mul_ps(z, _mm_set1_ps(SINCOS_FULL_S3)))))));
+      cr = _mm_add_ps(_mm_sub_ps(one, _mm_mul_ps(half, z)), _mm_mul_ps(_mm_mul_ps(z, z),
+             _mm_add_ps(_mm_set1_ps(SINCOS_FULL_C1), _mm_mul_ps(z,
+               _mm_add_ps(_mm_set1_ps(SINCOS_FULL_C2), _mm_mul_ps(z, _mm_set1_ps(SINCOS_FULL_C3)))))));
+    }
+
+    swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, oneBit), oneBit));
+    sine = _mm_or_ps(_mm_and_ps(swap, cr), _mm_andnot_ps(swap, sr));
+    cosine = _mm_or_ps(_mm_and_ps(swap, sr), _mm_andnot_ps(swap, cr));
+    sine = _mm_xor_ps(sine, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, twoBit), 30)));
+    cosine = _mm_xor_ps(cosine, _mm_castsi128_ps(
+               _mm_slli_epi32(_mm_and_si128(_mm_add_epi32(q, oneBit), twoBit), 30)));
+    _mm_storeu_ps(s+n, sine);
+    _mm_storeu_ps(c+n, cosine);
+
+    if (bad)
+      sinCosFixup(s+n, c+n, angles, bad, 4);
+  }
+  return n;
+}
+
+#endif /* MATRIX_HAVE_SSE */
+
+#ifdef MATRIX_HAVE_AVX2
+
+MATRIX_TARGET_AVX2
+static int sinCosArrayAVX2(float *s, float *c, const float *x, int count,
+                           SincosPrecision precision)
+{
+  const __m256 twoOverPi = _mm256_set1_ps(SINCOS_TWO_OVER_PI),
+               maxAngle = _mm256_set1_ps(SINCOS_MAX_ANGLE),
+               absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff)),
+               one = _mm256_set1_ps(1.0f), half = _mm256_set1_ps(0.5f);
+  const __m256i oneBit = _mm256_set1_epi32(1), twoBit = _mm256_set1_epi32(2);
+  int n;
+
+  for (n=0; n+8<=count; n+=8) {
+    __m256 v = _mm256_loadu_ps(x+n);
+    __m256i q = _mm256_cvtps_epi32(_mm256_mul_ps(v, twoOverPi));
+    __m256 k = _mm256_cvtepi32_ps(q);
+    __m256 r = _mm256_fnmadd_ps(k, _mm256_set1_ps(SINCOS_PIO2_1), v);
+    __m256 z, sr, cr, swap, sine, cosine;
+    int bad = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_and_ps(v, absMask), maxAngle, _CMP_NLE_UQ));
+    float angles[8];
+
+    if (bad)
+      _mm256_storeu_ps(angles, v);
+
+    if (precision == SINCOS_GRAPHICS) {
+      r = _mm256_fnmadd_ps(k, _mm256_set1_ps(SINCOS_PIO2_23), r);
+      z = _mm256_mul_ps(r, r);
+      sr = _mm256_fmadd_ps(_mm256_mul_ps(r, z),
+             _mm256_fmadd_ps(z, _mm256_set1_ps(SINCOS_FAST_S2), _mm256_set1_ps(SINCOS_FAST_S1)), r);
+      cr = _mm256_fmadd_ps(z,
+             _mm256_fmadd_ps(z, _mm256_set1_ps(SINCOS_FAST_C2), _mm256_set1_ps(SINCOS_FAST_C1)), one);
+    } else {
+      r = _mm256_fnmadd_ps(k, _mm256_set1_ps(SINCOS_PIO2_2), r);
+      r = _mm256_fnmadd_ps(k, _mm256_set1_ps(SINCOS_PIO2_3), r);
+      z = _mm256_mul_ps(r, r);
+      sr = _mm256_fmadd_ps(_mm256_mul_ps(r, z),
+             _mm256_fmadd_ps(z,
+               _mm256_fmadd_ps(z, _mm256_set1_ps(SINCOS_FULL_S3), _mm256_set1_ps(SINCOS_FULL_S2)),
+               _mm256_set1_ps(SINCOS_FULL_S1)), r);
+      cr = _mm256_fmadd_ps(_mm256_mul_ps(z, z),
+             _mm256_fmadd_ps(z,
+               _mm256_fmadd_ps(z, _mm256_set1_ps(SINCOS_FULL_C3), _mm256_set1_ps(SINCOS_FULL_C2)),
+               _mm256_set1_ps(SINCOS_FULL_C1)),
+             _mm256_fnmadd_ps(half, z, one));
+    }
+
+    swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(q, oneBit), oneBit));
+    sine = _mm256_blendv_ps(sr, cr, swap);
+    cosine = _mm256_blendv_ps(cr, sr, swap);
+    sine = _mm256_xor_ps(sine, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(q, twoBit), 30)));
+    cosine = _mm256_xor_ps(cosine, _mm256_castsi256_ps(
+               _mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(q, oneBit), twoBit), 30)));
+    _mm256_storeu_ps(s+n, sine);
+    _mm256_storeu_ps(c+n, cosine);
+
+    if (bad)
+      sinCosFixup(s+n, c+n, angles, bad, 8);
+  }
+  return n;
+}
+
+#endif /* MATRIX_HAVE_AVX2 */
+
+void sinCosArray(float *s, float *c, const float *x, int count,
+                 SincosPrecision precision)
+{
+  int done = 0;
+
+  if (count <= 0)
+    return;
+
+  switch (getMatrixSimdLevel()) {
+#ifdef MATRIX_HAVE_AVX2
+  case MATRIX_SIMD_AVX2:
+    done = sinCosArrayAVX2(s, c, x, count, precision);
+    break;
+#endif
+#ifdef MATRIX_HAVE_SSE
+  case MATRIX_SIMD_SSE:
+    done = sinCosArraySSE(s, c, x, count, precision);
+    break;
+#endif
+  default:
+    break;
+  }
+  sinCosArrayScalar(s + done, c + done, x + done, count - done, precision);
+}
@@ -0,0 +1,36 @@
+/* sincos.h - Sine and cosine of many angles at once, at a chosen precision. */
+
+/* Replaces one libm sin and one cos call per element in loops that
+   tessellate or animate thousands of vertices.  The angle is reduced to
+   [-pi/4, pi/4] around the nearest multiple of pi/2, and a short
+   polynomial is evaluated for four (SSE) or eight (AVX2) angles at a time,
+   at the level chosen by setMatrixSimdLevel (see matrix.h).
+
+   Error bounds are absolute, measured against double precision sin and
+   cos over |x| <= 8192 radians:
+
+     SINCOS_FULL      1e-7 (under 2 ulp near 1).
+
+     SINCOS_GRAPHICS  1.3e-5, with a shorter polynomial; plenty for vertex
+                      positions, normals, and colors.
+
+   Angles beyond 8192 radians, infinities, and NaNs get libm's answer at
+   either precision. */
+
+#ifndef SINCOS_H
+#define SINCOS_H
+
+typedef enum {
+  SINCOS_FULL     = 0,
+  SINCOS_GRAPHICS = 1
+} SincosPrecision;
+
+/* *s = sin(x), *c = cos(x). */
+void sinCos(float x, float *s, float *c, SincosPrecision precision);
+
+/* s[i] = sin(x[i]), c[i] = cos(x[i]) for count angles in radians.
+   Either output may be the same array as x. */
+void sinCosArray(float *s, float *c, const float *x, int count,
+                 SincosPrecision precision);
+
+#endif /* SINCOS_H */
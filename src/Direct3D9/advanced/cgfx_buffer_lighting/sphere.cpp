@@ -0,0 +1,137 @@
+/* sphere.c - Indexed sphere meshes ordered for the post-transform vertex cache. */
+
+/* The triangles are first emitted with "grid" vertex numbers: 0 for the
+   north pole, 1 + (ring-1)*slices + slice for the ring vertices, and the
+   last number for the south pole.  A second pass renumbers them in order
+   of first use and writes each vertex's position from tables of the ring
+   and slice sines and cosines, so sinCosArray runs once per ring and
+   slice instead of several times per triangle. */
+
+#include <assert.h>
+#include <vector>
+
+#include "sphere.h"
+#include "sincos.h"
+
+static const double myPi = 3.14159265358979323846;
+
+/* Quads per column: the two rings of a column, 2*(7+1) vertices, fill a
+   16-entry cache. */
+#define SPHERE_COLUMN 7
+
+int getSphereVertexCount(int slices, int stacks)
+{
+  assert(slices >= 3 && stacks >= 2);
+  return 2 + (stacks - 1) * slices;
+}
+
+int getSphereIndexCount(int slices, int stacks)
+{
+  assert(slices >= 3 && stacks >= 2);
+  /* One triangle per quad in the two polar bands, two elsewhere. */
+  return 3 * (2 * slices + 2 * slices * (stacks - 2));
+}
+
+/* Grid number of slice x (taken modulo slices) of ring k, where ring 0
+   and ring stacks are the poles. */
+static int gridVertex(int k, int x, int slices, int stacks)
+{
+  if (k == 0)
+    return 0;
+  if (k == stacks)
+    return 1 + (stacks - 1) * slices;
+  return 1 + (k - 1) * slices + x % slices;
+}
+
+template <typename Index>
+static Index *emitTriangle(Index *p, int a, int b, int c)
+{
+  p[0] = (Index) a;
+  p[1] = (Index) b;
+  p[2] = (Index) c;
+  return p + 3;
+}
+
+template <typename Index>
+static void sphereMesh(float *xyz, Index *indices, float radius, int slices, int stacks)
+{
+  int vertexCount = getSphereVertexCount(slices, stacks),
+      indexCount = getSphereIndexCount(slices, stacks);
+  std::vector<int> gridToVertex(vertexCount, -1), vertexToGrid(vertexCount);
+  std::vector<float> theta(slices), sinTheta(slices), cosTheta(slices),
+                     phi(stacks + 1), sinPhi(stacks + 1), cosPhi(stacks + 1);
+  Index *p = indices;
+  int column, k, x, i, n;
+
+  /* Triangles in grid numbers, clockwise from outside: quad (k, x) is
+     a = (k, x), b = (k+1, x), c = (k+1, x+1), d = (k, x+1), split into
+     abc and acd, and the polar bands keep the one that isn't degenerate. */
+  for (column = 0; column < slices; column += SPHERE_COLUMN) {
+    int end = column + SPHERE_COLUMN < slices ? column + SPHERE_COLUMN : slices;
+
+    for (k = 0; k < stacks; k++) {
+      for (x = column; x < end; x++) {
+        int a = gridVertex(k, x, slices, stacks),
+            b = gridVertex(k+1, x, slices, stacks),
+            c = gridVertex(k+1, x+1, slices, stacks),
+            d = gridVertex(k, x+1, slices, stacks);
+
+        if (k != stacks - 1)
+          p = emitTriangle(p, a, b, c);
+        if (k != 0)
+          p = emitTriangle(p, a, c, d);
+      }
+    }
+  }
+  assert(p == indices + indexCount);
+
+  /* Renumber by first use. */
+  n = 0;
+  for (i = 0; i < indexCount; i++) {
+    int g = (int) indices[i];
+
+    if (gridToVertex[g] < 0) {
+      gridToVertex[g] = n;
+      vertexToGrid[n++] = g;
+    }
+    indices[i] = (Index) gridToVertex[g];
+  }
+  assert(n == vertexCount);
+
+  for (x = 0; x < slices; x++)
+    theta[x] = (float) (2 * myPi * x / slices);
+  for (k = 0; k <= stacks; k++)
+    phi[k] = (float) (myPi * k / stacks);
+  sinCosArray(&sinTheta[0], &cosTheta[0], &theta[0], slices, SINCOS_FULL);
+  sinCosArray(&sinPhi[0], &cosPhi[0], &phi[0], stacks + 1, SINCOS_FULL);
+
+  for (i = 0; i < vertexCount; i++) {
+    int g = vertexToGrid[i];
+    float *v = xyz + i*3;
+
+    if (g == 0 || g == vertexCount - 1) {
+      v[0] = 0;
+      v[1] = g == 0 ? radius : -radius;
+      v[2] = 0;
+    } else {
+      k = 1 + (g - 1) / slices;
+      x = (g - 1) % slices;
+      v[0] = radius * sinPhi[k] * cosTheta[x];
+      v[1] = radius * cosPhi[k];
+      v[2] = radius * sinPhi[k] * sinTheta[x];
+    }
+  }
+}
+
+void makeSphere(float *xyz, unsigned int *indices,
+                float radius, int slices, int stacks)
+{
+  sphereMesh(xyz, indices, radius, slices, stacks);
+}
+
+void makeSphere16(float *xyz, unsigned short *indices,
+                  float radius, int slices, int stacks)
+{
+  assert(getSphereVertexCount(slices, stacks) <= 65536);
+  sphereMesh(xyz, indices, radius, slices, stacks);
+}
@@ -0,0 +1,34 @@
+/* sphere.h - Indexed sphere meshes ordered for the post-transform vertex cache. */
+
+/* A sphere of slices (around the Y axis) by stacks (pole to pole) has one
+   vertex at each pole and slices vertices on each of the stacks-1 rings
+   between them, shared by every triangle that touches it.  Positions are
+   3 floats, like a D3DFVF_XYZ vertex; the shader derives the normal from
+   the position.
+
+   Triangles are clockwise seen from outside the sphere, Direct3D's
+   default front face.  They are emitted in columns of 7 quads, each
+   column from the north pole to the south pole, so the two rings of a
+   column (16 vertices) stay in a 16-entry post-transform vertex cache
+   while it is drawn.  Vertices are numbered in the order the triangles
+   first use them, so vertex fetches also walk forward through memory. */
+
+#ifndef SPHERE_H
+#define SPHERE_H
+
+/* Vertices and indices (three per triangle) of a sphere with at least 3
+   slices and 2 stacks. */
+int getSphereVertexCount(int slices, int stacks);
+int getSphereIndexCount(int slices, int stacks);
+
+/* Fill xyz with getSphereVertexCount positions (3 floats each) and
+   indices with getSphereIndexCount indices of a sphere of the given
+   radius centered at the origin. */
+void makeSphere(float *xyz, unsigned int *indices,
+                float radius, int slices, int stacks);
+
+/* Same with 16-bit indices, for spheres of at most 65536 vertices. */
+void makeSphere16(float *xyz, unsigned short *indices,
+                  float radius, int slices, int stacks);
+
+#endif /* SPHERE_H */
@@ -0,0 +1,303 @@
+/* stripify.c - Triangle strips from indexed triangle lists, and picking the cheapest topology. */
+
+/* Triangle k of a strip s is s[k], s[k+1], s[k+2] with its winding
+   flipped when k is odd, so it holds the directed edge s[k] -> s[k+1]
+   when k is even and s[k+1] -> s[k] when k is odd.  Extending a strip
+   by one triangle is therefore a lookup of an unused triangle by directed
+   edge, whose third vertex becomes the next index. */
+
+#include <assert.h>
+#include <algorithm>
+#include <vector>
+
+#include "stripify.h"
+
+typedef struct {
+  unsigned int from, to;
+  int triangle;
+} DirectedEdge;
+
+static bool lessEdge(const DirectedEdge &a, const DirectedEdge &b)
+{
+  return a.from != b.from ? a.from < b.from : a.to < b.to;
+}
+
+typedef struct {
+  const unsigned int *indices;
+  std::vector<DirectedEdge> edges;   /* Sorted by (from, to) */
+  std::vector<int> used;             /* Per triangle: taken by a strip, or degenerate */
+} Stripifier;
+
+/* An unused triangle holding from -> to, or -1. */
+static int findTriangle(const Stripifier *s, unsigned int from, unsigned int to)
+{
+  DirectedEdge key;
+  std::vector<DirectedEdge>::const_iterator e;
+
+  key.from = from;
+  key.to = to;
+  for (e = std::lower_bound(s->edges.begin(), s->edges.end(), key, lessEdge);
+       e != s->edges.end() && e->from == from && e->to == to; ++e)
+    if (!s->used[e->triangle])
+      return e->triangle;
+  return -1;
+}
+
+/* The vertex of triangle t after "to". */
+static unsigned int thirdVertex(const Stripifier *s, int t, unsigned int to)
+{
+  const unsigned int *v = s->indices + 3*t;
+
+  return v[0] == to ? v[1] : v[1] == to ? v[2] : v[0];
+}
+
+/* Walk a strip of up to maxTriangles from triangle t, entered at
+   rotation, marking the triangles it takes as used and appending them to
+   taken.  Appends the strip to out if out is not NULL; returns the number
+   of triangles. */
+static int walkStrip(Stripifier *s, int t, int rotation, int maxTriangles,
+                     std::vector<int> *taken, std::vector<unsigned int> *out)
+{
+  const unsigned int *v = s->indices + 3*t;
+  unsigned int p = v[(rotation + 1) % 3], q = v[(rotation + 2) % 3];
+  int k;
+
+  if (out) {
+    out->push_back(v[rotation]);
+    out->push_back(p);
+    out->push_back(q);
+  }
+  s->used[t] = 1;
+  taken->push_back(t);
+  for (k = 1; k < maxTriangles; k++) {
+    int next = k % 2 == 0 ? findTriangle(s, p, q) : findTriangle(s, q, p);
+    unsigned int x;
+
+    if (next < 0)
+      break;
+    x = thirdVertex(s, next, k % 2 == 0 ? q : p);
+    s->used[next] = 1;
+    taken->push_back(next);
+    if (out)
+      out->push_back(x);
+    p = q;
+    q = x;
+  }
+  return k;
+}
+
+int listTriangles(unsigned int *list, PrimitiveTopology topology,
+                  const unsigned int *indices, int indexCount)
+{
+  unsigned int *p = list;
+  int i, start = 0;
+
+  for (i = 0; i < indexCount; i++) {
+    unsigned int a, b, c = indices[i];
+
+    if (c == STRIP_RESTART_INDEX) {
+      start = i + 1;
+      continue;
+    }
+    if (topology == PRIMITIVE_TRIANGLE_LIST) {
+      if (i % 3 != 2)
+        continue;
+      a = indices[i-2];
+      b = indices[i-1];
+    } else if (i - start < 2) {
+      continue;
+    } else if (topology == PRIMITIVE_TRIANGLE_FAN) {
+      a = indices[start];
+      b = indices[i-1];
+    } else if ((i - start) % 2 == 0) {
+      a = indices[i-2];
+      b = indices[i-1];
+    } else {
+      /* Odd strip triangles are flipped. */
+      a = indices[i-1];
+      b = indices[i-2];
+    }
+    if (a == b || b == c || c == a)
+      continue;
+    p[0] = a;
+    p[1] = b;
+    p[2] = c;
+    p += 3;
+  }
+  return (int) (p - list);
+}
+
+int getMaxStripIndexCount(int triangleCount)
+{
+  /* At worst every strip is one triangle plus three joining indices. */
+  return triangleCount > 0 ? 6 * triangleCount : 0;
+}
+
+int stripifyTriangles(unsigned int *strip, const unsigned int *indices, int indexCount,
+                      PrimitiveTopology topology, int cacheSize)
+{
+  const int triangleCount = indexCount / 3,
+            maxTriangles = cacheSize > 2 ? cacheSize - 2 : triangleCount;
+  Stripifier s;
+  std::vector<unsigned int> out, piece;
+  std::vector<int> taken;
+  int t, i;
+
+  assert(topology == PRIMITIVE_TRIANGLE_STRIP || topology == PRIMITIVE_TRIANGLE_STRIP_RESTART);
+  s.indices = indices;
+  s.used.assign(triangleCount, 0);
+  for (t = 0; t < triangleCount; t++) {
+    const unsigned int *v = indices + 3*t;
+
+    if (v[0] == v[1] || v[1] == v[2] || v[2] == v[0]) {
+      s.used[t] = -1;
+      continue;
+    }
+    for (i = 0; i < 3; i++) {
+      DirectedEdge e;
+
+      e.from = v[i];
+      e.to = v[(i + 1) % 3];
+      e.triangle = t;
+      s.edges.push_back(e);
+    }
+  }
+  std::stable_sort(s.edges.begin(), s.edges.end(), lessEdge);
+
+  for (t = 0; t < triangleCount; t++) {
+    int best = 0, bestLength = 0, rotation;
+
+    if (s.used[t])
+      continue;
+
+    /* Try all three ways into the triangle and keep the longest walk. */
+    for (rotation = 0; rotation < 3; rotation++) {
+      int length;
+      size_t j;
+
+      taken.clear();
+      length = walkStrip(&s, t, rotation, maxTriangles, &taken, NULL);
+      for (j = 0; j < taken.size(); j++)
+        s.used[taken[j]] = 0;
+      if (length > bestLength) {
+        best = rotation;
+        bestLength = length;
+      }
+    }
+    piece.clear();
+    walkStrip(&s, t, best, maxTriangles, &taken, &piece);
+
+    if (!out.empty()) {
+      if (topology == PRIMITIVE_TRIANGLE_STRIP_RESTART) {
+        out.push_back(STRIP_RESTART_INDEX);
+      } else {
+        /* Repeat the last index and the next first one; one more repeat
+           when needed starts the piece on an even triangle. */
+        if (out.size() % 2 == 1)
+          out.push_back(out.back());
+        out.push_back(out.back());
+        out.push_back(piece[0]);
+      }
+    }
+    out.insert(out.end(), piece.begin(), piece.end());
+  }
+
+  assert((int) out.size() <= getMaxStripIndexCount(triangleCount));
+  std::copy(out.begin(), out.end(), strip);
+  return (int) out.size();
+}
+
+void getDefaultPrimitiveCostModel(PrimitiveCostModel *model)
+{
+  model->shaderRun = 1;
+  model->index = 0.125;
+  model->drawCall = 1000;
+  model->cacheSize = 16;
+  model->allowRestart = 0;
+}
+
+void measurePrimitives(PrimitiveStats *stats, PrimitiveTopology topology,
+                       const unsigned int *indices, int indexCount, int drawCalls,
+                       const PrimitiveCostModel *model)
+{
+  std::vector<unsigned int> cache(model->cacheSize, STRIP_RESTART_INDEX), seen;
+  int head = 0, i, start = 0;
+
+  stats->topology = topology;
+  stats->indexCount = indexCount;
+  stats->triangleCount = stats->degenerateCount = 0;
+  stats->shaderRuns = 0;
+  stats->drawCalls = drawCalls;
+
+  for (i = 0; i < indexCount; i++) {
+    unsigned int v = indices[i];
+    int j;
+
+    if (v == STRIP_RESTART_INDEX) {
+      start = i + 1;
+      continue;
+    }
+    seen.push_back(v);
+    for (j = 0; j < model->cacheSize; j++)
+      if (cache[j] == v)
+        break;
+    if (j == model->cacheSize) {
+      if (model->cacheSize > 0) {
+        cache[head] = v;
+        head = (head + 1) % model->cacheSize;
+      }
+      stats->shaderRuns++;
+    }
+
+    /* Count the triangle that ends at this index. */
+    if (topology == PRIMITIVE_TRIANGLE_LIST ? i % 3 == 2 : i - start >= 2) {
+      unsigned int a = indices[topology == PRIMITIVE_TRIANGLE_FAN ? start : i-2],
+                   b = indices[i-1];
+
+      if (a == b || b == v || v == a)
+        stats->degenerateCount++;
+      else
+        stats->triangleCount++;
+    }
+  }
+
+  std::sort(seen.begin(), seen.end());
+  stats->vertexCount = (int) (std::unique(seen.begin(), seen.end()) - seen.begin());
+  stats->cost = model->shaderRun * stats->shaderRuns + model->index * indexCount +
+                model->drawCall * drawCalls;
+}
+
+int optimizePrimitives(unsigned int *out, PrimitiveStats *stats,
+                       const unsigned int *indices, int indexCount,
+                       const PrimitiveCostModel *model)
+{
+  std::vector<unsigned int> strip(getMaxStripIndexCount(indexCount / 3));
+  PrimitiveStats candidate;
+  int length, topology;
+
+  measurePrimitives(stats, PRIMITIVE_TRIANGLE_LIST, indices, indexCount, 1, model);
+  std::copy(indices, indices + indexCount, out);
+  length = indexCount;
+
+  for (topology = PRIMITIVE_TRIANGLE_STRIP; topology <= PRIMITIVE_TRIANGLE_STRIP_RESTART; topology++) {
+    int pass;
+
+    if (topology == PRIMITIVE_TRIANGLE_STRIP_RESTART && !model->allowRestart)
+      break;
+    if (strip.empty())
+      break;
+    /* Cache-sized pieces, then pieces as long as possible. */
+    for (pass = 0; pass < 2; pass++) {
+      int n = stripifyTriangles(&strip[0], indices, indexCount, (PrimitiveTopology) topology,
+                                pass == 0 ? model->cacheSize : 0);
+
+      measurePrimitives(&candidate, (PrimitiveTopology) topology, &strip[0], n, 1, model);
+      if (candidate.cost < stats->cost) {
+        *stats = candidate;
+        std::copy(strip.begin(), strip.begin() + n, out);
+        length = n;
+      }
+    }
+  }
+  return length;
+}
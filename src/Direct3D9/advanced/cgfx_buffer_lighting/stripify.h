@@ -0,0 +1,91 @@
+/* stripify.h - Triangle strips from indexed triangle lists, and picking the cheapest topology. */
+
+/* stripifyTriangles turns any indexed triangle list into one triangle
+   strip: it walks from triangle to neighboring triangle across shared
+   edges as long as it can, then starts a new strip at the next unused
+   triangle in list order (so a list already ordered for the vertex cache
+   keeps its locality) and stitches the pieces together, either with
+   repeated indices, whose degenerate triangles draw nothing, or with the
+   strip-restart index of Direct3D 10 and later and OpenGL.  Every
+   triangle keeps its winding, so culling still works.
+
+   measurePrimitives reports what drawing an index stream costs: indices,
+   real and degenerate triangles, vertex shader runs with a FIFO
+   post-transform cache, and draw calls.  optimizePrimitives stripifies a
+   list with and without the cache limit, measures the list and the
+   strips with a cost model, and keeps whichever is cheapest, so any mesh,
+   including one drawn as many small strips, takes a single draw call. */
+
+#ifndef STRIPIFY_H
+#define STRIPIFY_H
+
+typedef enum {
+  PRIMITIVE_TRIANGLE_LIST          = 0,
+  /* Strips joined by repeated indices; Direct3D 9 can draw these. */
+  PRIMITIVE_TRIANGLE_STRIP         = 1,
+  /* Strips separated by STRIP_RESTART_INDEX. */
+  PRIMITIVE_TRIANGLE_STRIP_RESTART = 2,
+  /* Only measured and listed, never produced. */
+  PRIMITIVE_TRIANGLE_FAN           = 3
+} PrimitiveTopology;
+
+#define STRIP_RESTART_INDEX 0xffffffffu
+
+/* Write the triangles that indices[0..indexCount) draws as topology to
+   list as a triangle list with the same windings, leaving out degenerate
+   ones, and return the list's length (at most 3*indexCount). */
+int listTriangles(unsigned int *list, PrimitiveTopology topology,
+                  const unsigned int *indices, int indexCount);
+
+/* Most indices stripifyTriangles writes for triangleCount triangles. */
+int getMaxStripIndexCount(int triangleCount);
+
+/* Write triangle list indices[0..indexCount) as one strip of topology
+   PRIMITIVE_TRIANGLE_STRIP or PRIMITIVE_TRIANGLE_STRIP_RESTART and return
+   its length.  Triangles with a repeated vertex are dropped.  With a
+   cacheSize, no piece is longer than cacheSize-2 triangles, so its
+   vertices are all still cached when the next piece, usually the next
+   row of a cache-ordered mesh, starts; 0 makes pieces as long as the
+   mesh allows, which needs the fewest indices. */
+int stripifyTriangles(unsigned int *strip, const unsigned int *indices, int indexCount,
+                      PrimitiveTopology topology, int cacheSize);
+
+typedef struct {
+  PrimitiveTopology topology;
+  int indexCount;
+  int triangleCount;     /* Triangles that draw something */
+  int degenerateCount;   /* Triangles with a repeated vertex */
+  int vertexCount;       /* Distinct vertices referenced */
+  int shaderRuns;        /* Vertex shader runs with the model's cache */
+  int drawCalls;
+  double cost;           /* By the cost model */
+} PrimitiveStats;
+
+/* Relative costs; only their ratios matter. */
+typedef struct {
+  double shaderRun;      /* One vertex shader run */
+  double index;          /* Fetching one index */
+  double drawCall;       /* One Draw*Primitive call */
+  int cacheSize;         /* Post-transform cache entries, FIFO */
+  int allowRestart;      /* Consider PRIMITIVE_TRIANGLE_STRIP_RESTART */
+} PrimitiveCostModel;
+
+/* A 16-entry cache, a shader run worth 8 index fetches, a draw call
+   worth 1000 shader runs, and no strip restart (Direct3D 9). */
+void getDefaultPrimitiveCostModel(PrimitiveCostModel *model);
+
+/* Measure drawing indices[0..indexCount) as topology with drawCalls
+   calls.  An unindexed draw of n vertices is the index stream 0..n-1. */
+void measurePrimitives(PrimitiveStats *stats, PrimitiveTopology topology,
+                       const unsigned int *indices, int indexCount, int drawCalls,
+                       const PrimitiveCostModel *model);
+
+/* Write the cheapest single-call form of triangle list
+   indices[0..indexCount) to out, which has room for
+   getMaxStripIndexCount(indexCount/3) indices, describe it in stats, and
+   return its length. */
+int optimizePrimitives(unsigned int *out, PrimitiveStats *stats,
+                       const unsigned int *indices, int indexCount,
+                       const PrimitiveCostModel *model);
+
+#endif /* STRIPIFY_H */
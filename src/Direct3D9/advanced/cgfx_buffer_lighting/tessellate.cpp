@@ -0,0 +1,263 @@
+/* tessellate.c - Indexed meshes of parametric surfaces, evaluated in parallel and cached. */
+
+#include <assert.h>
+#include <string.h>
+#include <vector>
+
+#include "matrix.h"
+#include "tessellate.h"
+#include "parallel.h"
+#include "sincos.h"
+
+static const double myPi = 3.14159265358979323846;
+
+/* Quads per column; see tessellate.h. */
+#define SURFACE_COLUMN 7
+
+/* Vertices below which evaluating on more threads is not worth it. */
+static const int myEvaluateMinPerThread = 4096;
+
+int getSurfaceIndexCount(int uSteps, int vSteps, SurfaceTopology topology)
+{
+  int columns, rows;
+
+  assert(uSteps >= 1 && vSteps >= 1);
+  if (topology == SURFACE_TRIANGLE_LIST)
+    return 6 * uSteps * vSteps;
+
+  /* Each row of a column is 2*(quads+1) indices, and consecutive rows are
+     joined by 2 repeated ones. */
+  columns = (uSteps + SURFACE_COLUMN - 1) / SURFACE_COLUMN;
+  rows = columns * vSteps;
+  return 2 * vSteps * (uSteps + columns) + 2 * (rows - 1);
+}
+
+typedef struct {
+  const ParametricSurface *surface;
+  SurfaceVertex *vertices;
+  int uSteps, vSteps;
+} EvaluateJob;
+
+struct EvaluateTask
+{
+  const EvaluateJob *job;
+
+  void operator()(int begin, int end) const
+  {
+    const EvaluateJob *j = job;
+    const int rowLength = j->uSteps + 1;
+    float u[SURFACE_BATCH], v[SURFACE_BATCH];
+    int first, i;
+
+    for (first = begin; first < end; first += SURFACE_BATCH) {
+      int count = end - first < SURFACE_BATCH ? end - first : SURFACE_BATCH;
+
+      for (i = 0; i < count; i++) {
+        SurfaceVertex *out = j->vertices + first + i;
+
+        u[i] = (float) ((first + i) % rowLength) / j->uSteps;
+        v[i] = (float) ((first + i) / rowLength) / j->vSteps;
+        out->texCoord[0] = u[i];
+        out->texCoord[1] = v[i];
+      }
+      j->surface->evaluate(j->vertices + first, u, v, count, j->surface->params);
+    }
+  }
+};
+
+static unsigned int *emit(unsigned int *p, int a, int b, int c)
+{
+  p[0] = (unsigned int) a;
+  p[1] = (unsigned int) b;
+  p[2] = (unsigned int) c;
+  return p + 3;
+}
+
+static void surfaceIndices(unsigned int *indices, int uSteps, int vSteps, SurfaceTopology topology)
+{
+  const int rowLength = uSteps + 1;
+  unsigned int *p = indices;
+  int column, i, j;
+
+  for (column = 0; column < uSteps; column += SURFACE_COLUMN) {
+    int end = column + SURFACE_COLUMN < uSteps ? column + SURFACE_COLUMN : uSteps;
+
+    for (j = 0; j < vSteps; j++) {
+      if (topology == SURFACE_TRIANGLE_LIST) {
+        /* Quad a = (i, j), b = (i, j+1), c = (i+1, j+1), d = (i+1, j),
+           split along bd like the strip. */
+        for (i = column; i < end; i++) {
+          int a = j*rowLength + i, b = a + rowLength, c = b + 1, d = a + 1;
+
+          p = emit(p, a, b, d);
+          p = emit(p, d, b, c);
+        }
+      } else {
+        /* Join to the previous row: its last index again, then this
+           row's first. */
+        if (p != indices) {
+          p[0] = p[-1];
+          p[1] = (unsigned int) (j*rowLength + column);
+          p += 2;
+        }
+        for (i = column; i <= end; i++) {
+          p[0] = (unsigned int) (j*rowLength + i);
+          p[1] = (unsigned int) ((j+1)*rowLength + i);
+          p += 2;
+        }
+      }
+    }
+  }
+  assert(p == indices + getSurfaceIndexCount(uSteps, vSteps, topology));
+}
+
+void tessellateSurface(SurfaceMesh *mesh, const ParametricSurface *surface,
+                       int uSteps, int vSteps, SurfaceTopology topology)
+{
+  EvaluateJob job;
+  EvaluateTask task;
+
+  assert(uSteps >= 1 && vSteps >= 1);
+  mesh->uSteps = uSteps;
+  mesh->vSteps = vSteps;
+  mesh->topology = topology;
+  mesh->vertexCount = (uSteps + 1) * (vSteps + 1);
+  mesh->vertices = new SurfaceVertex[mesh->vertexCount];
+  mesh->indexCount = getSurfaceIndexCount(uSteps, vSteps, topology);
+  mesh->indices = new unsigned int[mesh->indexCount];
+
+  job.surface = surface;
+  job.vertices = mesh->vertices;
+  job.uSteps = uSteps;
+  job.vSteps = vSteps;
+  task.job = &job;
+
+  /* Resolve the sinCosArray kernel before any worker thread asks for it. */
+  getMatrixSimdLevel();
+  parallelFor(mesh->vertexCount, myEvaluateMinPerThread, SURFACE_BATCH, task);
+  surfaceIndices(mesh->indices, uSteps, vSteps, topology);
+}
+
+void freeSurfaceMesh(SurfaceMesh *mesh)
+{
+  delete [] mesh->vertices;
+  delete [] mesh->indices;
+  mesh->vertices = 0;
+  mesh->indices = 0;
+  mesh->vertexCount = mesh->indexCount = 0;
+}
+
+/* Cache */
+
+typedef struct {
+  SurfaceFunction evaluate;
+  std::vector<unsigned char> params;
+  SurfaceMesh *mesh;
+} CachedSurfaceMesh;
+
+static std::vector<CachedSurfaceMesh> myCache;
+
+static bool sameSurfaceMesh(const CachedSurfaceMesh &entry, const ParametricSurface *surface,
+                            int uSteps, int vSteps, SurfaceTopology topology)
+{
+  return entry.evaluate == surface->evaluate &&
+         entry.mesh->uSteps == uSteps && entry.mesh->vSteps == vSteps &&
+         entry.mesh->topology == topology &&
+         (int) entry.params.size() == surface->paramsSize &&
+         (surface->paramsSize == 0 ||
+          !memcmp(&entry.params[0], surface->params, surface->paramsSize));
+}
+
+const SurfaceMesh *getSurfaceMesh(const ParametricSurface *surface,
+                                  int uSteps, int vSteps, SurfaceTopology topology)
+{
+  CachedSurfaceMesh entry;
+  const unsigned char *params = (const unsigned char *) surface->params;
+  size_t i;
+
+  for (i = 0; i < myCache.size(); i++)
+    if (sameSurfaceMesh(myCache[i], surface, uSteps, vSteps, topology))
+      return myCache[i].mesh;
+
+  entry.evaluate = surface->evaluate;
+  entry.params.assign(params, params + surface->paramsSize);
+  entry.mesh = new SurfaceMesh;
+  tessellateSurface(entry.mesh, surface, uSteps, vSteps, topology);
+  myCache.push_back(entry);
+  return entry.mesh;
+}
+
+void clearSurfaceMeshCache(void)
+{
+  size_t i;
+
+  for (i = 0; i < myCache.size(); i++) {
+    freeSurfaceMesh(myCache[i].mesh);
+    delete myCache[i].mesh;
+  }
+  myCache.clear();
+}
+
+/* Built-in surfaces */
+
+static void store3(float *dst, float x, float y, float z)
+{
+  dst[0] = x;
+  dst[1] = y;
+  dst[2] = z;
+}
+
+/* P = r (sin phi cos theta, cos phi, sin phi sin theta) with
+   theta = 2 pi u and phi = pi v. */
+void evaluateSphereSurface(SurfaceVertex *out, const float *u, const float *v,
+                           int count, const void *params)
+{
+  const float radius = ((const SphereSurface *) params)->radius;
+  float theta[SURFACE_BATCH] = { 0 }, phi[SURFACE_BATCH] = { 0 };
+  float sinTheta[SURFACE_BATCH], cosTheta[SURFACE_BATCH], sinPhi[SURFACE_BATCH],
+        cosPhi[SURFACE_BATCH];
+  int i;
+
+  for (i = 0; i < count; i++) {
+    theta[i] = (float) (2 * myPi) * u[i];
+    phi[i] = (float) myPi * v[i];
+  }
+  sinCosArray(sinTheta, cosTheta, theta, count, SINCOS_FULL);
+  sinCosArray(sinPhi, cosPhi, phi, count, SINCOS_FULL);
+
+  for (i = 0; i < count; i++) {
+    SurfaceVertex *p = out + i;
+
+    store3(p->normal, sinPhi[i] * cosTheta[i], cosPhi[i], sinPhi[i] * sinTheta[i]);
+    store3(p->position, radius * p->normal[0], radius * p->normal[1], radius * p->normal[2]);
+    store3(p->tangent, -sinTheta[i], 0, cosTheta[i]);
+  }
+}
+
+/* C8E6v_torus: P = ((M + N cos t) cos s, (M + N cos t) sin s, N sin t)
+   with s = 2 pi u and t = 2 pi v. */
+void evaluateTorusSurface(SurfaceVertex *out, const float *u, const float *v,
+                          int count, const void *params)
+{
+  const float M = ((const TorusSurface *) params)->M,
+              N = ((const TorusSurface *) params)->N;
+  float s[SURFACE_BATCH] = { 0 }, t[SURFACE_BATCH] = { 0 };
+  float sinS[SURFACE_BATCH], cosS[SURFACE_BATCH], sinT[SURFACE_BATCH], cosT[SURFACE_BATCH];
+  int i;
+
+  for (i = 0; i < count; i++) {
+    s[i] = (float) (2 * myPi) * u[i];
+    t[i] = (float) (2 * myPi) * v[i];
+  }
+  sinCosArray(sinS, cosS, s, count, SINCOS_FULL);
+  sinCosArray(sinT, cosT, t, count, SINCOS_FULL);
+
+  for (i = 0; i < count; i++) {
+    SurfaceVertex *p = out + i;
+    float ring = M + N * cosT[i];
+
+    store3(p->position, ring * cosS[i], ring * sinS[i], N * sinT[i]);
+    store3(p->normal, cosS[i] * cosT[i], sinS[i] * cosT[i], sinT[i]);
+    store3(p->tangent, -sinS[i], cosS[i], 0);
+  }
+}
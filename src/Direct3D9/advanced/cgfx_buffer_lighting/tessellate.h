@@ -0,0 +1,104 @@
+/* tessellate.h - Indexed meshes of parametric surfaces, evaluated in parallel and cached. */
+
+/* A parametric surface maps (u, v) in [0, 1] x [0, 1] to a position,
+   normal, and tangent.  tessellateSurface samples it on a grid of
+   (uSteps+1) x (vSteps+1) vertices, vertex i + j*(uSteps+1) at
+   (i/uSteps, j/vSteps), and indexes the grid as a triangle list or as a
+   single triangle strip.  Seams are not welded: a closed surface has
+   matching first and last columns (or rows), so each can carry its own
+   texture coordinate.
+
+   The grid is split into pieces that are evaluated on separate threads
+   (see parallel.h), each piece SURFACE_BATCH vertices at a time, so a
+   surface function can work on whole arrays of u and v with SIMD
+   routines such as sinCosArray.
+
+   Triangles are clockwise (Direct3D's default front face) seen from the
+   side that dP/du x dP/dv points to, which is outside for the built-in
+   sphere and torus.  Both topologies walk the grid in columns of 7 quads
+   so the two rows of a column (16 vertices) stay in a 16-entry
+   post-transform vertex cache. */
+
+#ifndef TESSELLATE_H
+#define TESSELLATE_H
+
+typedef struct {
+  float position[3];
+  float normal[3];
+  float tangent[3];    /* unit dP/du */
+  float texCoord[2];   /* (u, v) unless the surface function changes it */
+} SurfaceVertex;
+
+/* Most vertices a surface function is handed at once. */
+#define SURFACE_BATCH 256
+
+/* Evaluate out[i] at (u[i], v[i]) for count <= SURFACE_BATCH points.
+   out[i].texCoord is already (u[i], v[i]).  params is the surface's
+   params.  Called from several threads at once, so it must not modify
+   shared state. */
+typedef void (*SurfaceFunction)(SurfaceVertex *out, const float *u, const float *v,
+                                int count, const void *params);
+
+typedef struct {
+  SurfaceFunction evaluate;
+  const void *params;   /* Passed to evaluate. */
+  int paramsSize;       /* Bytes of params; the cache compares them. */
+} ParametricSurface;
+
+typedef enum {
+  SURFACE_TRIANGLE_LIST  = 0,
+  /* One strip; columns and rows are joined by repeated indices, which
+     make degenerate triangles that draw nothing. */
+  SURFACE_TRIANGLE_STRIP = 1
+} SurfaceTopology;
+
+typedef struct {
+  SurfaceVertex *vertices;
+  int vertexCount;
+  unsigned int *indices;
+  int indexCount;
+  SurfaceTopology topology;
+  int uSteps, vSteps;
+} SurfaceMesh;
+
+/* Number of indices tessellateSurface emits. */
+int getSurfaceIndexCount(int uSteps, int vSteps, SurfaceTopology topology);
+
+/* Tessellate into a new mesh; release it with freeSurfaceMesh.  uSteps
+   and vSteps are at least 1. */
+void tessellateSurface(SurfaceMesh *mesh, const ParametricSurface *surface,
+                       int uSteps, int vSteps, SurfaceTopology topology);
+
+void freeSurfaceMesh(SurfaceMesh *mesh);
+
+/* Same as tessellateSurface, but the mesh is remembered by surface
+   function, params contents, steps, and topology, and asking again (after
+   a device reset, say) returns the same mesh without evaluating anything.
+   The mesh belongs to the cache and lasts until clearSurfaceMeshCache.
+   Not safe to call from several threads at once. */
+const SurfaceMesh *getSurfaceMesh(const ParametricSurface *surface,
+                                  int uSteps, int vSteps, SurfaceTopology topology);
+
+void clearSurfaceMeshCache(void);
+
+/* Built-in surfaces. */
+
+/* Sphere centered at the origin: u goes once around the Y axis, v from
+   the north pole (+Y) to the south pole. */
+typedef struct {
+  float radius;
+} SphereSurface;
+
+void evaluateSphereSurface(SurfaceVertex *out, const float *u, const float *v,
+                           int count, const void *params);
+
+/* C8E6v_torus's torus around the Z axis: ring radius M, tube radius N, u
+   around the Z axis and v around the tube. */
+typedef struct {
+  float M, N;
+} TorusSurface;
+
+void evaluateTorusSurface(SurfaceVertex *out, const float *u, const float *v,
+                          int count, const void *params);
+
+#endif /* TESSELLATE_H */
@@ -0,0 +1,366 @@
+/* vertexcache.c - Measuring and improving how well an indexed mesh uses the GPU's caches. */
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#include "vertexcache.h"
+
+/* Vertex fetch cache: 256 lines of 64 bytes. */
+#define FETCH_LINE_SIZE   64
+#define FETCH_LINE_COUNT  256
+
+/* estimateOverdraw's render target. */
+#define OVERDRAW_SIZE     256
+
+/* Forsyth's constants: the scoring's largest cache, how fast a vertex's
+   score falls with its cache position, the score of the last
+   triangle's three vertices (lowered so strips do not wind back on
+   themselves), and the boost for vertices with few triangles left. */
+#define FORSYTH_CACHE_SIZE      32
+#define FORSYTH_DECAY_POWER     1.5
+#define FORSYTH_LAST_TRIANGLE   0.75
+#define FORSYTH_VALENCE_SCALE   2.0
+#define FORSYTH_VALENCE_POWER   0.5
+#define FORSYTH_MAX_VALENCE     64
+
+void simulateVertexCache(VertexCacheStats *stats, const unsigned int *indices, int indexCount,
+                         int vertexCount, int cacheSize, VertexCacheKind kind)
+{
+  std::vector<int> stamp(vertexCount, -1);
+  std::vector<unsigned int> lru(cacheSize > 0 ? cacheSize : 1);
+  int i, used = 0, runs = 0, size = 0;
+
+  for (i = 0; i < indexCount; i++) {
+    unsigned int v = indices[i];
+    int j;
+
+    if (stamp[v] < 0)
+      used++;
+    if (kind == VERTEX_CACHE_FIFO) {
+      /* v is cached if fewer than cacheSize runs have happened since it
+         went in, which needs no search. */
+      if (stamp[v] < 0 || runs - stamp[v] >= cacheSize)
+        stamp[v] = runs++;
+      continue;
+    }
+
+    if (stamp[v] < 0)
+      stamp[v] = 0;
+    for (j = 0; j < size; j++)
+      if (lru[j] == v)
+        break;
+    if (j == size) {
+      runs++;
+      if (cacheSize == 0)
+        continue;
+      if (size < cacheSize)
+        size++;
+      j = size - 1;
+    }
+    /* Move to the front, dropping the last entry on a miss. */
+    memmove(&lru[1], &lru[0], j * sizeof(lru[0]));
+    lru[0] = v;
+  }
+
+  stats->triangleCount = indexCount / 3;
+  stats->vertexCount = used;
+  stats->shaderRuns = runs;
+  stats->acmr = indexCount >= 3 ? (double) runs / (indexCount / 3) : 0;
+  stats->atvr = used > 0 ? (double) runs / used : 0;
+}
+
+void simulateVertexFetch(VertexFetchStats *stats, const unsigned int *indices, int indexCount,
+                         int vertexCount, int vertexSize, int cacheSize)
+{
+  long lineCount = ((long) vertexCount * vertexSize + FETCH_LINE_SIZE - 1) / FETCH_LINE_SIZE;
+  std::vector<int> stamp(vertexCount, -1);
+  std::vector<long> lineStamp(lineCount, -1);
+  double jumps = 0;
+  long lines = 0;
+  int i, runs = 0, used = 0;
+
+  for (i = 0; i < indexCount; i++) {
+    unsigned int v = indices[i];
+    long first, last, line;
+
+    if (i > 0)
+      jumps += v > indices[i-1] ? v - indices[i-1] : indices[i-1] - v;
+    if (stamp[v] < 0)
+      used++;
+    else if (runs - stamp[v] < cacheSize)
+      continue;
+    stamp[v] = runs++;
+
+    first = (long) v * vertexSize / FETCH_LINE_SIZE;
+    last = ((long) v * vertexSize + vertexSize - 1) / FETCH_LINE_SIZE;
+    for (line = first; line <= last; line++)
+      if (lineStamp[line] < 0 || lines - lineStamp[line] >= FETCH_LINE_COUNT)
+        lineStamp[line] = lines++;
+  }
+
+  stats->bytesFetched = (double) lines * FETCH_LINE_SIZE;
+  stats->overfetch = used > 0 ? stats->bytesFetched / ((double) used * vertexSize) : 0;
+  stats->meanIndexJump = indexCount > 1 ? jumps / (indexCount - 1) : 0;
+}
+
+/* Signed doubled area of (a, b, p), positive when p is left of a->b. */
+static double edgeFunction(const double a[2], const double b[2], double x, double y)
+{
+  return (b[0] - a[0]) * (y - a[1]) - (b[1] - a[1]) * (x - a[0]);
+}
+
+/* Whether edge a->b of a counter-clockwise triangle (in pixel space, y
+   up) is a top or left edge, whose pixels the triangle owns. */
+static int isTopLeft(const double a[2], const double b[2])
+{
+  return (a[1] == b[1] && b[0] < a[0]) || b[1] < a[1];
+}
+
+void estimateOverdraw(OverdrawStats *stats, const unsigned int *indices, int indexCount,
+                      const float *positions, int stride, int vertexCount)
+{
+  std::vector<float> depth(OVERDRAW_SIZE * OVERDRAW_SIZE);
+  double lo[3], hi[3];
+  int axis, sign, i, k;
+
+  stats->pixelsCovered = stats->pixelsShaded = 0;
+  stats->overdraw = 0;
+  if (vertexCount == 0)
+    return;
+  for (k = 0; k < 3; k++)
+    lo[k] = hi[k] = positions[k];
+  for (i = 1; i < vertexCount; i++)
+    for (k = 0; k < 3; k++) {
+      double p = positions[i*stride + k];
+
+      lo[k] = p < lo[k] ? p : lo[k];
+      hi[k] = p > hi[k] ? p : hi[k];
+    }
+
+  for (axis = 0; axis < 3; axis++)
+    for (sign = -1; sign <= 1; sign += 2) {
+      /* Look along -sign * axis, from the sign side; the screen is the
+         other two axes, scaled alike so the mesh keeps its proportions. */
+      int u = (axis + 1) % 3, v = (axis + 2) % 3;
+      double extent = hi[u] - lo[u] > hi[v] - lo[v] ? hi[u] - lo[u] : hi[v] - lo[v],
+             scale = extent > 0 ? (OVERDRAW_SIZE - 1) / extent : 0;
+
+      if (scale == 0)
+        continue;
+      for (i = 0; i < OVERDRAW_SIZE * OVERDRAW_SIZE; i++)
+        depth[i] = 1e30f;
+
+      for (i = 0; i + 2 < indexCount; i += 3) {
+        double p[3][2], z[3], e[3], area;
+        int x0, x1, y0, y1, x, y;
+
+        for (k = 0; k < 3; k++) {
+          const float *q = positions + indices[i+k] * stride;
+
+          p[k][0] = (q[u] - lo[u]) * scale;
+          p[k][1] = (q[v] - lo[v]) * scale;
+          z[k] = -sign * q[axis];
+        }
+        /* (u, v, axis) is right-handed, so the screen area is the
+           triangle's normal along axis; a front face's normal points
+           away from the viewer. */
+        area = edgeFunction(p[0], p[1], p[2][0], p[2][1]);
+        if (!(sign * area < 0))
+          continue;
+        if (area < 0) {
+          double t[2] = { p[1][0], p[1][1] }, tz = z[1];
+
+          p[1][0] = p[2][0]; p[1][1] = p[2][1]; z[1] = z[2];
+          p[2][0] = t[0]; p[2][1] = t[1]; z[2] = tz;
+          area = -area;
+        }
+
+        x0 = (int) floor(p[0][0] < p[1][0] ? (p[0][0] < p[2][0] ? p[0][0] : p[2][0])
+                                           : (p[1][0] < p[2][0] ? p[1][0] : p[2][0]));
+        x1 = (int) ceil(p[0][0] > p[1][0] ? (p[0][0] > p[2][0] ? p[0][0] : p[2][0])
+                                          : (p[1][0] > p[2][0] ? p[1][0] : p[2][0]));
+        y0 = (int) floor(p[0][1] < p[1][1] ? (p[0][1] < p[2][1] ? p[0][1] : p[2][1])
+                                           : (p[1][1] < p[2][1] ? p[1][1] : p[2][1]));
+        y1 = (int) ceil(p[0][1] > p[1][1] ? (p[0][1] > p[2][1] ? p[0][1] : p[2][1])
+                                          : (p[1][1] > p[2][1] ? p[1][1] : p[2][1]));
+        x1 = x1 < OVERDRAW_SIZE - 1 ? x1 : OVERDRAW_SIZE - 1;
+        y1 = y1 < OVERDRAW_SIZE - 1 ? y1 : OVERDRAW_SIZE - 1;
+
+        for (y = y0 > 0 ? y0 : 0; y <= y1; y++)
+          for (x = x0 > 0 ? x0 : 0; x <= x1; x++) {
+            double d;
+            float *target;
+
+            e[0] = edgeFunction(p[1], p[2], x + 0.5, y + 0.5);
+            e[1] = edgeFunction(p[2], p[0], x + 0.5, y + 0.5);
+            e[2] = edgeFunction(p[0], p[1], x + 0.5, y + 0.5);
+            if (e[0] < 0 || e[1] < 0 || e[2] < 0 ||
+                (e[0] == 0 && !isTopLeft(p[1], p[2])) ||
+                (e[1] == 0 && !isTopLeft(p[2], p[0])) ||
+                (e[2] == 0 && !isTopLeft(p[0], p[1])))
+              continue;
+            d = (e[0] * z[0] + e[1] * z[1] + e[2] * z[2]) / area;
+            target = &depth[y * OVERDRAW_SIZE + x];
+            if (d < *target) {
+              *target = (float) d;
+              stats->pixelsShaded++;
+            }
+          }
+      }
+
+      for (i = 0; i < OVERDRAW_SIZE * OVERDRAW_SIZE; i++)
+        if (depth[i] < 1e30f)
+          stats->pixelsCovered++;
+    }
+  stats->overdraw = stats->pixelsCovered > 0 ? stats->pixelsShaded / stats->pixelsCovered : 0;
+}
+
+/* Forsyth's score of a vertex at cache position (or -1) with some
+   triangles left, from precomputed tables. */
+typedef struct {
+  float cache[FORSYTH_CACHE_SIZE];
+  float valence[FORSYTH_MAX_VALENCE + 1];
+} ForsythTables;
+
+static void initForsythTables(ForsythTables *tables, int cacheSize)
+{
+  int i;
+
+  for (i = 0; i < FORSYTH_CACHE_SIZE; i++) {
+    if (i < 3)
+      tables->cache[i] = (float) FORSYTH_LAST_TRIANGLE;
+    else if (i < cacheSize)
+      tables->cache[i] = (float) pow(1 - (double) (i - 3) / (cacheSize - 3), FORSYTH_DECAY_POWER);
+    else
+      tables->cache[i] = 0;
+  }
+  tables->valence[0] = 0;
+  for (i = 1; i <= FORSYTH_MAX_VALENCE; i++)
+    tables->valence[i] = (float) (FORSYTH_VALENCE_SCALE * pow((double) i, -FORSYTH_VALENCE_POWER));
+}
+
+static float forsythScore(const ForsythTables *tables, int position, int remaining)
+{
+  if (remaining == 0)
+    return -1;
+  return (position >= 0 ? tables->cache[position] : 0) +
+         tables->valence[remaining < FORSYTH_MAX_VALENCE ? remaining : FORSYTH_MAX_VALENCE];
+}
+
+int optimizeVertexCache(unsigned int *out, const unsigned int *indices, int indexCount,
+                        int vertexCount, int cacheSize)
+{
+  const int triangleCount = indexCount / 3;
+  ForsythTables tables;
+  std::vector<int> start(vertexCount + 1, 0), remaining(vertexCount, 0), adjacency(indexCount),
+                   position(vertexCount, -1);
+  std::vector<float> vertexScore(vertexCount);
+  std::vector<char> emitted(triangleCount, 0);
+  std::vector<unsigned int> cache, next;
+  VertexCacheStats before, after;
+  int i, k, written = 0, cursor = 0, best = -1, fifoSize = cacheSize;
+
+  if (cacheSize > FORSYTH_CACHE_SIZE)
+    cacheSize = FORSYTH_CACHE_SIZE;
+  if (cacheSize < 4)
+    cacheSize = 4;
+  initForsythTables(&tables, cacheSize);
+
+  /* Each vertex's live triangles, kept at the front of its slice of
+     adjacency. */
+  for (i = 0; i < triangleCount * 3; i++)
+    remaining[indices[i]]++;
+  for (i = 0; i < vertexCount; i++)
+    start[i+1] = start[i] + remaining[i];
+  for (i = 0; i < vertexCount; i++)
+    remaining[i] = 0;
+  for (i = 0; i < triangleCount * 3; i++) {
+    unsigned int v = indices[i];
+
+    adjacency[start[v] + remaining[v]++] = i / 3;
+  }
+
+  for (i = 0; i < vertexCount; i++)
+    vertexScore[i] = forsythScore(&tables, -1, remaining[i]);
+
+  while (written < triangleCount) {
+    float bestScore = -1;
+
+    if (best < 0) {
+      /* Nothing in the cache has triangles left: take the next one. */
+      while (emitted[cursor])
+        cursor++;
+      best = cursor;
+    }
+
+    emitted[best] = 1;
+    memcpy(out + 3 * written++, indices + 3 * best, 3 * sizeof(unsigned int));
+
+    /* The triangle's vertices go to the front of the cache. */
+    next.clear();
+    for (k = 0; k < 3; k++) {
+      unsigned int v = indices[3*best + k];
+      int *live = &adjacency[start[v]], j;
+
+      for (j = 0; live[j] != best; j++)
+        ;
+      live[j] = live[--remaining[v]];
+      live[remaining[v]] = best;
+      next.push_back(v);
+    }
+    for (i = 0; i < (int) cache.size(); i++)
+      if (cache[i] != next[0] && cache[i] != next[1] && cache[i] != next[2])
+        next.push_back(cache[i]);
+    cache.swap(next);
+
+    /* Rescore what moved, including vertices pushed out. */
+    for (i = 0; i < (int) cache.size(); i++)
+      position[cache[i]] = i < cacheSize ? i : -1;
+    for (i = 0; i < (int) cache.size(); i++) {
+      unsigned int v = cache[i];
+
+      vertexScore[v] = forsythScore(&tables, position[v], remaining[v]);
+    }
+    for (i = 0; i < (int) cache.size(); i++) {
+      unsigned int v = cache[i];
+
+      for (k = 0; k < remaining[v]; k++) {
+        int t = adjacency[start[v] + k];
+        float score = vertexScore[indices[3*t]] + vertexScore[indices[3*t+1]] +
+                      vertexScore[indices[3*t+2]];
+
+        if (score > bestScore) {
+          bestScore = score;
+          best = t;
+        }
+      }
+    }
+    if (bestScore < 0)
+      best = -1;
+    if ((int) cache.size() > cacheSize)
+      cache.resize(cacheSize);
+  }
+
+  simulateVertexCache(&before, indices, triangleCount * 3, vertexCount, fifoSize,
+                      VERTEX_CACHE_FIFO);
+  simulateVertexCache(&after, out, triangleCount * 3, vertexCount, fifoSize, VERTEX_CACHE_FIFO);
+  if (before.shaderRuns <= after.shaderRuns) {
+    memcpy(out, indices, triangleCount * 3 * sizeof(unsigned int));
+    return 0;
+  }
+  return 1;
+}
+
+int getFirstUseRemap(unsigned int *remap, const unsigned int *indices, int indexCount,
+                     int vertexCount)
+{
+  int i, used = 0;
+
+  for (i = 0; i < vertexCount; i++)
+    remap[i] = ~0u;
+  for (i = 0; i < indexCount; i++)
+    if (remap[indices[i]] == ~0u)
+      remap[indices[i]] = used++;
+  return used;
+}
@@ -0,0 +1,91 @@
+/* vertexcache.h - Measuring and improving how well an indexed mesh uses the GPU's caches. */
+
+/* simulateVertexCache replays an index buffer through a post-transform
+   vertex cache, either FIFO (the usual hardware model: a hit does not
+   refresh an entry) or LRU, and reports
+
+     ACMR  vertex shader runs per triangle: 3 with no reuse at all, about
+           0.5 for a large regular grid with a perfect cache;
+     ATVR  vertex shader runs per distinct vertex: 1 is ideal, whatever
+           the mesh's shape, which makes it the better number to compare
+           meshes with.
+
+   simulateVertexFetch follows the shader runs into the vertex buffer
+   through a cache of 64-byte lines, reporting bytes fetched against the
+   bytes of the vertices used (overfetch; 1 when each line is read once)
+   and the mean jump between consecutive indices.
+
+   estimateOverdraw rasterizes the mesh orthographically from the six
+   axis directions at 256x256 pixels with a depth buffer, back faces
+   culled and triangles drawn in index order, and counts pixels shaded
+   against pixels covered.  Front faces are clockwise seen from the
+   viewer with positions in a right-handed frame, the way sphere.h and
+   tessellate.h build them.
+
+   optimizeVertexCache reorders triangles with Tom Forsyth's linear-speed
+   algorithm: every vertex scores by its position in a simulated LRU
+   cache and by how few of its triangles are left, and the triangle with
+   the best sum goes next.  It keeps each triangle's winding, and keeps
+   the input order instead when that already needs fewer shader runs in
+   a FIFO cache of the same size, as meshes built for one (sphere.h,
+   tessellate.h) can.  getFirstUseRemap then numbers the vertices in
+   the order the new triangles use them, so fetches walk forward
+   through memory. */
+
+#ifndef VERTEXCACHE_H
+#define VERTEXCACHE_H
+
+typedef enum {
+  VERTEX_CACHE_FIFO = 0,
+  VERTEX_CACHE_LRU  = 1
+} VertexCacheKind;
+
+typedef struct {
+  int triangleCount;
+  int vertexCount;     /* Distinct vertices referenced */
+  int shaderRuns;
+  double acmr, atvr;
+} VertexCacheStats;
+
+/* Replay triangle list indices[0..indexCount) over vertexCount vertices
+   through a cacheSize-entry cache of the given kind. */
+void simulateVertexCache(VertexCacheStats *stats, const unsigned int *indices, int indexCount,
+                         int vertexCount, int cacheSize, VertexCacheKind kind);
+
+typedef struct {
+  double bytesFetched;
+  double overfetch;        /* bytesFetched over the bytes of the vertices used */
+  double meanIndexJump;    /* Mean |indices[i] - indices[i-1]| */
+} VertexFetchStats;
+
+/* Fetch vertexSize-byte vertices for the shader runs of a cacheSize-entry
+   FIFO post-transform cache, through a 16 KB cache of 64-byte lines. */
+void simulateVertexFetch(VertexFetchStats *stats, const unsigned int *indices, int indexCount,
+                         int vertexCount, int vertexSize, int cacheSize);
+
+typedef struct {
+  double pixelsCovered;    /* Summed over the views */
+  double pixelsShaded;
+  double overdraw;         /* Shaded over covered; 1 is none */
+} OverdrawStats;
+
+/* Positions are 3 floats at positions + v*stride floats.  Views in which
+   the mesh is flat (a 2D mesh seen edge-on) cover nothing. */
+void estimateOverdraw(OverdrawStats *stats, const unsigned int *indices, int indexCount,
+                      const float *positions, int stride, int vertexCount);
+
+/* Write triangle list indices[0..indexCount) to out (which may not be
+   indices) in an order that suits a post-transform cache of about
+   cacheSize entries (the scoring assumes up to 32).  Return 1 if the
+   triangles were reordered and 0 if the input order was kept. */
+int optimizeVertexCache(unsigned int *out, const unsigned int *indices, int indexCount,
+                        int vertexCount, int cacheSize);
+
+/* Set remap[v] to vertex v's new number, in order of first use by
+   indices[0..indexCount), and return how many vertices are used; unused
+   vertices get ~0u.  The caller moves vertex v to remap[v] and replaces
+   each index i with remap[i]. */
+int getFirstUseRemap(unsigned int *remap, const unsigned int *indices, int indexCount,
+                     int vertexCount);
+
+#endif /* VERTEXCACHE_H */
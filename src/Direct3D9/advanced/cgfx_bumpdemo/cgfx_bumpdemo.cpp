@@ -2,6 +2,8 @@
 /* cgfx_bumpdemo.c - a Direct3D9-based Cg 1.5 demo */
 
 #include <stdio.h>
+#include <stddef.h>
+#include <string.h>
 #include <math.h>
 #include <assert.h>
 #include <windows.h>
@@ -11,6 +13,10 @@
 #pragma comment(lib, "d3d9.lib")
 #include <Cg/cg.h>     /* Cg Core API: Can't include this?  Is Cg Toolkit installed! */
 #include <Cg/cgD3D9.h> /* Cg Direct3D9 API (part of Cg Toolkit) */
+#include "../cgfx_buffer_lighting/mat4.h"
+#include "../cgfx_buffer_lighting/lod.h"
+#include "../cgfx_buffer_lighting/stripify.h"
+#include "../cgfx_buffer_lighting/tessellate.h"
 
 static const char *myProgramName = "cgfx_bumpdemo"; /* Program name for messages. */
 
@@ -18,11 +24,17 @@ static const char *myProgramName = "cgfx_bumpdemo"; /* Program name for messages
 CGcontext   myCgContext;
 CGeffect    myCgEffect;
 CGtechnique myCgTechnique, myCgTechniqueHLSL, myCurrentCgTechninque;
+CGtechnique myCgBakedTechnique, myCgBakedTechniqueHLSL;
 CGparameter myCgEyePositionParam,
             myCgLightPositionParam,
             myCgModelViewProjParam;
 
 int myRenderWithHLSLProfile = 0;
+int myRenderBakedTorus = 0;
+
+/* The torus's radii, read from the effect so the baked torus matches
+   the one C8E6v_torus computes. */
+static TorusSurface myTorus;
 
 /* Forward declare helper functions and callbacks registered by main. */
 static void checkForCgError(const char *situation);
@@ -55,6 +67,7 @@ int main(int argc, char **argv)
      Not strictly necessary if we are simply going to exit. */
   cgDestroyEffect(myCgEffect);
   checkForCgError("destroying effect");
+  clearSurfaceMeshCache();
   cgDestroyContext(myCgContext);
   cgD3D9SetDevice(NULL);
 
@@ -86,6 +99,52 @@ static void checkForCgError(const char *situation)
   }
 }
 
+/* bumpdemo.cgfx lists the parametric techniques, then the same ones
+   for the baked torus, each in order of preference. */
+static int isBakedTechnique(CGtechnique technique)
+{
+  return strncmp(cgGetTechniqueName(technique), "bumpdemo_baked_", 15) == 0;
+}
+
+static CGtechnique getFirstValidTechnique(int baked)
+{
+  CGtechnique technique = cgGetFirstTechnique(myCgEffect);
+
+  while (technique && (isBakedTechnique(technique) != baked ||
+                       cgValidateTechnique(technique) == CG_FALSE)) {
+    if (isBakedTechnique(technique) == baked)
+      fprintf(stderr, "%s: Technique %s did not validate.  Skipping.\n",
+        myProgramName, cgGetTechniqueName(technique));
+    technique = cgGetNextTechnique(technique);
+  }
+  return technique;
+}
+
+static CGtechnique getValidNamedTechnique(const char *name)
+{
+  CGtechnique technique = cgGetNamedTechnique(myCgEffect, name);
+
+  if (!cgValidateTechnique(technique)) {
+    fprintf(stderr, "%s: HLSL technique %s failed to validate.\n",
+      myProgramName, name);
+    return 0;
+  }
+  return technique;
+}
+
+static void selectTechnique(void)
+{
+  if (myRenderBakedTorus) {
+    myCurrentCgTechninque = myRenderWithHLSLProfile ? myCgBakedTechniqueHLSL
+                                                    : myCgBakedTechnique;
+  } else {
+    myCurrentCgTechninque = myRenderWithHLSLProfile ? myCgTechniqueHLSL
+                                                    : myCgTechnique;
+  }
+  fprintf(stderr, "%s: Using technique %s.\n",
+    myProgramName, cgGetTechniqueName(myCurrentCgTechninque));
+}
+
 static void initCg(void)
 {
   cgD3D9RegisterStates(myCgContext);
@@ -97,12 +156,7 @@ static void initCg(void)
   checkForCgError("creating bumpdemo.cgfx effect");
   assert(myCgEffect);
 
-  myCgTechnique = cgGetFirstTechnique(myCgEffect);
-  while (myCgTechnique && cgValidateTechnique(myCgTechnique) == CG_FALSE) {
-    fprintf(stderr, "%s: Technique %s did not validate.  Skipping.\n",
-      myProgramName, cgGetTechniqueName(myCgTechnique));
-    myCgTechnique = cgGetNextTechnique(myCgTechnique);
-  }
+  myCgTechnique = getFirstValidTechnique(0);
   if (myCgTechnique) {
     fprintf(stderr, "%s: Use technique %s.\n",
       myProgramName, cgGetTechniqueName(myCgTechnique));
@@ -113,13 +167,16 @@ static void initCg(void)
   }
   myCurrentCgTechninque = myCgTechnique;
 
-  myCgTechniqueHLSL = cgGetNamedTechnique(myCgEffect, "bumpdemo_hlsl");
-  if (!cgValidateTechnique(myCgTechniqueHLSL)) {
-    fprintf(stderr, "%s: HLSL technique %s failed to validate.\n",
-      myProgramName, cgGetTechniqueName(myCgTechniqueHLSL));
-    myCgTechniqueHLSL = 0;
-    myRenderWithHLSLProfile = 0;
-  }
+  myCgTechniqueHLSL = getValidNamedTechnique("bumpdemo_hlsl");
+
+  /* The baked torus is optional: without a valid technique for it, the
+     B key does nothing. */
+  myCgBakedTechnique = getFirstValidTechnique(1);
+  myCgBakedTechniqueHLSL = getValidNamedTechnique("bumpdemo_baked_hlsl");
+
+  cgGetParameterValuefr(cgGetNamedEffectParameter(myCgEffect, "OuterRadius"), 1, &myTorus.M);
+  cgGetParameterValuefr(cgGetNamedEffectParameter(myCgEffect, "InnerRadius"), 1, &myTorus.N);
+  checkForCgError("getting torus radii");
 
   myCgModelViewProjParam =
     cgGetEffectParameterBySemantic(myCgEffect, "ModelViewProjection");
@@ -248,13 +305,44 @@ struct MY_V3F {
 
 static PDIRECT3DVERTEXBUFFER9 myVertexBuffer = NULL;
 
+/* The flat patch's rings as one indexed primitive. */
+static PDIRECT3DINDEXBUFFER9 myIndexBuffer = NULL;
+static int myIndexCount;
+static D3DPRIMITIVETYPE myPrimitiveType;
+
+/* The baked torus: SurfaceVertex straight from tessellate.h, indexed,
+   with every level of its LOD chain in the same buffers. */
+static PDIRECT3DVERTEXBUFFER9 myBakedVertexBuffer = NULL;
+static PDIRECT3DINDEXBUFFER9 myBakedIndexBuffer = NULL;
+static PDIRECT3DVERTEXDECLARATION9 myBakedVertexDeclaration = NULL;
+static int myBakedVertexCount, myBakedIndexCount;
+static LodChain myBakedLod;
+static int myBakedLevel = -1;   /* Drawn last frame */
+static int myViewportHeight;
+
+static const D3DVERTEXELEMENT9 myBakedVertexElements[] = {
+  { 0, offsetof(SurfaceVertex, position), D3DDECLTYPE_FLOAT3,
+    D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_POSITION, 0 },
+  { 0, offsetof(SurfaceVertex, normal),   D3DDECLTYPE_FLOAT3,
+    D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_NORMAL,   0 },
+  { 0, offsetof(SurfaceVertex, tangent),  D3DDECLTYPE_FLOAT3,
+    D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_TANGENT,  0 },
+  { 0, offsetof(SurfaceVertex, texCoord), D3DDECLTYPE_FLOAT2,
+    D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_TEXCOORD, 0 },
+  D3DDECL_END()
+};
+
+/* The flat patch is a (rings+1) by (sides+1) grid of vertices, shared
+   by neighboring rings.  Each ring is still a strip over the grid, but
+   optimizePrimitives joins all of them into a single strip or list, so
+   the whole patch is one DrawIndexedPrimitive. */
 static HRESULT initTorusVertexBuffer(IDirect3DDevice9* pDev, int sides, int rings)
 {
   const float m = 1.0f / float(rings);
   const float n = 1.0f / float(sides);
 
   const int numVertsPerStrip = 2 * sides + 2;
-  const int numVertsPerPatch = numVertsPerStrip * rings;
+  const int numVertsPerPatch = (sides + 1) * (rings + 1);
 
   if (FAILED(pDev->CreateVertexBuffer(numVertsPerPatch * sizeof(MY_V3F),
                                       0, D3DFVF_XYZ,
@@ -268,63 +356,117 @@ static HRESULT initTorusVertexBuffer(IDirect3DDevice9* pDev, int sides, int ring
     return E_FAIL;
 
   int index = 0;
-  for( int i = 0; i < rings; ++i ) {
-    for( int j = 0; j <= sides; ++j ) {            
+  for( int i = 0; i <= rings; ++i ) {
+    for( int j = 0; j <= sides; ++j ) {
       pVertices[index].x = i*m;
       pVertices[index].y = j*n;
       pVertices[index].z = 0;
       index++;
-      pVertices[index].x = (i+1)*m;
-      pVertices[index].y = j*n;
-      pVertices[index].z = 0;
-      index++;
-    }        
+    }
   }
 
   myVertexBuffer->Unlock();
-  return S_OK;
-}
 
-static const double myPi = 3.14159265358979323846;
+  /* Ring i's strip, as drawFlatPatch used to draw it, then the triangles
+     of all the rings as one list. */
+  unsigned int *list = new unsigned int[3 * numVertsPerStrip * rings];
+  unsigned int *strip = new unsigned int[numVertsPerStrip];
+  int listCount = 0;
+
+  for( int i = 0; i < rings; ++i ) {
+    for( int j = 0; j <= sides; ++j ) {
+      strip[2*j]   = i * (sides + 1) + j;
+      strip[2*j+1] = (i + 1) * (sides + 1) + j;
+    }
+    listCount += listTriangles(list + listCount, PRIMITIVE_TRIANGLE_STRIP,
+                               strip, numVertsPerStrip);
+  }
+  delete [] strip;
+
+  PrimitiveCostModel model;
+  PrimitiveStats stats;
+  unsigned int *indices = new unsigned int[getMaxStripIndexCount(listCount / 3)];
+
+  getDefaultPrimitiveCostModel(&model);
+  myIndexCount = optimizePrimitives(indices, &stats, list, listCount, &model);
+  myPrimitiveType = stats.topology == PRIMITIVE_TRIANGLE_STRIP ? D3DPT_TRIANGLESTRIP
+                                                               : D3DPT_TRIANGLELIST;
+  delete [] list;
+
+  assert(numVertsPerPatch <= 65536);
+  HRESULT hr = pDev->CreateIndexBuffer(myIndexCount * sizeof(WORD),
+                                       0, D3DFMT_INDEX16,
+                                       D3DPOOL_DEFAULT, &myIndexBuffer, NULL);
+  WORD *pIndices;
+
+  if (SUCCEEDED(hr))
+    hr = myIndexBuffer->Lock(0, 0, (VOID**)&pIndices, 0);
+  if (SUCCEEDED(hr)) {
+    for (int i = 0; i < myIndexCount; i++)
+      pIndices[i] = (WORD) indices[i];
+    myIndexBuffer->Unlock();
+  }
+  delete [] indices;
+  return FAILED(hr) ? E_FAIL : S_OK;
+}
 
-static void buildPerspectiveMatrix(double fieldOfView,
-                                   double aspectRatio,
-                                   double zNear, double zFar,
-                                   float m[16])
+/* The same torus evaluated once on the CPU, at up to four times the
+   flat patch's rings and sides and at each coarser level down from there
+   (see lod.h).  s runs over the rings and t over the sides, as in the flat
+   patch above.  getSurfaceMesh keeps the meshes, so a device reset only
+   copies them again. */
+static HRESULT initBakedTorusBuffers(IDirect3DDevice9* pDev, int sides, int rings)
 {
-  double sine, cotangent, deltaZ;
-  double radians = fieldOfView / 2.0 * myPi / 180.0;
-  
-  deltaZ = zFar - zNear;
-  sine = sin(radians);
-  /* Should be non-zero to avoid division by zero. */
-  assert(deltaZ);
-  assert(sine);
-  assert(aspectRatio);
-  cotangent = cos(radians) / sine;
-  
-  m[0*4+0] = -float(cotangent / aspectRatio);
-  m[1*4+0] = 0.0;
-  m[2*4+0] = 0.0;
-  m[3*4+0] = 0.0;
-  
-  m[0*4+1] = 0.0;
-  m[1*4+1] = float(cotangent);
-  m[2*4+1] = 0.0;
-  m[3*4+1] = 0.0;
-  
-  m[0*4+2] = 0.0;
-  m[1*4+2] = 0.0;
-  m[2*4+2] = float(zFar / deltaZ);
-  m[3*4+2] = 1;
-  
-  m[0*4+3] = 0.0;
-  m[1*4+3] = 0.0;
-  m[2*4+3] = float(-(zFar / deltaZ)*zNear);
-  m[3*4+3] = 0;
+  const ParametricSurface surface = { evaluateTorusSurface, &myTorus, sizeof(myTorus) };
+  int index16;
+  void *pVertices, *pIndices;
+
+  getSurfaceLodChain(&myBakedLod, &surface, myTorus.M + myTorus.N,
+                     4 * rings, 4 * sides, LOD_MAX_LEVELS);
+  myBakedVertexCount = myBakedLod.vertexCount;
+  myBakedIndexCount = myBakedLod.indexCount;
+  /* 16-bit indices when they can address every vertex of each level. */
+  index16 = myBakedLod.levels[0].vertexCount <= 65536;
+
+  if (FAILED(pDev->CreateVertexDeclaration(myBakedVertexElements,
+                                           &myBakedVertexDeclaration)))
+    return E_FAIL;
+  if (FAILED(pDev->CreateVertexBuffer(myBakedVertexCount * sizeof(SurfaceVertex),
+                                      0, 0, D3DPOOL_DEFAULT,
+                                      &myBakedVertexBuffer, NULL)))
+    return E_FAIL;
+  if (FAILED(pDev->CreateIndexBuffer(myBakedIndexCount * (index16 ? sizeof(WORD) : sizeof(DWORD)),
+                                     0, index16 ? D3DFMT_INDEX16 : D3DFMT_INDEX32,
+                                     D3DPOOL_DEFAULT, &myBakedIndexBuffer, NULL)))
+    return E_FAIL;
+
+  unsigned int *indices = new unsigned int[myBakedIndexCount];
+  HRESULT hr = myBakedVertexBuffer->Lock(0, 0, &pVertices, 0);
+
+  if (SUCCEEDED(hr)) {
+    makeSurfaceLod(&myBakedLod, &surface, (SurfaceVertex*)pVertices, indices);
+    myBakedVertexBuffer->Unlock();
+    hr = myBakedIndexBuffer->Lock(0, 0, &pIndices, 0);
+  }
+  if (SUCCEEDED(hr)) {
+    if (index16) {
+      for (int i = 0; i < myBakedIndexCount; i++)
+        ((WORD*)pIndices)[i] = (WORD) indices[i];
+    } else {
+      memcpy(pIndices, indices, myBakedIndexCount * sizeof(DWORD));
+    }
+    myBakedIndexBuffer->Unlock();
+  }
+  delete [] indices;
+  return FAILED(hr) ? E_FAIL : S_OK;
 }
 
-static float myProjectionMatrix[16];
+/* The torus is modelled in a right-handed space (like the OpenGL version
+   of this demo) but drawn with Direct3D's [0,1] clip depth.  The matrices
+   are uploaded with cgSetMatrixParameterfr, so they are stored row-major. */
+typedef MatrixConvention<RightHanded, DepthZeroToOne, RowMajorStorage> BumpDemoConvention;
+
+static Mat4f myProjectionMatrix;
 const int myTorusSides = 20,
           myTorusRings = 40;
 
@@ -350,16 +492,18 @@ static HRESULT CALLBACK OnResetDevice(IDirect3DDevice9* pDev,
     return E_FAIL;
   if (FAILED(initTorusVertexBuffer(pDev, myTorusSides, myTorusRings)))
     return E_FAIL;
+  if (FAILED(initBakedTorusBuffers(pDev, myTorusSides, myTorusRings)))
+    return E_FAIL;
 
   double fieldOfView = 60.0;  // In degrees
   double width = backBuf->Width;
   double height = backBuf->Height;
+  myViewportHeight = (int) backBuf->Height;
   double aspectRatio = width / height;
   double zNear = 0.1;
   double zFar = 100.0;
-  buildPerspectiveMatrix(fieldOfView, aspectRatio,
-                         zNear, zFar,
-                         myProjectionMatrix);
+  myProjectionMatrix = BumpDemoConvention::perspectiveFov<float>(fieldOfView, aspectRatio,
+                                                                zNear, zFar);
 
   return S_OK;
 }
@@ -367,6 +511,10 @@ static HRESULT CALLBACK OnResetDevice(IDirect3DDevice9* pDev,
 static void CALLBACK OnLostDevice(void* userContext)
 {
   myVertexBuffer->Release();
+  myIndexBuffer->Release();
+  myBakedVertexBuffer->Release();
+  myBakedIndexBuffer->Release();
+  myBakedVertexDeclaration->Release();
   myBrickNormalMap->Release();
   myNormalizeVectorCubeMap->Release();
   cgD3D9SetDevice(NULL);
@@ -377,120 +525,49 @@ static int myAnimating = 0;
 static float myEyeAngle = 0;
 static const float myLightPosition[3] = { -8, 0, 15 };
 
-/* Build a row-major (C-style) 4x4 matrix transform based on the
-   parameters for gluLookAt. */
-static void buildLookAtMatrix(double eyex, double eyey, double eyez,
-                              double centerx, double centery, double centerz,
-                              double upx, double upy, double upz,
-                              float m[16])
+HRESULT drawFlatPatch(IDirect3DDevice9* pDev, IDirect3DVertexBuffer9 *vb,
+                      IDirect3DIndexBuffer9 *ib, int sides, int rings)
 {
-  double x[3], y[3], z[3], mag;
-
-  /* Difference center and eye vectors to make Z vector. */
-  z[0] = centerx - eyex;
-  z[1] = centery - eyey;
-  z[2] = centerz - eyez;
-  /* Normalize Z. */
-  mag = sqrt(z[0]*z[0] + z[1]*z[1] + z[2]*z[2]);
-  if (mag) {
-    z[0] /= mag;
-    z[1] /= mag;
-    z[2] /= mag;
-  }
+  HRESULT hr = S_OK;
 
-  /* Up vector makes Y vector. */
-  y[0] = upx;
-  y[1] = upy;
-  y[2] = upz;
-
-  /* X vector = Y cross Z. */
-  x[0] =  y[1]*z[2] - y[2]*z[1];
-  x[1] = -y[0]*z[2] + y[2]*z[0];
-  x[2] =  y[0]*z[1] - y[1]*z[0];
-
-  /* Recompute Y = Z cross X. */
-  y[0] =  z[1]*x[2] - z[2]*x[1];
-  y[1] = -z[0]*x[2] + z[2]*x[0];
-  y[2] =  z[0]*x[1] - z[1]*x[0];
-
-  /* Normalize X. */
-  mag = sqrt(x[0]*x[0] + x[1]*x[1] + x[2]*x[2]);
-  if (mag) {
-    x[0] /= mag;
-    x[1] /= mag;
-    x[2] /= mag;
-  }
+  hr = pDev->SetStreamSource(0, vb, 0, sizeof(MY_V3F));
+  if (FAILED(hr))
+    return hr;
 
-  /* Normalize Y. */
-  mag = sqrt(y[0]*y[0] + y[1]*y[1] + y[2]*y[2]);
-  if (mag) {
-    y[0] /= mag;
-    y[1] /= mag;
-    y[2] /= mag;
-  }
+  hr = pDev->SetIndices(ib);
+  if (FAILED(hr))
+    return hr;
 
-  /* Build resulting view matrix. */
-  m[0*4+0] = float(x[0]);
-  m[0*4+1] = float(x[1]);
-  m[0*4+2] = float(x[2]);
-  m[0*4+3] = -float(x[0]*eyex + x[1]*eyey + x[2]*eyez);
-
-  m[1*4+0] = float(y[0]);
-  m[1*4+1] = float(y[1]);
-  m[1*4+2] = float(y[2]);
-  m[1*4+3] = -float(y[0]*eyex + y[1]*eyey + y[2]*eyez);
-
-  m[2*4+0] = float(z[0]);
-  m[2*4+1] = float(z[1]);
-  m[2*4+2] = float(z[2]);
-  m[2*4+3] = -float(z[0]*eyex + z[1]*eyey + z[2]*eyez);
-
-  m[3*4+0] = 0.0;
-  m[3*4+1] = 0.0;
-  m[3*4+2] = 0.0;
-  m[3*4+3] = 1.0;
-}
+  hr = pDev->SetFVF(D3DFVF_XYZ);
+  if (FAILED(hr))
+    return hr;
 
-/* Simple 4x4 matrix by 4x4 matrix multiply. */
-static void multMatrix(float dst[16],
-                       const float src1[16], const float src2[16])
-{
-  float tmp[16];
-  int i, j;
-
-  for (i=0; i<4; i++) {
-    for (j=0; j<4; j++) {
-      tmp[i*4+j] = src1[i*4+0] * src2[0*4+j] +
-                   src1[i*4+1] * src2[1*4+j] +
-                   src1[i*4+2] * src2[2*4+j] +
-                   src1[i*4+3] * src2[3*4+j];
-    }
-  }
-  /* Copy result to dst (so dst can also be src1 or src2). */
-  for (i=0; i<16; i++)
-    dst[i] = tmp[i];
+  /* A strip's degenerate joining triangles count as primitives. */
+  return pDev->DrawIndexedPrimitive(myPrimitiveType, 0, 0, (UINT) ((sides + 1) * (rings + 1)), 0,
+                                    (UINT) (myPrimitiveType == D3DPT_TRIANGLESTRIP ?
+                                            myIndexCount - 2 : myIndexCount / 3));
 }
 
-HRESULT drawFlatPatch(IDirect3DDevice9* pDev, IDirect3DVertexBuffer9 *vb, int sides, int rings)
+HRESULT drawBakedTorus(IDirect3DDevice9* pDev, int lod)
 {
+  const LodLevel *level = &myBakedLod.levels[lod];
   HRESULT hr = S_OK;
 
-  hr = pDev->SetStreamSource(0, vb, 0, sizeof(MY_V3F));
+  hr = pDev->SetStreamSource(0, myBakedVertexBuffer, 0, sizeof(SurfaceVertex));
   if (FAILED(hr))
     return hr;
 
-  hr = pDev->SetFVF(D3DFVF_XYZ);
+  hr = pDev->SetIndices(myBakedIndexBuffer);
   if (FAILED(hr))
     return hr;
 
-  for (int i = 0, vertStart = 0;
-      i < rings;
-      i++, vertStart += (2 * sides + 2)) {
-    hr = pDev->DrawPrimitive(D3DPT_TRIANGLESTRIP, vertStart, sides * 2);
-    if (FAILED(hr))
-      return hr;
-  }
-  return hr;
+  hr = pDev->SetVertexDeclaration(myBakedVertexDeclaration);
+  if (FAILED(hr))
+    return hr;
+
+  return pDev->DrawIndexedPrimitive(D3DPT_TRIANGLELIST, level->vertexStart, 0,
+                                    (UINT) level->vertexCount, (UINT) level->indexStart,
+                                    (UINT) level->indexCount / 3);
 }
 
 static void CALLBACK OnFrameRender(IDirect3DDevice9* pDev,
@@ -502,12 +579,14 @@ static void CALLBACK OnFrameRender(IDirect3DDevice9* pDev,
               eyeElevationRange = 8.0;
   float eyePosition[3];
   CGpass pass;
-  float modelViewMatrix[16],
-        modelViewProjMatrix[16];
+  Mat4f modelViewMatrix;
+  float modelViewProjMatrix[16], projectionMatrix[16];
 
   pDev->Clear(0, NULL, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER, D3DXCOLOR( 0.1f, 0.3f, 0.6f, 1.0f ), 1.0f, 0);
   pDev->SetRenderState(D3DRS_ZENABLE, D3DZB_TRUE);
-  pDev->SetRenderState(D3DRS_CULLMODE, D3DCULL_CW);
+  /* tessellate.h winds its triangles the other way round from the flat
+     patch's. */
+  pDev->SetRenderState(D3DRS_CULLMODE, myRenderBakedTorus ? D3DCULL_CCW : D3DCULL_CW);
 
   if (FAILED(pDev->BeginScene())) 
     return;
@@ -518,14 +597,13 @@ static void CALLBACK OnFrameRender(IDirect3DDevice9* pDev,
   eyePosition[1] = eyeElevationRange * sin(myEyeAngle);
   eyePosition[2] = eyeRadius * cos(myEyeAngle);
 
-  buildLookAtMatrix(
-  eyePosition[0], eyePosition[1], eyePosition[2], 
+  modelViewMatrix = BumpDemoConvention::lookAt<float>(
+    eyePosition[0], eyePosition[1], eyePosition[2], 
     0.0 ,0.0,  0.0,   /* XYZ view center */
-    0.0, 1.0,  0.0,   /* Up is in positive Y direction */
-    modelViewMatrix);
+    0.0, 1.0,  0.0);  /* Up is in positive Y direction */
 
   /* modelViewProj = projectionMatrix * modelViewMatrix */
-  multMatrix(modelViewProjMatrix, myProjectionMatrix, modelViewMatrix);
+  BumpDemoConvention::store(myProjectionMatrix * modelViewMatrix, modelViewProjMatrix);
 
   // Row major version 
   cgSetMatrixParameterfr(myCgModelViewProjParam, modelViewProjMatrix );
@@ -533,12 +611,29 @@ static void CALLBACK OnFrameRender(IDirect3DDevice9* pDev,
   cgSetParameter3fv(myCgEyePositionParam, eyePosition);
   cgSetParameter3fv(myCgLightPositionParam, myLightPosition);
 
+  /* The baked torus's level of detail, from the size on screen of its
+     bounding sphere about the origin.  Element 5 of the projection is
+     the same in either storage order. */
+  if (myRenderBakedTorus) {
+    BumpDemoConvention::store(myProjectionMatrix, projectionMatrix);
+    myBakedLevel = selectLod(&myBakedLod,
+                             getProjectedRadius(projectionMatrix, myViewportHeight,
+                                                sqrtf(eyePosition[0]*eyePosition[0] +
+                                                      eyePosition[1]*eyePosition[1] +
+                                                      eyePosition[2]*eyePosition[2]),
+                                                myTorus.M + myTorus.N),
+                             0.5f, 0.25f, myBakedLevel);
+  }
+
   /* Iterate through rendering passes for technique (even
      though bumpdemo.cgfx has just one pass). */
   pass = cgGetFirstPass(myCurrentCgTechninque);
   while (pass) {
     cgSetPassState(pass);
-    drawFlatPatch(pDev, myVertexBuffer, myTorusSides, myTorusRings );
+    if (myRenderBakedTorus)
+      drawBakedTorus(pDev, myBakedLevel);
+    else
+      drawFlatPatch(pDev, myVertexBuffer, myIndexBuffer, myTorusSides, myTorusRings );
     cgResetPassState(pass);
     pass = cgGetNextPass(pass);
   }
@@ -607,16 +702,15 @@ static void CALLBACK KeyboardProc(UINT nChar,
     myAnimating = !myAnimating;
     break;
   case 'H':
-    if (myCgTechniqueHLSL) {
+    if (myRenderBakedTorus ? myCgBakedTechniqueHLSL : myCgTechniqueHLSL) {
       myRenderWithHLSLProfile = !myRenderWithHLSLProfile; // toggle
-      if (myRenderWithHLSLProfile) {
-        myCurrentCgTechninque = myCgTechniqueHLSL;
-      } else {
-        myCurrentCgTechninque = myCgTechnique;
-      }
-      const char *techniqueName = cgGetTechniqueName(myCurrentCgTechninque);
-      fprintf(stderr, "%s: Using technique %s.\n",
-        myProgramName, techniqueName);
+      selectTechnique();
+    }
+    break;
+  case 'B':
+    if (myCgBakedTechnique && (!myRenderWithHLSLProfile || myCgBakedTechniqueHLSL)) {
+      myRenderBakedTorus = !myRenderBakedTorus; // toggle
+      selectTechnique();
     }
     break;
   case 'L':
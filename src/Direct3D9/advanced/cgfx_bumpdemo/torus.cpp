@@ -0,0 +1,112 @@
+/* torus.c - CPU reference for the bump-mapped torus's two vertex programs. */
+
+#include <math.h>
+
+#include "torus.h"
+
+static const float myPi2 = 6.28318530f;  /* 2 times Pi, as in C8E6v_torus */
+
+static float dot3(const float a[3], const float b[3])
+{
+  return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+static void normalize3(float v[3])
+{
+  float s = 1 / sqrtf(dot3(v, v));
+
+  v[0] *= s;
+  v[1] *= s;
+  v[2] *= s;
+}
+
+static void cross3(float dst[3], const float a[3], const float b[3])
+{
+  dst[0] = a[1]*b[2] - a[2]*b[1];
+  dst[1] = a[2]*b[0] - a[0]*b[2];
+  dst[2] = a[0]*b[1] - a[1]*b[0];
+}
+
+/* The part both programs share: clip position, and the light and eye
+   directions rotated into the texture space of (tangent, binormal,
+   normal). */
+static void shadeFrame(TorusShaderOutput *out, const float position[3],
+                       const float tangent[3], const float binormal[3], const float normal[3],
+                       const TorusUniforms *uniforms)
+{
+  const float *m = uniforms->modelViewProj;
+  float light[3], eye[3], toEye[3];
+  int i;
+
+  for (i = 0; i < 4; i++)
+    out->position[i] = m[i*4+0]*position[0] + m[i*4+1]*position[1] +
+                       m[i*4+2]*position[2] + m[i*4+3];
+
+  for (i = 0; i < 3; i++) {
+    light[i] = uniforms->lightPosition[i] - position[i];
+    eye[i] = uniforms->eyePosition[i] - position[i];
+  }
+  out->lightDirection[0] = dot3(tangent, light);
+  out->lightDirection[1] = dot3(binormal, light);
+  out->lightDirection[2] = dot3(normal, light);
+  toEye[0] = dot3(tangent, eye);
+  toEye[1] = dot3(binormal, eye);
+  toEye[2] = dot3(normal, eye);
+
+  for (i = 0; i < 3; i++)
+    light[i] = out->lightDirection[i];
+  normalize3(light);
+  normalize3(toEye);
+  for (i = 0; i < 3; i++)
+    out->halfAngle[i] = light[i] + toEye[i];
+  normalize3(out->halfAngle);
+}
+
+void shadeParametricTorus(TorusShaderOutput *out, const float *parametric, int count,
+                          const TorusUniforms *uniforms)
+{
+  const float M = uniforms->M, N = uniforms->N;
+  int i;
+
+  for (i = 0; i < count; i++) {
+    const float *p = parametric + 2*i;
+    float sinS = sinf(myPi2 * p[0]), cosS = cosf(myPi2 * p[0]),
+          sinT = sinf(myPi2 * p[1]), cosT = cosf(myPi2 * p[1]);
+    float ring = M + N * cosT;
+    float position[3], dPds[3], normal[3], dPdt[3];
+
+    out[i].texCoord[0] = p[0] * -6;
+    out[i].texCoord[1] = p[1] * 2;
+
+    position[0] = ring * cosS;
+    position[1] = ring * sinS;
+    position[2] = N * sinT;
+    dPds[0] = -sinS * ring;
+    dPds[1] = cosS * ring;
+    dPds[2] = 0;
+    normalize3(dPds);
+    normal[0] = cosS * cosT;
+    normal[1] = sinS * cosT;
+    normal[2] = sinT;
+    cross3(dPdt, normal, dPds);
+
+    shadeFrame(out + i, position, dPds, dPdt, normal, uniforms);
+  }
+}
+
+void shadeBakedTorus(TorusShaderOutput *out, const SurfaceVertex *vertices, int count,
+                     const TorusUniforms *uniforms)
+{
+  int i;
+
+  for (i = 0; i < count; i++) {
+    const SurfaceVertex *v = vertices + i;
+    float binormal[3];
+
+    out[i].texCoord[0] = v->texCoord[0] * -6;
+    out[i].texCoord[1] = v->texCoord[1] * 2;
+    cross3(binormal, v->normal, v->tangent);
+
+    shadeFrame(out + i, v->position, v->tangent, binormal, v->normal, uniforms);
+  }
+}
@@ -0,0 +1,48 @@
+/* torus.h - CPU reference for the bump-mapped torus's two vertex programs. */
+
+/* The demo can draw the torus two ways:
+
+     parametric  C8E6v_torus: each vertex is just its (s, t) parameters,
+                 and every frame the vertex program works out the position,
+                 dP/ds, normal, and texture-space rotation from them;
+     baked       C8E6v_bakedTorus: position, normal, and tangent are
+                 computed once on the CPU (evaluateTorusSurface in
+                 tessellate.h) into an indexed SurfaceVertex stream, and the
+                 vertex program only rotates the light and eye directions.
+
+   The routines here do, on the CPU, exactly what each vertex program does,
+   so the two can be checked against each other and their per-frame cost
+   compared without a GPU. */
+
+#ifndef TORUS_H
+#define TORUS_H
+
+#include "../cgfx_buffer_lighting/tessellate.h"
+
+/* The vertex programs' uniform parameters. */
+typedef struct {
+  float lightPosition[3];   /* Object space */
+  float eyePosition[3];     /* Object space */
+  float modelViewProj[16];  /* Row-major, column vectors */
+  float M, N;               /* OuterRadius and InnerRadius */
+} TorusUniforms;
+
+/* What either vertex program outputs for one vertex. */
+typedef struct {
+  float position[4];        /* POSITION */
+  float texCoord[2];        /* TEXCOORD0 */
+  float lightDirection[3];  /* TEXCOORD1 */
+  float halfAngle[3];       /* TEXCOORD2 */
+} TorusShaderOutput;
+
+/* C8E6v_torus for count vertices whose (s, t) parameters are
+   parametric[2*i], parametric[2*i+1]. */
+void shadeParametricTorus(TorusShaderOutput *out, const float *parametric, int count,
+                          const TorusUniforms *uniforms);
+
+/* C8E6v_bakedTorus for count vertices of a mesh tessellated from a
+   TorusSurface with the same M and N. */
+void shadeBakedTorus(TorusShaderOutput *out, const SurfaceVertex *vertices, int count,
+                     const TorusUniforms *uniforms);
+
+#endif /* TORUS_H */
@@ -10,6 +10,7 @@
 #include <Cg/cgD3D9.h>
 
 #include "DXUT.h"  /* DirectX Utility Toolkit (part of the DirectX SDK) */
+#include "subdivide.h"
 
 #pragma comment(lib, "dxguid.lib")
 #pragma comment(lib, "d3d9.lib")
@@ -22,6 +23,7 @@ static CGprogram   myCgVertexProgram,
 static CGparameter myCgVertexParam_twisting;
 
 static LPDIRECT3DVERTEXBUFFER9 myVertexBuffer = NULL;
+static LPDIRECT3DINDEXBUFFER9 myIndexBuffer = NULL;
 
 static const WCHAR *myProgramNameW = L"06_vertex_twisting";
 static const char *myProgramName = "06_vertex_twisting",
@@ -33,7 +35,7 @@ static const char *myProgramName = "06_vertex_twisting",
 static bool myAnimating = false;
 static float myTwisting = 2.9f, /* Twisting angle in radians. */
              myTwistDirection = 0.1f; /* Animation delta for twist. */
-static int myNumTriangles;
+static int myNumVertices, myNumTriangles;
 
 static void checkForCgError(const char *situation)
 {
@@ -153,74 +155,37 @@ static void createCgPrograms()
   checkForCgError("creating fragment program from file");
 }
 
-struct MY_V3F_C4UB {
-  FLOAT x, y, z;
-  DWORD color;  // RGBA
-};
-
-/* Helper function to write vertex positions into vertex buffer. */
-static inline void writeVertex(MY_V3F_C4UB &v,
-                               const float p[2], const float c[3])
-{
-  v.x = FLOAT(p[0]);
-  v.y = FLOAT(p[1]);
-  v.z = 0;
-  v.color = D3DXCOLOR(c[0], c[1], c[2], 1);
-}
-
-static void triangleDivide(MY_V3F_C4UB v[],
-                           int &n,
-                           int depth,
-                           const float a[2], const float b[2], const float c[2],
-                           const float ca[3], const float cb[3], const float cc[3])
-{
-  if (depth == 0) {
-    writeVertex(v[n++], a, ca);
-    writeVertex(v[n++], b, cb);
-    writeVertex(v[n++], c, cc);
-  } else {
-    const float d[2] = { (a[0]+b[0])/2, (a[1]+b[1])/2 },
-                e[2] = { (b[0]+c[0])/2, (b[1]+c[1])/2 },
-                f[2] = { (c[0]+a[0])/2, (c[1]+a[1])/2 };
-    const float cd[3] = { (ca[0]+cb[0])/2, (ca[1]+cb[1])/2, (ca[2]+cb[2])/2 },
-                ce[3] = { (cb[0]+cc[0])/2, (cb[1]+cc[1])/2, (cb[2]+cc[2])/2 },
-                cf[3] = { (cc[0]+ca[0])/2, (cc[1]+ca[1])/2, (cc[2]+ca[2])/2 };
-
-    depth -= 1;
-    triangleDivide(v, n, depth, a, d, f, ca, cd, cf);
-    triangleDivide(v, n, depth, d, b, e, cd, cb, ce);
-    triangleDivide(v, n, depth, f, e, c, cf, ce, cc);
-    triangleDivide(v, n, depth, d, e, f, cd, ce, cf);
-  }
-}
-
-static inline int numDividedTriangles(int subdivisions)
-{
-  int tris = 1;
-
-  for (int i=0; i<subdivisions; i++) {
-    tris *= 4;
-  }
-  return tris;
-}
-
 static HRESULT initVertexBuffer(IDirect3DDevice9* pDev)
 {
   const int subdivisions = 5;
+  /* 16-bit indices when they can address every vertex. */
+  int index16;
 
-  myNumTriangles = numDividedTriangles(subdivisions);
+  myNumVertices = getSubdividedVertexCount(subdivisions);
+  myNumTriangles = getSubdividedTriangleCount(subdivisions);
+  index16 = myNumVertices <= 65536;
 
-  if (FAILED(pDev->CreateVertexBuffer(myNumTriangles*3*sizeof(MY_V3F_C4UB),
+  if (FAILED(pDev->CreateVertexBuffer(myNumVertices*sizeof(SubdividedVertex),
                                       0, D3DFVF_XYZ|D3DFVF_DIFFUSE,
                                       D3DPOOL_DEFAULT,
                                       &myVertexBuffer, NULL))) {
     return E_FAIL;
   }
+  if (FAILED(pDev->CreateIndexBuffer(myNumTriangles*3*(index16 ? sizeof(WORD) : sizeof(DWORD)),
+                                     0, index16 ? D3DFMT_INDEX16 : D3DFMT_INDEX32,
+                                     D3DPOOL_DEFAULT,
+                                     &myIndexBuffer, NULL))) {
+    return E_FAIL;
+  }
 
-  void *pVertices;
+  void *pVertices, *pIndices;
   if (FAILED(myVertexBuffer->Lock(0, 0, &pVertices, 0))) {
     return E_FAIL;
   }
+  if (FAILED(myIndexBuffer->Lock(0, 0, &pIndices, 0))) {
+    myVertexBuffer->Unlock();
+    return E_FAIL;
+  }
 
   const float a[2] = { -0.8f, 0.8f },
               b[2] = {  0.8f, 0.8f },
@@ -229,10 +194,15 @@ static HRESULT initVertexBuffer(IDirect3DDevice9* pDev)
               cb[3] = { 0, 0, 1 },
               cc[3] = { 0.7f, 0.7f, 1 };
 
-  int n = 0;
-  MY_V3F_C4UB *v = (MY_V3F_C4UB*) pVertices;
-  triangleDivide(v, n, subdivisions, a, b, c, ca, cb, cc);
+  /* Each shared vertex is written once, straight into the locked buffers. */
+  SubdividedVertex *v = (SubdividedVertex*) pVertices;
+  if (index16) {
+    subdivideTriangle16(v, (unsigned short*) pIndices, subdivisions, a, b, c, ca, cb, cc);
+  } else {
+    subdivideTriangle(v, (unsigned int*) pIndices, subdivisions, a, b, c, ca, cb, cc);
+  }
 
+  myIndexBuffer->Unlock();
   myVertexBuffer->Unlock();
 
   return S_OK;
@@ -284,10 +254,12 @@ void CALLBACK OnFrameRender(IDirect3DDevice9* pDev,
     checkForCgError("binding fragment program");
 
     /* Render the stars. */
-    pDev->SetStreamSource(0, myVertexBuffer, 0, sizeof(MY_V3F_C4UB));
+    pDev->SetStreamSource(0, myVertexBuffer, 0, sizeof(SubdividedVertex));
+    pDev->SetIndices(myIndexBuffer);
     pDev->SetFVF(D3DFVF_XYZ|D3DFVF_DIFFUSE);
 
-    pDev->DrawPrimitive(D3DPT_TRIANGLELIST, 0, myNumTriangles);
+    pDev->DrawIndexedPrimitive(D3DPT_TRIANGLELIST, 0, 0, myNumVertices,
+                               0, myNumTriangles);
 
     pDev->EndScene();
   }
@@ -335,5 +307,6 @@ static void CALLBACK KeyboardProc(UINT nChar,
 static void CALLBACK OnLostDevice(void* userContext)
 {
   myVertexBuffer->Release();
+  myIndexBuffer->Release();
   cgD3D9SetDevice(NULL);
 }
@@ -0,0 +1,200 @@
+/* subdivide.c - Indexed, evenly subdivided triangles for 06_vertex_twisting. */
+
+#include <assert.h>
+#include <stddef.h>
+
+#include "subdivide.h"
+#include "../../advanced/cgfx_buffer_lighting/parallel.h"
+
+/* Blocks are 2^SUBDIVIDE_BLOCK_DEPTH segments on a side. */
+#define SUBDIVIDE_BLOCK_DEPTH 3
+
+/* Vertices and blocks below which more threads are not worth it. */
+static const int myVerticesMinPerThread = 16384,
+                 myBlocksMinPerThread = 256;
+
+int getSubdividedVertexCount(int depth)
+{
+  int n = 1 << depth;
+
+  assert(depth >= 0 && depth <= 14);
+  return (n + 1) * (n + 2) / 2;
+}
+
+int getSubdividedTriangleCount(int depth)
+{
+  assert(depth >= 0 && depth <= 14);
+  return 1 << (2 * depth);
+}
+
+/* First vertex of lattice row j: rows shrink from n+1 vertices to 1. */
+static int vertexRowStart(int j, int n)
+{
+  return j * (n + 1) - j * (j - 1) / 2;
+}
+
+/* First triangle of row j of a lattice n triangles on a side: row j has
+   n-j upright and n-j-1 upside-down triangles. */
+static int triangleRowStart(int j, int n)
+{
+  return j * (2 * n - j);
+}
+
+static unsigned int packColor(float r, float g, float b)
+{
+  /* As D3DXCOLOR's conversion to DWORD. */
+  unsigned int R = r >= 1 ? 0xff : r <= 0 ? 0 : (unsigned int) (r * 255 + 0.5f),
+               G = g >= 1 ? 0xff : g <= 0 ? 0 : (unsigned int) (g * 255 + 0.5f),
+               B = b >= 1 ? 0xff : b <= 0 ? 0 : (unsigned int) (b * 255 + 0.5f);
+
+  return 0xff000000u | (R << 16) | (G << 8) | B;
+}
+
+typedef struct {
+  int n;
+  float a[2], b[2], c[2], ca[3], cb[3], cc[3];
+} SubdivideJob;
+
+struct VertexTask
+{
+  const SubdivideJob *job;
+  SubdividedVertex *vertices;
+
+  void operator()(int begin, int end) const
+  {
+    const SubdivideJob *s = job;
+    const int n = s->n;
+    const float scale = 1.0f / n;
+    int i, j = 0, v;
+
+    while (vertexRowStart(j + 1, n) <= begin)
+      j++;
+    i = begin - vertexRowStart(j, n);
+
+    for (v = begin; v < end; v++) {
+      float wb = i * scale, wc = j * scale, wa = (n - i - j) * scale;
+      SubdividedVertex *p = vertices + v;
+
+      p->x = wa * s->a[0] + wb * s->b[0] + wc * s->c[0];
+      p->y = wa * s->a[1] + wb * s->b[1] + wc * s->c[1];
+      p->z = 0;
+      p->color = packColor(wa * s->ca[0] + wb * s->cb[0] + wc * s->cc[0],
+                           wa * s->ca[1] + wb * s->cb[1] + wc * s->cc[1],
+                           wa * s->ca[2] + wb * s->cb[2] + wc * s->cc[2]);
+      if (++i > n - j) {
+        i = 0;
+        j++;
+      }
+    }
+  }
+};
+
+template <typename Index>
+struct TriangleTask
+{
+  const SubdivideJob *job;
+  Index *indices;
+
+  void operator()(int begin, int end) const
+  {
+    const int n = job->n,
+              m = n < (1 << SUBDIVIDE_BLOCK_DEPTH) ? n : 1 << SUBDIVIDE_BLOCK_DEPTH,
+              blocksPerSide = n / m;
+    int J = 0, block;
+
+    while (triangleRowStart(J + 1, blocksPerSide) <= begin)
+      J++;
+
+    for (block = begin; block < end; block++) {
+      int r, I, x0, y0, dir, i, j;
+      Index *p = indices + (size_t) block * 3 * m * m;
+
+      if (block >= triangleRowStart(J + 1, blocksPerSide))
+        J++;
+      r = block - triangleRowStart(J, blocksPerSide);
+      I = r / 2;
+
+      /* An upright block's lattice point (i, j) is (x0 + i, y0 + j); an
+         upside-down one is the same turned half way round about its
+         right-angle corner, which keeps the winding. */
+      if (r % 2 == 0) {
+        x0 = I * m;
+        y0 = J * m;
+        dir = 1;
+      } else {
+        x0 = (I + 1) * m;
+        y0 = (J + 1) * m;
+        dir = -1;
+      }
+
+#define VERTEX(i, j) ((Index) (vertexRowStart(y0 + dir*(j), n) + x0 + dir*(i)))
+      for (j = 0; j < m; j++) {
+        for (i = 0; i < m - j; i++) {
+          p[0] = VERTEX(i, j);
+          p[1] = VERTEX(i + 1, j);
+          p[2] = VERTEX(i, j + 1);
+          p += 3;
+          if (i < m - j - 1) {
+            p[0] = VERTEX(i + 1, j);
+            p[1] = VERTEX(i + 1, j + 1);
+            p[2] = VERTEX(i, j + 1);
+            p += 3;
+          }
+        }
+      }
+#undef VERTEX
+    }
+  }
+};
+
+static void copy(float *dst, const float *src, int count)
+{
+  int i;
+
+  for (i = 0; i < count; i++)
+    dst[i] = src[i];
+}
+
+template <typename Index>
+static void subdivide(SubdividedVertex *vertices, Index *indices, int depth,
+                      const float a[2], const float b[2], const float c[2],
+                      const float ca[3], const float cb[3], const float cc[3])
+{
+  SubdivideJob job;
+  VertexTask vertexTask;
+  TriangleTask<Index> triangleTask;
+  int blockDepth = depth < SUBDIVIDE_BLOCK_DEPTH ? depth : SUBDIVIDE_BLOCK_DEPTH;
+
+  assert(depth >= 0 && depth <= 14);
+  job.n = 1 << depth;
+  copy(job.a, a, 2);
+  copy(job.b, b, 2);
+  copy(job.c, c, 2);
+  copy(job.ca, ca, 3);
+  copy(job.cb, cb, 3);
+  copy(job.cc, cc, 3);
+
+  vertexTask.job = &job;
+  vertexTask.vertices = vertices;
+  parallelFor(getSubdividedVertexCount(depth), myVerticesMinPerThread, 1, vertexTask);
+
+  triangleTask.job = &job;
+  triangleTask.indices = indices;
+  parallelFor(getSubdividedTriangleCount(depth - blockDepth), myBlocksMinPerThread, 1,
+              triangleTask);
+}
+
+void subdivideTriangle(SubdividedVertex *vertices, unsigned int *indices, int depth,
+                       const float a[2], const float b[2], const float c[2],
+                       const float ca[3], const float cb[3], const float cc[3])
+{
+  subdivide(vertices, indices, depth, a, b, c, ca, cb, cc);
+}
+
+void subdivideTriangle16(SubdividedVertex *vertices, unsigned short *indices, int depth,
+                         const float a[2], const float b[2], const float c[2],
+                         const float ca[3], const float cb[3], const float cc[3])
+{
+  assert(getSubdividedVertexCount(depth) <= 65536);
+  subdivide(vertices, indices, depth, a, b, c, ca, cb, cc);
+}
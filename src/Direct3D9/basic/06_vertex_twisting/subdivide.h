@@ -0,0 +1,46 @@
+/* subdivide.h - Indexed, evenly subdivided triangles for 06_vertex_twisting. */
+
+/* Subdividing a triangle abc depth times, splitting every triangle into
+   four at its edge midpoints, puts the vertices on a barycentric lattice:
+   with n = 2^depth, vertex (i, j) for i, j >= 0 and i + j <= n sits at
+
+     ((n-i-j) a + i b + j c) / n
+
+   and its color is interpolated the same way.  Each lattice vertex is
+   stored once, row by row (j = 0 first, each row ordered by i), so the
+   vertex count is (n+1)(n+2)/2 instead of three per triangle, and the
+   4^depth triangles index them.
+
+   Triangles wind the same way as abc.  They are emitted in blocks of
+   8x8-segment sub-triangles, each one row by row, so neighboring
+   triangles share vertices in the post-transform cache, and the blocks are
+   generated on several threads (see parallel.h in cgfx_buffer_lighting).
+   Nothing is allocated: the caller sizes the arrays, for example by
+   locking vertex and index buffers, and depth 12 (16.7 million
+   triangles) needs 134 MB of vertices and 201 MB of indices. */
+
+#ifndef SUBDIVIDE_H
+#define SUBDIVIDE_H
+
+/* D3DFVF_XYZ | D3DFVF_DIFFUSE. */
+typedef struct {
+  float x, y, z;        /* z is always zero */
+  unsigned int color;   /* D3DCOLOR: 0xAARRGGBB */
+} SubdividedVertex;
+
+/* depth is 0 to 14. */
+int getSubdividedVertexCount(int depth);
+int getSubdividedTriangleCount(int depth);
+
+/* Write getSubdividedVertexCount(depth) vertices and 3 indices for each
+   of the getSubdividedTriangleCount(depth) triangles. */
+void subdivideTriangle(SubdividedVertex *vertices, unsigned int *indices, int depth,
+                       const float a[2], const float b[2], const float c[2],
+                       const float ca[3], const float cb[3], const float cc[3]);
+
+/* The same with 16-bit indices, for depth 8 and below. */
+void subdivideTriangle16(SubdividedVertex *vertices, unsigned short *indices, int depth,
+                         const float a[2], const float b[2], const float c[2],
+                         const float ca[3], const float cb[3], const float cc[3]);
+
+#endif /* SUBDIVIDE_H */